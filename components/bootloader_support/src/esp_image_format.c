@@ -957,7 +957,7 @@ static esp_err_t process_segment_data(intptr_t load_addr, uint32_t data_addr, ui
 
         ret = bootloader_flash_read((size_t)&src[i], pbuf, bytes, false);
         if (ret) {
-            ESP_LOGE(TAG, "bootloader read flash @ %p %d error %d", &src[i], bytes, ret);
+            ESP_LOGE(TAG, "bootloader read flash @ %p %d error %d", (const void *)&src[i], bytes, ret);
             goto exit;
         }
 
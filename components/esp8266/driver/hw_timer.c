@@ -230,6 +230,9 @@ esp_err_t hw_timer_deinit(void)
 
 esp_err_t hw_timer_init(hw_timer_callback_t callback, void *arg)
 {
+#ifdef CONFIG_ESP_TIMER_HW
+    HW_TIMER_CHECK(0, "FRC1 is used by esp_timer", ESP_FAIL);
+#endif
     HW_TIMER_CHECK(hw_timer_obj == NULL, "hw_timer has been initialized", ESP_FAIL);
     HW_TIMER_CHECK(callback != NULL, "callback pointer NULL", ESP_ERR_INVALID_ARG);
 
@@ -0,0 +1,110 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+/**
+ * @file esp_timer_list.h
+ * @brief Scheduling core of the hardware esp_timer engine
+ *
+ * Timers are kept in a list sorted by their absolute alarm time in microseconds.
+ * The list does not read the clock and does no locking: the caller passes the
+ * current time in and serializes all calls, so the core can be unit tested on
+ * the host with a mock clock.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/queue.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Entry of a timer list, embedded in the timer object
+ */
+typedef struct esp_timer_list_item {
+    uint64_t alarm;                                 //!< Absolute time of the next expiry, in microseconds
+    uint64_t period;                                //!< Period in microseconds, 0 for one-shot timers
+    uint32_t missed;                                //!< Periods skipped because the timer was serviced late
+    LIST_ENTRY(esp_timer_list_item) list_entry;     //!< Link to the neighbours in the list
+} esp_timer_list_item_t;
+
+/**
+ * @brief List of armed timers, sorted by alarm time
+ */
+typedef LIST_HEAD(esp_timer_list, esp_timer_list_item) esp_timer_list_t;
+
+/**
+ * @brief Initialize an empty timer list
+ */
+void esp_timer_list_init(esp_timer_list_t *list);
+
+/**
+ * @brief Initialize a timer list entry which is not in any list
+ */
+void esp_timer_list_item_init(esp_timer_list_item_t *item);
+
+/**
+ * @brief Check if the entry is currently in a list
+ */
+bool esp_timer_list_item_is_armed(const esp_timer_list_item_t *item);
+
+/**
+ * @brief Add an entry to the list
+ *
+ * Entries with the same alarm time expire in the order they were added.
+ *
+ * @param list timer list
+ * @param item entry which is not in any list
+ * @param alarm absolute time of the first expiry, in microseconds
+ * @param period period in microseconds, 0 for a one-shot timer
+ *
+ * @return true if the entry is now the first one to expire and the hardware alarm has to be updated
+ */
+bool esp_timer_list_add(esp_timer_list_t *list, esp_timer_list_item_t *item, uint64_t alarm, uint64_t period);
+
+/**
+ * @brief Remove an entry from the list
+ *
+ * @return true if the entry was the first one to expire and the hardware alarm has to be updated
+ */
+bool esp_timer_list_remove(esp_timer_list_t *list, esp_timer_list_item_t *item);
+
+/**
+ * @brief Get the alarm time of the first entry to expire
+ *
+ * @return absolute time in microseconds, UINT64_MAX if the list is empty
+ */
+uint64_t esp_timer_list_next_alarm(const esp_timer_list_t *list);
+
+/**
+ * @brief Take the next expired entry from the list
+ *
+ * Periodic entries are added back with their alarm advanced by whole periods,
+ * so they don't drift by the time it took to service them. If the entry was
+ * serviced more than one period late, the missed expiries are skipped and
+ * counted in the entry instead of being reported in a burst.
+ *
+ * @param list timer list
+ * @param now current time in microseconds
+ *
+ * @return the expired entry whose callback should be run, NULL if no entry has expired
+ */
+esp_timer_list_item_t *esp_timer_list_pop_expired(esp_timer_list_t *list, uint64_t now);
+
+#ifdef __cplusplus
+}
+#endif
@@ -29,14 +29,16 @@
  * use RTOS notification mechanisms (queues, semaphores, event groups, etc.) to
  * pass information to other tasks.
  *
- * To be implemented: it should be possible to request the callback to be called
- * directly from the ISR. This reduces the latency, but has potential impact on
- * all other callbacks which need to be dispatched. This option should only be
- * used for simple callback functions, which do not take longer than a few
- * microseconds to run.
- *
- * Implementation note: on the ESP32, esp_timer APIs use the "legacy" FRC2
- * timer. Timer callbacks are called from a task running on the PRO CPU.
+ * With CONFIG_ESP_TIMER_HW, it is possible to request the callback to be called
+ * directly from the ISR (ESP_TIMER_ISR). This reduces the latency, but has potential
+ * impact on all other callbacks which need to be dispatched. This option should
+ * only be used for simple callback functions, which do not take longer than a few
+ * microseconds to run, and which are placed in IRAM.
+ *
+ * Implementation note: on the ESP8266, esp_timer APIs use FreeRTOS software timers
+ * by default, so timeouts have to be multiples of the RTOS tick. With
+ * CONFIG_ESP_TIMER_HW, they use the FRC1 timer instead and have microsecond
+ * resolution; the hw_timer driver can't be used in this case.
  */
 
 #include <stdint.h>
@@ -47,11 +49,6 @@
 extern "C" {
 #endif
 
-/**
- * Important: This function is based on FreeRTOS timer not real time hard timer.
- *            Adding this just for some user passing compiling now.
- */
-
 /**
  * @brief Opaque type representing a single esp_timer
  */
@@ -69,13 +66,8 @@ typedef void (*esp_timer_cb_t)(void* arg);
  */
 typedef enum {
     ESP_TIMER_TASK,     //!< Callback is called from timer task
-
-    /* Not supported for now, provision to allow callbacks to run directly
-     * from an ISR:
-
-        ESP_TIMER_ISR,      //!< Callback is called from timer ISR
-
-     */
+    ESP_TIMER_ISR,      //!< Callback is called from timer ISR, only supported with CONFIG_ESP_TIMER_HW
+    ESP_TIMER_MAX,      //!< Count of the methods for dispatching timer callback
 } esp_timer_dispatch_t;
 
 /**
@@ -0,0 +1,302 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sdkconfig.h"
+
+#ifdef CONFIG_ESP_TIMER_HW
+
+#include <stdbool.h>
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_attr.h"
+#include "esp_task.h"
+#include "FreeRTOS.h"
+#include "freertos/task.h"
+#include "rom/ets_sys.h"
+#include "esp8266/eagle_soc.h"
+#include "esp8266/timer_struct.h"
+#include "driver/hw_timer.h"
+#include "driver/soc.h"
+#include "esp_private/esp_timer_list.h"
+
+#define FRC1_TICKS_PER_US       ((APB_CLK_FREQ) / 16 / 1000000)
+#define FRC1_MAX_ALARM_US       (0x7fffff / FRC1_TICKS_PER_US)
+
+/* Alarms closer than this are delayed, so that the ISR doesn't miss the edge while setting it */
+#define FRC1_MIN_ALARM_US       (10)
+
+struct esp_timer {
+    esp_timer_list_item_t   item;
+
+    esp_timer_cb_t          cb;
+
+    void                    *arg;
+
+    esp_timer_dispatch_t    dispatch_method;
+};
+
+static esp_timer_list_t s_timers[ESP_TIMER_MAX];
+
+static TaskHandle_t s_timer_task;
+
+/* Set from the ISR when task timers have expired, until the timer task has run them */
+static bool s_task_pending;
+
+/**
+ * @brief Program FRC1 for the first alarm of the timer lists, must be called with interrupts disabled
+ */
+static void IRAM_ATTR update_alarm(void)
+{
+    uint64_t alarm = esp_timer_list_next_alarm(&s_timers[ESP_TIMER_ISR]);
+    uint64_t now, delta;
+
+    if (!s_task_pending) {
+        uint64_t task_alarm = esp_timer_list_next_alarm(&s_timers[ESP_TIMER_TASK]);
+
+        if (task_alarm < alarm)
+            alarm = task_alarm;
+    }
+
+    frc1.ctrl.en = 0;
+    if (alarm == UINT64_MAX)
+        return;
+
+    now = esp_timer_get_time();
+    delta = alarm > now ? alarm - now : 0;
+    if (delta < FRC1_MIN_ALARM_US)
+        delta = FRC1_MIN_ALARM_US;
+    else if (delta > FRC1_MAX_ALARM_US)
+        delta = FRC1_MAX_ALARM_US;  // re-evaluated when it fires
+
+    frc1.ctrl.div = TIMER_CLKDIV_16;
+    frc1.ctrl.intr_type = TIMER_EDGE_INT;
+    frc1.ctrl.reload = 0;
+    frc1.load.data = (uint32_t)delta * FRC1_TICKS_PER_US;
+    frc1.ctrl.en = 1;
+}
+
+static void IRAM_ATTR esp_timer_isr(void *arg)
+{
+    esp_timer_list_item_t *item;
+    uint64_t now;
+
+    frc1.ctrl.en = 0;
+
+    now = esp_timer_get_time();
+    while ((item = esp_timer_list_pop_expired(&s_timers[ESP_TIMER_ISR], now)) != NULL) {
+        struct esp_timer *timer = (struct esp_timer *)item;
+
+        timer->cb(timer->arg);
+    }
+
+    if (!s_task_pending && esp_timer_list_next_alarm(&s_timers[ESP_TIMER_TASK]) <= now) {
+        BaseType_t woken = pdFALSE;
+
+        s_task_pending = true;
+        vTaskNotifyGiveFromISR(s_timer_task, &woken);
+        if (woken == pdTRUE)
+            portYIELD_FROM_ISR();
+    }
+
+    update_alarm();
+}
+
+static void esp_timer_task(void *arg)
+{
+    while (1) {
+        esp_timer_list_item_t *item;
+        esp_irqflag_t flag;
+
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        flag = soc_save_local_irq();
+        while ((item = esp_timer_list_pop_expired(&s_timers[ESP_TIMER_TASK], esp_timer_get_time())) != NULL) {
+            struct esp_timer *timer = (struct esp_timer *)item;
+            esp_timer_cb_t cb = timer->cb;
+            void *cb_arg = timer->arg;
+
+            // the callback may stop or delete its timer
+            soc_restore_local_irq(flag);
+            cb(cb_arg);
+            flag = soc_save_local_irq();
+        }
+        s_task_pending = false;
+        update_alarm();
+        soc_restore_local_irq(flag);
+    }
+}
+
+/**
+ * @brief Initialize esp_timer library
+ */
+esp_err_t esp_timer_init(void)
+{
+    if (s_timer_task)
+        return ESP_ERR_INVALID_STATE;
+
+    for (int i = 0; i < ESP_TIMER_MAX; i++)
+        esp_timer_list_init(&s_timers[i]);
+    s_task_pending = false;
+
+    if (xTaskCreate(esp_timer_task, "esp_timer", ESP_TASK_TIMER_STACK, NULL, ESP_TASK_TIMER_PRIO, &s_timer_task) != pdPASS) {
+        s_timer_task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    frc1.ctrl.val = 0;
+    _xt_isr_attach(ETS_FRC_TIMER1_INUM, esp_timer_isr, NULL);
+    TM1_EDGE_INT_ENABLE();
+    _xt_isr_unmask(1 << ETS_FRC_TIMER1_INUM);
+
+    return ESP_OK;
+}
+
+/**
+ * @brief De-initialize esp_timer library
+ */
+esp_err_t esp_timer_deinit(void)
+{
+    if (!s_timer_task)
+        return ESP_ERR_INVALID_STATE;
+
+    for (int i = 0; i < ESP_TIMER_MAX; i++) {
+        if (esp_timer_list_next_alarm(&s_timers[i]) != UINT64_MAX)
+            return ESP_ERR_INVALID_STATE;
+    }
+
+    _xt_isr_mask(1 << ETS_FRC_TIMER1_INUM);
+    TM1_EDGE_INT_DISABLE();
+    _xt_isr_attach(ETS_FRC_TIMER1_INUM, NULL, NULL);
+    frc1.ctrl.val = 0;
+
+    vTaskDelete(s_timer_task);
+    s_timer_task = NULL;
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Create an esp_timer instance
+ */
+esp_err_t esp_timer_create(const esp_timer_create_args_t* create_args,
+                           esp_timer_handle_t* out_handle)
+{
+    assert(create_args);
+    assert(out_handle);
+
+    esp_timer_handle_t esp_timer;
+
+    if (!s_timer_task)
+        return ESP_ERR_INVALID_STATE;
+
+    if (!create_args->callback || create_args->dispatch_method >= ESP_TIMER_MAX)
+        return ESP_ERR_INVALID_ARG;
+
+    // accessed from the ISR, so it must not be placed in IRAM
+    esp_timer = heap_caps_malloc(sizeof(struct esp_timer), MALLOC_CAP_8BIT);
+    if (!esp_timer)
+        return ESP_ERR_NO_MEM;
+
+    esp_timer_list_item_init(&esp_timer->item);
+    esp_timer->cb = create_args->callback;
+    esp_timer->arg = create_args->arg;
+    esp_timer->dispatch_method = create_args->dispatch_method;
+    *out_handle = esp_timer;
+
+    return ESP_OK;
+}
+
+static esp_err_t IRAM_ATTR start_timer(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period)
+{
+    esp_err_t ret = ESP_OK;
+    esp_irqflag_t flag;
+
+    assert(timer);
+
+    flag = soc_save_local_irq();
+    if (esp_timer_list_item_is_armed(&timer->item)) {
+        ret = ESP_ERR_INVALID_STATE;
+    } else {
+        timer->item.missed = 0;
+        if (esp_timer_list_add(&s_timers[timer->dispatch_method], &timer->item, esp_timer_get_time() + timeout_us, period))
+            update_alarm();
+    }
+    soc_restore_local_irq(flag);
+
+    return ret;
+}
+
+/**
+ * @brief Start one-shot timer
+ */
+esp_err_t IRAM_ATTR esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return start_timer(timer, timeout_us, 0);
+}
+
+/**
+ * @brief Start a periodic timer
+ */
+esp_err_t IRAM_ATTR esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+    if (!period)
+        return ESP_ERR_INVALID_ARG;
+
+    return start_timer(timer, period, period);
+}
+
+/**
+ * @brief Stop the timer
+ */
+esp_err_t IRAM_ATTR esp_timer_stop(esp_timer_handle_t timer)
+{
+    esp_err_t ret = ESP_OK;
+    esp_irqflag_t flag;
+
+    assert(timer);
+
+    flag = soc_save_local_irq();
+    if (!esp_timer_list_item_is_armed(&timer->item)) {
+        ret = ESP_ERR_INVALID_STATE;
+    } else if (esp_timer_list_remove(&s_timers[timer->dispatch_method], &timer->item)) {
+        update_alarm();
+    }
+    soc_restore_local_irq(flag);
+
+    return ret;
+}
+
+/**
+ * @brief Delete an esp_timer instance
+ */
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    esp_irqflag_t flag;
+
+    assert(timer);
+
+    // a running timer is stopped first, as the FreeRTOS timer backend does
+    flag = soc_save_local_irq();
+    if (esp_timer_list_item_is_armed(&timer->item)) {
+        if (esp_timer_list_remove(&s_timers[timer->dispatch_method], &timer->item))
+            update_alarm();
+    }
+    soc_restore_local_irq(flag);
+
+    heap_caps_free(timer);
+
+    return ESP_OK;
+}
+
+#endif /* CONFIG_ESP_TIMER_HW */
@@ -0,0 +1,106 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stddef.h>
+#include "esp_private/esp_timer_list.h"
+
+/*
+ * The functions are called from the timer ISR. They are placed in IRAM by the
+ * linker fragment of this component, so that the file builds unchanged on the host.
+ */
+
+void esp_timer_list_init(esp_timer_list_t *list)
+{
+    LIST_INIT(list);
+}
+
+void esp_timer_list_item_init(esp_timer_list_item_t *item)
+{
+    item->alarm = 0;
+    item->period = 0;
+    item->missed = 0;
+    item->list_entry.le_next = NULL;
+    item->list_entry.le_prev = NULL;
+}
+
+bool esp_timer_list_item_is_armed(const esp_timer_list_item_t *item)
+{
+    return item->list_entry.le_prev != NULL;
+}
+
+bool esp_timer_list_add(esp_timer_list_t *list, esp_timer_list_item_t *item, uint64_t alarm, uint64_t period)
+{
+    esp_timer_list_item_t *it, *last = NULL;
+
+    item->alarm = alarm;
+    item->period = period;
+
+    LIST_FOREACH(it, list, list_entry) {
+        if (it->alarm > alarm) {
+            break;
+        }
+        last = it;
+    }
+
+    if (last) {
+        LIST_INSERT_AFTER(last, item, list_entry);
+    } else {
+        LIST_INSERT_HEAD(list, item, list_entry);
+    }
+
+    return LIST_FIRST(list) == item;
+}
+
+bool esp_timer_list_remove(esp_timer_list_t *list, esp_timer_list_item_t *item)
+{
+    bool first = LIST_FIRST(list) == item;
+
+    LIST_REMOVE(item, list_entry);
+    item->list_entry.le_next = NULL;
+    item->list_entry.le_prev = NULL;
+
+    return first;
+}
+
+uint64_t esp_timer_list_next_alarm(const esp_timer_list_t *list)
+{
+    const esp_timer_list_item_t *first = LIST_FIRST(list);
+
+    return first ? first->alarm : UINT64_MAX;
+}
+
+esp_timer_list_item_t *esp_timer_list_pop_expired(esp_timer_list_t *list, uint64_t now)
+{
+    esp_timer_list_item_t *item = LIST_FIRST(list);
+
+    if (!item || item->alarm > now) {
+        return NULL;
+    }
+
+    esp_timer_list_remove(list, item);
+
+    if (item->period) {
+        uint64_t alarm = item->alarm + item->period;
+
+        if (alarm <= now) {
+            uint64_t missed = (now - alarm) / item->period + 1;
+
+            alarm += missed * item->period;
+            item->missed += missed;
+        }
+        esp_timer_list_add(list, item, alarm, item->period);
+    }
+
+    return item;
+}
@@ -27,6 +27,7 @@
 #include "esp_phy_init.h"
 #include "esp_heap_caps_init.h"
 #include "esp_task_wdt.h"
+#include "esp_timer.h"
 #include "esp_private/wifi.h"
 #include "esp_private/esp_system_internal.h"
 #include "esp8266/eagle_soc.h"
@@ -97,6 +98,14 @@ static void user_init_entry(void *param)
     assert(th25q16hb_apply_patch_0() == 0);
 #endif
 
+#ifdef CONFIG_ESP_TIMER_HW
+    assert(esp_timer_init() == ESP_OK);
+#endif
+
+#ifdef CONFIG_LOG_ASYNC
+    assert(esp_log_async_init() == ESP_OK);
+#endif
+
     app_main();
 
     vTaskDelete(NULL);
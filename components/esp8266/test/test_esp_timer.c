@@ -111,3 +111,117 @@ TEST_CASE("Test esp_timer create and delete once mode", "[log]")
 
     vSemaphoreDelete(sem);
 }
+
+#ifdef CONFIG_ESP_TIMER_HW
+
+typedef struct {
+    SemaphoreHandle_t sem;
+    bool from_isr;
+    int64_t times[ESP_NUM_MAX];
+    volatile int count;
+} test_timer_stamp_t;
+
+static void IRAM_ATTR test_timer_stamp_cb(void *p)
+{
+    test_timer_stamp_t *stamp = (test_timer_stamp_t *)p;
+
+    if (stamp->count < ESP_NUM_MAX)
+        stamp->times[stamp->count++] = esp_timer_get_time();
+    if (stamp->count == ESP_NUM_MAX) {
+        if (stamp->from_isr) {
+            BaseType_t woken = pdFALSE;
+
+            xSemaphoreGiveFromISR(stamp->sem, &woken);
+        } else
+            xSemaphoreGive(stamp->sem);
+    }
+}
+
+static void test_timer_stamp(esp_timer_dispatch_t dispatch_method, bool periodic, uint64_t timeout, int64_t max_late)
+{
+    test_timer_stamp_t stamp = { 0 };
+    esp_timer_handle_t timer;
+    int64_t start;
+
+    stamp.sem = xSemaphoreCreateBinary();
+    TEST_ASSERT_NOT_NULL(stamp.sem);
+    stamp.from_isr = dispatch_method == ESP_TIMER_ISR;
+
+    esp_timer_create_args_t timer_args = {
+        .callback = test_timer_stamp_cb,
+        .arg = &stamp,
+        .dispatch_method = dispatch_method,
+        .name = "test_stamp",
+    };
+
+    TEST_ESP_OK(esp_timer_create(&timer_args, &timer));
+
+    start = esp_timer_get_time();
+    if (periodic) {
+        TEST_ESP_OK(esp_timer_start_periodic(timer, timeout));
+    } else {
+        for (int i = 0; i < ESP_NUM_MAX; i++) {
+            start = esp_timer_get_time();
+            TEST_ESP_OK(esp_timer_start_once(timer, timeout));
+            while (stamp.count == i)
+                ;
+            stamp.times[i] -= start;
+        }
+    }
+    TEST_ASSERT_EQUAL_HEX32(pdPASS, xSemaphoreTake(stamp.sem, 1000 / portTICK_PERIOD_MS));
+    TEST_ESP_OK(esp_timer_delete(timer));
+
+    for (int i = 0; i < ESP_NUM_MAX; i++) {
+        // periodic expiries stay on the grid of the first start, they don't accumulate the latency
+        int64_t delta = periodic ? stamp.times[i] - start - (int64_t)timeout * (i + 1) : stamp.times[i] - (int64_t)timeout;
+
+        printf("expiry %d: %d us late\n", i, (int)delta);
+        TEST_ASSERT(delta >= 0);
+        TEST_ASSERT(delta <= max_late);
+    }
+
+    vSemaphoreDelete(stamp.sem);
+}
+
+TEST_CASE("Test esp_timer one-shot with microsecond timeout from ISR", "[esp_timer]")
+{
+    test_timer_stamp(ESP_TIMER_ISR, false, 500, 50);
+}
+
+TEST_CASE("Test esp_timer periodic doesn't drift", "[esp_timer]")
+{
+    test_timer_stamp(ESP_TIMER_ISR, true, 2000, 50);
+    test_timer_stamp(ESP_TIMER_TASK, true, 5000, 500);
+}
+
+TEST_CASE("Test esp_timer stop and restart", "[esp_timer]")
+{
+    SemaphoreHandle_t sem;
+    esp_timer_handle_t timer;
+
+    sem = xSemaphoreCreateCounting(ESP_NUM_MAX, 0);
+    TEST_ASSERT_NOT_NULL(sem);
+
+    esp_timer_create_args_t timer_args = {
+        .callback = test_timer_cb,
+        .arg = sem,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "test_timer",
+    };
+
+    TEST_ESP_OK(esp_timer_create(&timer_args, &timer));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, esp_timer_stop(timer));
+    TEST_ESP_OK(esp_timer_start_once(timer, ESP_TIMER_PERIOD));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, esp_timer_start_once(timer, ESP_TIMER_PERIOD));
+    TEST_ESP_OK(esp_timer_stop(timer));
+    TEST_ASSERT_EQUAL_HEX32(pdFALSE, xSemaphoreTake(sem, 2 * ESP_TIMER_PERIOD / 1000 / portTICK_PERIOD_MS));
+
+    TEST_ESP_OK(esp_timer_start_once(timer, ESP_TIMER_PERIOD));
+    TEST_ASSERT_EQUAL_HEX32(pdPASS, xSemaphoreTake(sem, 2 * ESP_TIMER_PERIOD / 1000 / portTICK_PERIOD_MS));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, esp_timer_start_periodic(timer, 0));
+    TEST_ESP_OK(esp_timer_delete(timer));
+
+    vSemaphoreDelete(sem);
+}
+
+#endif /* CONFIG_ESP_TIMER_HW */
@@ -0,0 +1,208 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "catch.hpp"
+#include "esp_private/esp_timer_list.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+/* Mock clock, advanced by the tests instead of reading the hardware */
+class MockClock
+{
+public:
+    MockClock(esp_timer_list_t* list) : mList(list) { }
+
+    // Moves the clock to `time` and returns the expired entries in the order they were reported
+    std::vector<esp_timer_list_item_t*> advance(uint64_t time)
+    {
+        std::vector<esp_timer_list_item_t*> expired;
+        esp_timer_list_item_t* item;
+
+        mNow = time;
+        while ((item = esp_timer_list_pop_expired(mList, mNow)) != nullptr) {
+            expired.push_back(item);
+        }
+        return expired;
+    }
+
+    uint64_t now() const
+    {
+        return mNow;
+    }
+
+protected:
+    esp_timer_list_t* mList;
+    uint64_t mNow = 0;
+};
+
+TEST_CASE("timers expire in order of their alarm time", "[esp_timer_list]")
+{
+    esp_timer_list_t list;
+    esp_timer_list_item_t items[4];
+    MockClock clock(&list);
+
+    esp_timer_list_init(&list);
+    for (auto& item : items) {
+        esp_timer_list_item_init(&item);
+    }
+
+    CHECK(esp_timer_list_next_alarm(&list) == UINT64_MAX);
+    CHECK(esp_timer_list_add(&list, &items[0], 300, 0));
+    CHECK(esp_timer_list_add(&list, &items[1], 100, 0));
+    CHECK_FALSE(esp_timer_list_add(&list, &items[2], 200, 0));
+    CHECK_FALSE(esp_timer_list_add(&list, &items[3], 100, 0));
+    CHECK(esp_timer_list_next_alarm(&list) == 100);
+
+    CHECK(clock.advance(99).empty());
+
+    auto expired = clock.advance(100);
+    REQUIRE(expired.size() == 2);
+    CHECK(expired[0] == &items[1]);
+    CHECK(expired[1] == &items[3]);  // same alarm, expires after the one added first
+    CHECK_FALSE(esp_timer_list_item_is_armed(&items[1]));
+    CHECK(esp_timer_list_next_alarm(&list) == 200);
+
+    expired = clock.advance(1000);
+    REQUIRE(expired.size() == 2);
+    CHECK(expired[0] == &items[2]);
+    CHECK(expired[1] == &items[0]);
+    CHECK(esp_timer_list_next_alarm(&list) == UINT64_MAX);
+}
+
+TEST_CASE("removing the first timer reports that the alarm has to be updated", "[esp_timer_list]")
+{
+    esp_timer_list_t list;
+    esp_timer_list_item_t a, b;
+    MockClock clock(&list);
+
+    esp_timer_list_init(&list);
+    esp_timer_list_item_init(&a);
+    esp_timer_list_item_init(&b);
+    CHECK_FALSE(esp_timer_list_item_is_armed(&a));
+
+    esp_timer_list_add(&list, &a, 10, 0);
+    esp_timer_list_add(&list, &b, 20, 0);
+    CHECK(esp_timer_list_item_is_armed(&a));
+
+    CHECK_FALSE(esp_timer_list_remove(&list, &b));
+    CHECK_FALSE(esp_timer_list_item_is_armed(&b));
+    CHECK(esp_timer_list_next_alarm(&list) == 10);
+
+    esp_timer_list_add(&list, &b, 20, 0);
+    CHECK(esp_timer_list_remove(&list, &a));
+    CHECK(esp_timer_list_next_alarm(&list) == 20);
+
+    auto expired = clock.advance(30);
+    REQUIRE(expired.size() == 1);
+    CHECK(expired[0] == &b);
+}
+
+TEST_CASE("periodic timer doesn't drift when serviced late", "[esp_timer_list]")
+{
+    esp_timer_list_t list;
+    esp_timer_list_item_t item;
+    MockClock clock(&list);
+
+    esp_timer_list_init(&list);
+    esp_timer_list_item_init(&item);
+    esp_timer_list_add(&list, &item, 1000, 1000);
+
+    // each expiry is serviced a bit late, the alarms stay on the period grid
+    for (uint64_t n = 1; n <= 100; ++n) {
+        auto expired = clock.advance(n * 1000 + 37);
+        REQUIRE(expired.size() == 1);
+        CHECK(esp_timer_list_next_alarm(&list) == (n + 1) * 1000);
+    }
+    CHECK(item.missed == 0);
+    CHECK(esp_timer_list_item_is_armed(&item));
+}
+
+TEST_CASE("periodic timer skips and counts the periods it missed", "[esp_timer_list]")
+{
+    esp_timer_list_t list;
+    esp_timer_list_item_t item;
+    MockClock clock(&list);
+
+    esp_timer_list_init(&list);
+    esp_timer_list_item_init(&item);
+    esp_timer_list_add(&list, &item, 100, 100);
+
+    // serviced at 450: the expiries at 200, 300 and 400 are reported as missed
+    auto expired = clock.advance(450);
+    REQUIRE(expired.size() == 1);
+    CHECK(item.missed == 3);
+    CHECK(esp_timer_list_next_alarm(&list) == 500);
+
+    // serviced exactly on the next alarm
+    expired = clock.advance(500);
+    REQUIRE(expired.size() == 1);
+    CHECK(item.missed == 3);
+    CHECK(esp_timer_list_next_alarm(&list) == 600);
+}
+
+TEST_CASE("periodic and one-shot timers interleave", "[esp_timer_list]")
+{
+    esp_timer_list_t list;
+    esp_timer_list_item_t periodic, once;
+    MockClock clock(&list);
+
+    esp_timer_list_init(&list);
+    esp_timer_list_item_init(&periodic);
+    esp_timer_list_item_init(&once);
+    esp_timer_list_add(&list, &periodic, 100, 100);
+    esp_timer_list_add(&list, &once, 250, 0);
+
+    std::vector<esp_timer_list_item_t*> order;
+    for (uint64_t t = 0; t <= 400; t += 50) {
+        auto expired = clock.advance(t);
+        order.insert(order.end(), expired.begin(), expired.end());
+    }
+
+    std::vector<esp_timer_list_item_t*> expected = {&periodic, &periodic, &once, &periodic, &periodic};
+    CHECK(order == expected);
+    CHECK_FALSE(esp_timer_list_item_is_armed(&once));
+    CHECK(esp_timer_list_next_alarm(&list) == 500);
+}
+
+TEST_CASE("dump esp_timer_list performance", "[esp_timer_list][benchmark]")
+{
+    const size_t count = 1000;
+    const size_t periods = 100;
+    std::vector<esp_timer_list_item_t> items(count);
+    std::mt19937 gen(0x3b95);
+    std::uniform_int_distribution<uint64_t> dist(1000, 100000);
+    esp_timer_list_t list;
+    MockClock clock(&list);
+
+    esp_timer_list_init(&list);
+
+    auto start = std::chrono::steady_clock::now();
+    for (auto& item : items) {
+        esp_timer_list_item_init(&item);
+        esp_timer_list_add(&list, &item, dist(gen), dist(gen));
+    }
+    auto added = std::chrono::steady_clock::now();
+
+    size_t fired = 0;
+    for (uint64_t t = 1000; t <= 100000 * periods; t += 1000) {
+        fired += clock.advance(t).size();
+    }
+    auto done = std::chrono::steady_clock::now();
+
+    CHECK(fired >= count * (periods - 1));
+    printf("%zu timers: add %.1f ns/timer, expire %.1f ns/expiry\n", count,
+           std::chrono::duration<double, std::nano>(added - start).count() / count,
+           std::chrono::duration<double, std::nano>(done - added).count() / fired);
+}
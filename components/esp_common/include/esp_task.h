@@ -43,5 +43,7 @@
 #define ESP_TASK_TCPIP_STACK          (CONFIG_LWIP_TCPIP_TASK_STACK_SIZE)
 #define ESP_TASK_MAIN_PRIO            (ESP_TASK_PRIO_MIN + 1)
 #define ESP_TASK_MAIN_STACK           (CONFIG_ESP_MAIN_TASK_STACK_SIZE + TASK_EXTRA_STACK_SIZE)
+#define ESP_TASK_LOG_PRIO             (ESP_TASK_PRIO_MIN + 1)
+#define ESP_TASK_LOG_STACK            (CONFIG_LOG_ASYNC_TASK_STACK_SIZE + TASK_EXTRA_STACK_SIZE)
 
 #endif
@@ -55,6 +55,35 @@ esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id,
             event_data, event_data_size, ticks_to_wait);
 }
 
+esp_err_t esp_event_post_with_priority(esp_event_base_t event_base, int32_t event_id,
+        void* event_data, size_t event_data_size, esp_event_priority_t priority, TickType_t ticks_to_wait)
+{
+    if (s_default_loop == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    return esp_event_post_to_with_priority(s_default_loop, event_base, event_id,
+            event_data, event_data_size, priority, ticks_to_wait);
+}
+
+esp_err_t esp_event_coalesce_register(esp_event_base_t event_base, int32_t event_id)
+{
+    if (s_default_loop == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    return esp_event_coalesce_register_with(s_default_loop, event_base, event_id);
+}
+
+esp_err_t esp_event_coalesce_unregister(esp_event_base_t event_base, int32_t event_id)
+{
+    if (s_default_loop == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    return esp_event_coalesce_unregister_with(s_default_loop, event_base, event_id);
+}
+
 
 #if CONFIG_ESP_EVENT_POST_FROM_ISR
 esp_err_t esp_event_isr_post(esp_event_base_t event_base, int32_t event_id,
@@ -81,7 +110,9 @@ esp_err_t esp_event_loop_create_default()
         .task_name = "sys_evt",
         .task_stack_size = ESP_TASKD_EVENT_STACK,
         .task_priority = ESP_TASKD_EVENT_PRIO,
-        .task_core_id = 0
+        .task_core_id = 0,
+        .data_inline_size = CONFIG_ESP_EVENT_DEFAULT_LOOP_DATA_INLINE_SIZE,
+        .queue_size_high = CONFIG_ESP_EVENT_DEFAULT_LOOP_QUEUE_SIZE_HIGH
     };
 
     esp_err_t err;
@@ -16,6 +16,8 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <inttypes.h>
+#include <sys/param.h>
 
 #include "esp_log.h"
 
@@ -29,11 +31,18 @@
 
 /* ---------------------------- Definitions --------------------------------- */
 
+// Queue items are read to the stack, so the size of data carried in them is limited
+#define DATA_INLINE_SIZE_MAX          128
+
+// Inline event data is carried in the queue item, right after the post
+#define POST_DATA_INLINE(post)        ((void*)((post) + 1))
+
 #ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
-// LOOP @<address, name> rx:<recieved events no.> dr:<dropped events no.>
-#define LOOP_DUMP_FORMAT              "LOOP @%p,%s rx:%u dr:%u\n"
+// LOOP @<address, name> rx:<recieved events no.> dr:<dropped events no.> co:<coalesced events no.>
+//      in:<inline data no.> pl:<pool data no.> hp:<heap data no.>
+#define LOOP_DUMP_FORMAT              "LOOP @%p,%s rx:%u dr:%u co:%u in:%u pl:%u hp:%u\n"
  // handler @<address> ev:<base, id> inv:<times invoked> time:<runtime>
-#define HANDLER_DUMP_FORMAT           "  HANDLER @%p ev:%s,%s inv:%u time:%lld us\n"
+#define HANDLER_DUMP_FORMAT           "  HANDLER @%p ev:%s,%s inv:%u time:%" PRId64 " us\n"
 
 #define PRINT_DUMP_INFO(dst, sz, ...)  do { \
                                             int cb = snprintf(dst, sz, __VA_ARGS__); \
@@ -97,7 +106,7 @@ static int esp_event_dump_prepare()
 
     // Reserve slightly more memory than computed
     int allowance = 3;
-    int size = (((loops + allowance) * (sizeof(LOOP_DUMP_FORMAT) + 10 + 20 + 2 * 11)) +
+    int size = (((loops + allowance) * (sizeof(LOOP_DUMP_FORMAT) + 10 + 20 + 6 * 11)) +
                         ((handlers + allowance) * (sizeof(HANDLER_DUMP_FORMAT) + 10 + 2 * 20 + 11 + 20)));
 
     return size;
@@ -122,34 +131,42 @@ static void esp_event_loop_run_task(void* args)
     vTaskSuspend(NULL);
 }
 
-static void handler_execute(esp_event_loop_instance_t* loop, esp_event_handler_instance_t *handler, esp_event_post_instance_t post)
+static void* post_instance_data(esp_event_post_instance_t* post)
 {
-    ESP_LOGD(TAG, "running post %s:%d with handler %p on loop %p", post.base, post.id, handler->handler, loop);
+    if (post->data_inline) {
+        return POST_DATA_INLINE(post);
+    }
+#if CONFIG_ESP_EVENT_POST_FROM_ISR
+    if (!post->data_set) {
+        return NULL;
+    }
+    return post->data_allocated ? post->data.ptr : &post->data.val;
+#else
+    return post->data;
+#endif
+}
+
+static void handler_execute(esp_event_loop_instance_t* loop, esp_event_handler_instance_t *handler, esp_event_post_instance_t* post)
+{
+    ESP_LOGD(TAG, "running post %s:%d with handler %p on loop %p", post->base, post->id, handler->handler, loop);
 
 #ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
     int64_t start, diff;
+    loop->running_handler = handler;
     start = esp_timer_get_time();
 #endif
     // Execute the handler
-#if CONFIG_ESP_EVENT_POST_FROM_ISR
-    void* data_ptr = NULL;
-
-    if (post.data_set) {
-        if (post.data_allocated) {
-            data_ptr = post.data.ptr;
-        } else {
-            data_ptr = &post.data.val;
-        }
-    }
-
-    (*(handler->handler))(handler->arg, post.base, post.id, data_ptr);
-#else
-    (*(handler->handler))(handler->arg, post.base, post.id, post.data);
-#endif
+    (*(handler->handler))(handler->arg, post->base, post->id, post_instance_data(post));
 
 #ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
     diff = esp_timer_get_time() - start;
 
+    if (loop->running_handler != handler) {
+        // The handler may have been unregistered while running and freed
+        return;
+    }
+    loop->running_handler = NULL;
+
     xSemaphoreTake(loop->profiling_mutex, portMAX_DELAY);
 
     handler->invoked++;
@@ -392,20 +409,424 @@ static void loop_node_remove_all_handler(esp_event_loop_node_t* loop_node)
     }
 }
 
-static void inline __attribute__((always_inline)) post_instance_delete(esp_event_post_instance_t* post)
+// Executes the handler unless it has already been executed for the running dispatch, returns true if
+// it registered or unregistered handlers
+static bool handler_dispatch(esp_event_loop_instance_t* loop, esp_event_handler_instance_t *handler, esp_event_post_instance_t* post, bool* exec)
+{
+    uint32_t changes = loop->handlers_changes;
+
+    if (handler->dispatch_seq == loop->dispatch_seq) {
+        return false;
+    }
+    handler->dispatch_seq = loop->dispatch_seq;
+
+    handler_execute(loop, handler, post);
+    *exec = true;
+
+    return loop->handlers_changes != changes;
+}
+
+// Executes the handlers for the post by walking the handler lists, in the order they were registered
+static bool loop_dispatch_lists(esp_event_loop_instance_t* loop, esp_event_post_instance_t* post)
+{
+    bool exec = false;
+
+    esp_event_handler_instance_t *handler;
+    esp_event_loop_node_t *loop_node;
+    esp_event_base_node_t *base_node;
+    esp_event_id_node_t *id_node;
+
+    if (++loop->dispatch_seq == 0) {
+        // Zero is the sequence number of handlers which have never been executed
+        loop->dispatch_seq = 1;
+    }
+
+    // When a handler changes the lists, the nodes being walked may have been freed. The walk starts
+    // over, skipping the handlers which have already been executed for this post.
+restart:
+    SLIST_FOREACH(loop_node, &(loop->loop_nodes), next) {
+        // Execute loop level handlers
+        SLIST_FOREACH(handler, &(loop_node->handlers), next) {
+            if (handler_dispatch(loop, handler, post, &exec)) {
+                goto restart;
+            }
+        }
+
+        SLIST_FOREACH(base_node, &(loop_node->base_nodes), next) {
+            if (base_node->base == post->base) {
+                // Execute base level handlers
+                SLIST_FOREACH(handler, &(base_node->handlers), next) {
+                    if (handler_dispatch(loop, handler, post, &exec)) {
+                        goto restart;
+                    }
+                }
+
+                SLIST_FOREACH(id_node, &(base_node->id_nodes), next) {
+                    if (id_node->id == post->id) {
+                        // Execute id level handlers
+                        SLIST_FOREACH(handler, &(id_node->handlers), next) {
+                            if (handler_dispatch(loop, handler, post, &exec)) {
+                                goto restart;
+                            }
+                        }
+                        // Skip to next base node
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    return exec;
+}
+
+#ifdef CONFIG_ESP_EVENT_LOOP_DISPATCH_TABLE
+static inline uint32_t dispatch_table_hash(esp_event_base_t base, int32_t id)
+{
+    uint32_t hash = (uint32_t)(uintptr_t)base * 0x9E3779B1 ^ (uint32_t)id * 0x85EBCA6B;
+
+    return hash ^ (hash >> 15);
+}
+
+static const esp_event_dispatch_entry_t* dispatch_table_find(const esp_event_dispatch_table_t* table, esp_event_base_t base, int32_t id)
+{
+    // Look for the id level entry first, then for the base level one
+    for (int i = 0; i < 2; i++, id = ESP_EVENT_ANY_ID) {
+        uint32_t slot = dispatch_table_hash(base, id) & table->mask;
+
+        while (table->entries[slot].base) {
+            if (table->entries[slot].base == base && table->entries[slot].id == id) {
+                return &table->entries[slot];
+            }
+            slot = (slot + 1) & table->mask;
+        }
+    }
+
+    return &table->any;
+}
+
+static esp_event_dispatch_entry_t* dispatch_table_insert(esp_event_dispatch_table_t* table, esp_event_base_t base, int32_t id, bool* inserted)
+{
+    uint32_t slot = dispatch_table_hash(base, id) & table->mask;
+
+    while (table->entries[slot].base) {
+        if (table->entries[slot].base == base && table->entries[slot].id == id) {
+            *inserted = false;
+            return &table->entries[slot];
+        }
+        slot = (slot + 1) & table->mask;
+    }
+
+    table->entries[slot].base = base;
+    table->entries[slot].id = id;
+    *inserted = true;
+
+    return &table->entries[slot];
+}
+
+// Collects the handlers loop_dispatch_lists() would execute for the event, returns their number.
+// Pass NULL to only count them.
+static uint32_t loop_collect_handlers(esp_event_loop_instance_t* loop, esp_event_base_t base, int32_t id,
+                                      esp_event_handler_instance_t** handlers)
+{
+    uint32_t count = 0;
+
+    esp_event_handler_instance_t *handler;
+    esp_event_loop_node_t *loop_node;
+    esp_event_base_node_t *base_node;
+    esp_event_id_node_t *id_node;
+
+    SLIST_FOREACH(loop_node, &(loop->loop_nodes), next) {
+        SLIST_FOREACH(handler, &(loop_node->handlers), next) {
+            if (handlers) {
+                handlers[count] = handler;
+            }
+            count++;
+        }
+
+        SLIST_FOREACH(base_node, &(loop_node->base_nodes), next) {
+            if (base_node->base == base) {
+                SLIST_FOREACH(handler, &(base_node->handlers), next) {
+                    if (handlers) {
+                        handlers[count] = handler;
+                    }
+                    count++;
+                }
+
+                SLIST_FOREACH(id_node, &(base_node->id_nodes), next) {
+                    if (id_node->id == id) {
+                        SLIST_FOREACH(handler, &(id_node->handlers), next) {
+                            if (handlers) {
+                                handlers[count] = handler;
+                            }
+                            count++;
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    return count;
+}
+
+static void loop_dispatch_table_set(esp_event_loop_instance_t* loop, esp_event_dispatch_table_t* table)
+{
+    esp_event_dispatch_table_t* old = loop->dispatch_table;
+
+    loop->dispatch_table = table;
+
+    // The table a handler is being dispatched from is freed once the dispatch moves on
+    if (old && old != loop->dispatch_in_use) {
+        free(old->handlers);
+        free(old);
+    }
+}
+
+// Rebuilds the dispatch table from the handler lists, must be called with the loop mutex taken
+static esp_err_t loop_dispatch_table_rebuild(esp_event_loop_instance_t* loop)
+{
+    esp_event_loop_node_t *loop_node;
+    esp_event_base_node_t *base_node;
+    esp_event_id_node_t *id_node;
+    uint32_t keys = 0, slots = 1, total;
+
+    SLIST_FOREACH(loop_node, &(loop->loop_nodes), next) {
+        SLIST_FOREACH(base_node, &(loop_node->base_nodes), next) {
+            keys++;
+            SLIST_FOREACH(id_node, &(base_node->id_nodes), next) {
+                keys++;
+            }
+        }
+    }
+
+    // Keep the load factor at 1/2 at most, so the probe sequences stay short
+    while (slots < keys * 2) {
+        slots <<= 1;
+    }
+
+    esp_event_dispatch_table_t* table = calloc(1, sizeof(*table) + slots * sizeof(table->entries[0]));
+    if (!table) {
+        goto on_err;
+    }
+    table->mask = slots - 1;
+
+    // Insert an entry for every registered base and (base, id) pair and count its handlers
+    table->any.base = esp_event_any_base;
+    table->any.id = ESP_EVENT_ANY_ID;
+    table->any.count = loop_collect_handlers(loop, esp_event_any_base, ESP_EVENT_ANY_ID, NULL);
+    total = table->any.count;
+
+    SLIST_FOREACH(loop_node, &(loop->loop_nodes), next) {
+        SLIST_FOREACH(base_node, &(loop_node->base_nodes), next) {
+            bool inserted;
+            esp_event_dispatch_entry_t* entry = dispatch_table_insert(table, base_node->base, ESP_EVENT_ANY_ID, &inserted);
+
+            if (inserted) {
+                entry->count = loop_collect_handlers(loop, entry->base, entry->id, NULL);
+                total += entry->count;
+            }
+
+            SLIST_FOREACH(id_node, &(base_node->id_nodes), next) {
+                entry = dispatch_table_insert(table, base_node->base, id_node->id, &inserted);
+
+                if (inserted) {
+                    entry->count = loop_collect_handlers(loop, entry->base, entry->id, NULL);
+                    total += entry->count;
+                }
+            }
+        }
+    }
+
+    if (total) {
+        table->handlers = malloc(total * sizeof(table->handlers[0]));
+        if (!table->handlers) {
+            free(table);
+            goto on_err;
+        }
+    }
+
+    // Fill the handler lists of the entries
+    esp_event_handler_instance_t** handlers = table->handlers;
+
+    table->any.handlers = handlers;
+    handlers += loop_collect_handlers(loop, esp_event_any_base, ESP_EVENT_ANY_ID, handlers);
+
+    for (uint32_t slot = 0; slot < slots; slot++) {
+        esp_event_dispatch_entry_t* entry = &table->entries[slot];
+
+        if (entry->base) {
+            entry->handlers = handlers;
+            handlers += loop_collect_handlers(loop, entry->base, entry->id, handlers);
+        }
+    }
+
+    loop_dispatch_table_set(loop, table);
+
+    return ESP_OK;
+
+on_err:
+    ESP_LOGW(TAG, "alloc for dispatch table of loop %p failed, walking handler lists", loop);
+    loop_dispatch_table_set(loop, NULL);
+    return ESP_ERR_NO_MEM;
+}
+
+// Executes the handlers for the post, as listed in the dispatch table
+static bool loop_dispatch_indexed(esp_event_loop_instance_t* loop, esp_event_post_instance_t* post)
+{
+    esp_event_dispatch_table_t* table = loop->dispatch_table;
+    const esp_event_dispatch_entry_t* entry = dispatch_table_find(table, post->base, post->id);
+    bool exec = false;
+
+    if (++loop->dispatch_seq == 0) {
+        // Zero is the sequence number of handlers which have never been executed
+        loop->dispatch_seq = 1;
+    }
+    loop->dispatch_in_use = table;
+
+    for (uint32_t i = 0; i < entry->count; i++) {
+        esp_event_handler_instance_t* handler = entry->handlers[i];
+
+        if (handler->dispatch_seq == loop->dispatch_seq) {
+            continue;
+        }
+        handler->dispatch_seq = loop->dispatch_seq;
+
+        handler_execute(loop, handler, post);
+        exec = true;
+
+        if (loop->dispatch_table != table) {
+            // The handler registered or unregistered handlers. Continue with the rebuilt table,
+            // skipping the handlers which have already been executed for this post.
+            loop->dispatch_in_use = NULL;
+            free(table->handlers);
+            free(table);
+
+            table = loop->dispatch_table;
+            if (!table) {
+                // Out of memory, the rest of the handlers run from the next post on
+                break;
+            }
+            loop->dispatch_in_use = table;
+            entry = dispatch_table_find(table, post->base, post->id);
+            i = -1;
+        }
+    }
+
+    loop->dispatch_in_use = NULL;
+
+    return exec;
+}
+#endif
+
+static void* post_data_alloc(esp_event_loop_instance_t* loop, size_t size)
+{
+#ifdef CONFIG_ESP_EVENT_POST_DATA_POOL
+    if (loop->data_pool && size <= CONFIG_ESP_EVENT_POST_DATA_POOL_OBJ_SIZE) {
+#ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
+        atomic_fetch_add(&loop->posts_pool, 1);
+#endif
+        return heap_caps_pool_alloc(loop->data_pool);
+    }
+#endif
+#ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
+    atomic_fetch_add(&loop->posts_heap, 1);
+#endif
+    return malloc(size);
+}
+
+static void post_data_free(esp_event_loop_instance_t* loop, void* data)
+{
+#ifdef CONFIG_ESP_EVENT_POST_DATA_POOL
+    // Data which is not from the pool memory is freed to the heap by the pool
+    if (loop->data_pool) {
+        heap_caps_pool_free(loop->data_pool, data);
+        return;
+    }
+#endif
+    free(data);
+}
+
+static void inline __attribute__((always_inline)) post_instance_delete(esp_event_loop_instance_t* loop, esp_event_post_instance_t* post)
 {
 #if CONFIG_ESP_EVENT_POST_FROM_ISR
     if (post->data_allocated && post->data.ptr) {
-        free(post->data.ptr);
+        post_data_free(loop, post->data.ptr);
     }
 #else
     if (post->data) {
-        free(post->data);
+        post_data_free(loop, post->data);
     }
 #endif
     memset(post, 0, sizeof(*post));
 }
 
+static void post_instance_set_data(esp_event_post_instance_t* post, void* data)
+{
+#if CONFIG_ESP_EVENT_POST_FROM_ISR
+    post->data.ptr = data;
+    post->data_allocated = true;
+    post->data_set = true;
+#else
+    post->data = data;
+#endif
+}
+
+// Finds the coalesce entry of an event, must be called in a critical section
+static esp_event_coalesce_entry_t* loop_coalesce_find(esp_event_loop_instance_t* loop, esp_event_base_t base, int32_t id)
+{
+    esp_event_coalesce_entry_t* it;
+
+    SLIST_FOREACH(it, &(loop->coalesce_entries), next) {
+        if (it->base == base && it->id == id) {
+            return it;
+        }
+    }
+
+    return NULL;
+}
+
+// Moves the data of the latest coalesced post to the post taken from the queue
+static void loop_coalesce_take(esp_event_loop_instance_t* loop, esp_event_post_instance_t* post)
+{
+    esp_event_coalesce_entry_t* entry;
+    void* data = NULL;
+
+    portENTER_CRITICAL();
+    entry = loop_coalesce_find(loop, post->base, post->id);
+    if (entry) {
+        data = entry->data;
+        entry->data = NULL;
+        entry->pending = false;
+    }
+    portEXIT_CRITICAL();
+
+    post->coalesced = false;
+    if (data) {
+        post_instance_set_data(post, data);
+    }
+}
+
+// Receives the next post, from the highest priority lane which has one
+static bool loop_receive(esp_event_loop_instance_t* loop, esp_event_post_instance_t* items, TickType_t ticks_to_wait)
+{
+    if (loop->lanes_ready == NULL) {
+        return xQueueReceive(loop->queue, items, ticks_to_wait) == pdTRUE;
+    }
+
+    // The semaphore is given once for every post, after the post is in its lane
+    if (xSemaphoreTake(loop->lanes_ready, ticks_to_wait) != pdTRUE) {
+        return false;
+    }
+
+    if (xQueueReceive(loop->queue_high, items, 0) == pdTRUE) {
+        return true;
+    }
+
+    return xQueueReceive(loop->queue, items, 0) == pdTRUE;
+}
+
 /* ---------------------------- Public API --------------------------------- */
 
 esp_err_t esp_event_loop_create(const esp_event_loop_args_t* event_loop_args, esp_event_loop_handle_t* event_loop)
@@ -415,24 +836,56 @@ esp_err_t esp_event_loop_create(const esp_event_loop_args_t* event_loop_args, es
     esp_event_loop_instance_t* loop;
     esp_err_t err = ESP_ERR_NO_MEM; // most likely error
 
+    if (event_loop_args->data_inline_size > DATA_INLINE_SIZE_MAX) {
+        ESP_LOGE(TAG, "inline data size %u is larger than %u", event_loop_args->data_inline_size, DATA_INLINE_SIZE_MAX);
+        return ESP_ERR_INVALID_ARG;
+    }
+
     loop = calloc(1, sizeof(*loop));
     if (loop == NULL) {
         ESP_LOGE(TAG, "alloc for event loop failed");
         return err;
     }
 
-    loop->queue = xQueueCreate(event_loop_args->queue_size , sizeof(esp_event_post_instance_t));
+    // Queue items are made of whole post instances, so the inline data is rounded up
+    loop->post_units = 1 + (event_loop_args->data_inline_size + sizeof(esp_event_post_instance_t) - 1) / sizeof(esp_event_post_instance_t);
+    loop->data_inline_size = (loop->post_units - 1) * sizeof(esp_event_post_instance_t);
+
+    loop->queue = xQueueCreate(event_loop_args->queue_size , loop->post_units * sizeof(esp_event_post_instance_t));
     if (loop->queue == NULL) {
         ESP_LOGE(TAG, "create event loop queue failed");
         goto on_err;
     }
 
+    if (event_loop_args->queue_size_high > 0) {
+        loop->queue_high = xQueueCreate(event_loop_args->queue_size_high, loop->post_units * sizeof(esp_event_post_instance_t));
+        if (loop->queue_high == NULL) {
+            ESP_LOGE(TAG, "create event loop high priority queue failed");
+            goto on_err;
+        }
+
+        loop->lanes_ready = xSemaphoreCreateCounting(event_loop_args->queue_size + event_loop_args->queue_size_high, 0);
+        if (loop->lanes_ready == NULL) {
+            ESP_LOGE(TAG, "create event loop lanes semaphore failed");
+            goto on_err;
+        }
+    }
+
     loop->mutex = xSemaphoreCreateRecursiveMutex();
     if (loop->mutex == NULL) {
         ESP_LOGE(TAG, "create event loop mutex failed");
         goto on_err;
     }
 
+#ifdef CONFIG_ESP_EVENT_POST_DATA_POOL
+    loop->data_pool = heap_caps_pool_create(CONFIG_ESP_EVENT_POST_DATA_POOL_OBJ_SIZE,
+                                            MIN(event_loop_args->queue_size, CONFIG_ESP_EVENT_POST_DATA_POOL_NUM), MALLOC_CAP_8BIT);
+    if (loop->data_pool == NULL) {
+        ESP_LOGE(TAG, "create event loop data pool failed");
+        goto on_err;
+    }
+#endif
+
 #ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
     loop->profiling_mutex = xSemaphoreCreateMutex();
     if (loop->profiling_mutex == NULL) {
@@ -442,6 +895,7 @@ esp_err_t esp_event_loop_create(const esp_event_loop_args_t* event_loop_args, es
 #endif
 
     SLIST_INIT(&(loop->loop_nodes));
+    SLIST_INIT(&(loop->coalesce_entries));
 
     // Create the loop task if requested
     if (event_loop_args->task_name != NULL) {
@@ -482,10 +936,24 @@ on_err:
         vQueueDelete(loop->queue);
     }
 
+    if (loop->queue_high != NULL) {
+        vQueueDelete(loop->queue_high);
+    }
+
+    if (loop->lanes_ready != NULL) {
+        vSemaphoreDelete(loop->lanes_ready);
+    }
+
     if (loop->mutex != NULL) {
         vSemaphoreDelete(loop->mutex);
     }
 
+#ifdef CONFIG_ESP_EVENT_POST_DATA_POOL
+    if (loop->data_pool != NULL) {
+        heap_caps_pool_delete(loop->data_pool);
+    }
+#endif
+
 #ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
     if (loop->profiling_mutex != NULL) {
         vSemaphoreDelete(loop->profiling_mutex);
@@ -503,12 +971,15 @@ on_err:
 // indicate that the difference is not that substantial, especially considering the additional
 // pointers per node of rbtrees. Code for the rbtree implementation of the event loop library is archived
 // in feature/esp_event_loop_library_rbtrees if needed.
+// With CONFIG_ESP_EVENT_LOOP_DISPATCH_TABLE the lists are only walked when handlers are registered or
+// unregistered, to rebuild a hash table which gives the handlers of an event in O(1).
 esp_err_t esp_event_loop_run(esp_event_loop_handle_t event_loop, TickType_t ticks_to_run)
 {
     assert(event_loop);
 
     esp_event_loop_instance_t* loop = (esp_event_loop_instance_t*) event_loop;
-    esp_event_post_instance_t post;
+    esp_event_post_instance_t items[loop->post_units];
+    esp_event_post_instance_t* post = items;
     TickType_t marker = xTaskGetTickCount();
     TickType_t end = 0;
 
@@ -518,53 +989,26 @@ esp_err_t esp_event_loop_run(esp_event_loop_handle_t event_loop, TickType_t tick
     int64_t remaining_ticks = ticks_to_run;
 #endif
 
-    while(xQueueReceive(loop->queue, &post, ticks_to_run) == pdTRUE) {
+    while(loop_receive(loop, items, ticks_to_run)) {
+        if (post->coalesced) {
+            loop_coalesce_take(loop, post);
+        }
+
         // The event has already been unqueued, so ensure it gets executed.
         xSemaphoreTakeRecursive(loop->mutex, portMAX_DELAY);
 
         loop->running_task = xTaskGetCurrentTaskHandle();
 
-        bool exec = false;
-
-        esp_event_handler_instance_t *handler;
-        esp_event_loop_node_t *loop_node;
-        esp_event_base_node_t *base_node;
-        esp_event_id_node_t *id_node;
-
-        SLIST_FOREACH(loop_node, &(loop->loop_nodes), next) {
-            // Execute loop level handlers
-            SLIST_FOREACH(handler, &(loop_node->handlers), next) {
-                handler_execute(loop, handler, post);
-                exec |= true;
-            }
-
-            SLIST_FOREACH(base_node, &(loop_node->base_nodes), next) {
-                if (base_node->base == post.base) {
-                    // Execute base level handlers
-                    SLIST_FOREACH(handler, &(base_node->handlers), next) {
-                        handler_execute(loop, handler, post);
-                        exec |= true;
-                    }
-
-                    SLIST_FOREACH(id_node, &(base_node->id_nodes), next) {
-                        if (id_node->id == post.id) {
-                            // Execute id level handlers
-                            SLIST_FOREACH(handler, &(id_node->handlers), next) {
-                                handler_execute(loop, handler, post);
-                                exec |= true;
-                            }
-                            // Skip to next base node
-                            break;
-                        }
-                    }
-                }
-            }
-        }
+#ifdef CONFIG_ESP_EVENT_LOOP_DISPATCH_TABLE
+        bool exec = loop->dispatch_table ? loop_dispatch_indexed(loop, post) : loop_dispatch_lists(loop, post);
+#else
+        bool exec = loop_dispatch_lists(loop, post);
+#endif
 
-        esp_event_base_t base = post.base;
-        int32_t id = post.id;
+        esp_event_base_t base = post->base;
+        int32_t id = post->id;
 
-        post_instance_delete(&post);
+        post_instance_delete(loop, post);
 
         if (ticks_to_run != portMAX_DELAY) {
             end = xTaskGetTickCount();
@@ -623,14 +1067,40 @@ esp_err_t esp_event_loop_delete(esp_event_loop_handle_t event_loop)
         free(it);
     }
 
+#ifdef CONFIG_ESP_EVENT_LOOP_DISPATCH_TABLE
+    loop->dispatch_in_use = NULL;
+    loop_dispatch_table_set(loop, NULL);
+#endif
+
     // Drop existing posts on the queue
-    esp_event_post_instance_t post;
-    while(xQueueReceive(loop->queue, &post, 0) == pdTRUE) {
-        post_instance_delete(&post);
+    esp_event_post_instance_t items[loop->post_units];
+    while(xQueueReceive(loop->queue, items, 0) == pdTRUE) {
+        post_instance_delete(loop, items);
+    }
+    if (loop->queue_high != NULL) {
+        while(xQueueReceive(loop->queue_high, items, 0) == pdTRUE) {
+            post_instance_delete(loop, items);
+        }
+    }
+
+    // The data of coalesced posts is held by their entries
+    esp_event_coalesce_entry_t *coalesce_it, *coalesce_temp;
+    SLIST_FOREACH_SAFE(coalesce_it, &(loop->coalesce_entries), next, coalesce_temp) {
+        if (coalesce_it->data) {
+            post_data_free(loop, coalesce_it->data);
+        }
+        free(coalesce_it);
     }
 
     // Cleanup loop
     vQueueDelete(loop->queue);
+    if (loop->queue_high != NULL) {
+        vQueueDelete(loop->queue_high);
+        vSemaphoreDelete(loop->lanes_ready);
+    }
+#ifdef CONFIG_ESP_EVENT_POST_DATA_POOL
+    heap_caps_pool_delete(loop->data_pool);
+#endif
     free(loop);
     // Free loop mutex before deleting
     xSemaphoreGiveRecursive(loop_mutex);
@@ -704,6 +1174,17 @@ esp_err_t esp_event_handler_register_with(esp_event_loop_handle_t event_loop, es
         err = loop_node_add_handler(last_loop_node, event_base, event_id, event_handler, event_handler_arg);
     }
 
+    if (err == ESP_OK) {
+        loop->handlers_changes++;
+    }
+
+#ifdef CONFIG_ESP_EVENT_LOOP_DISPATCH_TABLE
+    if (err == ESP_OK) {
+        // The handler is registered even if the table can't be built, posts then walk the lists
+        loop_dispatch_table_rebuild(loop);
+    }
+#endif
+
 on_err:
     xSemaphoreGiveRecursive(loop->mutex);
     return err;
@@ -728,6 +1209,13 @@ esp_err_t esp_event_handler_unregister_with(esp_event_loop_handle_t event_loop,
 
     xSemaphoreTakeRecursive(loop->mutex, portMAX_DELAY);
 
+#ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
+    if (loop->running_handler && loop->running_handler->handler == event_handler) {
+        // The running handler may be the instance to be freed, skip updating its statistics
+        loop->running_handler = NULL;
+    }
+#endif
+
     esp_event_loop_node_t *it, *temp;
 
     SLIST_FOREACH_SAFE(it, &(loop->loop_nodes), next, temp) {
@@ -740,13 +1228,102 @@ esp_err_t esp_event_handler_unregister_with(esp_event_loop_handle_t event_loop,
         }
     }
 
+    loop->handlers_changes++;
+
+#ifdef CONFIG_ESP_EVENT_LOOP_DISPATCH_TABLE
+    loop_dispatch_table_rebuild(loop);
+#endif
+
     xSemaphoreGiveRecursive(loop->mutex);
 
     return ESP_OK;
 }
 
+esp_err_t esp_event_coalesce_register_with(esp_event_loop_handle_t event_loop, esp_event_base_t event_base, int32_t event_id)
+{
+    assert(event_loop);
+
+    if (event_base == ESP_EVENT_ANY_BASE || event_id == ESP_EVENT_ANY_ID) {
+        ESP_LOGE(TAG, "coalescing events of any event base or id unsupported");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_event_loop_instance_t* loop = (esp_event_loop_instance_t*) event_loop;
+    esp_event_coalesce_entry_t* entry = calloc(1, sizeof(*entry));
+    esp_event_coalesce_entry_t* existing;
+
+    if (entry == NULL) {
+        ESP_LOGE(TAG, "alloc for coalesced event failed");
+        return ESP_ERR_NO_MEM;
+    }
+
+    entry->base = event_base;
+    entry->id = event_id;
+    entry->enabled = true;
+
+    portENTER_CRITICAL();
+    existing = loop_coalesce_find(loop, event_base, event_id);
+    if (existing) {
+        existing->enabled = true;
+    } else {
+        SLIST_INSERT_HEAD(&(loop->coalesce_entries), entry, next);
+    }
+    portEXIT_CRITICAL();
+
+    if (existing) {
+        free(entry);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t esp_event_coalesce_unregister_with(esp_event_loop_handle_t event_loop, esp_event_base_t event_base, int32_t event_id)
+{
+    assert(event_loop);
+
+    esp_event_loop_instance_t* loop = (esp_event_loop_instance_t*) event_loop;
+    esp_event_coalesce_entry_t* entry;
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+
+    // The entry is kept, a post which is pending may still refer to it
+    portENTER_CRITICAL();
+    entry = loop_coalesce_find(loop, event_base, event_id);
+    if (entry && entry->enabled) {
+        entry->enabled = false;
+        err = ESP_OK;
+    }
+    portEXIT_CRITICAL();
+
+    return err;
+}
+
+esp_err_t esp_event_loop_get_stats(esp_event_loop_handle_t event_loop, esp_event_loop_stats_t* stats)
+{
+    assert(event_loop);
+    assert(stats);
+
+    esp_event_loop_instance_t* loop = (esp_event_loop_instance_t*) event_loop;
+
+    stats->queue_depth[ESP_EVENT_PRIORITY_NORMAL] = uxQueueMessagesWaiting(loop->queue);
+    stats->queue_depth[ESP_EVENT_PRIORITY_HIGH] = loop->queue_high ? uxQueueMessagesWaiting(loop->queue_high) : 0;
+
+    portENTER_CRITICAL();
+    stats->events_dropped = loop->events_dropped;
+    stats->events_coalesced = loop->events_coalesced;
+    portEXIT_CRITICAL();
+
+    return ESP_OK;
+}
+
 esp_err_t esp_event_post_to(esp_event_loop_handle_t event_loop, esp_event_base_t event_base, int32_t event_id,
                             void* event_data, size_t event_data_size, TickType_t ticks_to_wait)
+{
+    return esp_event_post_to_with_priority(event_loop, event_base, event_id, event_data, event_data_size,
+                                           ESP_EVENT_PRIORITY_NORMAL, ticks_to_wait);
+}
+
+esp_err_t esp_event_post_to_with_priority(esp_event_loop_handle_t event_loop, esp_event_base_t event_base, int32_t event_id,
+                            void* event_data, size_t event_data_size, esp_event_priority_t priority, TickType_t ticks_to_wait)
 {
     assert(event_loop);
 
@@ -754,30 +1331,91 @@ esp_err_t esp_event_post_to(esp_event_loop_handle_t event_loop, esp_event_base_t
         return ESP_ERR_INVALID_ARG;
     }
 
+    if (priority != ESP_EVENT_PRIORITY_NORMAL && priority != ESP_EVENT_PRIORITY_HIGH) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
     esp_event_loop_instance_t* loop = (esp_event_loop_instance_t*) event_loop;
 
-    esp_event_post_instance_t post;
-    memset((void*)(&post), 0, sizeof(post));
+    // Loops with a single lane take the high priority posts in it
+    QueueHandle_t queue = (priority == ESP_EVENT_PRIORITY_HIGH && loop->queue_high) ? loop->queue_high : loop->queue;
+
+    esp_event_post_instance_t items[loop->post_units];
+    esp_event_post_instance_t* post = items;
+    memset((void*)post, 0, sizeof(*post));
+
+    esp_event_coalesce_entry_t* coalesce = NULL;
+
+    if (!SLIST_EMPTY(&(loop->coalesce_entries))) {
+        portENTER_CRITICAL();
+        coalesce = loop_coalesce_find(loop, event_base, event_id);
+        if (coalesce && !coalesce->enabled) {
+            coalesce = NULL;
+        }
+        portEXIT_CRITICAL();
+    }
 
     if (event_data != NULL && event_data_size != 0) {
-        // Make persistent copy of event data on heap.
-        void* event_data_copy = calloc(1, event_data_size);
+        // The data of coalesced posts may be replaced while the post is queued, so it is never inline
+        if (event_data_size <= loop->data_inline_size && !coalesce) {
+            // Carry the event data in the queue item
+            memcpy(POST_DATA_INLINE(post), event_data, event_data_size);
+            post->data_inline = true;
+#if CONFIG_ESP_EVENT_POST_FROM_ISR
+            post->data_set = true;
+#endif
+#ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
+            atomic_fetch_add(&loop->posts_inline, 1);
+#endif
+        } else {
+            // Make persistent copy of event data on heap or in the loop data pool.
+            void* event_data_copy = post_data_alloc(loop, event_data_size);
+
+            if (event_data_copy == NULL) {
+                return ESP_ERR_NO_MEM;
+            }
 
-        if (event_data_copy == NULL) {
-            return ESP_ERR_NO_MEM;
+            memcpy(event_data_copy, event_data, event_data_size);
+            post_instance_set_data(post, event_data_copy);
         }
+    }
 
-        memcpy(event_data_copy, event_data, event_data_size);
+    if (coalesce) {
+        // The entry holds the data of the latest post, the queued post only marks that one is pending
 #if CONFIG_ESP_EVENT_POST_FROM_ISR
-        post.data.ptr = event_data_copy;
-        post.data_allocated = true;
-        post.data_set = true;
+        void* data = post->data.ptr;
 #else
-        post.data = event_data_copy;
+        void* data = post->data;
+#endif
+        void* replaced;
+        bool pending;
+
+        portENTER_CRITICAL();
+        pending = coalesce->pending;
+        replaced = coalesce->data;
+        coalesce->data = data;
+        coalesce->pending = true;
+        if (pending) {
+            loop->events_coalesced++;
+        }
+        portEXIT_CRITICAL();
+
+        if (pending) {
+            if (replaced) {
+                post_data_free(loop, replaced);
+            }
+#ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
+            atomic_fetch_add(&loop->events_recieved, 1);
 #endif
+            return ESP_OK;
+        }
+
+        memset((void*)post, 0, sizeof(*post));
+        post->coalesced = true;
     }
-    post.base = event_base;
-    post.id = event_id;
+
+    post->base = event_base;
+    post->id = event_id;
 
     BaseType_t result = pdFALSE;
 
@@ -790,30 +1428,43 @@ esp_err_t esp_event_post_to(esp_event_loop_handle_t event_loop, esp_event_base_t
         if (result == pdTRUE) {
             if (loop->running_task != xTaskGetCurrentTaskHandle()) {
                 xSemaphoreGiveRecursive(loop->mutex);
-                result = xQueueSendToBack(loop->queue, &post, ticks_to_wait);
+                result = xQueueSendToBack(queue, items, ticks_to_wait);
             } else {
                 xSemaphoreGiveRecursive(loop->mutex);
-                result = xQueueSendToBack(loop->queue, &post, 0);
+                result = xQueueSendToBack(queue, items, 0);
             }
         }
     } else {
         // The loop has a dedicated task.
         if (loop->task != xTaskGetCurrentTaskHandle()) {
-            result = xQueueSendToBack(loop->queue, &post, ticks_to_wait);
+            result = xQueueSendToBack(queue, items, ticks_to_wait);
         } else {
-            result = xQueueSendToBack(loop->queue, &post, 0);
+            result = xQueueSendToBack(queue, items, 0);
         }
     }
 
     if (result != pdTRUE) {
-        post_instance_delete(&post);
+        if (post->coalesced) {
+            // Posts coalesced meanwhile into this one are dropped with it
+            portENTER_CRITICAL();
+            post_instance_set_data(post, coalesce->data);
+            coalesce->data = NULL;
+            coalesce->pending = false;
+            portEXIT_CRITICAL();
+        }
 
-#ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
-        atomic_fetch_add(&loop->events_dropped, 1);
-#endif
+        post_instance_delete(loop, post);
+
+        portENTER_CRITICAL();
+        loop->events_dropped++;
+        portEXIT_CRITICAL();
         return ESP_ERR_TIMEOUT;
     }
 
+    if (loop->lanes_ready) {
+        xSemaphoreGive(loop->lanes_ready);
+    }
+
 #ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
     atomic_fetch_add(&loop->events_recieved, 1);
 #endif
@@ -833,35 +1484,47 @@ esp_err_t esp_event_isr_post_to(esp_event_loop_handle_t event_loop, esp_event_ba
 
     esp_event_loop_instance_t* loop = (esp_event_loop_instance_t*) event_loop;
 
-    esp_event_post_instance_t post;
-    memset((void*)(&post), 0, sizeof(post));
+    esp_event_post_instance_t items[loop->post_units];
+    esp_event_post_instance_t* post = items;
+    memset((void*)post, 0, sizeof(*post));
 
-    if (event_data_size > sizeof(post.data.val)) {
+    if (event_data_size > sizeof(post->data.val) && event_data_size > loop->data_inline_size) {
         return ESP_ERR_INVALID_ARG;
     }
 
     if (event_data != NULL && event_data_size != 0) {
-        memcpy((void*)(&(post.data.val)), event_data, event_data_size);
-        post.data_allocated = false;
-        post.data_set = true;
+        if (event_data_size <= sizeof(post->data.val)) {
+            memcpy((void*)(&(post->data.val)), event_data, event_data_size);
+        } else {
+            memcpy(POST_DATA_INLINE(post), event_data, event_data_size);
+            post->data_inline = true;
+        }
+        post->data_allocated = false;
+        post->data_set = true;
+#ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
+        atomic_fetch_add(&loop->posts_inline, 1);
+#endif
     }
-    post.base = event_base;
-    post.id = event_id;
+    post->base = event_base;
+    post->id = event_id;
 
     BaseType_t result = pdFALSE;
 
     // Post the event from an ISR,
-    result = xQueueSendToBackFromISR(loop->queue, &post, task_unblocked);
+    result = xQueueSendToBackFromISR(loop->queue, items, task_unblocked);
 
     if (result != pdTRUE) {
-        post_instance_delete(&post);
+        post_instance_delete(loop, post);
 
-#ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
-        atomic_fetch_add(&loop->events_dropped, 1);
-#endif
+        // Tasks update the counter in critical sections, which ISRs don't preempt
+        loop->events_dropped++;
         return ESP_FAIL;
     }
 
+    if (loop->lanes_ready) {
+        xSemaphoreGiveFromISR(loop->lanes_ready, task_unblocked);
+    }
+
 #ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
     atomic_fetch_add(&loop->events_recieved, 1);
 #endif
@@ -892,13 +1555,15 @@ esp_err_t esp_event_dump(FILE* file)
     portENTER_CRITICAL(&s_event_loops_spinlock);
 
     SLIST_FOREACH(loop_it, &s_event_loops, next) {
-        uint32_t events_recieved, events_dropped;
+        uint32_t events_recieved, events_dropped, events_coalesced;
 
         events_recieved = atomic_load(&loop_it->events_recieved);
-        events_dropped = atomic_load(&loop_it->events_dropped);
+        events_dropped = loop_it->events_dropped;
+        events_coalesced = loop_it->events_coalesced;
 
         PRINT_DUMP_INFO(dst, sz, LOOP_DUMP_FORMAT, loop_it, loop_it->task != NULL ? loop_it->name : "none" ,
-                        events_recieved, events_dropped);
+                        events_recieved, events_dropped, events_coalesced, atomic_load(&loop_it->posts_inline),
+                        atomic_load(&loop_it->posts_pool), atomic_load(&loop_it->posts_heap));
 
         int sz_bak = sz;
 
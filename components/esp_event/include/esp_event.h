@@ -29,6 +29,13 @@
 extern "C" {
 #endif
 
+/// Priority lanes of event loops, posts in a lane are dispatched before the pending posts of lower lanes
+typedef enum {
+    ESP_EVENT_PRIORITY_NORMAL = 0,              /**< lane of the posts of esp_event_post_to */
+    ESP_EVENT_PRIORITY_HIGH,                    /**< lane for urgent events, such as disconnections */
+    ESP_EVENT_PRIORITY_MAX,
+} esp_event_priority_t;
+
 /// Configuration for creating event loops
 typedef struct {
     int32_t queue_size;                         /**< size of the event loop queue */
@@ -38,8 +45,20 @@ typedef struct {
     uint32_t task_stack_size;                   /**< stack size of the event loop task, ignored if task name is NULL */
     BaseType_t task_core_id;                    /**< core to which the event loop task is pinned to,
                                                         ignored if task name is NULL */
+    uint32_t data_inline_size;                  /**< event data up to this size is carried in the queue items of the
+                                                        loop instead of being copied to the heap, at most 128 bytes.
+                                                        It is rounded up to the internal queue item size; 0 disables it */
+    int32_t queue_size_high;                    /**< size of the high priority lane queue; if 0, the loop has a single
+                                                        lane and high priority posts go to the normal lane */
 } esp_event_loop_args_t;
 
+/// Statistics of an event loop
+typedef struct {
+    uint32_t queue_depth[ESP_EVENT_PRIORITY_MAX]; /**< number of posts waiting in each priority lane */
+    uint32_t events_dropped;                    /**< number of events dropped due to a full queue */
+    uint32_t events_coalesced;                  /**< number of posts merged into a pending post of the same event */
+} esp_event_loop_stats_t;
+
 /**
  * @brief Create a new event loop.
  *
@@ -217,6 +236,80 @@ esp_err_t esp_event_handler_unregister_with(esp_event_loop_handle_t event_loop,
                                             int32_t event_id,
                                             esp_event_handler_t event_handler);
 
+/**
+ * @brief Coalesce the pending posts of an event to the system event loop.
+ *
+ * While a post of the event waits in the queue, further posts of the same event don't add posts to the queue:
+ * they replace the data of the waiting post, which is dispatched once with the data of the latest post.
+ * This suits events which report a state, where only the latest one matters.
+ *
+ * Posts of the event with esp_event_isr_post are not coalesced.
+ *
+ * @param[in] event_base the base of the event to coalesce
+ * @param[in] event_id the id of the event to coalesce
+ *
+ * @return
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NO_MEM: Cannot allocate memory for the coalesced event
+ *  - ESP_ERR_INVALID_ARG: Invalid combination of event base and event id
+ *  - Others: Fail
+ */
+esp_err_t esp_event_coalesce_register(esp_event_base_t event_base, int32_t event_id);
+
+/**
+ * @brief Coalesce the pending posts of an event to the specified event loop.
+ *
+ * This function behaves in the same manner as esp_event_coalesce_register, except the additional specification of
+ * the event loop whose posts are coalesced.
+ *
+ * @param[in] event_loop the event loop whose posts are coalesced
+ * @param[in] event_base the base of the event to coalesce
+ * @param[in] event_id the id of the event to coalesce
+ *
+ * @return
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NO_MEM: Cannot allocate memory for the coalesced event
+ *  - ESP_ERR_INVALID_ARG: Invalid combination of event base and event id
+ *  - Others: Fail
+ */
+esp_err_t esp_event_coalesce_register_with(esp_event_loop_handle_t event_loop,
+                                        esp_event_base_t event_base,
+                                        int32_t event_id);
+
+/**
+ * @brief Stop coalescing the posts of an event to the system event loop.
+ *
+ * A post of the event which is already waiting in the queue is still dispatched with the data of the latest post.
+ *
+ * @param[in] event_base the base of the event
+ * @param[in] event_id the id of the event
+ *
+ * @return
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NOT_FOUND: The posts of the event are not coalesced
+ *  - Others: Fail
+ */
+esp_err_t esp_event_coalesce_unregister(esp_event_base_t event_base, int32_t event_id);
+
+/**
+ * @brief Stop coalescing the posts of an event to the specified event loop.
+ *
+ * This function behaves in the same manner as esp_event_coalesce_unregister, except the additional specification of
+ * the event loop whose posts are coalesced.
+ *
+ * @param[in] event_loop the event loop whose posts are coalesced
+ * @param[in] event_base the base of the event
+ * @param[in] event_id the id of the event
+ *
+ * @return
+ *  - ESP_OK: Success
+ *  - ESP_ERR_NOT_FOUND: The posts of the event are not coalesced
+ *  - Others: Fail
+ */
+esp_err_t esp_event_coalesce_unregister_with(esp_event_loop_handle_t event_loop,
+                                            esp_event_base_t event_base,
+                                            int32_t event_id);
+
 /**
  * @brief Posts an event to the system default event loop. The event loop library keeps a copy of event_data and manages
  * the copy's lifetime automatically (allocation + deletion); this ensures that the data the
@@ -270,6 +363,62 @@ esp_err_t esp_event_post_to(esp_event_loop_handle_t event_loop,
                             size_t event_data_size,
                             TickType_t ticks_to_wait);
 
+/**
+ * @brief Posts an event to a priority lane of the system default event loop.
+ *
+ * This function behaves in the same manner as esp_event_post, except the additional specification of the lane
+ * to post the event to. The posts of the high priority lane are dispatched before the pending posts of the normal
+ * lane; the posts of the same lane are dispatched in the order they were posted. If the loop has a single lane,
+ * the event is posted to it.
+ *
+ * @param[in] event_base the event base that identifies the event
+ * @param[in] event_id the event id that identifies the event
+ * @param[in] event_data the data, specific to the event occurence, that gets passed to the handler
+ * @param[in] event_data_size the size of the event data
+ * @param[in] priority the priority lane to post the event to
+ * @param[in] ticks_to_wait number of ticks to block on a full event queue
+ *
+ * @return
+ *  - ESP_OK: Success
+ *  - ESP_ERR_TIMEOUT: Time to wait for event queue to unblock expired
+ *  - ESP_ERR_INVALID_ARG: Invalid combination of event base and event id, invalid priority
+ *  - Others: Fail
+ */
+esp_err_t esp_event_post_with_priority(esp_event_base_t event_base,
+                            int32_t event_id,
+                            void* event_data,
+                            size_t event_data_size,
+                            esp_event_priority_t priority,
+                            TickType_t ticks_to_wait);
+
+/**
+ * @brief Posts an event to a priority lane of the specified event loop.
+ *
+ * This function behaves in the same manner as esp_event_post_with_priority, except the additional specification
+ * of the event loop to post the event to.
+ *
+ * @param[in] event_loop the event loop to post to
+ * @param[in] event_base the event base that identifies the event
+ * @param[in] event_id the event id that identifies the event
+ * @param[in] event_data the data, specific to the event occurence, that gets passed to the handler
+ * @param[in] event_data_size the size of the event data
+ * @param[in] priority the priority lane to post the event to
+ * @param[in] ticks_to_wait number of ticks to block on a full event queue
+ *
+ * @return
+ *  - ESP_OK: Success
+ *  - ESP_ERR_TIMEOUT: Time to wait for event queue to unblock expired
+ *  - ESP_ERR_INVALID_ARG: Invalid combination of event base and event id, invalid priority
+ *  - Others: Fail
+ */
+esp_err_t esp_event_post_to_with_priority(esp_event_loop_handle_t event_loop,
+                            esp_event_base_t event_base,
+                            int32_t event_id,
+                            void* event_data,
+                            size_t event_data_size,
+                            esp_event_priority_t priority,
+                            TickType_t ticks_to_wait);
+
 #if CONFIG_ESP_EVENT_POST_FROM_ISR
 /**
  * @brief Special variant of esp_event_post for posting events from interrupt handlers.
@@ -277,7 +426,8 @@ esp_err_t esp_event_post_to(esp_event_loop_handle_t event_loop,
  * @param[in] event_base the event base that identifies the event
  * @param[in] event_id the event id that identifies the event
  * @param[in] event_data the data, specific to the event occurence, that gets passed to the handler
- * @param[in] event_data_size the size of the event data; max is 4 bytes
+ * @param[in] event_data_size the size of the event data; max is 4 bytes, or the inline data size of the
+ *                            default loop if it is larger
  * @param[out] task_unblocked an optional parameter (can be NULL) which indicates that an event task with 
  *                            higher priority than currently running task has been unblocked by the posted event;
  *                            a context switch should be requested before the interrupt is existed.
@@ -305,7 +455,8 @@ esp_err_t esp_event_isr_post(esp_event_base_t event_base,
  * @param[in] event_base the event base that identifies the event
  * @param[in] event_id the event id that identifies the event
  * @param[in] event_data the data, specific to the event occurence, that gets passed to the handler
- * @param[in] event_data_size the size of the event data
+ * @param[in] event_data_size the size of the event data; max is 4 bytes, or the inline data size of the loop
+ *                            if it is larger
  * @param[out] task_unblocked an optional parameter (can be NULL) which indicates that an event task with 
  *                            higher priority than currently running task has been unblocked by the posted event;
  *                            a context switch should be requested before the interrupt is existed.
@@ -318,7 +469,7 @@ esp_err_t esp_event_isr_post(esp_event_base_t event_base,
  *  - ESP_OK: Success
  *  - ESP_FAIL: Event queue for the loop full
  *  - ESP_ERR_INVALID_ARG: Invalid combination of event base and event id,
- *                          data size of more than 4 bytes 
+ *                          data size larger than the loop can carry 
  *  - Others: Fail
  */
 esp_err_t esp_event_isr_post_to(esp_event_loop_handle_t event_loop,
@@ -329,6 +480,18 @@ esp_err_t esp_event_isr_post_to(esp_event_loop_handle_t event_loop,
                             BaseType_t* task_unblocked);
 #endif
 
+/**
+ * @brief Get the queue depth and the counters of an event loop
+ *
+ * @param[in] event_loop the event loop
+ * @param[out] stats statistics of the loop
+ *
+ * @return
+ *  - ESP_OK: Success
+ *  - Others: Fail
+ */
+esp_err_t esp_event_loop_get_stats(esp_event_loop_handle_t event_loop, esp_event_loop_stats_t* stats);
+
 /**
  * @brief Dumps statistics of all event loops.
  *
@@ -347,12 +510,17 @@ esp_err_t esp_event_isr_post_to(esp_event_loop_handle_t event_loop,
   where:
 
    event loop
-       format: address,name rx:total_recieved dr:total_dropped
+       format: address,name rx:total_recieved dr:total_dropped co:total_coalesced
+               in:total_inline pl:total_pool hp:total_heap
        where:
            address - memory address of the event loop
            name - name of the event loop, 'none' if no dedicated task
            total_recieved - number of successfully posted events
            total_dropped - number of events unsucessfully posted due to queue being full
+           total_coalesced - number of posts merged into a pending post of the same event
+           total_inline - number of posts with event data carried in the queue item
+           total_pool - number of posts with event data copied to the loop data pool
+           total_heap - number of posts with event data copied to the heap
 
    handler
        format: address ev:base,id inv:total_invoked run:total_runtime
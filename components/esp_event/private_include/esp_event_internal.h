@@ -18,6 +18,10 @@
 #include "esp_event.h"
 #include "stdatomic.h"
 
+#ifdef CONFIG_ESP_EVENT_POST_DATA_POOL
+#include "esp_heap_pool.h"
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -32,6 +36,8 @@ typedef struct esp_event_handler_instance {
     uint32_t invoked;                                               /**< number of times this handler has been invoked */
     int64_t time;                                                   /**< total runtime of this handler across all calls */
 #endif
+    uint32_t dispatch_seq;                                          /**< sequence number of the last post this handler
+                                                                            was executed for */
     SLIST_ENTRY(esp_event_handler_instance) next;                   /**< next event handler in the list */
 } esp_event_handler_instance_t;
 
@@ -67,20 +73,77 @@ typedef struct esp_event_loop_node {
 
 typedef SLIST_HEAD(esp_event_loop_nodes, esp_event_loop_node) esp_event_loop_nodes_t;
 
+/// Event whose pending posts are coalesced, entries are kept until the loop is deleted
+typedef struct esp_event_coalesce_entry {
+    esp_event_base_t base;                                          /**< base of the event */
+    int32_t id;                                                     /**< id of the event */
+    bool enabled;                                                   /**< posts of the event are coalesced */
+    bool pending;                                                   /**< a post of the event is in the queue */
+    void* data;                                                     /**< copy of the data of the latest post */
+    SLIST_ENTRY(esp_event_coalesce_entry) next;                     /**< next coalesced event of the loop */
+} esp_event_coalesce_entry_t;
+
+typedef SLIST_HEAD(esp_event_coalesce_entries, esp_event_coalesce_entry) esp_event_coalesce_entries_t;
+
+#ifdef CONFIG_ESP_EVENT_LOOP_DISPATCH_TABLE
+/// Handlers to execute for an event, in the order they are executed
+typedef struct esp_event_dispatch_entry {
+    esp_event_base_t base;                                          /**< base of the event, NULL for an empty slot */
+    int32_t id;                                                     /**< id of the event, ESP_EVENT_ANY_ID for the
+                                                                            ids of the base without id level handlers */
+    uint32_t count;                                                 /**< number of handlers to execute */
+    esp_event_handler_instance_t** handlers;                        /**< handlers to execute */
+} esp_event_dispatch_entry_t;
+
+/// Registered handlers indexed by (base, id), rebuilt every time handlers are registered or unregistered
+typedef struct esp_event_dispatch_table {
+    uint32_t mask;                                                  /**< number of slots minus one */
+    esp_event_dispatch_entry_t any;                                 /**< loop level handlers, for events
+                                                                            of bases not in the table */
+    esp_event_handler_instance_t** handlers;                        /**< storage of the handler lists of all entries */
+    esp_event_dispatch_entry_t entries[];                           /**< slots of the open addressing hash table */
+} esp_event_dispatch_table_t;
+#endif
+
 /// Event loop
 typedef struct esp_event_loop_instance {
     const char* name;                                               /**< name of this event loop */
-    QueueHandle_t queue;                                            /**< event queue */
+    QueueHandle_t queue;                                            /**< event queue, normal priority lane */
+    QueueHandle_t queue_high;                                       /**< high priority lane, NULL if the loop has
+                                                                            a single lane */
+    SemaphoreHandle_t lanes_ready;                                  /**< counts the posts in all lanes, the loop
+                                                                            waits on it if it has several lanes */
     TaskHandle_t task;                                              /**< task that consumes the event queue */
     TaskHandle_t running_task;                                      /**< for loops with no dedicated task, the
                                                                             task that consumes the queue */
     SemaphoreHandle_t mutex;                                        /**< mutex for updating the events linked list */
+    uint32_t post_units;                                            /**< size of the queue items, in post instances */
+    uint32_t data_inline_size;                                      /**< size of the event data carried in queue items */
     esp_event_loop_nodes_t loop_nodes;                              /**< set of linked lists containing the
                                                                             registered handlers for the loop */
+    esp_event_coalesce_entries_t coalesce_entries;                  /**< events whose pending posts are coalesced */
+    uint32_t events_dropped;                                        /**< number of events dropped due to queue being full */
+    uint32_t events_coalesced;                                      /**< number of posts merged into a pending post */
+    uint32_t dispatch_seq;                                          /**< sequence number of the running dispatch */
+    uint32_t handlers_changes;                                      /**< incremented when handlers are registered
+                                                                            or unregistered */
+#ifdef CONFIG_ESP_EVENT_LOOP_DISPATCH_TABLE
+    esp_event_dispatch_table_t* dispatch_table;                     /**< index of the handlers in loop_nodes, NULL if
+                                                                            it could not be built */
+    esp_event_dispatch_table_t* dispatch_in_use;                    /**< table the running dispatch iterates, it is
+                                                                            kept until the dispatch moves on */
+#endif
+#ifdef CONFIG_ESP_EVENT_POST_DATA_POOL
+    heap_caps_pool_handle_t data_pool;                              /**< pool for copies of small event data */
+#endif
 #ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
     atomic_uint_least32_t events_recieved;                          /**< number of events successfully posted to the loop */
-    atomic_uint_least32_t events_dropped;                           /**< number of events dropped due to queue being full */
+    atomic_uint_least32_t posts_inline;                             /**< number of posts with data carried in the queue item */
+    atomic_uint_least32_t posts_pool;                               /**< number of posts with data copied to the loop pool */
+    atomic_uint_least32_t posts_heap;                               /**< number of posts with data copied to the heap */
     SemaphoreHandle_t profiling_mutex;                              /**< mutex used for profiliing */
+    esp_event_handler_instance_t* running_handler;                  /**< handler being executed, NULL if it has
+                                                                            been unregistered while running */
     SLIST_ENTRY(esp_event_loop_instance) next;                      /**< next event loop in the list */
 #endif
 } esp_event_loop_instance_t;
@@ -94,12 +157,14 @@ typedef union esp_event_post_data {
 typedef void* esp_event_post_data_t;
 #endif
 
-/// Event posted to the event queue
+/// Event posted to the event queue, followed by the event data in loops which carry it in queue items
 typedef struct esp_event_post_instance {
 #if CONFIG_ESP_EVENT_POST_FROM_ISR
     bool data_allocated;                                             /**< indicates whether data is allocated from heap */
     bool data_set;                                                   /**< indicates if data is null */
 #endif
+    bool data_inline;                                                /**< indicates whether data follows the post in the queue item */
+    bool coalesced;                                                  /**< indicates whether data is held by the coalesce entry */
     esp_event_base_t base;                                           /**< the event base */
     int32_t id;                                                      /**< the event id */
     esp_event_post_data_t data;                                      /**< data associated with the event */
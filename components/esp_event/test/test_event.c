@@ -1156,6 +1156,53 @@ TEST_CASE("events are dispatched in the order they are registered", "[event]")
     TEST_TEARDOWN();
 }
 
+TEST_CASE("can dispatch high priority events first and coalesce pending events", "[event]")
+{
+    TEST_SETUP();
+
+    esp_event_loop_handle_t loop;
+    esp_event_loop_args_t loop_args = test_event_get_default_loop_args();
+
+    loop_args.task_name = NULL;
+    loop_args.queue_size_high = 4;
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_loop_create(&loop_args, &loop));
+
+    int id_arr[2] = {0, 1};
+    int data_arr[2] = {0};
+
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_handler_register_with(loop, s_test_base1, TEST_EVENT_BASE1_EV1, test_event_ordered_dispatch, id_arr + 0));
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_handler_register_with(loop, s_test_base1, TEST_EVENT_BASE1_EV2, test_event_ordered_dispatch, id_arr + 1));
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_coalesce_register_with(loop, s_test_base1, TEST_EVENT_BASE1_EV1));
+
+    ordered_data_t data = {
+        .arr = data_arr,
+        .index = 0
+    };
+
+    ordered_data_t* dptr = &data;
+
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_post_to(loop, s_test_base1, TEST_EVENT_BASE1_EV1, &dptr, sizeof(dptr), portMAX_DELAY));
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_post_to(loop, s_test_base1, TEST_EVENT_BASE1_EV1, &dptr, sizeof(dptr), portMAX_DELAY));
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_post_to_with_priority(loop, s_test_base1, TEST_EVENT_BASE1_EV2, &dptr, sizeof(dptr),
+                                                              ESP_EVENT_PRIORITY_HIGH, portMAX_DELAY));
+
+    esp_event_loop_stats_t stats;
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_loop_get_stats(loop, &stats));
+    TEST_ASSERT_EQUAL(1, stats.queue_depth[ESP_EVENT_PRIORITY_NORMAL]);
+    TEST_ASSERT_EQUAL(1, stats.queue_depth[ESP_EVENT_PRIORITY_HIGH]);
+    TEST_ASSERT_EQUAL(1, stats.events_coalesced);
+
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_loop_run(loop, pdMS_TO_TICKS(10)));
+
+    TEST_ASSERT_EQUAL(2, data.index);
+    TEST_ASSERT_EQUAL(1, data_arr[0]);
+    TEST_ASSERT_EQUAL(0, data_arr[1]);
+
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_loop_delete(loop));
+
+    TEST_TEARDOWN();
+}
+
 #if CONFIG_ESP_EVENT_POST_FROM_ISR
 TEST_CASE("can properly prepare event data posted to loop", "[event]")
 {
@@ -0,0 +1,203 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+
+struct mock_queue {
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+    uint8_t storage[];
+};
+
+struct mock_semaphore {
+    int taken;
+    bool counting;
+    UBaseType_t count;
+    UBaseType_t max_count;
+};
+
+static TickType_t s_ticks;
+
+/* Any non-NULL value, there is only one task */
+static int s_current_task;
+
+void mock_freertos_advance_ticks(TickType_t ticks)
+{
+    s_ticks += ticks;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode, const char* pcName, uint32_t usStackDepth,
+                                   void* pvParameters, UBaseType_t uxPriority, TaskHandle_t* pvCreatedTask, BaseType_t xCoreID)
+{
+    return pdFAIL;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return &s_current_task;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return s_ticks;
+}
+
+void vTaskDelete(TaskHandle_t xTask)
+{
+}
+
+void vTaskSuspend(TaskHandle_t xTask)
+{
+    abort();
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize)
+{
+    QueueHandle_t queue = calloc(1, sizeof(*queue) + uxQueueLength * uxItemSize);
+
+    if (queue) {
+        queue->length = uxQueueLength;
+        queue->item_size = uxItemSize;
+    }
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t xQueue)
+{
+    free(xQueue);
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t xQueue, const void* pvItemToQueue, TickType_t xTicksToWait)
+{
+    if (xQueue->count == xQueue->length) {
+        return pdFALSE;
+    }
+
+    UBaseType_t tail = (xQueue->head + xQueue->count) % xQueue->length;
+
+    memcpy(xQueue->storage + tail * xQueue->item_size, pvItemToQueue, xQueue->item_size);
+    xQueue->count++;
+    return pdTRUE;
+}
+
+BaseType_t xQueueSendToBackFromISR(QueueHandle_t xQueue, const void* pvItemToQueue, BaseType_t* pxHigherPriorityTaskWoken)
+{
+    if (pxHigherPriorityTaskWoken) {
+        *pxHigherPriorityTaskWoken = pdFALSE;
+    }
+    return xQueueSendToBack(xQueue, pvItemToQueue, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void* pvBuffer, TickType_t xTicksToWait)
+{
+    if (xQueue->count == 0) {
+        return pdFALSE;
+    }
+
+    memcpy(pvBuffer, xQueue->storage + xQueue->head * xQueue->item_size, xQueue->item_size);
+    xQueue->head = (xQueue->head + 1) % xQueue->length;
+    xQueue->count--;
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue)
+{
+    return xQueue->count;
+}
+
+static SemaphoreHandle_t semaphore_create(void)
+{
+    return calloc(1, sizeof(struct mock_semaphore));
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return semaphore_create();
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void)
+{
+    return semaphore_create();
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t uxMaxCount, UBaseType_t uxInitialCount)
+{
+    SemaphoreHandle_t semaphore = semaphore_create();
+
+    if (semaphore) {
+        semaphore->counting = true;
+        semaphore->count = uxInitialCount;
+        semaphore->max_count = uxMaxCount;
+    }
+    return semaphore;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t xSemaphore)
+{
+    free(xSemaphore);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xTicksToWait)
+{
+    if (xSemaphore->counting) {
+        if (xSemaphore->count == 0) {
+            return pdFALSE;
+        }
+        xSemaphore->count--;
+        return pdTRUE;
+    }
+
+    xSemaphore->taken++;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore)
+{
+    if (xSemaphore->counting) {
+        if (xSemaphore->count == xSemaphore->max_count) {
+            return pdFALSE;
+        }
+        xSemaphore->count++;
+        return pdTRUE;
+    }
+
+    xSemaphore->taken--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t xSemaphore, BaseType_t* pxHigherPriorityTaskWoken)
+{
+    if (pxHigherPriorityTaskWoken) {
+        *pxHigherPriorityTaskWoken = pdFALSE;
+    }
+    return xSemaphoreGive(xSemaphore);
+}
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
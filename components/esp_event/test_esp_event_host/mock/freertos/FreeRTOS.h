@@ -0,0 +1,63 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+/*
+ * Single threaded stand-in for the FreeRTOS API used by the event loop library.
+ * Queues never block: receiving from an empty queue or sending to a full one fails
+ * immediately, and the tick count only moves when a test advances it.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE                 ((BaseType_t)0)
+#define pdTRUE                  ((BaseType_t)1)
+#define pdPASS                  pdTRUE
+#define pdFAIL                  pdFALSE
+#define portMAX_DELAY           ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS      ((TickType_t)10)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms) / portTICK_PERIOD_MS)
+#define configUSE_16_BIT_TICKS  0
+#define portNUM_PROCESSORS      1
+#define tskNO_AFFINITY          0x7fffffff
+
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED    0
+/* Takes the spinlock argument of the multi-core ports, the ESP8266 port has none */
+#define portENTER_CRITICAL(...)         mock_freertos_critical(0, ##__VA_ARGS__)
+#define portEXIT_CRITICAL(...)          mock_freertos_critical(0, ##__VA_ARGS__)
+
+static inline void mock_freertos_critical(int unused, ...)
+{
+}
+
+/**
+ * @brief Advance the tick count returned by xTaskGetTickCount()
+ */
+void mock_freertos_advance_ticks(TickType_t ticks);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,32 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+/* Only the types the legacy event definitions refer to */
+
+#include <stdint.h>
+#include "esp_wifi_types.h"
+
+typedef struct {
+    uint32_t ip;
+} ip_event_ap_staipassigned_t;
+
+typedef struct {
+    uint32_t ip;
+} ip_event_got_ip_t;
+
+typedef struct {
+    uint32_t ip6[4];
+} ip_event_got_ip6_t;
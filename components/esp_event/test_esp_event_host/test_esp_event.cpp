@@ -0,0 +1,433 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "catch.hpp"
+#include "esp_event.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+ESP_EVENT_DEFINE_BASE(TEST_BASE1);
+ESP_EVENT_DEFINE_BASE(TEST_BASE2);
+ESP_EVENT_DEFINE_BASE(TEST_BASE3);
+
+/* Event loop without a task, the test dispatches the posted events */
+class TestLoop
+{
+public:
+    TestLoop(int32_t queueSize = 32, uint32_t dataInlineSize = 0, int32_t queueSizeHigh = 0)
+    {
+        esp_event_loop_args_t args = { };
+        args.queue_size = queueSize;
+        args.task_name = NULL;
+        args.data_inline_size = dataInlineSize;
+        args.queue_size_high = queueSizeHigh;
+        REQUIRE(esp_event_loop_create(&args, &mLoop) == ESP_OK);
+    }
+
+    ~TestLoop()
+    {
+        esp_event_loop_delete(mLoop);
+    }
+
+    void run()
+    {
+        // the mock tick count doesn't move, so the loop runs until the queue is empty
+        REQUIRE(esp_event_loop_run(mLoop, 1) == ESP_OK);
+    }
+
+    operator esp_event_loop_handle_t()
+    {
+        return mLoop;
+    }
+
+protected:
+    esp_event_loop_handle_t mLoop;
+};
+
+static std::vector<int> s_order;
+
+template<int N>
+static void recordHandler(void* arg, esp_event_base_t base, int32_t id, void* data)
+{
+    s_order.push_back(N);
+}
+
+static void countHandler(void* arg, esp_event_base_t base, int32_t id, void* data)
+{
+    ++*static_cast<int*>(arg);
+}
+
+TEST_CASE("handlers are executed in the order they are registered", "[esp_event]")
+{
+    TestLoop loop;
+
+    REQUIRE(esp_event_handler_register_with(loop, TEST_BASE1, 1, recordHandler<1>, NULL) == ESP_OK);
+    REQUIRE(esp_event_handler_register_with(loop, ESP_EVENT_ANY_BASE, ESP_EVENT_ANY_ID, recordHandler<2>, NULL) == ESP_OK);
+    REQUIRE(esp_event_handler_register_with(loop, TEST_BASE1, ESP_EVENT_ANY_ID, recordHandler<3>, NULL) == ESP_OK);
+    REQUIRE(esp_event_handler_register_with(loop, TEST_BASE1, 1, recordHandler<4>, NULL) == ESP_OK);
+    REQUIRE(esp_event_handler_register_with(loop, TEST_BASE2, 7, recordHandler<5>, NULL) == ESP_OK);
+
+    s_order.clear();
+    REQUIRE(esp_event_post_to(loop, TEST_BASE1, 1, NULL, 0, 0) == ESP_OK);
+    loop.run();
+    CHECK(s_order == std::vector<int>({1, 2, 3, 4}));
+
+    s_order.clear();
+    REQUIRE(esp_event_post_to(loop, TEST_BASE1, 2, NULL, 0, 0) == ESP_OK);
+    loop.run();
+    CHECK(s_order == std::vector<int>({2, 3}));
+
+    s_order.clear();
+    REQUIRE(esp_event_post_to(loop, TEST_BASE2, 7, NULL, 0, 0) == ESP_OK);
+    REQUIRE(esp_event_post_to(loop, TEST_BASE3, 7, NULL, 0, 0) == ESP_OK);
+    loop.run();
+    CHECK(s_order == std::vector<int>({2, 5, 2}));
+
+    REQUIRE(esp_event_handler_unregister_with(loop, ESP_EVENT_ANY_BASE, ESP_EVENT_ANY_ID, recordHandler<2>) == ESP_OK);
+    REQUIRE(esp_event_handler_unregister_with(loop, TEST_BASE1, 1, recordHandler<1>) == ESP_OK);
+
+    s_order.clear();
+    REQUIRE(esp_event_post_to(loop, TEST_BASE1, 1, NULL, 0, 0) == ESP_OK);
+    REQUIRE(esp_event_post_to(loop, TEST_BASE3, 7, NULL, 0, 0) == ESP_OK);
+    loop.run();
+    CHECK(s_order == std::vector<int>({3, 4}));
+}
+
+static esp_event_loop_handle_t s_loop;
+
+static void unregisterOthersHandler(void* arg, esp_event_base_t base, int32_t id, void* data)
+{
+    s_order.push_back(10);
+    REQUIRE(esp_event_handler_unregister_with(s_loop, TEST_BASE1, 1, recordHandler<12>) == ESP_OK);
+    REQUIRE(esp_event_handler_unregister_with(s_loop, TEST_BASE1, 1, unregisterOthersHandler) == ESP_OK);
+    REQUIRE(esp_event_handler_register_with(s_loop, TEST_BASE1, 1, recordHandler<13>, NULL) == ESP_OK);
+}
+
+TEST_CASE("handlers registered or unregistered by a handler apply to the event being dispatched", "[esp_event]")
+{
+    TestLoop loop;
+
+    s_loop = loop;
+    REQUIRE(esp_event_handler_register_with(loop, TEST_BASE1, 1, recordHandler<11>, NULL) == ESP_OK);
+    REQUIRE(esp_event_handler_register_with(loop, TEST_BASE1, 1, unregisterOthersHandler, NULL) == ESP_OK);
+    REQUIRE(esp_event_handler_register_with(loop, TEST_BASE1, 1, recordHandler<12>, NULL) == ESP_OK);
+
+    s_order.clear();
+    REQUIRE(esp_event_post_to(loop, TEST_BASE1, 1, NULL, 0, 0) == ESP_OK);
+    loop.run();
+    CHECK(s_order == std::vector<int>({11, 10, 13}));
+
+    s_order.clear();
+    REQUIRE(esp_event_post_to(loop, TEST_BASE1, 1, NULL, 0, 0) == ESP_OK);
+    loop.run();
+    CHECK(s_order == std::vector<int>({11, 13}));
+}
+
+static std::vector<std::vector<uint8_t> > s_data;
+
+static void dataHandler(void* arg, esp_event_base_t base, int32_t id, void* data)
+{
+    // Handlers cast the data to their event structures, it must be aligned
+    CHECK(reinterpret_cast<uintptr_t>(data) % sizeof(uint32_t) == 0);
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    s_data.push_back(std::vector<uint8_t>(bytes, bytes + id));
+}
+
+static std::vector<uint8_t> testData(size_t size)
+{
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = static_cast<uint8_t>(i * 37 + size);
+    }
+    return data;
+}
+
+TEST_CASE("event data is carried in queue items when it fits", "[esp_event]")
+{
+    // the id of the posted events is the size of their data
+    const size_t sizes[] = {1, 4, 5, 24, 48, 49, 200};
+    TestLoop loop(16, 48);
+
+    REQUIRE(esp_event_handler_register_with(loop, TEST_BASE1, ESP_EVENT_ANY_ID, dataHandler, NULL) == ESP_OK);
+
+    s_data.clear();
+    for (auto size : sizes) {
+        auto data = testData(size);
+        REQUIRE(esp_event_post_to(loop, TEST_BASE1, size, data.data(), size, 0) == ESP_OK);
+    }
+    loop.run();
+
+    REQUIRE(s_data.size() == sizeof(sizes) / sizeof(sizes[0]));
+    for (size_t i = 0; i < s_data.size(); i++) {
+        CHECK(s_data[i] == testData(sizes[i]));
+    }
+
+#ifdef CONFIG_ESP_EVENT_LOOP_PROFILING
+    char buf[1024] = { };
+    FILE* f = tmpfile();
+    REQUIRE(esp_event_dump(f) == ESP_OK);
+    rewind(f);
+    CHECK(fread(buf, 1, sizeof(buf) - 1, f) > 0);
+    fclose(f);
+    // the inline data size is rounded up to whole items, only the 200 bytes don't fit
+    CHECK(std::string(buf).find("rx:7 dr:0 co:0 in:6 pl:0 hp:1") != std::string::npos);
+#endif
+}
+
+TEST_CASE("events with inline data can be posted from ISR", "[esp_event]")
+{
+    TestLoop loop(16, 16);
+    TestLoop wordLoop(16);
+    auto data = testData(16);
+
+    REQUIRE(esp_event_handler_register_with(loop, TEST_BASE1, ESP_EVENT_ANY_ID, dataHandler, NULL) == ESP_OK);
+
+    s_data.clear();
+    REQUIRE(esp_event_isr_post_to(loop, TEST_BASE1, 3, data.data(), 3, NULL) == ESP_OK);
+    REQUIRE(esp_event_isr_post_to(loop, TEST_BASE1, 16, data.data(), 16, NULL) == ESP_OK);
+    loop.run();
+
+    REQUIRE(s_data.size() == 2);
+    CHECK(s_data[0] == std::vector<uint8_t>(data.begin(), data.begin() + 3));
+    CHECK(s_data[1] == data);
+
+    CHECK(esp_event_isr_post_to(wordLoop, TEST_BASE1, 4, data.data(), 4, NULL) == ESP_OK);
+    CHECK(esp_event_isr_post_to(wordLoop, TEST_BASE1, 16, data.data(), 16, NULL) == ESP_ERR_INVALID_ARG);
+}
+
+TEST_CASE("inline data size of a loop is limited", "[esp_event]")
+{
+    esp_event_loop_args_t args = { };
+    esp_event_loop_handle_t loop;
+
+    args.queue_size = 4;
+    args.data_inline_size = 129;
+    CHECK(esp_event_loop_create(&args, &loop) == ESP_ERR_INVALID_ARG);
+
+    args.data_inline_size = 128;
+    REQUIRE(esp_event_loop_create(&args, &loop) == ESP_OK);
+    CHECK(esp_event_loop_delete(loop) == ESP_OK);
+}
+
+static std::vector<std::pair<int32_t, int> > s_events;
+
+// records the id of the event and its int data, -1 if it has none
+static void eventHandler(void* arg, esp_event_base_t base, int32_t id, void* data)
+{
+    s_events.push_back(std::make_pair(id, data ? *static_cast<int*>(data) : -1));
+}
+
+static esp_err_t post(esp_event_loop_handle_t loop, int32_t id, int value,
+                      esp_event_priority_t priority = ESP_EVENT_PRIORITY_NORMAL)
+{
+    return esp_event_post_to_with_priority(loop, TEST_BASE1, id, &value, sizeof(value), priority, 0);
+}
+
+TEST_CASE("high priority posts are dispatched before pending normal posts", "[esp_event]")
+{
+    TestLoop loop(8, 0, 4);
+    TestLoop singleLane(8);
+
+    for (esp_event_loop_handle_t l : {static_cast<esp_event_loop_handle_t>(loop), static_cast<esp_event_loop_handle_t>(singleLane)}) {
+        REQUIRE(esp_event_handler_register_with(l, TEST_BASE1, ESP_EVENT_ANY_ID, eventHandler, NULL) == ESP_OK);
+        REQUIRE(post(l, 1, 10) == ESP_OK);
+        REQUIRE(post(l, 2, 20) == ESP_OK);
+        REQUIRE(post(l, 3, 30, ESP_EVENT_PRIORITY_HIGH) == ESP_OK);
+        REQUIRE(post(l, 4, 40, ESP_EVENT_PRIORITY_HIGH) == ESP_OK);
+        REQUIRE(esp_event_post_to(l, TEST_BASE1, 5, NULL, 0, 0) == ESP_OK);
+    }
+
+    s_events.clear();
+    loop.run();
+    std::vector<std::pair<int32_t, int> > expected = {{3, 30}, {4, 40}, {1, 10}, {2, 20}, {5, -1}};
+    CHECK(s_events == expected);
+
+    // a loop with a single lane takes the high priority posts in it
+    s_events.clear();
+    singleLane.run();
+    expected = {{1, 10}, {2, 20}, {3, 30}, {4, 40}, {5, -1}};
+    CHECK(s_events == expected);
+
+    CHECK(post(loop, 1, 10, ESP_EVENT_PRIORITY_MAX) == ESP_ERR_INVALID_ARG);
+}
+
+TEST_CASE("pending posts of coalesced events are dispatched once with the latest data", "[esp_event]")
+{
+    TestLoop loop(8, 16);
+    esp_event_loop_stats_t stats;
+
+    REQUIRE(esp_event_handler_register_with(loop, TEST_BASE1, ESP_EVENT_ANY_ID, eventHandler, NULL) == ESP_OK);
+    REQUIRE(esp_event_coalesce_register_with(loop, TEST_BASE1, 1) == ESP_OK);
+
+    s_events.clear();
+    REQUIRE(post(loop, 1, 10) == ESP_OK);
+    REQUIRE(post(loop, 2, 20) == ESP_OK);
+    REQUIRE(post(loop, 1, 11) == ESP_OK);
+    REQUIRE(post(loop, 2, 21) == ESP_OK);
+    REQUIRE(post(loop, 1, 12) == ESP_OK);
+
+    REQUIRE(esp_event_loop_get_stats(loop, &stats) == ESP_OK);
+    CHECK(stats.queue_depth[ESP_EVENT_PRIORITY_NORMAL] == 3);
+    CHECK(stats.events_coalesced == 2);
+
+    loop.run();
+    std::vector<std::pair<int32_t, int> > expected = {{1, 12}, {2, 20}, {2, 21}};
+    CHECK(s_events == expected);
+
+    // the event is posted again once the pending post has been dispatched, also without data
+    s_events.clear();
+    REQUIRE(post(loop, 1, 13) == ESP_OK);
+    loop.run();
+    REQUIRE(esp_event_post_to(loop, TEST_BASE1, 1, NULL, 0, 0) == ESP_OK);
+    REQUIRE(post(loop, 1, 14) == ESP_OK);
+    REQUIRE(esp_event_post_to(loop, TEST_BASE1, 1, NULL, 0, 0) == ESP_OK);
+    loop.run();
+    expected = {{1, 13}, {1, -1}};
+    CHECK(s_events == expected);
+
+    // a post which is pending when coalescing stops still carries the latest data
+    s_events.clear();
+    REQUIRE(post(loop, 1, 15) == ESP_OK);
+    REQUIRE(post(loop, 1, 16) == ESP_OK);
+    REQUIRE(esp_event_coalesce_unregister_with(loop, TEST_BASE1, 1) == ESP_OK);
+    CHECK(esp_event_coalesce_unregister_with(loop, TEST_BASE1, 1) == ESP_ERR_NOT_FOUND);
+    REQUIRE(post(loop, 1, 17) == ESP_OK);
+    REQUIRE(post(loop, 1, 18) == ESP_OK);
+    loop.run();
+    expected = {{1, 16}, {1, 17}, {1, 18}};
+    CHECK(s_events == expected);
+
+    REQUIRE(esp_event_loop_get_stats(loop, &stats) == ESP_OK);
+    CHECK(stats.events_coalesced == 5);
+
+    CHECK(esp_event_coalesce_register_with(loop, TEST_BASE1, ESP_EVENT_ANY_ID) == ESP_ERR_INVALID_ARG);
+    CHECK(esp_event_coalesce_register_with(loop, ESP_EVENT_ANY_BASE, ESP_EVENT_ANY_ID) == ESP_ERR_INVALID_ARG);
+    CHECK(esp_event_coalesce_unregister_with(loop, TEST_BASE2, 1) == ESP_ERR_NOT_FOUND);
+
+    // the data of a pending post is freed with the loop
+    REQUIRE(esp_event_coalesce_register_with(loop, TEST_BASE1, 1) == ESP_OK);
+    REQUIRE(post(loop, 1, 19) == ESP_OK);
+}
+
+TEST_CASE("queue depth and dropped posts are counted per loop", "[esp_event]")
+{
+    TestLoop loop(2, 0, 1);
+    esp_event_loop_stats_t stats;
+
+    REQUIRE(esp_event_handler_register_with(loop, TEST_BASE1, ESP_EVENT_ANY_ID, eventHandler, NULL) == ESP_OK);
+    REQUIRE(esp_event_coalesce_register_with(loop, TEST_BASE1, 3) == ESP_OK);
+
+    REQUIRE(post(loop, 1, 10) == ESP_OK);
+    REQUIRE(post(loop, 2, 20) == ESP_OK);
+    CHECK(post(loop, 1, 11) == ESP_ERR_TIMEOUT);
+    // a coalesced event which doesn't fit is dropped and not left pending
+    CHECK(post(loop, 3, 30) == ESP_ERR_TIMEOUT);
+    REQUIRE(post(loop, 4, 40, ESP_EVENT_PRIORITY_HIGH) == ESP_OK);
+    CHECK(post(loop, 4, 41, ESP_EVENT_PRIORITY_HIGH) == ESP_ERR_TIMEOUT);
+
+    REQUIRE(esp_event_loop_get_stats(loop, &stats) == ESP_OK);
+    CHECK(stats.queue_depth[ESP_EVENT_PRIORITY_NORMAL] == 2);
+    CHECK(stats.queue_depth[ESP_EVENT_PRIORITY_HIGH] == 1);
+    CHECK(stats.events_dropped == 3);
+    CHECK(stats.events_coalesced == 0);
+
+    s_events.clear();
+    loop.run();
+    REQUIRE(post(loop, 3, 31) == ESP_OK);
+    loop.run();
+    std::vector<std::pair<int32_t, int> > expected = {{4, 40}, {1, 10}, {2, 20}, {3, 31}};
+    CHECK(s_events == expected);
+
+    REQUIRE(esp_event_loop_get_stats(loop, &stats) == ESP_OK);
+    CHECK(stats.queue_depth[ESP_EVENT_PRIORITY_NORMAL] == 0);
+    CHECK(stats.queue_depth[ESP_EVENT_PRIORITY_HIGH] == 0);
+}
+
+TEST_CASE("dump esp_event dispatch performance", "[esp_event][benchmark]")
+{
+    // 64 handlers is roughly the default loop of an application with Wi-Fi, IP, provisioning and
+    // application events. The time per event should not grow with the number of handlers.
+    const esp_event_base_t bases[] = {TEST_BASE1, TEST_BASE2, TEST_BASE3};
+    const int batch = 32;
+    const int posts = 100000;
+    const int rounds = 5;
+
+    for (int handlers = 16; handlers <= 256; handlers *= 4) {
+        TestLoop loop(batch);
+        const int32_t ids = handlers / 3 + 1;
+        int count = 0, posted = 0;
+        double best = 0;
+
+        for (int i = 0; i < handlers; i++) {
+            REQUIRE(esp_event_handler_register_with(loop, bases[i % 3], i / 3, countHandler, &count) == ESP_OK);
+        }
+
+        // Take the best of a few rounds, so that the result doesn't depend on the load of the host
+        for (int round = 0; round < rounds; round++) {
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < posts; i += batch) {
+                for (int j = 0; j < batch; j++) {
+                    int event = (i + j) * 7 % handlers;
+                    posted += esp_event_post_to(loop, bases[event % 3], event / 3 % ids, NULL, 0, 0) == ESP_OK;
+                }
+                esp_event_loop_run(loop, 1);
+            }
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / posts;
+            if (round == 0 || ns < best) {
+                best = ns;
+            }
+        }
+
+        CHECK(posted == posts * rounds);
+        CHECK(count == posts * rounds);
+        printf("%d handlers: %.1f ns/event (post and dispatch)\n", handlers, best);
+    }
+}
+
+TEST_CASE("dump esp_event post data performance", "[esp_event][benchmark]")
+{
+    const int batch = 32;
+    const int posts = 100000;
+    const int rounds = 5;
+    uint8_t data[24] = { };
+
+    for (uint32_t dataInlineSize : {0, 32}) {
+        TestLoop loop(batch, dataInlineSize);
+        int count = 0, posted = 0;
+        double best = 0;
+
+        REQUIRE(esp_event_handler_register_with(loop, TEST_BASE1, 1, countHandler, &count) == ESP_OK);
+
+        for (int round = 0; round < rounds; round++) {
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < posts; i += batch) {
+                for (int j = 0; j < batch; j++) {
+                    posted += esp_event_post_to(loop, TEST_BASE1, 1, data, sizeof(data), 0) == ESP_OK;
+                }
+                esp_event_loop_run(loop, 1);
+            }
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / posts;
+            if (round == 0 || ns < best) {
+                best = ns;
+            }
+        }
+
+        CHECK(posted == posts * rounds);
+        CHECK(count == posts * rounds);
+        printf("%zu bytes of data, %s: %.1f ns/event (post and dispatch)\n", sizeof(data),
+               dataInlineSize ? "inline" : "heap", best);
+    }
+}
@@ -23,6 +23,7 @@
 #include "esp_transport_tcp.h"
 #include "http_utils.h"
 #include "http_auth.h"
+#include "http_pool.h"
 #include "sdkconfig.h"
 #include "esp_http_client.h"
 #include "errno.h"
@@ -119,6 +120,16 @@ struct esp_http_client {
     bool                        first_line_prepared;
     int                         header_index;
     bool                        is_async;
+    bool                        is_pipelined;
+    http_pool_handle_t          pool;
+    esp_transport_list_handle_t pool_connection;    /*!< Connection taken from or made for the pool, owned until it is given back */
+    char                        *pool_key;
+    bool                        connection_reused;
+    const char                  *cert_pem;
+    const char                  *client_cert_pem;
+    const char                  *client_key_pem;
+    bool                        use_global_ca_store;
+    bool                        skip_cert_common_name_check;
 };
 
 typedef struct esp_http_client esp_http_client_t;
@@ -260,6 +271,10 @@ static int http_on_message_complete(http_parser *parser)
     ESP_LOGD(TAG, "http_on_message_complete, parser=%x", (int)parser);
     esp_http_client_handle_t client = parser->data;
     client->is_chunk_complete = true;
+    if (client->is_pipelined) {
+        /* Stop at the end of each response, the next one being in the same buffer maybe */
+        http_parser_pause(parser, 1);
+    }
     return 0;
 }
 
@@ -424,7 +439,14 @@ static esp_err_t _set_config(esp_http_client_handle_t client, const esp_http_cli
     }
     if (config->is_async) {
         client->is_async = true;
+    } else {
+        client->pool = (http_pool_handle_t) config->pool;
     }
+    client->cert_pem = config->cert_pem;
+    client->client_cert_pem = config->client_cert_pem;
+    client->client_key_pem = config->client_key_pem;
+    client->use_global_ca_store = config->use_global_ca_store;
+    client->skip_cert_common_name_check = config->skip_cert_common_name_check;
 
     return ESP_OK;
 }
@@ -461,6 +483,43 @@ static esp_err_t _clear_auth_data(esp_http_client_handle_t client)
     return ESP_OK;
 }
 
+/* Makes the transport of a scheme, for the transport list of the client or for a connection of the pool */
+static esp_transport_handle_t _init_transport(esp_http_client_handle_t client, const char *scheme)
+{
+    esp_transport_handle_t t = NULL;
+
+    if (strcasecmp(scheme, "http") == 0) {
+        if ((t = esp_transport_tcp_init()) != NULL) {
+            esp_transport_set_default_port(t, DEFAULT_HTTP_PORT);
+        }
+        return t;
+    }
+#ifdef CONFIG_ESP_HTTP_CLIENT_ENABLE_HTTPS
+    if (strcasecmp(scheme, "https") == 0 && (t = esp_transport_ssl_init()) != NULL) {
+        esp_transport_set_default_port(t, DEFAULT_HTTPS_PORT);
+
+        if (client->use_global_ca_store == true) {
+            esp_transport_ssl_enable_global_ca_store(t);
+        } else if (client->cert_pem) {
+            esp_transport_ssl_set_cert_data(t, client->cert_pem, strlen(client->cert_pem));
+        }
+
+        if (client->client_cert_pem) {
+            esp_transport_ssl_set_client_cert_data(t, client->client_cert_pem, strlen(client->client_cert_pem));
+        }
+
+        if (client->client_key_pem) {
+            esp_transport_ssl_set_client_key_data(t, client->client_key_pem, strlen(client->client_key_pem));
+        }
+
+        if (client->skip_cert_common_name_check) {
+            esp_transport_ssl_skip_common_name_check(t);
+        }
+    }
+#endif
+    return t;
+}
+
 static esp_err_t esp_http_client_prepare(esp_http_client_handle_t client)
 {
     client->process_again = 0;
@@ -513,10 +572,14 @@ esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *co
         goto error;
     }
 
+    if (_set_config(client, config) != ESP_OK) {
+        ESP_LOGE(TAG, "Error set configurations");
+        goto error;
+    }
+
     _success = (
                    (client->transport_list = esp_transport_list_init()) &&
-                   (tcp = esp_transport_tcp_init()) &&
-                   (esp_transport_set_default_port(tcp, DEFAULT_HTTP_PORT) == ESP_OK) &&
+                   (tcp = _init_transport(client, "http")) &&
                    (esp_transport_list_add(client->transport_list, tcp, "http") == ESP_OK)
                );
     if (!_success) {
@@ -526,8 +589,7 @@ esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *co
 #ifdef CONFIG_ESP_HTTP_CLIENT_ENABLE_HTTPS
     esp_transport_handle_t ssl;
     _success = (
-                   (ssl = esp_transport_ssl_init()) &&
-                   (esp_transport_set_default_port(ssl, DEFAULT_HTTPS_PORT) == ESP_OK) &&
+                   (ssl = _init_transport(client, "https")) &&
                    (esp_transport_list_add(client->transport_list, ssl, "https") == ESP_OK)
                );
 
@@ -535,30 +597,7 @@ esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *co
         ESP_LOGE(TAG, "Error initialize SSL Transport");
         goto error;
     }
-
-    if (config->use_global_ca_store == true) {
-        esp_transport_ssl_enable_global_ca_store(ssl);
-    } else if (config->cert_pem) {
-        esp_transport_ssl_set_cert_data(ssl, config->cert_pem, strlen(config->cert_pem));
-    }
-
-    if (config->client_cert_pem) {
-        esp_transport_ssl_set_client_cert_data(ssl, config->client_cert_pem, strlen(config->client_cert_pem));
-    }
-
-    if (config->client_key_pem) {
-        esp_transport_ssl_set_client_key_data(ssl, config->client_key_pem, strlen(config->client_key_pem));
-    }
-
-    if (config->skip_cert_common_name_check) {
-        esp_transport_ssl_skip_common_name_check(ssl);
-    }
 #endif
-
-    if (_set_config(client, config) != ESP_OK) {
-        ESP_LOGE(TAG, "Error set configurations");
-        goto error;
-    }
     _success = (
                    (client->request->buffer->data  = malloc(client->buffer_size_tx))  &&
                    (client->response->buffer->data = malloc(client->buffer_size_rx))
@@ -620,7 +659,9 @@ esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
         return ESP_FAIL;
     }
     esp_http_client_close(client);
-    esp_transport_list_destroy(client->transport_list);
+    if (client->transport_list) {
+        esp_transport_list_destroy(client->transport_list);
+    }
     if (client->request) {
         http_header_destroy(client->request->headers);
         if (client->request->buffer) {
@@ -896,6 +937,104 @@ int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
     return ridx;
 }
 
+/* Whether another request can be sent on the connection: none was sent on it yet, or the last response
+ * was read through and the server didn't ask to close it */
+static bool http_client_connection_is_idle(esp_http_client_handle_t client)
+{
+    if (client->state == HTTP_STATE_CONNECTED) {
+        return !client->first_line_prepared;
+    }
+    return client->state >= HTTP_STATE_RES_COMPLETE_HEADER &&
+           esp_http_client_is_complete_data_received(client) &&
+           http_should_keep_alive(client->parser);
+}
+
+/* Gives the connection back to the pool if it is idle, closes it otherwise */
+static void http_client_release_connection(esp_http_client_handle_t client)
+{
+    if (client->pool_connection) {
+        if (http_client_connection_is_idle(client)) {
+            ESP_LOGD(TAG, "Give connection to %s back to the pool", client->pool_key);
+            http_pool_put(client->pool, client->pool_key, client->pool_connection);
+        } else {
+            esp_transport_list_destroy(client->pool_connection);
+        }
+        client->pool_connection = NULL;
+        client->transport = NULL;
+    }
+    free(client->pool_key);
+    client->pool_key = NULL;
+}
+
+/* Key of the pool connections the client can take. TLS connections are only shared by the clients
+ * which verify the server and authenticate themselves with the same settings */
+static char *http_client_pool_key(esp_http_client_handle_t client)
+{
+    connection_info_t *info = &client->connection_info;
+    char *key = NULL;
+    int ret;
+
+    if (strcasecmp(info->scheme, "https") == 0) {
+        ret = asprintf(&key, "%s://%s:%d ca=%p,%d cn=%d cert=%p key=%p", info->scheme, info->host, info->port,
+                       client->cert_pem, client->use_global_ca_store, client->skip_cert_common_name_check,
+                       client->client_cert_pem, client->client_key_pem);
+    } else {
+        ret = asprintf(&key, "%s://%s:%d", info->scheme, info->host, info->port);
+    }
+    return ret < 0 ? NULL : key;
+}
+
+/* Takes an idle connection to the host of the URL from the pool, or makes the transport of a new one */
+static esp_transport_handle_t http_client_take_connection(esp_http_client_handle_t client)
+{
+    connection_info_t *info = &client->connection_info;
+    esp_transport_handle_t t;
+
+    /* Left by a connection which failed */
+    http_client_release_connection(client);
+
+    client->pool_key = http_client_pool_key(client);
+    HTTP_MEM_CHECK(TAG, client->pool_key, return NULL);
+
+    client->pool_connection = http_pool_get(client->pool, client->pool_key);
+    client->connection_reused = client->pool_connection != NULL;
+    if (client->pool_connection) {
+        ESP_LOGD(TAG, "Reuse connection to %s from the pool", client->pool_key);
+        return esp_transport_list_get_transport(client->pool_connection, NULL);
+    }
+
+    /* Each connection has a transport list of its own, sharing errors with the transport */
+    if ((t = _init_transport(client, info->scheme)) == NULL) {
+        return NULL;
+    }
+    if ((client->pool_connection = esp_transport_list_init()) == NULL ||
+            esp_transport_list_add(client->pool_connection, t, info->scheme) != ESP_OK) {
+        esp_transport_destroy(t);
+        if (client->pool_connection) {
+            esp_transport_list_destroy(client->pool_connection);
+            client->pool_connection = NULL;
+        }
+        return NULL;
+    }
+    return t;
+}
+
+/* The server may close an idle connection of the pool while the request is sent on it, in which case
+ * the request is sent again on another connection */
+static bool http_client_retry_on_new_connection(esp_http_client_handle_t client)
+{
+    if (!client->connection_reused) {
+        return false;
+    }
+    ESP_LOGD(TAG, "Connection from the pool failed, retry on another one");
+    client->connection_reused = false;
+    if (client->state > HTTP_STATE_INIT) {
+        esp_http_client_close(client);
+    }
+    client->process_again = 1;
+    return true;
+}
+
 esp_err_t esp_http_client_perform(esp_http_client_handle_t client)
 {
     esp_err_t err;
@@ -921,6 +1060,9 @@ esp_err_t esp_http_client_perform(esp_http_client_handle_t client)
                     if (client->is_async && errno == EAGAIN) {
                         return ESP_ERR_HTTP_EAGAIN;
                     }
+                    if (http_client_retry_on_new_connection(client)) {
+                        break;
+                    }
                     return err;
                 }
                 /* falls through */
@@ -937,6 +1079,10 @@ esp_err_t esp_http_client_perform(esp_http_client_handle_t client)
                     if (client->is_async && errno == EAGAIN) {
                         return ESP_ERR_HTTP_EAGAIN;
                     }
+                    /* Only if nothing of the response came, the request may have been processed otherwise */
+                    if (client->parser->nread == 0 && http_client_retry_on_new_connection(client)) {
+                        break;
+                    }
                     return ESP_ERR_HTTP_FETCH_HEADER;
                 }
                 /* falls through */
@@ -1024,7 +1170,11 @@ static esp_err_t esp_http_client_connect(esp_http_client_handle_t client)
 
     if (client->state < HTTP_STATE_CONNECTED) {
         ESP_LOGD(TAG, "Begin connect to: %s://%s:%d", client->connection_info.scheme, client->connection_info.host, client->connection_info.port);
-        client->transport = esp_transport_list_get_transport(client->transport_list, client->connection_info.scheme);
+        if (client->pool) {
+            client->transport = http_client_take_connection(client);
+        } else {
+            client->transport = esp_transport_list_get_transport(client->transport_list, client->connection_info.scheme);
+        }
         if (client->transport == NULL) {
             ESP_LOGE(TAG, "No transport found");
 #ifndef CONFIG_ESP_HTTP_CLIENT_ENABLE_HTTPS
@@ -1034,7 +1184,9 @@ static esp_err_t esp_http_client_connect(esp_http_client_handle_t client)
 #endif
             return ESP_ERR_HTTP_INVALID_TRANSPORT;
         }
-        if (!client->is_async) {
+        if (client->connection_reused) {
+            /* Connected already */
+        } else if (!client->is_async) {
             if (esp_transport_connect(client->transport, client->connection_info.host, client->connection_info.port, client->timeout_ms) < 0) {
                 ESP_LOGE(TAG, "Connection failed, sock < 0");
                 return ESP_ERR_HTTP_CONNECT;
@@ -1224,6 +1376,11 @@ esp_err_t esp_http_client_close(esp_http_client_handle_t client)
 {
     if (client->state >= HTTP_STATE_INIT) {
         http_dispatch_event(client, HTTP_EVENT_DISCONNECTED, esp_transport_get_error_handle(client->transport), 0);
+        if (client->pool) {
+            http_client_release_connection(client);
+            client->state = HTTP_STATE_INIT;
+            return ESP_OK;
+        }
         client->state = HTTP_STATE_INIT;
         return esp_transport_close(client->transport);
     }
@@ -1357,3 +1514,144 @@ esp_err_t esp_http_client_get_url(esp_http_client_handle_t client, char *url, co
     }
     return ESP_FAIL;
 }
+
+/* Sends the requests, then reads the responses, counting those passed to the event handler */
+static esp_err_t http_client_pipeline(esp_http_client_handle_t client, const char *const paths[], int count, int *finished)
+{
+    esp_http_buffer_t *buffer = client->response->buffer;
+    esp_err_t err;
+
+    if ((err = esp_http_client_connect(client)) != ESP_OK) {
+        return err;
+    }
+    for (int i = 0; i < count; i++) {
+        http_utils_assign_string(&client->connection_info.path, paths[i], 0);
+        HTTP_MEM_CHECK(TAG, client->connection_info.path, return ESP_ERR_NO_MEM);
+        client->first_line_prepared = false;
+        if ((err = esp_http_client_request_send(client, 0)) != ESP_OK) {
+            return err;
+        }
+    }
+
+    http_utils_assign_string(&client->connection_info.path, paths[0], 0);
+    HTTP_MEM_CHECK(TAG, client->connection_info.path, return ESP_ERR_NO_MEM);
+    client->state = HTTP_STATE_REQ_COMPLETE_DATA;
+    client->response->status_code = -1;
+    bool keep_alive = true;
+    while (*finished < count) {
+        int len = esp_transport_read(client->transport, buffer->data, client->buffer_size_rx, client->timeout_ms);
+        if (len <= 0) {
+            ESP_LOGE(TAG, "Connection closed after %d of %d responses", *finished, count);
+            return ESP_ERR_HTTP_FETCH_HEADER;
+        }
+        char *data = buffer->data;
+        while (len > 0 && *finished < count) {
+            size_t parsed = http_parser_execute(client->parser, client->parser_settings, data, len);
+            buffer->raw_len = 0;
+            if (HTTP_PARSER_ERRNO(client->parser) != HPE_PAUSED) {
+                if (HTTP_PARSER_ERRNO(client->parser) != HPE_OK) {
+                    ESP_LOGE(TAG, "Error parsing response %d: %s", *finished, http_errno_name(HTTP_PARSER_ERRNO(client->parser)));
+                    return ESP_ERR_HTTP_FETCH_HEADER;
+                }
+                break;
+            }
+            http_parser_pause(client->parser, 0);
+            data += parsed;
+            len -= parsed;
+
+            http_dispatch_event(client, HTTP_EVENT_ON_FINISH, NULL, 0);
+            keep_alive = http_should_keep_alive(client->parser);
+            if (++*finished == count) {
+                break;
+            }
+            if (!keep_alive) {
+                ESP_LOGE(TAG, "Server closes the connection after %d of %d responses", *finished, count);
+                return ESP_ERR_HTTP_FETCH_HEADER;
+            }
+            http_utils_assign_string(&client->connection_info.path, paths[*finished], 0);
+            HTTP_MEM_CHECK(TAG, client->connection_info.path, return ESP_ERR_NO_MEM);
+            client->state = HTTP_STATE_REQ_COMPLETE_DATA;
+            client->response->status_code = -1;
+        }
+        /* Anything after the last response can't be told apart from the next one */
+        if (len > 0 && *finished == count) {
+            keep_alive = false;
+        }
+    }
+
+    if (keep_alive) {
+        client->state = HTTP_STATE_CONNECTED;
+        client->first_line_prepared = false;
+    } else {
+        esp_http_client_close(client);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_perform_pipelined(esp_http_client_handle_t client, const char *const paths[], int count)
+{
+    if (client == NULL || paths == NULL || count <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < count; i++) {
+        if (paths[i] == NULL) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    if (client->is_async) {
+        ESP_LOGE(TAG, "Pipelining is not supported in asynchronous mode");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    esp_http_client_method_t method = client->connection_info.method;
+    int post_len = client->post_len;
+    int finished;
+    esp_err_t err;
+
+    /* The paths come with their query */
+    free(client->connection_info.query);
+    client->connection_info.query = NULL;
+    client->connection_info.method = HTTP_METHOD_GET;
+    client->post_len = 0;
+    client->is_pipelined = true;
+    do {
+        finished = 0;
+        err = http_client_pipeline(client, paths, count, &finished);
+    } while (err != ESP_OK && finished == 0 && client->parser->nread == 0 &&
+             http_client_retry_on_new_connection(client));
+    client->is_pipelined = false;
+    client->process_again = 0;
+    client->connection_info.method = method;
+    client->post_len = post_len;
+
+    if (err != ESP_OK && client->state > HTTP_STATE_INIT) {
+        esp_http_client_close(client);
+    }
+    return err;
+}
+
+esp_http_client_pool_handle_t esp_http_client_pool_create(const esp_http_client_pool_config_t *config)
+{
+    if (config == NULL) {
+        return NULL;
+    }
+    return (esp_http_client_pool_handle_t) http_pool_init(config->max_connections, config->max_per_host, config->idle_timeout_ms);
+}
+
+esp_err_t esp_http_client_pool_purge(esp_http_client_pool_handle_t pool)
+{
+    if (pool == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    http_pool_purge((http_pool_handle_t) pool);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_pool_destroy(esp_http_client_pool_handle_t pool)
+{
+    if (pool == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    http_pool_destroy((http_pool_handle_t) pool);
+    return ESP_OK;
+}
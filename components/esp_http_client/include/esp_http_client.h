@@ -95,6 +95,23 @@ typedef enum {
     HTTP_AUTH_TYPE_DIGEST,      /*!< HTTP Disgest authentication */
 } esp_http_client_auth_type_t;
 
+typedef struct esp_http_client_pool *esp_http_client_pool_handle_t;
+
+/**
+ * @brief Keep-alive connection pool configuration
+ */
+typedef struct {
+    int max_connections;    /*!< Maximum number of idle connections kept, for all hosts together */
+    int max_per_host;       /*!< Maximum number of idle connections kept for one scheme, host and port, max_connections if zero */
+    int idle_timeout_ms;    /*!< Idle connections are closed after this time instead of being reused, never if zero */
+} esp_http_client_pool_config_t;
+
+#define ESP_HTTP_CLIENT_POOL_DEFAULT_CONFIG() {     \
+        .max_connections = 4,                       \
+        .max_per_host = 2,                          \
+        .idle_timeout_ms = 30000,                   \
+}
+
 /**
  * @brief HTTP configuration
  */
@@ -122,6 +139,7 @@ typedef struct {
     bool                        is_async;                 /*!< Set asynchronous mode, only supported with HTTPS for now */
     bool                        use_global_ca_store;      /*!< Use a global ca_store for all the connections in which this bool is set. */
     bool                        skip_cert_common_name_check;    /*!< Skip any validation of server certificate CN field */
+    esp_http_client_pool_handle_t pool;                   /*!< Pool of keep-alive connections shared with other clients, see `esp_http_client_pool_create`, not used in asynchronous mode */
 } esp_http_client_config_t;
 
 /**
@@ -525,6 +543,77 @@ int esp_http_client_read_response(esp_http_client_handle_t client, char *buffer,
 
 esp_err_t esp_http_client_get_url(esp_http_client_handle_t client, char *url, const int len);
 
+/**
+ * @brief      Send GET requests for several paths of the current host over one connection, before reading the responses.
+ *             The responses are passed to the event handler in the order of the paths, each one ending with an
+ *             HTTP_EVENT_ON_FINISH event. While its events are dispatched, the path of the client is the one of the
+ *             response, so that `esp_http_client_get_url` and `esp_http_client_get_status_code` tell which request
+ *             it answers and how. The client is left with the last path.
+ *
+ * @note       Redirections and authentication challenges aren't followed, the server must keep the connection open
+ *             until the last response, and the paths replace the path and query of the URL of the client.
+ *             Pipelining isn't supported in asynchronous mode.
+ *
+ * @param[in]  client  The esp_http_client handle
+ * @param[in]  paths   The paths to get, each one with its query if any
+ * @param[in]  count   The number of paths
+ *
+ * @return
+ *     - ESP_OK if all the responses were received
+ *     - ESP_ERR_INVALID_ARG
+ *     - ESP_ERR_NOT_SUPPORTED in asynchronous mode
+ *     - ESP_ERR_HTTP_FETCH_HEADER if a response is missing
+ *     - Errors of the connection and of sending the requests
+ */
+esp_err_t esp_http_client_perform_pipelined(esp_http_client_handle_t client, const char *const paths[], int count);
+
+/**
+ * @brief      Create a pool of keep-alive connections, for clients to share through the `pool` field of their
+ *             configuration.
+ *             A client takes an idle connection to its scheme, host and port from the pool when it connects, and
+ *             gives its connection back when it is closed or cleaned up, or when its URL changes host, unless the
+ *             server asked to close it or a response wasn't read through. As the server may close an idle
+ *             connection at any time, `esp_http_client_perform` retries a request on a new connection if it
+ *             fails on one taken from the pool before the response headers came.
+ *
+ * @note       TLS connections are only shared by the clients configured with the same `cert_pem`,
+ *             `client_cert_pem` and `client_key_pem` pointers, `use_global_ca_store` and
+ *             `skip_cert_common_name_check`. Each of these groups of clients has its own `max_per_host`.
+ *             The certificates and keys given in the configuration of a client must stay valid until it is
+ *             cleaned up, as connections are made with them after `esp_http_client_init` returns.
+ *
+ * @param[in]  config  The pool configuration, see `ESP_HTTP_CLIENT_POOL_DEFAULT_CONFIG`
+ *
+ * @return
+ *     - `esp_http_client_pool_handle_t`
+ *     - NULL if any errors
+ */
+esp_http_client_pool_handle_t esp_http_client_pool_create(const esp_http_client_pool_config_t *config);
+
+/**
+ * @brief      Close the idle connections which have timed out.
+ *             The pool otherwise only closes them when a client connects or gives back a connection.
+ *
+ * @param[in]  pool  The pool handle
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ */
+esp_err_t esp_http_client_pool_purge(esp_http_client_pool_handle_t pool);
+
+/**
+ * @brief      Close the idle connections of a pool and free it.
+ *             The clients using the pool must have been cleaned up before.
+ *
+ * @param[in]  pool  The pool handle
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG
+ */
+esp_err_t esp_http_client_pool_destroy(esp_http_client_pool_handle_t pool);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,170 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "http_pool.h"
+#include "http_utils.h"
+
+static const char *TAG = "HTTP_POOL";
+
+/**
+ * Idle connection
+ */
+typedef struct {
+    char                        *key;       /*!< "scheme://host:port" of the connection */
+    esp_transport_list_handle_t list;       /*!< Transport list owning the connected transport */
+    TickType_t                  released;   /*!< When the connection was given to the pool */
+} http_pool_item_t;
+
+struct http_pool {
+    SemaphoreHandle_t   lock;
+    http_pool_item_t    *items;             /*!< Idle connections, from the least to the most recently released */
+    int                 count;
+    int                 max_connections;
+    int                 max_per_key;
+    TickType_t          idle_timeout;       /*!< 0 if connections don't expire */
+};
+
+http_pool_handle_t http_pool_init(int max_connections, int max_per_key, int idle_timeout_ms)
+{
+    if (max_connections <= 0 || max_per_key < 0 || idle_timeout_ms < 0) {
+        return NULL;
+    }
+    http_pool_handle_t pool = calloc(1, sizeof(struct http_pool));
+    HTTP_MEM_CHECK(TAG, pool, return NULL);
+    pool->items = calloc(max_connections, sizeof(http_pool_item_t));
+    pool->lock = xSemaphoreCreateMutex();
+    if (pool->items == NULL || pool->lock == NULL) {
+        ESP_LOGE(TAG, "Memory exhausted");
+        http_pool_destroy(pool);
+        return NULL;
+    }
+    pool->max_connections = max_connections;
+    pool->max_per_key = max_per_key ? max_per_key : max_connections;
+    pool->idle_timeout = pdMS_TO_TICKS(idle_timeout_ms);
+    if (idle_timeout_ms && pool->idle_timeout == 0) {
+        pool->idle_timeout = 1;
+    }
+    return pool;
+}
+
+/* Closes the connection at index i, the following ones take its place */
+static void http_pool_remove(http_pool_handle_t pool, int i)
+{
+    esp_transport_list_destroy(pool->items[i].list);
+    free(pool->items[i].key);
+    memmove(&pool->items[i], &pool->items[i + 1], (pool->count - i - 1) * sizeof(http_pool_item_t));
+    pool->count--;
+}
+
+static void http_pool_remove_expired(http_pool_handle_t pool)
+{
+    if (pool->idle_timeout == 0) {
+        return;
+    }
+    TickType_t now = xTaskGetTickCount();
+    /* The least recently released connections come first */
+    while (pool->count > 0 && now - pool->items[0].released >= pool->idle_timeout) {
+        ESP_LOGD(TAG, "Idle connection to %s timed out", pool->items[0].key);
+        http_pool_remove(pool, 0);
+    }
+}
+
+void http_pool_destroy(http_pool_handle_t pool)
+{
+    if (pool == NULL) {
+        return;
+    }
+    if (pool->items) {
+        while (pool->count > 0) {
+            http_pool_remove(pool, pool->count - 1);
+        }
+        free(pool->items);
+    }
+    if (pool->lock) {
+        vSemaphoreDelete(pool->lock);
+    }
+    free(pool);
+}
+
+esp_transport_list_handle_t http_pool_get(http_pool_handle_t pool, const char *key)
+{
+    esp_transport_list_handle_t list = NULL;
+
+    xSemaphoreTake(pool->lock, portMAX_DELAY);
+    http_pool_remove_expired(pool);
+    for (int i = pool->count - 1; i >= 0 && list == NULL; i--) {
+        if (strcasecmp(pool->items[i].key, key) != 0) {
+            continue;
+        }
+        /* An idle connection has nothing to read, unless the server closed it */
+        esp_transport_handle_t t = esp_transport_list_get_transport(pool->items[i].list, NULL);
+        if (esp_transport_poll_read(t, 0) != 0) {
+            ESP_LOGD(TAG, "Idle connection to %s was closed", key);
+            http_pool_remove(pool, i);
+            continue;
+        }
+        list = pool->items[i].list;
+        free(pool->items[i].key);
+        memmove(&pool->items[i], &pool->items[i + 1], (pool->count - i - 1) * sizeof(http_pool_item_t));
+        pool->count--;
+    }
+    xSemaphoreGive(pool->lock);
+    return list;
+}
+
+esp_err_t http_pool_put(http_pool_handle_t pool, const char *key, esp_transport_list_handle_t list)
+{
+    char *item_key = strdup(key);
+    if (item_key == NULL) {
+        ESP_LOGE(TAG, "Memory exhausted");
+        esp_transport_list_destroy(list);
+        return ESP_ERR_NO_MEM;
+    }
+
+    xSemaphoreTake(pool->lock, portMAX_DELAY);
+    http_pool_remove_expired(pool);
+    int same_key = 0, oldest = -1;
+    for (int i = 0; i < pool->count; i++) {
+        if (strcasecmp(pool->items[i].key, key) == 0) {
+            if (oldest < 0) {
+                oldest = i;
+            }
+            same_key++;
+        }
+    }
+    if (same_key >= pool->max_per_key) {
+        http_pool_remove(pool, oldest);
+    } else if (pool->count == pool->max_connections) {
+        http_pool_remove(pool, 0);
+    }
+    pool->items[pool->count].key = item_key;
+    pool->items[pool->count].list = list;
+    pool->items[pool->count].released = xTaskGetTickCount();
+    pool->count++;
+    xSemaphoreGive(pool->lock);
+    return ESP_OK;
+}
+
+void http_pool_purge(http_pool_handle_t pool)
+{
+    xSemaphoreTake(pool->lock, portMAX_DELAY);
+    http_pool_remove_expired(pool);
+    xSemaphoreGive(pool->lock);
+}
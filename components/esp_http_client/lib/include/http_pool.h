@@ -0,0 +1,87 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _HTTP_POOL_H_
+#define _HTTP_POOL_H_
+
+#include "esp_err.h"
+#include "esp_transport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct http_pool *http_pool_handle_t;
+
+/**
+ * @brief      Allocate a pool of idle connections
+ *
+ * @param[in]  max_connections  The maximum number of connections kept, for all keys together
+ * @param[in]  max_per_key      The maximum number of connections kept for one key, 0 for max_connections
+ * @param[in]  idle_timeout_ms  The time after which a connection is closed instead of being reused, 0 for none
+ *
+ * @return
+ *     - http_pool_handle_t
+ *     - NULL if any errors
+ */
+http_pool_handle_t http_pool_init(int max_connections, int max_per_key, int idle_timeout_ms);
+
+/**
+ * @brief      Close the connections of the pool and free it
+ *
+ * @param[in]  pool  The pool
+ */
+void http_pool_destroy(http_pool_handle_t pool);
+
+/**
+ * @brief      Take the most recently released connection for a key out of the pool.
+ *             Connections which timed out, or which the server closed or sent unexpected data on, are
+ *             closed on the way.
+ *
+ * @param[in]  pool  The pool
+ * @param[in]  key   The scheme, host and port of the connection, as "scheme://host:port"
+ *
+ * @return
+ *     - The transport list of the connection, its first transport is the connected one
+ *     - NULL if there is no usable connection for the key
+ */
+esp_transport_list_handle_t http_pool_get(http_pool_handle_t pool, const char *key);
+
+/**
+ * @brief      Give an idle connection to the pool, which then owns it.
+ *             The least recently released connection for the same key, or for any key, is closed
+ *             if the pool is full.
+ *
+ * @param[in]  pool  The pool
+ * @param[in]  key   The scheme, host and port of the connection, as "scheme://host:port"
+ * @param[in]  list  The transport list of the connection, its first transport being the connected one
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_NO_MEM if the connection was closed for lack of memory
+ */
+esp_err_t http_pool_put(http_pool_handle_t pool, const char *key, esp_transport_list_handle_t list);
+
+/**
+ * @brief      Close the connections which have been idle for longer than the timeout
+ *
+ * @param[in]  pool  The pool
+ */
+void http_pool_purge(http_pool_handle_t pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
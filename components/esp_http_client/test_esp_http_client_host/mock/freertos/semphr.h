@@ -0,0 +1,48 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <pthread.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+
+/* Mutexes only, on pthreads */
+typedef pthread_mutex_t *SemaphoreHandle_t;
+
+static inline SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    SemaphoreHandle_t mutex = malloc(sizeof(pthread_mutex_t));
+
+    if (mutex) {
+        pthread_mutex_init(mutex, NULL);
+    }
+    return mutex;
+}
+
+static inline void vSemaphoreDelete(SemaphoreHandle_t mutex)
+{
+    pthread_mutex_destroy(mutex);
+    free(mutex);
+}
+
+static inline bool xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticks)
+{
+    return pthread_mutex_lock(mutex) == 0;
+}
+
+static inline bool xSemaphoreGive(SemaphoreHandle_t mutex)
+{
+    return pthread_mutex_unlock(mutex) == 0;
+}
@@ -0,0 +1,511 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch.hpp"
+#include "esp_http_client.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+// Authentication needs the MD5 of the ROM, it isn't tested on the host
+extern "C" {
+#include "http_auth.h"
+}
+
+extern "C" char *http_auth_digest(const char *username, const char *password, esp_http_auth_data_t *auth_data)
+{
+    return nullptr;
+}
+
+extern "C" char *http_auth_basic(const char *username, const char *password)
+{
+    return nullptr;
+}
+
+/* Keep-alive HTTP server on the loopback interface, answering each request of a
+ * connection in turn, pipelined ones included:
+ * - "/size/<n>" with a body of n bytes
+ * - "/close" with its path, closing the connection after the response
+ * - "/stale" by closing the connection without a response, unless it is the first
+ *   request of the connection, as a server closing an idle connection would
+ * - anything else with its path */
+class TestServer
+{
+public:
+    TestServer()
+    {
+        // the client may close its connections before reading the responses
+        signal(SIGPIPE, SIG_IGN);
+
+        mListener = socket(AF_INET, SOCK_STREAM, 0);
+        REQUIRE(mListener >= 0);
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        REQUIRE(bind(mListener, (struct sockaddr *) &addr, sizeof(addr)) == 0);
+        REQUIRE(listen(mListener, 64) == 0);
+        socklen_t len = sizeof(addr);
+        REQUIRE(getsockname(mListener, (struct sockaddr *) &addr, &len) == 0);
+        port = ntohs(addr.sin_port);
+        mAcceptor = std::thread([this]() {
+            accept_all();
+        });
+    }
+
+    ~TestServer()
+    {
+        shutdown(mListener, SHUT_RDWR);
+        mAcceptor.join();
+        close(mListener);
+        drop_all();
+        for (auto &thread : mConnections) {
+            thread.join();
+        }
+    }
+
+    /* Closes the open connections, as the server would when they have been idle for too long */
+    void drop_all()
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        for (int fd : mOpen) {
+            shutdown(fd, SHUT_RDWR);
+        }
+    }
+
+    std::string url(const std::string &path = "/") const
+    {
+        return "http://127.0.0.1:" + std::to_string(port) + path;
+    }
+
+    uint16_t port;
+    std::atomic<int> connections{0};
+    std::atomic<int> closed{0};
+    std::atomic<int> requests{0};
+
+private:
+    void accept_all()
+    {
+        int fd;
+        while ((fd = accept(mListener, nullptr, nullptr)) >= 0) {
+            connections++;
+            // pipelined responses go out one after the other, as soon as they are ready
+            int nodelay = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+            std::lock_guard<std::mutex> guard(mLock);
+            mOpen.insert(fd);
+            mConnections.emplace_back([this, fd]() {
+                serve(fd);
+                {
+                    std::lock_guard<std::mutex> guard(mLock);
+                    mOpen.erase(fd);
+                }
+                close(fd);
+                closed++;
+            });
+        }
+    }
+
+    void serve(int fd)
+    {
+        std::string received;
+        char buf[4096];
+        int served = 0;
+        while (true) {
+            size_t end;
+            while ((end = received.find("\r\n\r\n")) == std::string::npos) {
+                ssize_t len = recv(fd, buf, sizeof(buf), 0);
+                if (len <= 0) {
+                    return;
+                }
+                received.append(buf, len);
+            }
+            // GET requests, which have no body
+            std::string path = received.substr(received.find(' ') + 1);
+            path = path.substr(0, path.find(' '));
+            received.erase(0, end + 4);
+            requests++;
+
+            if (path == "/stale" && served > 0) {
+                return;
+            }
+            std::string body = path;
+            if (path.compare(0, 6, "/size/") == 0) {
+                body = std::string(atoi(path.c_str() + 6), 'x');
+            }
+            std::string response = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\n";
+            if (path == "/close") {
+                response += "Connection: close\r\n";
+            }
+            response += "\r\n" + body;
+            if (send(fd, response.data(), response.size(), 0) != (ssize_t) response.size() || path == "/close") {
+                return;
+            }
+            served++;
+        }
+    }
+
+    int mListener;
+    std::thread mAcceptor;
+    std::mutex mLock;
+    std::set<int> mOpen;
+    std::vector<std::thread> mConnections;
+};
+
+/* Responses which the event handler of a client got */
+struct Responses {
+    struct Response {
+        std::string url;
+        int status;
+        std::string body;
+    };
+
+    std::string body;               // of the response being received
+    std::vector<Response> finished;
+};
+
+static esp_err_t collect_handler(esp_http_client_event_t *evt)
+{
+    Responses *responses = static_cast<Responses *>(evt->user_data);
+    switch (evt->event_id) {
+    case HTTP_EVENT_ON_DATA:
+        responses->body.append(static_cast<char *>(evt->data), evt->data_len);
+        break;
+    case HTTP_EVENT_ON_FINISH: {
+        char url[256];
+        REQUIRE(esp_http_client_get_url(evt->client, url, sizeof(url)) == ESP_OK);
+        int status = esp_http_client_get_status_code(evt->client);
+        responses->finished.push_back({url, status, responses->body});
+        responses->body.clear();
+        break;
+    }
+    default:
+        break;
+    }
+    return ESP_OK;
+}
+
+/* A client collecting its responses, cleaned up with the object */
+class Client
+{
+public:
+    Client(const std::string &url, esp_http_client_pool_handle_t pool = nullptr)
+    {
+        esp_http_client_config_t config = {};
+        config.url = url.c_str();
+        config.event_handler = collect_handler;
+        config.user_data = &responses;
+        config.pool = pool;
+        handle = esp_http_client_init(&config);
+        REQUIRE(handle != nullptr);
+    }
+
+    ~Client()
+    {
+        esp_http_client_cleanup(handle);
+    }
+
+    /* Body of the response to a GET of the URL, "" if it failed */
+    std::string get()
+    {
+        responses.finished.clear();
+        if (esp_http_client_perform(handle) != ESP_OK || responses.finished.size() != 1 ||
+                responses.finished[0].status != 200) {
+            return "";
+        }
+        return responses.finished[0].body;
+    }
+
+    esp_http_client_handle_t handle;
+    Responses responses;
+};
+
+/* The pool and the clients using it, which must be cleaned up first */
+struct Pool {
+    explicit Pool(esp_http_client_pool_config_t config = ESP_HTTP_CLIENT_POOL_DEFAULT_CONFIG())
+    {
+        handle = esp_http_client_pool_create(&config);
+        REQUIRE(handle != nullptr);
+    }
+
+    ~Pool()
+    {
+        esp_http_client_pool_destroy(handle);
+    }
+
+    esp_http_client_pool_handle_t handle;
+};
+
+/* The server side of a connection is closed asynchronously */
+static bool eventually(const std::atomic<int> &value, int expected)
+{
+    for (int i = 0; i < 1000 && value != expected; i++) {
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    return value == expected;
+}
+
+TEST_CASE("clients share keep-alive connections through a pool", "[esp_http_client][pool]")
+{
+    TestServer server;
+    for (int i = 0; i < 5; i++) {
+        Client client(server.url("/a"));
+        CHECK(client.get() == "/a");
+    }
+    CHECK(server.connections == 5);
+
+    {
+        Pool pool;
+        for (int i = 0; i < 5; i++) {
+            Client client(server.url(i % 2 ? "/b" : "/c?q=1"), pool.handle);
+            CHECK(client.get() == (i % 2 ? "/b" : "/c?q=1"));
+            CHECK(client.get() == (i % 2 ? "/b" : "/c?q=1"));
+        }
+        CHECK(server.connections == 6);
+
+        // clients connected at the same time have a connection each, two of them are kept
+        std::vector<std::unique_ptr<Client>> clients;
+        for (int i = 0; i < 3; i++) {
+            clients.emplace_back(new Client(server.url("/d"), pool.handle));
+            CHECK(clients.back()->get() == "/d");
+        }
+        CHECK(server.connections == 8);
+        clients.clear();
+        CHECK(eventually(server.closed, 6));
+        for (int i = 0; i < 3; i++) {
+            clients.emplace_back(new Client(server.url("/e"), pool.handle));
+            CHECK(clients.back()->get() == "/e");
+        }
+        CHECK(server.connections == 9);
+        clients.clear();
+    }
+    // the pool closes its connections
+    CHECK(eventually(server.closed, 9));
+}
+
+TEST_CASE("pool connections are kept per scheme, host and port", "[esp_http_client][pool]")
+{
+    TestServer a, b;
+    esp_http_client_pool_config_t config = ESP_HTTP_CLIENT_POOL_DEFAULT_CONFIG();
+    config.max_connections = 2;
+    config.max_per_host = 2;
+    Pool pool(config);
+
+    {
+        Client a1(a.url("/a1"), pool.handle), a2(a.url("/a2"), pool.handle);
+        CHECK(a1.get() == "/a1");
+        CHECK(a2.get() == "/a2");
+    }
+    {
+        // gives its connection back when it changes host, which evicts the oldest one of a
+        Client client(b.url("/b"), pool.handle);
+        CHECK(client.get() == "/b");
+        REQUIRE(esp_http_client_set_url(client.handle, a.url("/a3").c_str()) == ESP_OK);
+        CHECK(client.get() == "/a3");
+    }
+    CHECK(a.connections == 2);
+    CHECK(b.connections == 1);
+    CHECK(eventually(a.closed, 1));
+    CHECK(b.closed == 0);
+
+    {
+        Client client(b.url("/b"), pool.handle);
+        CHECK(client.get() == "/b");
+    }
+    CHECK(b.connections == 1);
+}
+
+TEST_CASE("idle pool connections time out", "[esp_http_client][pool]")
+{
+    TestServer server;
+    esp_http_client_pool_config_t config = ESP_HTTP_CLIENT_POOL_DEFAULT_CONFIG();
+    config.idle_timeout_ms = 50;
+    Pool pool(config);
+
+    for (int i = 0; i < 2; i++) {
+        Client client(server.url(), pool.handle);
+        CHECK(client.get() == "/");
+    }
+    CHECK(server.connections == 1);
+    std::this_thread::sleep_for(milliseconds(100));
+    {
+        Client client(server.url(), pool.handle);
+        CHECK(client.get() == "/");
+    }
+    CHECK(server.connections == 2);
+    CHECK(eventually(server.closed, 1));
+
+    std::this_thread::sleep_for(milliseconds(100));
+    CHECK(esp_http_client_pool_purge(pool.handle) == ESP_OK);
+    CHECK(eventually(server.closed, 2));
+}
+
+TEST_CASE("pool connections closed by the server are not reused", "[esp_http_client][pool]")
+{
+    TestServer server;
+    Pool pool;
+
+    {
+        Client client(server.url(), pool.handle);
+        CHECK(client.get() == "/");
+    }
+    server.drop_all();
+    REQUIRE(eventually(server.closed, 1));
+    {
+        Client client(server.url("/after-drop"), pool.handle);
+        CHECK(client.get() == "/after-drop");
+    }
+    CHECK(server.connections == 2);
+
+    // closed as the request comes, the request is sent again on a new connection
+    {
+        Client client(server.url("/stale"), pool.handle);
+        CHECK(client.get() == "/stale");
+    }
+    CHECK(server.connections == 3);
+
+    // a connection which the server closes isn't given to the pool
+    {
+        Client client(server.url("/close"), pool.handle);
+        CHECK(client.get() == "/close");
+    }
+    {
+        Client client(server.url(), pool.handle);
+        CHECK(client.get() == "/");
+    }
+    CHECK(server.connections == 4);
+}
+
+TEST_CASE("pipelined requests are answered in order", "[esp_http_client][pipelining]")
+{
+    TestServer server;
+    Client client(server.url());
+    std::vector<std::string> paths;
+    for (int i = 0; i < 20; i++) {
+        paths.push_back(i % 3 ? "/p" + std::to_string(i) + "?q=" + std::to_string(i) : "/size/" + std::to_string(i * 100));
+    }
+    std::vector<const char *> c_paths;
+    for (auto &path : paths) {
+        c_paths.push_back(path.c_str());
+    }
+
+    REQUIRE(esp_http_client_perform_pipelined(client.handle, c_paths.data(), c_paths.size()) == ESP_OK);
+    REQUIRE(client.responses.finished.size() == paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+        // without the port, which esp_http_client_get_url() leaves out
+        CHECK(client.responses.finished[i].url == "http://127.0.0.1" + paths[i]);
+        CHECK(client.responses.finished[i].status == 200);
+        CHECK(client.responses.finished[i].body == (i % 3 ? paths[i] : std::string(i * 100, 'x')));
+    }
+    CHECK(server.connections == 1);
+    CHECK(server.requests == 20);
+
+    // the connection is kept for the next requests
+    CHECK(client.get() == paths.back());
+    REQUIRE(esp_http_client_perform_pipelined(client.handle, c_paths.data(), 2) == ESP_OK);
+    CHECK(server.connections == 1);
+
+    // responses after the server closes the connection are missing
+    client.responses.finished.clear();
+    const char *closing[] = {"/1", "/close", "/3"};
+    CHECK(esp_http_client_perform_pipelined(client.handle, closing, 3) == ESP_ERR_HTTP_FETCH_HEADER);
+    CHECK(client.responses.finished.size() == 2);
+    CHECK(client.get() == "/close");
+    CHECK(server.connections == 2);
+
+    CHECK(esp_http_client_perform_pipelined(client.handle, closing, 0) == ESP_ERR_INVALID_ARG);
+}
+
+TEST_CASE("pipelined requests use the connections of the pool", "[esp_http_client][pipelining]")
+{
+    TestServer server;
+    Pool pool;
+    const char *paths[] = {"/1", "/2", "/3"};
+
+    for (int i = 0; i < 3; i++) {
+        Client client(server.url(), pool.handle);
+        REQUIRE(esp_http_client_perform_pipelined(client.handle, paths, 3) == ESP_OK);
+        CHECK(client.responses.finished.size() == 3);
+    }
+    CHECK(server.connections == 1);
+
+    // the requests are sent again on a new connection
+    server.drop_all();
+    REQUIRE(eventually(server.closed, 1));
+    Client client(server.url(), pool.handle);
+    REQUIRE(esp_http_client_perform_pipelined(client.handle, paths, 3) == ESP_OK);
+    CHECK(client.responses.finished.size() == 3);
+    CHECK(server.connections == 2);
+}
+
+TEST_CASE("dump esp_http_client connection reuse performance", "[esp_http_client][benchmark]")
+{
+    const int count = 2000;
+    const int depth = 10;
+    TestServer server;
+    std::string url = server.url("/size/100");
+    std::vector<const char *> paths(depth, "/size/100");
+
+    auto run = [&](const char *name, std::function<void()> requests) {
+        int before = server.connections;
+        auto start = steady_clock::now();
+        requests();
+        double elapsed = duration_cast<duration<double>>(steady_clock::now() - start).count();
+        printf("%-40s %8.0f requests/s, %4d connections\n", name, count / elapsed, server.connections - before);
+    };
+
+    run("new client per request", [&]() {
+        for (int i = 0; i < count; i++) {
+            Client client(url);
+            REQUIRE(client.get().size() == 100);
+        }
+    });
+    Pool pool;
+    run("new client per request, with a pool", [&]() {
+        for (int i = 0; i < count; i++) {
+            Client client(url, pool.handle);
+            REQUIRE(client.get().size() == 100);
+        }
+    });
+    run("one client", [&]() {
+        Client client(url);
+        for (int i = 0; i < count; i++) {
+            REQUIRE(client.get().size() == 100);
+        }
+    });
+    run("one client, pipelining 10 requests", [&]() {
+        Client client(url);
+        for (int i = 0; i < count / depth; i++) {
+            client.responses.finished.clear();
+            REQUIRE(esp_http_client_perform_pipelined(client.handle, paths.data(), depth) == ESP_OK);
+            REQUIRE(client.responses.finished.size() == depth);
+        }
+    });
+}
@@ -43,6 +43,8 @@ initializer that should be kept in sync
         .lru_purge_enable   = false,                    \
         .recv_wait_timeout  = 5,                        \
         .send_wait_timeout  = 5,                        \
+        .worker_count       = 0,                        \
+        .worker_stack_size  = 4096,                     \
         .global_user_ctx = NULL,                        \
         .global_user_ctx_free_fn = NULL,                \
         .global_transport_ctx = NULL,                   \
@@ -139,6 +141,21 @@ typedef struct httpd_config {
     uint16_t    recv_wait_timeout;  /*!< Timeout for recv function (in seconds)*/
     uint16_t    send_wait_timeout;  /*!< Timeout for send function (in seconds)*/
 
+    /**
+     * Number of worker tasks which receive requests and run the URI handlers.
+     *
+     * With 0, requests are processed in the server task, one at a time. Otherwise
+     * the server task keeps accepting connections and watching the sessions while
+     * a slow handler runs, and hands the sessions with incoming data over to idle
+     * workers. The requests of one session are always processed in order by a
+     * single worker at a time, but handlers of different sessions may run
+     * concurrently, so any state they share has to be protected.
+     *
+     * Worker tasks run at task_priority.
+     */
+    uint16_t    worker_count;
+    size_t      worker_stack_size;  /*!< The maximum stack size allowed for each worker task */
+
     /**
      * Global user context.
      *
@@ -330,7 +347,18 @@ typedef struct httpd_req {
  * @brief Structure for URI handler
  */
 typedef struct httpd_uri {
-    const char       *uri;    /*!< The URI to handle */
+    /**
+     * The URI to handle. Besides exact paths, this may be a pattern in which
+     *  - a {name} segment, e.g. "/dev/{id}/state", matches one non-empty
+     *    path segment, which is retrieved with httpd_req_get_path_param()
+     *  - a trailing '*', e.g. "/api/\*", matches the rest of the path, which
+     *    is retrieved with httpd_req_get_path_param() under the name "*"
+     *
+     * Exact parts take precedence over captures, and captures over the
+     * wildcard. Up to 4 captures are allowed in a pattern, the wildcard
+     * included.
+     */
+    const char       *uri;
     httpd_method_t    method; /*!< Method supported by the URI */
 
     /**
@@ -343,13 +371,34 @@ typedef struct httpd_uri {
      * Pointer to user context data which will be available to handler
      */
     void *user_ctx;
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    /**
+     * Flag for indicating a WebSocket endpoint, whose method must be HTTP_GET.
+     *
+     * The server responds to the upgrade request itself and then calls the
+     * handler with it, req->method being HTTP_GET only in this call. After
+     * that the handler is called for every frame received by the session,
+     * which it fetches with httpd_ws_recv_frame().
+     */
+    bool is_websocket;
+
+    /**
+     * Flag indicating that control frames (PING, PONG, CLOSE) are also passed
+     * to the handler, which is then responsible for answering them. Otherwise
+     * the server answers PING frames with PONG frames and echoes CLOSE frames
+     * itself. The session is closed after a CLOSE frame in either case.
+     */
+    bool handle_ws_control_frames;
+#endif
 } httpd_uri_t;
 
 /**
  * @brief   Registers a URI handler
  *
  * @note    URI handlers can be registered in real time as long as the
- *          server handle is valid.
+ *          server handle is valid, also while the server task or its
+ *          workers are processing requests.
  *
  * Example usage:
  * @code{c}
@@ -392,7 +441,8 @@ typedef struct httpd_uri {
  *
  * @return
  *  - ESP_OK : On successfully registering the handler
- *  - ESP_ERR_INVALID_ARG : Null arguments
+ *  - ESP_ERR_INVALID_ARG : Null arguments or malformed URI pattern
+ *  - ESP_ERR_HTTPD_ALLOC_MEM      : Failed to allocate memory for the handler
  *  - ESP_ERR_HTTPD_HANDLERS_FULL  : If no slots left for new handler
  *  - ESP_ERR_HTTPD_HANDLER_EXISTS : If handler with same URI and
  *                                   method is already registered
@@ -403,6 +453,10 @@ esp_err_t httpd_register_uri_handler(httpd_handle_t handle,
 /**
  * @brief   Unregister a URI handler
  *
+ * @note    Requests routed to the handler before it was unregistered, by
+ *          workers or by the handler itself, still complete with it, its
+ *          copy being freed once they are done.
+ *
  * @param[in] handle    handle to HTTPD server instance
  * @param[in] uri       URI string
  * @param[in] method    HTTP method
@@ -411,6 +465,7 @@ esp_err_t httpd_register_uri_handler(httpd_handle_t handle,
  *  - ESP_OK : On successfully deregistering the handler
  *  - ESP_ERR_INVALID_ARG : Null arguments
  *  - ESP_ERR_NOT_FOUND   : Handler with specified URI and method not found
+ *  - ESP_ERR_HTTPD_ALLOC_MEM : Failed to allocate memory for recompiling the router
  */
 esp_err_t httpd_unregister_uri_handler(httpd_handle_t handle,
                                        const char *uri, httpd_method_t method);
@@ -426,6 +481,7 @@ esp_err_t httpd_unregister_uri_handler(httpd_handle_t handle,
  *  - ESP_OK : On successfully deregistering all such handlers
  *  - ESP_ERR_INVALID_ARG : Null arguments
  *  - ESP_ERR_NOT_FOUND   : No handler registered with specified uri string
+ *  - ESP_ERR_HTTPD_ALLOC_MEM : Failed to allocate memory for recompiling the router
  */
 esp_err_t httpd_unregister_uri(httpd_handle_t handle, const char* uri);
 
@@ -744,6 +800,33 @@ esp_err_t httpd_req_get_url_query_str(httpd_req_t *r, char *buf, size_t buf_len)
  */
 esp_err_t httpd_query_key_value(const char *qry, const char *key, char *val, size_t val_size);
 
+/**
+ * @brief   Get the value of a path parameter captured by the URI pattern
+ *          of the handler, e.g. "id" for "/dev/{id}/state"
+ *
+ * @note
+ *  - This API is supposed to be called only from the context of
+ *    a URI handler where httpd_req_t* request pointer is valid.
+ *  - The value of the trailing wildcard of a pattern is retrieved
+ *    with the name "*".
+ *  - Values are not URLdecoded.
+ *  - If actual value size is greater than val_size, then the value is truncated,
+ *    accompanied by truncation error as return value.
+ *
+ * @param[in]  r         The request being responded to
+ * @param[in]  name      Name of the capture in the URI pattern
+ * @param[out] val       Pointer to the buffer into which the value will be copied if found
+ * @param[in]  val_size  Size of the user buffer "val"
+ *
+ * @return
+ *  - ESP_OK : Parameter is found and copied to buffer
+ *  - ESP_ERR_NOT_FOUND          : No such capture in the URI pattern
+ *  - ESP_ERR_INVALID_ARG        : Null arguments or zero sized buffer
+ *  - ESP_ERR_HTTPD_INVALID_REQ  : Invalid HTTP request pointer
+ *  - ESP_ERR_HTTPD_RESULT_TRUNC : Value string truncated
+ */
+esp_err_t httpd_req_get_path_param(httpd_req_t *r, const char *name, char *val, size_t val_size);
+
 /**
  * @brief   API to send a complete HTTP response.
  *
@@ -783,6 +866,50 @@ esp_err_t httpd_query_key_value(const char *qry, const char *key, char *val, siz
  */
 esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len);
 
+/**
+ * @brief   Buffer of a response sent with httpd_resp_sendv()
+ */
+typedef struct httpd_iov {
+    const char *buf;    /*!< Pointer to the data */
+    size_t      len;    /*!< Length of the data */
+} httpd_iov_t;
+
+/**
+ * @brief   API to send a complete HTTP response gathered from several buffers.
+ *
+ * This API works like httpd_resp_send(), except that the content of the
+ * response is the concatenation of the buffers in the vector, so that
+ * a handler doesn't need to copy e.g. a template and its variable parts
+ * into a single buffer. The Content-Length is the sum of their lengths.
+ *
+ * The headers and the buffers which fit into the internal scratch buffer
+ * are sent with a single write. The rest is passed along with them to
+ * one sendmsg() call, unless the send function of the session has been
+ * overridden with httpd_sess_set_send_override(), which then gets called
+ * with each of them in turn.
+ *
+ * @note
+ *  - This API is supposed to be called only from the context of
+ *    a URI handler where httpd_req_t* request pointer is valid.
+ *  - Once this API is called, the request has been responded to.
+ *  - No additional data can then be sent for the request.
+ *  - Once this API is called, all request headers are purged, so
+ *    request headers need be copied into separate buffers if
+ *    they are required later.
+ *
+ * @param[in] r         The request being responded to
+ * @param[in] iov       Buffers from where the content is to be fetched
+ * @param[in] iovcnt    Number of buffers in the vector
+ *
+ * @return
+ *  - ESP_OK : On successfully sending the response packet
+ *  - ESP_ERR_INVALID_ARG : Null request pointer or buffer with content
+ *  - ESP_ERR_HTTPD_RESP_HDR    : Essential headers are too large for internal buffer
+ *  - ESP_ERR_HTTPD_RESP_SEND   : Error in raw send
+ *  - ESP_ERR_HTTPD_INVALID_REQ : Invalid request
+ */
+esp_err_t httpd_resp_sendv(httpd_req_t *r, const httpd_iov_t *iov, size_t iovcnt);
+
 /**
  * @brief   API to send one HTTP chunk
  *
@@ -1181,6 +1308,221 @@ esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void *ar
  * @}
  */
 
+/* ************** Group: Static Files ************** */
+/** @name Static Files
+ * APIs for serving the files of a directory
+ * @{
+ */
+
+/**
+ * @brief   Granularity of the reads from served files
+ *
+ * Reading whole pages of the underlying flash file system (e.g. the
+ * logical pages of SPIFFS) saves it from copying partial ones.
+ */
+#define HTTPD_STATIC_READ_ALIGN 256
+
+/**
+ * @brief   Configuration of a directory of static files
+ *
+ * A request for \<uri_prefix\>/\<path\> is answered with the file
+ * \<base_path\>/\<path\>, or with \<base_path\>/\<path\>.gz if that
+ * exists and the client accepts gzip content encoding. Clients can
+ * validate their cached copies with the content hash sent as ETag.
+ */
+typedef struct httpd_static_config {
+    const char *uri_prefix;         /*!< URI prefix the files are served under, e.g. "/static", or "/" for all URIs */
+    const char *base_path;          /*!< VFS path of the directory the files are in, e.g. "/spiffs/www" */
+    const char *index_file;         /*!< File served for URIs ending with '/', NULL for none */
+    const char *cache_control;      /*!< Value of the Cache-Control header of the responses, NULL for none */
+    size_t      read_size;          /*!< Size of the buffer for reading the files, rounded down to a multiple of HTTPD_STATIC_READ_ALIGN */
+    uint16_t    etag_cache_size;    /*!< Number of files whose ETag is remembered, 0 for not sending ETags.
+                                         ETags are computed from the content of a file when it is first served
+                                         and kept as long as its size and modification time remain the same */
+} httpd_static_config_t;
+
+/**
+ * @brief Directory of static files configuration to be used by default
+ *
+ * @note    The base_path is to be set by the caller
+ */
+#define HTTPD_STATIC_DEFAULT_CONFIG() {                 \
+        .uri_prefix         = "/",                      \
+        .base_path          = NULL,                     \
+        .index_file         = "index.html",             \
+        .cache_control      = NULL,                     \
+        .read_size          = 4096,                     \
+        .etag_cache_size    = 16,                       \
+}
+
+/**
+ * @brief   Serve the files of a directory
+ *
+ * This registers a GET handler for all the URIs under the prefix, which
+ * takes up a URI handler slot like httpd_register_uri_handler().
+ *
+ * @note    The files are streamed in reads of read_size bytes, from a buffer
+ *          allocated for each request. URIs are percent-decoded and those
+ *          with ".." segments are refused.
+ *
+ * @param[in] handle    handle to HTTPD server instance
+ * @param[in] config    configuration of the directory, which is copied
+ *
+ * @return
+ *  - ESP_OK : On successfully registering the directory
+ *  - ESP_ERR_INVALID_ARG : Null arguments or read_size smaller than HTTPD_STATIC_READ_ALIGN
+ *  - ESP_ERR_HTTPD_ALLOC_MEM : Failed to allocate memory
+ *  - Errors of httpd_register_uri_handler()
+ */
+esp_err_t httpd_register_static(httpd_handle_t handle, const httpd_static_config_t *config);
+
+/**
+ * @brief   Stop serving the files registered under a prefix
+ *
+ * @param[in] handle        handle to HTTPD server instance
+ * @param[in] uri_prefix    URI prefix passed to httpd_register_static()
+ *
+ * @return
+ *  - ESP_OK : On successfully unregistering the directory
+ *  - ESP_ERR_INVALID_ARG : Null arguments
+ *  - ESP_ERR_NOT_FOUND   : No directory registered under this prefix
+ */
+esp_err_t httpd_unregister_static(httpd_handle_t handle, const char *uri_prefix);
+
+/** End of Group Static Files
+ * @}
+ */
+
+/* ************** Group: WebSocket ************** */
+/** @name WebSocket
+ * Functions and structs for WebSocket server
+ * @{
+ */
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+
+/**
+ * @brief Enum for WebSocket packet types (Opcode in the header)
+ * @note Please refer to RFC6455 Section 5.4 for more details
+ */
+typedef enum {
+    HTTPD_WS_TYPE_CONTINUE   = 0x0,
+    HTTPD_WS_TYPE_TEXT       = 0x1,
+    HTTPD_WS_TYPE_BINARY     = 0x2,
+    HTTPD_WS_TYPE_CLOSE      = 0x8,
+    HTTPD_WS_TYPE_PING       = 0x9,
+    HTTPD_WS_TYPE_PONG       = 0xA
+} httpd_ws_type_t;
+
+/**
+ * @brief WebSocket frame format
+ */
+typedef struct httpd_ws_frame {
+    bool final;                 /*!< Final frame of a message: for received frames, and for sent ones which are fragmented */
+    bool fragmented;            /*!< Frame is part of a fragmented message: when sending, "final" and "type" are then taken as they are */
+    httpd_ws_type_t type;       /*!< WebSocket frame type, HTTPD_WS_TYPE_CONTINUE for the fragments after the first one */
+    uint8_t *payload;           /*!< Pre-allocated data buffer */
+    size_t len;                 /*!< Length of the WebSocket data */
+} httpd_ws_frame_t;
+
+/**
+ * @brief Kind of a session, see httpd_ws_get_fd_info()
+ */
+typedef enum {
+    HTTPD_WS_CLIENT_INVALID     = 0x0,  /*!< No session with this descriptor */
+    HTTPD_WS_CLIENT_HTTP        = 0x1,  /*!< HTTP session */
+    HTTPD_WS_CLIENT_WEBSOCKET   = 0x2,  /*!< Session upgraded to WebSocket */
+} httpd_ws_client_info_t;
+
+/**
+ * @brief Receive and parse a WebSocket frame
+ *
+ * The header of the frame has been received by the server before calling
+ * the handler, so this fetches its payload, unmasked.
+ *
+ * @note
+ *  - This API is supposed to be called only from the context of
+ *    a WebSocket URI handler called for a frame.
+ *  - Call this with max_len 0 to get the type and the payload length
+ *    of the frame first, without receiving anything.
+ *  - A payload longer than max_len can be received with several calls,
+ *    each one setting frame->len to the length received. What is left
+ *    unreceived when the handler returns is discarded.
+ *
+ * @param[in]     req       Current request
+ * @param[in,out] frame     WebSocket frame, with the buffer for the payload
+ * @param[in]     max_len   Maximum length of the payload to receive into the buffer
+ *
+ * @return
+ *  - ESP_OK                    : On successful
+ *  - ESP_ERR_INVALID_ARG       : Null arguments
+ *  - ESP_ERR_INVALID_STATE     : Not called for a frame of a WebSocket session
+ *  - ESP_ERR_HTTPD_INVALID_REQ : Invalid request
+ *  - ESP_FAIL                  : Socket errors
+ */
+esp_err_t httpd_ws_recv_frame(httpd_req_t *req, httpd_ws_frame_t *frame, size_t max_len);
+
+/**
+ * @brief Construct and send a WebSocket frame
+ *
+ * @note    This API is supposed to be called only from the context of
+ *          a WebSocket URI handler.
+ *
+ * @param[in] req    Current request
+ * @param[in] frame  WebSocket frame
+ *
+ * @return
+ *  - ESP_OK                    : On successful
+ *  - ESP_ERR_INVALID_ARG       : Null arguments, or control frame too long or fragmented
+ *  - ESP_ERR_INVALID_STATE     : Session isn't a WebSocket one
+ *  - ESP_ERR_HTTPD_INVALID_REQ : Invalid request
+ *  - ESP_FAIL                  : Socket errors
+ */
+esp_err_t httpd_ws_send_frame(httpd_req_t *req, httpd_ws_frame_t *frame);
+
+/**
+ * @brief Send a WebSocket frame to a session outside of its URI handler
+ *
+ * @note    This API is supposed to be called in the HTTPD's context, i.e.
+ *          from a function queued by another task with httpd_queue_work(),
+ *          which needs to copy the payload it sends as the calling task
+ *          doesn't wait for it. A session which is being processed by a
+ *          worker task can only be sent to by its URI handler, as the
+ *          frames of other tasks could get mixed up with those of the
+ *          handler.
+ *
+ * @param[in] hd     Server instance data
+ * @param[in] fd     Socket descriptor of the session
+ * @param[in] frame  WebSocket frame
+ *
+ * @return
+ *  - ESP_OK                : On successful
+ *  - ESP_ERR_INVALID_ARG   : Null arguments, no such session, or
+ *                            control frame too long or fragmented
+ *  - ESP_ERR_INVALID_STATE : Session isn't a WebSocket one, or is being
+ *                            processed by another task
+ *  - ESP_FAIL              : Socket errors
+ */
+esp_err_t httpd_ws_send_frame_async(httpd_handle_t hd, int fd, httpd_ws_frame_t *frame);
+
+/**
+ * @brief Checks the supplied socket descriptor if it belongs to any active client
+ * of this server instance and if the websoket protocol is active
+ *
+ * @param[in] hd      Server instance data
+ * @param[in] fd      Socket descriptor
+ *
+ * @return
+ *  - HTTPD_WS_CLIENT_INVALID   : This fd is not a client of this httpd
+ *  - HTTPD_WS_CLIENT_HTTP      : This fd is an active client, protocol is not WS
+ *  - HTTPD_WS_CLIENT_WEBSOCKET : This fd is an active client, protocol is WS
+ */
+httpd_ws_client_info_t httpd_ws_get_fd_info(httpd_handle_t hd, int fd);
+
+#endif /* CONFIG_HTTPD_WS_SUPPORT */
+/** End of WebSocket related stuff
+ * @}
+ */
+
 #ifdef __cplusplus
 }
 #endif
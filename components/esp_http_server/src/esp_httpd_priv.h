@@ -38,6 +38,13 @@ extern "C" {
 /* Calculate the maximum size needed for the scratch buffer */
 #define HTTPD_SCRATCH_BUF  MAX(HTTPD_MAX_REQ_HDR_LEN, HTTPD_MAX_URI_LEN)
 
+/* Maximum number of {captures} in a URI pattern, the trailing wildcard included */
+#define HTTPD_MAX_PATH_PARAMS  4
+
+/* Number of request contexts of a server: one per worker task, or a single one
+ * used by the server task itself if it runs the URI handlers */
+#define HTTPD_REQ_CTX_CNT(config)  MAX(1, (config)->worker_count)
+
 /* Formats a log string to prepend context function name */
 #define LOG_FMT(x)      "%s: " x, __func__
 
@@ -125,9 +132,20 @@ struct sock_db {
     httpd_send_func_t send_fn;              /*!< Send function for this socket */
     httpd_recv_func_t recv_fn;              /*!< Receive function for this socket */
     httpd_pending_func_t pending_fn;        /*!< Pending function for this socket */
-    uint64_t lru_counter;                   /*!< LRU Counter indicating when the socket was last used */
+    struct sock_db *lru_prev;               /*!< Session used less recently, NULL for the least recently used one */
+    struct sock_db *lru_next;               /*!< Session used more recently, or next free entry of the database */
+    bool lru_touched;                       /*!< Marked as used by httpd_sess_update_lru_counter() since it last moved in the LRU list */
     char pending_data[PARSER_BLOCK_SIZE];   /*!< Buffer for pending data to be received */
     size_t pending_len;                     /*!< Length of pending data to be received */
+    struct httpd_worker *worker;            /*!< Worker processing a request of this session, NULL if idle */
+    bool close_pending;                     /*!< Closure was requested while a worker was processing the session */
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    bool ws_handshake_done;                 /*!< True if it has done WebSocket handshake (if this socket is a valid WS) */
+    bool ws_control_frames;                 /*!< WebSocket flag indicating that control frames should be passed to user handlers */
+    bool ws_fragmented;                     /*!< A fragmented WebSocket message is being received */
+    esp_err_t (*ws_handler)(httpd_req_t *r);/*!< WebSocket handler, kept here once the session has been upgraded */
+    void *ws_user_ctx;                      /*!< Pointer to user context data which will be available to the WebSocket handler */
+#endif
 };
 
 /**
@@ -148,6 +166,35 @@ struct httpd_req_aux {
         const char *value;
     } *resp_hdrs;                                   /*!< Additional headers in response packet */
     struct http_parser_url url_parse_res;           /*!< URL parsing result, used for retrieving URL elements */
+    const char     *uri_pattern;                    /*!< URI pattern of the handler the request was routed to */
+    unsigned        path_params_count;              /*!< Count of path parameters captured while routing */
+    struct path_param {
+        const char *value;
+        size_t      len;
+    } path_params[HTTPD_MAX_PATH_PARAMS];           /*!< Captured path parameters, pointing into the URI */
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    bool            ws_handshake_detect;            /*!< WebSocket handshake detection flag */
+    bool            ws_frame;                       /*!< Request is a WebSocket frame, whose header has been received */
+    httpd_ws_type_t ws_type;                        /*!< WebSocket frame type */
+    bool            ws_final;                       /*!< WebSocket FIN bit (final frame or not) */
+    uint8_t         ws_mask_key[4];                 /*!< WebSocket masking key for this payload */
+    size_t          ws_offset;                      /*!< Amount of the payload unmasked already */
+#endif
+};
+
+/**
+ * @brief   Context in which a session's request is received and its URI handler
+ *          is run, either by a worker task or by the server task itself
+ */
+struct httpd_worker {
+    struct httpd_data *hd;                  /*!< Server instance data */
+    struct thread_data td;                  /*!< Information for the worker thread */
+    osem_t start;                           /*!< Given by the server thread when a session is handed over */
+    struct sock_db *sd;                     /*!< Session being processed, NULL if the worker is idle */
+    esp_err_t result;                       /*!< Result of processing the session */
+    bool done;                              /*!< Set by the worker once it has finished with the session */
+    struct httpd_req req;                   /*!< The current HTTPD request */
+    struct httpd_req_aux req_aux;           /*!< Additional data about the HTTPD request kept unexposed */
 };
 
 /**
@@ -161,9 +208,15 @@ struct httpd_data {
     int msg_fd;                             /*!< Ctrl message sender FD */
     struct thread_data hd_td;               /*!< Information for the HTTPd thread */
     struct sock_db *hd_sd;                  /*!< The socket database */
+    struct sock_db **hd_sd_map;             /*!< Open sessions by descriptor, an open addressing table of httpd_sess_map_size() entries */
+    struct sock_db *hd_sd_free;             /*!< Free entries of the socket database */
+    struct sock_db *hd_lru_head;            /*!< Least recently used open session */
+    struct sock_db *hd_lru_tail;            /*!< Most recently used open session */
     httpd_uri_t **hd_calls;                 /*!< Registered URI handlers */
-    struct httpd_req hd_req;                /*!< The current HTTPD request */
-    struct httpd_req_aux hd_req_aux;        /*!< Additional data about the HTTPD request kept unexposed */
+    struct httpd_uri_router *hd_router;     /*!< Router compiled from the URI handlers */
+    osem_t hd_router_lock;                  /*!< Guards replacing the router and its references */
+    struct httpd_worker *hd_workers;        /*!< Request contexts, HTTPD_REQ_CTX_CNT() of them */
+    struct httpd_static *hd_static;         /*!< Static file directories, see httpd_register_static() */
 };
 
 /******************* Group : Session Management ********************/
@@ -172,6 +225,25 @@ struct httpd_data {
  * @{
  */
 
+/**
+ * @brief Size of the table of open sessions by descriptor
+ *
+ * A power of 2 with at least twice as many entries as sessions, so that
+ * the descriptors, which the network stack hands out in sequence, mostly
+ * get an entry of their own.
+ *
+ * @param[in] max_open_sockets  Number of sessions
+ * @return number of entries of the table
+ */
+static inline unsigned httpd_sess_map_size(uint16_t max_open_sockets)
+{
+    unsigned size = 4;
+    while (size < 2 * (unsigned) max_open_sockets) {
+        size <<= 1;
+    }
+    return size;
+}
+
 /**
  * @brief Retrieve a session by its descriptor
  *
@@ -212,14 +284,17 @@ esp_err_t httpd_sess_new(struct httpd_data *hd, int newfd);
 /**
  * @brief   Processes incoming HTTP requests
  *
+ * The request is received in the context of the worker the session
+ * has been handed over to (sd->worker).
+ *
  * @param[in] hd    Server instance data
- * @param[in] clifd Descriptor of the client from which data is to be received
+ * @param[in] sd    Session from which data is to be received
  *
  * @return
  *  - ESP_OK    : on successfully receiving, parsing and responding to a request
  *  - ESP_FAIL  : in case of failure in any of the stages of processing
  */
-esp_err_t httpd_sess_process(struct httpd_data *hd, int clifd);
+esp_err_t httpd_sess_process(struct httpd_data *hd, struct sock_db *sd);
 
 /**
  * @brief   Remove client descriptor from the session / socket database
@@ -252,6 +327,7 @@ void httpd_sess_free_ctx(void *ctx, httpd_free_ctx_fn_t free_fn);
  * @brief   Add descriptors present in the socket database to an fd_set and
  *          update the value of maxfd which are needed by the select function
  *          for looking through all available sockets for incoming data.
+ *          Sessions being processed by a worker are left out.
  *
  * @param[in]  hd    Server instance data
  * @param[out] fdset File descriptor set to be updated.
@@ -263,6 +339,7 @@ void httpd_sess_set_descriptors(struct httpd_data *hd, fd_set *fdset, int *maxfd
  * @brief   Iterates through the list of client fds in the session /socket database.
  *          Passing the value of a client fd returns the fd for the next client
  *          in the database. In order to iterate from the beginning pass -1 as fd.
+ *          Clients come from the least to the most recently used one.
  *
  * @param[in] hd    Server instance data
  * @param[in] fd    Last accessed client descriptor.
@@ -305,17 +382,30 @@ bool httpd_is_sess_available(struct httpd_data *hd);
  */
 bool httpd_sess_pending(struct httpd_data *hd, int fd);
 
+/**
+ * @brief   Marks a session as the most recently used one
+ *
+ * @note    Only to be called in the server context, other tasks call
+ *          httpd_sess_update_lru_counter() instead.
+ *
+ * @param[in] hd  Server instance data
+ * @param[in] sd  Session used
+ */
+void httpd_sess_lru_touch(struct httpd_data *hd, struct sock_db *sd);
+
 /**
  * @brief   Removes the least recently used client from the session
  *
  * This may be useful if new clients are requesting for connection but
  * max number of connections is reached, in which case the client which
  * is inactive for the longest will be removed from the session.
+ * Sessions being processed by a worker are not considered.
  *
  * @param[in] hd  Server instance data
  *
  * @return
  *  - ESP_OK    : if session closure initiated successfully
+ *  - ESP_ERR_NOT_FOUND : if all sessions are being processed by workers
  *  - ESP_FAIL  : if failed
  */
 esp_err_t httpd_sess_close_lru(struct httpd_data *hd);
@@ -331,16 +421,17 @@ esp_err_t httpd_sess_close_lru(struct httpd_data *hd);
  */
 
 /**
- * @brief   For an HTTP request, searches through all the registered URI handlers
- *          and invokes the appropriate one if found
+ * @brief   For an HTTP request, looks up the registered URI handler for its path
+ *          in the prefix tree and invokes it if found
  *
  * @param[in] hd  Server instance data for which handler needs to be invoked
+ * @param[in] req The parsed request
  *
  * @return
  *  - ESP_OK    : if handler found and executed successfully
  *  - ESP_FAIL  : otherwise
  */
-esp_err_t httpd_uri(struct httpd_data *hd);
+esp_err_t httpd_uri(struct httpd_data *hd, httpd_req_t *req);
 
 /**
  * @brief   Deregister all URI handlers
@@ -374,6 +465,61 @@ bool httpd_validate_req_ptr(httpd_req_t *r);
  * @}
  */
 
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+/****************** Group : WebSocket ********************/
+/** @name WebSocket
+ * Functions for WebSocket header parsing
+ * @{
+ */
+
+/**
+ * @brief   Respond to the handshake of a request for upgrading to WebSocket
+ *
+ * @param[in] req   The request being upgraded
+ *
+ * @return
+ *  - ESP_OK    : the session has been upgraded
+ *  - ESP_FAIL  : invalid handshake, which was responded to with an error,
+ *                or error in sending the response
+ */
+esp_err_t httpd_ws_respond_server_handshake(httpd_req_t *req);
+
+/**
+ * @brief   Receive the header of the next frame of a WebSocket session
+ *          and dispatch it: control frames are answered by the server,
+ *          other ones passed to the WebSocket handler of the session
+ *
+ * @param[in] req   The request for the frame
+ *
+ * @return
+ *  - ESP_OK    : if the frame was processed successfully
+ *  - ESP_FAIL  : if the session is to be closed, because of a Close frame,
+ *                a protocol error or a socket error
+ */
+esp_err_t httpd_ws_process_frame(httpd_req_t *req);
+
+/** End of WebSocket related functions
+ * @}
+ */
+#endif /* CONFIG_HTTPD_WS_SUPPORT */
+
+/****************** Group : Static Files ********************/
+/** @name Static Files
+ * Functions for serving files
+ * @{
+ */
+
+/**
+ * @brief   Unregister all the static file directories and free them
+ *
+ * @param[in] hd   Server instance data
+ */
+void httpd_static_unregister_all(struct httpd_data *hd);
+
+/** End of Group : Static Files
+ * @}
+ */
+
 /****************** Group : Processing ********************/
 /** @name Processing
  * Methods for processing HTTP requests
@@ -388,6 +534,8 @@ bool httpd_validate_req_ptr(httpd_req_t *r);
  * URI, headers are ready to be fetched from scratch buffer and calling
  * http_recv() after this reads the body of the request.
  *
+ * The request is kept in the context of the worker processing the session.
+ *
  * @param[in] hd  Server instance data
  * @param[in] sd  Pointer to socket which is needed for receiving TCP packets.
  *
@@ -402,12 +550,13 @@ esp_err_t httpd_req_new(struct httpd_data *hd, struct sock_db *sd);
  *          purges any data left to be received
  *
  * @param[in] hd  Server instance data
+ * @param[in] r   The request to reset
  *
  * @return
  *  - ESP_OK    : if request packet deleted and resources cleaned.
  *  - ESP_FAIL  : otherwise.
  */
-esp_err_t httpd_req_delete(struct httpd_data *hd);
+esp_err_t httpd_req_delete(struct httpd_data *hd, httpd_req_t *r);
 
 /** End of Group : Parsing
  * @}
@@ -444,6 +593,39 @@ esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_resp_t error);
  */
 int httpd_send(httpd_req_t *req, const char *buf, size_t buf_len);
 
+/**
+ * @brief   For sending out the whole of a buffer, in as many calls
+ *          to the send function as it takes.
+ *
+ * @param[in] r       The request
+ * @param[in] buf     Buffer to send
+ * @param[in] buf_len Length of the buffer
+ *
+ * @return
+ *  - ESP_OK    : if successful
+ *  - ESP_FAIL  : if failed
+ */
+esp_err_t httpd_send_all(httpd_req_t *r, const char *buf, size_t buf_len);
+
+/**
+ * @brief   For sending out the head of a response with the given content length,
+ *          together with the start of the content.
+ *
+ * Like httpd_resp_sendv(), but the vector may hold only part of the content,
+ * the rest of which is then to be sent with httpd_send_all().
+ *
+ * @param[in] r           The request
+ * @param[in] content_len Length of the whole content
+ * @param[in] iov         Start of the content
+ * @param[in] iovcnt      Number of elements in the vector
+ *
+ * @return
+ *  - ESP_OK                 : if successful
+ *  - ESP_ERR_HTTPD_RESP_HDR : essential headers are too large for internal buffer
+ *  - ESP_ERR_HTTPD_RESP_SEND: error in raw send
+ */
+esp_err_t httpd_resp_send_head(httpd_req_t *r, size_t content_len, const httpd_iov_t *iov, size_t iovcnt);
+
 /**
  * @brief   For receiving HTTP request data
  *
@@ -32,12 +32,17 @@ static esp_err_t httpd_accept_conn(struct httpd_data *hd, int listen_fd)
     if (hd->config.lru_purge_enable == true) {
         if (!httpd_is_sess_available(hd)) {
             /* Queue asynchronous closure of the least recently used session */
-            return httpd_sess_close_lru(hd);
+            esp_err_t ret = httpd_sess_close_lru(hd);
+            if (ret != ESP_ERR_NOT_FOUND) {
+                return ret;
+            }
             /* Returning from this allowes the main server thread to process
              * the queued asynchronous control message for closing LRU session.
              * Since connection request hasn't been addressed yet using accept()
              * therefore httpd_accept_conn() will be called again, but this time
-             * with space available for one session
+             * with space available for one session.
+             * If all sessions are being processed by workers there is nothing
+             * to purge, and the connection is refused below
              */
        }
     }
@@ -75,6 +80,7 @@ struct httpd_ctrl_data {
     enum httpd_ctrl_msg {
         HTTPD_CTRL_SHUTDOWN,
         HTTPD_CTRL_WORK,
+        HTTPD_CTRL_WORKER_DONE,
     } hc_msg;
     httpd_work_fn_t hc_work;
     void *hc_work_arg;
@@ -142,6 +148,11 @@ static void httpd_process_ctrl_msg(struct httpd_data *hd)
             (*msg.hc_work)(msg.hc_work_arg);
         }
         break;
+    case HTTPD_CTRL_WORKER_DONE:
+        /* Finished workers are collected on every turn of the server loop,
+         * this only wakes it up */
+        ESP_LOGD(TAG, LOG_FMT("worker done"));
+        break;
     case HTTPD_CTRL_SHUTDOWN:
         ESP_LOGD(TAG, LOG_FMT("shutdown"));
         hd->hd_td.status = THREAD_STOPPING;
@@ -151,6 +162,147 @@ static void httpd_process_ctrl_msg(struct httpd_data *hd)
     }
 }
 
+static struct httpd_worker *httpd_worker_get_idle(struct httpd_data *hd)
+{
+    for (int i = 0; i < HTTPD_REQ_CTX_CNT(&hd->config); i++) {
+        if (hd->hd_workers[i].sd == NULL) {
+            return &hd->hd_workers[i];
+        }
+    }
+    return NULL;
+}
+
+/* Returns the session of a worker which is done to the server loop, or closes it */
+static void httpd_worker_release(struct httpd_data *hd, struct httpd_worker *w)
+{
+    struct sock_db *sd = w->sd;
+    int fd = sd->fd;
+
+    sd->worker = NULL;
+    w->sd = NULL;
+    if (w->result != ESP_OK || sd->close_pending) {
+        ESP_LOGD(TAG, LOG_FMT("closing socket %d"), fd);
+        close(fd);
+        httpd_sess_delete(hd, fd);
+        return;
+    }
+    httpd_sess_lru_touch(hd, sd);
+}
+
+/* Hands a session with incoming data over to an idle worker. Without worker
+ * tasks the request is processed right away in the server thread */
+static void httpd_worker_dispatch(struct httpd_data *hd, struct httpd_worker *w, struct sock_db *sd)
+{
+    w->sd = sd;
+    w->done = false;
+    sd->worker = w;
+
+    if (hd->config.worker_count == 0) {
+        w->result = httpd_sess_process(hd, sd);
+        httpd_worker_release(hd, w);
+        return;
+    }
+
+    httpd_os_sem_give(w->start);
+}
+
+/* Collects the workers which are done since the last turn of the server loop */
+static void httpd_worker_collect(struct httpd_data *hd)
+{
+    for (int i = 0; i < hd->config.worker_count; i++) {
+        struct httpd_worker *w = &hd->hd_workers[i];
+        if (w->sd && __atomic_load_n(&w->done, __ATOMIC_ACQUIRE)) {
+            httpd_worker_release(hd, w);
+        }
+    }
+}
+
+static void httpd_worker_thread(void *arg)
+{
+    struct httpd_worker *w = (struct httpd_worker *) arg;
+    struct httpd_data *hd = w->hd;
+    struct httpd_ctrl_data msg = {
+        .hc_msg = HTTPD_CTRL_WORKER_DONE,
+    };
+
+    while (1) {
+        httpd_os_sem_take(w->start);
+        if (w->td.status == THREAD_STOPPING) {
+            break;
+        }
+
+        ESP_LOGD(TAG, LOG_FMT("processing socket %d"), w->sd->fd);
+        w->result = httpd_sess_process(hd, w->sd);
+        __atomic_store_n(&w->done, true, __ATOMIC_RELEASE);
+
+        /* Wake up the server thread, which gives the session back to the select loop */
+        cs_send_to_ctrl_sock(hd->msg_fd, hd->config.ctrl_port, &msg, sizeof(msg));
+    }
+
+    w->td.status = THREAD_STOPPED;
+    httpd_os_thread_delete();
+}
+
+/* Stops the worker threads, letting those processing a request finish it */
+static void httpd_workers_stop(struct httpd_data *hd, int count)
+{
+    for (int i = 0; i < count; i++) {
+        hd->hd_workers[i].td.status = THREAD_STOPPING;
+        httpd_os_sem_give(hd->hd_workers[i].start);
+    }
+    for (int i = 0; i < count; i++) {
+        while (hd->hd_workers[i].td.status != THREAD_STOPPED) {
+            httpd_os_thread_sleep(10);
+        }
+    }
+}
+
+static esp_err_t httpd_workers_start(struct httpd_data *hd)
+{
+    for (int i = 0; i < hd->config.worker_count; i++) {
+        struct httpd_worker *w = &hd->hd_workers[i];
+        w->td.status = THREAD_RUNNING;
+        if (httpd_os_thread_create(&w->td.handle, "httpd_worker",
+                                   hd->config.worker_stack_size,
+                                   hd->config.task_priority,
+                                   httpd_worker_thread, w) != ESP_OK) {
+            ESP_LOGE(TAG, LOG_FMT("failed to launch worker %d"), i);
+            httpd_workers_stop(hd, i);
+            return ESP_FAIL;
+        }
+    }
+    return ESP_OK;
+}
+
+/* Checks if a session which isn't being processed has data left in its
+ * pending buffer, which select() doesn't report */
+static bool httpd_sess_pending_any(struct httpd_data *hd)
+{
+    for (struct sock_db *sd = hd->hd_lru_head; sd; sd = sd->lru_next) {
+        if (sd->worker == NULL && httpd_sess_pending(hd, sd->fd)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Finds the least recently used of the sessions which have data to be
+ * processed, so that sessions busy with requests can't starve the others
+ * when there are less workers than sessions */
+static struct sock_db *httpd_sess_get_ready(struct httpd_data *hd, fd_set *read_set)
+{
+    for (struct sock_db *sd = hd->hd_lru_head; sd; sd = sd->lru_next) {
+        if (sd->worker) {
+            /* Session is being processed by a worker */
+            continue;
+        }
+        if (FD_ISSET(sd->fd, read_set) || httpd_sess_pending(hd, sd->fd)) {
+            return sd;
+        }
+    }
+    return NULL;
+}
+
 /* Manage in-coming connection or data requests */
 static esp_err_t httpd_server(struct httpd_data *hd)
 {
@@ -159,20 +311,32 @@ static esp_err_t httpd_server(struct httpd_data *hd)
     FD_SET(hd->listen_fd, &read_set);
     FD_SET(hd->ctrl_fd, &read_set);
 
-    int tmp_max_fd;
-    httpd_sess_set_descriptors(hd, &read_set, &tmp_max_fd);
+    /* Sessions are only watched while there is a worker to process them,
+     * select() would keep returning for the data they have received otherwise */
+    int tmp_max_fd = -1;
+    struct timeval no_wait = { 0 };
+    struct timeval *timeout = NULL;
+    if (httpd_worker_get_idle(hd)) {
+        httpd_sess_set_descriptors(hd, &read_set, &tmp_max_fd);
+        /* Pipelined requests may have been received already */
+        if (httpd_sess_pending_any(hd)) {
+            timeout = &no_wait;
+        }
+    }
     int maxfd = MAX(hd->listen_fd, tmp_max_fd);
     tmp_max_fd = maxfd;
     maxfd = MAX(hd->ctrl_fd, tmp_max_fd);
 
     ESP_LOGD(TAG, LOG_FMT("doing select maxfd+1 = %d"), maxfd + 1);
-    int active_cnt = select(maxfd + 1, &read_set, NULL, NULL, NULL);
+    int active_cnt = select(maxfd + 1, &read_set, NULL, NULL, timeout);
     if (active_cnt < 0) {
         ESP_LOGE(TAG, LOG_FMT("error in select (%d)"), errno);
         httpd_sess_delete_invalid(hd);
         return ESP_OK;
     }
 
+    httpd_worker_collect(hd);
+
     /* Case0: Do we have a control message? */
     if (FD_ISSET(hd->ctrl_fd, &read_set)) {
         ESP_LOGD(TAG, LOG_FMT("processing ctrl message"));
@@ -185,18 +349,15 @@ static esp_err_t httpd_server(struct httpd_data *hd)
 
     /* Case1: Do we have any activity on the current data
      * sessions? */
-    int fd = -1;
-    while ((fd = httpd_sess_iterate(hd, fd)) != -1) {
-        if (FD_ISSET(fd, &read_set) || (httpd_sess_pending(hd, fd))) {
-            ESP_LOGD(TAG, LOG_FMT("processing socket %d"), fd);
-            if (httpd_sess_process(hd, fd) != ESP_OK) {
-                ESP_LOGD(TAG, LOG_FMT("closing socket %d"), fd);
-                close(fd);
-                /* Delete session and update fd to that
-                 * preceding the one being deleted */
-                fd = httpd_sess_delete(hd, fd);
-            }
-        }
+    struct httpd_worker *w;
+    struct sock_db *sd;
+    while ((w = httpd_worker_get_idle(hd)) != NULL &&
+           (sd = httpd_sess_get_ready(hd, &read_set)) != NULL) {
+        ESP_LOGD(TAG, LOG_FMT("processing socket %d"), sd->fd);
+        /* The socket has been looked at, only pending data can
+         * bring the session back in this turn */
+        FD_CLR(sd->fd, &read_set);
+        httpd_worker_dispatch(hd, w, sd);
     }
 
     /* Case2: Do we have any incoming connection requests to
@@ -226,6 +387,7 @@ static void httpd_thread(void *arg)
     }
 
     ESP_LOGD(TAG, LOG_FMT("web server exiting"));
+    httpd_workers_stop(hd, hd->config.worker_count);
     close(hd->msg_fd);
     cs_free_ctrl_sock(hd->ctrl_fd);
     httpd_close_all_sessions(hd);
@@ -307,6 +469,42 @@ static esp_err_t httpd_server_init(struct httpd_data *hd)
     return ESP_OK;
 }
 
+static void httpd_workers_deinit(struct httpd_data *hd)
+{
+    if (hd->hd_workers == NULL) {
+        return;
+    }
+    for (int i = 0; i < HTTPD_REQ_CTX_CNT(&hd->config); i++) {
+        struct httpd_worker *w = &hd->hd_workers[i];
+        free(w->req_aux.resp_hdrs);
+        if (w->start) {
+            httpd_os_sem_delete(w->start);
+        }
+    }
+    free(hd->hd_workers);
+    hd->hd_workers = NULL;
+}
+
+static esp_err_t httpd_workers_init(struct httpd_data *hd)
+{
+    hd->hd_workers = calloc(HTTPD_REQ_CTX_CNT(&hd->config), sizeof(struct httpd_worker));
+    if (hd->hd_workers == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < HTTPD_REQ_CTX_CNT(&hd->config); i++) {
+        struct httpd_worker *w = &hd->hd_workers[i];
+        w->hd = hd;
+        w->req_aux.resp_hdrs = calloc(hd->config.max_resp_headers, sizeof(struct resp_hdr));
+        if (w->req_aux.resp_hdrs == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        if (hd->config.worker_count && httpd_os_sem_create(&w->start) != OS_SUCCESS) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    return ESP_OK;
+}
+
 static struct httpd_data *httpd_create(const httpd_config_t *config)
 {
     /* Allocate memory for httpd instance data */
@@ -318,21 +516,26 @@ static struct httpd_data *httpd_create(const httpd_config_t *config)
             return NULL;
         }
         hd->hd_sd = calloc(config->max_open_sockets, sizeof(struct sock_db));
-        if (hd->hd_sd == NULL) {
+        hd->hd_sd_map = calloc(httpd_sess_map_size(config->max_open_sockets), sizeof(struct sock_db *));
+        if (hd->hd_sd == NULL || hd->hd_sd_map == NULL) {
+            free(hd->hd_sd_map);
+            free(hd->hd_sd);
             free(hd->hd_calls);
             free(hd);
             return NULL;
         }
-        struct httpd_req_aux *ra = &hd->hd_req_aux;
-        ra->resp_hdrs = calloc(config->max_resp_headers, sizeof(struct resp_hdr));
-        if (ra->resp_hdrs == NULL) {
+        /* Save the configuration for this instance */
+        hd->config = *config;
+        if (httpd_workers_init(hd) != ESP_OK ||
+            httpd_os_sem_create(&hd->hd_router_lock) != OS_SUCCESS) {
+            httpd_workers_deinit(hd);
+            free(hd->hd_sd_map);
             free(hd->hd_sd);
             free(hd->hd_calls);
             free(hd);
             return NULL;
         }
-        /* Save the configuration for this instance */
-        hd->config = *config;
+        httpd_os_sem_give(hd->hd_router_lock);
     } else {
         ESP_LOGE(TAG, "mem alloc failed");
     }
@@ -341,13 +544,15 @@ static struct httpd_data *httpd_create(const httpd_config_t *config)
 
 static void httpd_delete(struct httpd_data *hd)
 {
-    struct httpd_req_aux *ra = &hd->hd_req_aux;
     /* Free memory of httpd instance data */
-    free(ra->resp_hdrs);
+    httpd_workers_deinit(hd);
+    free(hd->hd_sd_map);
     free(hd->hd_sd);
 
     /* Free registered URI handlers */
     httpd_unregister_all_uri_handlers(hd);
+    httpd_static_unregister_all(hd);
+    httpd_os_sem_delete(hd->hd_router_lock);
     free(hd->hd_calls);
     free(hd);
 }
@@ -370,11 +575,19 @@ esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config)
     }
 
     httpd_sess_init(hd);
+    if (httpd_workers_start(hd) != ESP_OK) {
+        close(hd->msg_fd);
+        cs_free_ctrl_sock(hd->ctrl_fd);
+        close(hd->listen_fd);
+        httpd_delete(hd);
+        return ESP_ERR_HTTPD_TASK;
+    }
     if (httpd_os_thread_create(&hd->hd_td.handle, "httpd",
                                hd->config.stack_size,
                                hd->config.task_priority,
                                httpd_thread, hd) != ESP_OK) {
         /* Failed to launch task */
+        httpd_workers_stop(hd, hd->config.worker_count);
         httpd_delete(hd);
         return ESP_ERR_HTTPD_TASK;
     }
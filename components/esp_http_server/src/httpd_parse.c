@@ -299,10 +299,23 @@ static esp_err_t cb_headers_complete(http_parser *parser)
     ESP_LOGD(TAG, LOG_FMT("content length = %zu"), r->content_len);
 
     if (parser->upgrade) {
-        ESP_LOGW(TAG, LOG_FMT("upgrade from HTTP not supported"));
-        parser_data->error = HTTPD_XXX_UPGRADE_NOT_SUPPORTED;
-        parser_data->status = PARSING_FAILED;
-        return ESP_FAIL;
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+        /* Upgrades to WebSocket are completed by httpd_uri(),
+         * if the URI is registered as a WebSocket endpoint */
+        char upgrade[sizeof("websocket")];
+        if ((r->method == HTTP_GET) &&
+            (httpd_req_get_hdr_value_str(r, "Upgrade", upgrade, sizeof(upgrade)) == ESP_OK) &&
+            (strcasecmp(upgrade, "websocket") == 0)) {
+            ESP_LOGD(TAG, LOG_FMT("WebSocket upgrade request"));
+            ra->ws_handshake_detect = true;
+        } else
+#endif
+        {
+            ESP_LOGW(TAG, LOG_FMT("upgrade from HTTP not supported"));
+            parser_data->error = HTTPD_XXX_UPGRADE_NOT_SUPPORTED;
+            parser_data->status = PARSING_FAILED;
+            return ESP_FAIL;
+        }
     }
 
     parser_data->status = PARSING_BODY;
@@ -493,9 +506,8 @@ static void parse_init(httpd_req_t *r, http_parser *parser, parser_data_t *data)
 
 /* Function that receives TCP data and runs parser on it
  */
-static esp_err_t httpd_parse_req(struct httpd_data *hd)
+static esp_err_t httpd_parse_req(struct httpd_data *hd, httpd_req_t *r)
 {
-    httpd_req_t *r = &hd->hd_req;
     int blk_len,  offset;
     http_parser   parser;
     parser_data_t parser_data;
@@ -524,7 +536,7 @@ static esp_err_t httpd_parse_req(struct httpd_data *hd)
     } while (parser_data.status != PARSING_COMPLETE);
 
     ESP_LOGD(TAG, LOG_FMT("parsing complete"));
-    return httpd_uri(hd);
+    return httpd_uri(hd, r);
 }
 
 static void init_req(httpd_req_t *r, httpd_config_t *config)
@@ -549,6 +561,12 @@ static void init_req_aux(struct httpd_req_aux *ra, httpd_config_t *config)
     ra->first_chunk_sent = 0;
     ra->req_hdrs_count = 0;
     ra->resp_hdrs_count = 0;
+    ra->uri_pattern = NULL;
+    ra->path_params_count = 0;
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    ra->ws_handshake_detect = false;
+    ra->ws_frame = false;
+#endif
     memset(ra->resp_hdrs, 0, config->max_resp_headers * sizeof(struct resp_hdr));
 }
 
@@ -575,11 +593,11 @@ static void httpd_req_cleanup(httpd_req_t *r)
  */
 esp_err_t httpd_req_new(struct httpd_data *hd, struct sock_db *sd)
 {
-    httpd_req_t *r = &hd->hd_req;
+    httpd_req_t *r = &sd->worker->req;
     init_req(r, &hd->config);
-    init_req_aux(&hd->hd_req_aux, &hd->config);
+    init_req_aux(&sd->worker->req_aux, &hd->config);
     r->handle = hd;
-    r->aux = &hd->hd_req_aux;
+    r->aux = &sd->worker->req_aux;
     /* Associate the request to the socket */
     struct httpd_req_aux *ra = r->aux;
     ra->sd = sd;
@@ -590,8 +608,15 @@ esp_err_t httpd_req_new(struct httpd_data *hd, struct sock_db *sd)
     /* Copy session info to the request */
     r->sess_ctx = sd->ctx;
     r->free_ctx = sd->free_ctx;
+    esp_err_t err;
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    /* Frames of WebSocket sessions bypass the HTTP parser */
+    if (sd->ws_handshake_done) {
+        err = httpd_ws_process_frame(r);
+    } else
+#endif
     /* Parse request */
-    esp_err_t err = httpd_parse_req(hd);
+    err = httpd_parse_req(hd, r);
     if (err != ESP_OK) {
         httpd_req_cleanup(r);
     }
@@ -600,9 +625,8 @@ esp_err_t httpd_req_new(struct httpd_data *hd, struct sock_db *sd)
 
 /* Function that resets the http request data
  */
-esp_err_t httpd_req_delete(struct httpd_data *hd)
+esp_err_t httpd_req_delete(struct httpd_data *hd, httpd_req_t *r)
 {
-    httpd_req_t *r = &hd->hd_req;
     struct httpd_req_aux *ra = r->aux;
 
     /* Finish off reading any pending/leftover data */
@@ -635,9 +659,13 @@ bool httpd_validate_req_ptr(httpd_req_t *r)
         struct httpd_data *hd = (struct httpd_data *) r->handle;
         if (hd) {
             /* Check if this function is running in the context of
-             * the correct httpd server thread */
-            if (httpd_os_thread_handle() == hd->hd_td.handle) {
-                return true;
+             * the httpd thread which is processing the request */
+            for (int i = 0; i < HTTPD_REQ_CTX_CNT(&hd->config); i++) {
+                struct httpd_worker *w = &hd->hd_workers[i];
+                if (r == &w->req) {
+                    othread_t handle = hd->config.worker_count ? w->td.handle : hd->hd_td.handle;
+                    return httpd_os_thread_handle() == handle;
+                }
             }
         }
     }
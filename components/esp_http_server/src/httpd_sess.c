@@ -14,6 +14,7 @@
 
 
 #include <stdlib.h>
+#include <errno.h>
 #include <esp_log.h>
 #include <esp_err.h>
 
@@ -25,66 +26,131 @@ static const char *TAG = "httpd_sess";
 
 bool httpd_is_sess_available(struct httpd_data *hd)
 {
-    int i;
-    for (i = 0; i < hd->config.max_open_sockets; i++) {
-        if (hd->hd_sd[i].fd == -1) {
-            return true;
+    return hd->hd_sd_free != NULL;
+}
+
+/* Entry of the descriptor in the table of open sessions: the one holding
+ * its session if it has any, or the free entry ending its probe sequence */
+static unsigned httpd_sess_map_find(struct httpd_data *hd, int sockfd)
+{
+    unsigned mask = httpd_sess_map_size(hd->config.max_open_sockets) - 1;
+    unsigned i = (unsigned) sockfd & mask;
+
+    while (hd->hd_sd_map[i] && hd->hd_sd_map[i]->fd != sockfd) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+/* Removes the session from the table, moving the entries which follow in
+ * the probe sequence back over the hole, so that lookups needn't skip it */
+static void httpd_sess_map_remove(struct httpd_data *hd, int sockfd)
+{
+    unsigned mask = httpd_sess_map_size(hd->config.max_open_sockets) - 1;
+    unsigned hole = httpd_sess_map_find(hd, sockfd);
+
+    hd->hd_sd_map[hole] = NULL;
+    for (unsigned i = (hole + 1) & mask; hd->hd_sd_map[i]; i = (i + 1) & mask) {
+        unsigned home = (unsigned) hd->hd_sd_map[i]->fd & mask;
+        /* Entry can move to the hole if that is between its home and it */
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            hd->hd_sd_map[hole] = hd->hd_sd_map[i];
+            hd->hd_sd_map[i] = NULL;
+            hole = i;
         }
     }
-    return false;
 }
 
-struct sock_db *httpd_sess_get(struct httpd_data *hd, int sockfd)
+static void httpd_sess_lru_unlink(struct httpd_data *hd, struct sock_db *sd)
 {
-    if (hd == NULL) {
-        return NULL;
+    if (sd->lru_prev) {
+        sd->lru_prev->lru_next = sd->lru_next;
+    } else {
+        hd->hd_lru_head = sd->lru_next;
+    }
+    if (sd->lru_next) {
+        sd->lru_next->lru_prev = sd->lru_prev;
+    } else {
+        hd->hd_lru_tail = sd->lru_prev;
     }
+    sd->lru_prev = NULL;
+    sd->lru_next = NULL;
+}
 
-    /* Check if called inside a request handler, and the
-     * session sockfd in use is same as the parameter */
-    if ((hd->hd_req_aux.sd) && (hd->hd_req_aux.sd->fd == sockfd)) {
-        /* Just return the pointer to the sock_db
-         * corresponding to the request */
-        return hd->hd_req_aux.sd;
+static void httpd_sess_lru_append(struct httpd_data *hd, struct sock_db *sd)
+{
+    sd->lru_prev = hd->hd_lru_tail;
+    sd->lru_next = NULL;
+    if (hd->hd_lru_tail) {
+        hd->hd_lru_tail->lru_next = sd;
+    } else {
+        hd->hd_lru_head = sd;
     }
+    hd->hd_lru_tail = sd;
+}
 
-    int i;
-    for (i = 0; i < hd->config.max_open_sockets; i++) {
-        if (hd->hd_sd[i].fd == sockfd) {
-            return &hd->hd_sd[i];
-        }
+void httpd_sess_lru_touch(struct httpd_data *hd, struct sock_db *sd)
+{
+    __atomic_store_n(&sd->lru_touched, false, __ATOMIC_RELAXED);
+    if (sd != hd->hd_lru_tail) {
+        httpd_sess_lru_unlink(hd, sd);
+        httpd_sess_lru_append(hd, sd);
+    }
+}
+
+/* Takes the session out of the table and the LRU list, and frees its entry */
+static void httpd_sess_release(struct httpd_data *hd, struct sock_db *sd)
+{
+    httpd_sess_map_remove(hd, sd->fd);
+    httpd_sess_lru_unlink(hd, sd);
+    sd->fd = -1;
+    sd->lru_next = hd->hd_sd_free;
+    hd->hd_sd_free = sd;
+}
+
+struct sock_db *httpd_sess_get(struct httpd_data *hd, int sockfd)
+{
+    if (hd == NULL || sockfd < 0) {
+        return NULL;
     }
-    return NULL;
+
+    return hd->hd_sd_map[httpd_sess_map_find(hd, sockfd)];
 }
 
 esp_err_t httpd_sess_new(struct httpd_data *hd, int newfd)
 {
     ESP_LOGD(TAG, LOG_FMT("fd = %d"), newfd);
 
-    if (httpd_sess_get(hd, newfd)) {
+    if (newfd < 0 || httpd_sess_get(hd, newfd)) {
         ESP_LOGE(TAG, LOG_FMT("session already exists with fd = %d"), newfd);
         return ESP_FAIL;
     }
 
-    int i;
-    for (i = 0; i < hd->config.max_open_sockets; i++) {
-        if (hd->hd_sd[i].fd == -1) {
-            memset(&hd->hd_sd[i], 0, sizeof(hd->hd_sd[i]));
-            hd->hd_sd[i].fd = newfd;
-            hd->hd_sd[i].handle = (httpd_handle_t) hd;
-            hd->hd_sd[i].send_fn = httpd_default_send;
-            hd->hd_sd[i].recv_fn = httpd_default_recv;
-
-            /* Call user-defined session opening function */
-            if (hd->config.open_fn) {
-                esp_err_t ret = hd->config.open_fn(hd, hd->hd_sd[i].fd);
-                if (ret != ESP_OK) return ret;
-            }
-            return ESP_OK;
+    struct sock_db *sd = hd->hd_sd_free;
+    if (sd == NULL) {
+        ESP_LOGD(TAG, LOG_FMT("unable to launch session for fd = %d"), newfd);
+        return ESP_FAIL;
+    }
+    hd->hd_sd_free = sd->lru_next;
+
+    memset(sd, 0, sizeof(*sd));
+    sd->fd = newfd;
+    sd->handle = (httpd_handle_t) hd;
+    sd->send_fn = httpd_default_send;
+    sd->recv_fn = httpd_default_recv;
+    hd->hd_sd_map[httpd_sess_map_find(hd, newfd)] = sd;
+    httpd_sess_lru_append(hd, sd);
+
+    /* Call user-defined session opening function */
+    if (hd->config.open_fn) {
+        esp_err_t ret = hd->config.open_fn(hd, sd->fd);
+        if (ret != ESP_OK) {
+            /* The descriptor is closed by the caller */
+            httpd_sess_release(hd, sd);
+            return ret;
         }
     }
-    ESP_LOGD(TAG, LOG_FMT("unable to launch session for fd = %d"), newfd);
-    return ESP_FAIL;
+    return ESP_OK;
 }
 
 void httpd_sess_free_ctx(void *ctx, httpd_free_ctx_fn_t free_fn)
@@ -108,9 +174,8 @@ void *httpd_sess_get_ctx(httpd_handle_t handle, int sockfd)
     /* Check if the function has been called from inside a
      * request handler, in which case fetch the context from
      * the httpd_req_t structure */
-    struct httpd_data *hd = (struct httpd_data *) handle;
-    if (hd->hd_req_aux.sd == sd) {
-        return hd->hd_req.sess_ctx;
+    if (sd->worker && sd->worker->req_aux.sd == sd) {
+        return sd->worker->req.sess_ctx;
     }
 
     return sd->ctx;
@@ -126,18 +191,18 @@ void httpd_sess_set_ctx(httpd_handle_t handle, int sockfd, void *ctx, httpd_free
     /* Check if the function has been called from inside a
      * request handler, in which case set the context inside
      * the httpd_req_t structure */
-    struct httpd_data *hd = (struct httpd_data *) handle;
-    if (hd->hd_req_aux.sd == sd) {
-        if (hd->hd_req.sess_ctx != ctx) {
+    if (sd->worker && sd->worker->req_aux.sd == sd) {
+        httpd_req_t *r = &sd->worker->req;
+        if (r->sess_ctx != ctx) {
             /* Don't free previous context if it is in sockdb
              * as it will be freed inside httpd_req_cleanup() */
-            if (sd->ctx != hd->hd_req.sess_ctx) {
+            if (sd->ctx != r->sess_ctx) {
                 /* Free previous context */
-                httpd_sess_free_ctx(hd->hd_req.sess_ctx, hd->hd_req.free_ctx);
+                httpd_sess_free_ctx(r->sess_ctx, r->free_ctx);
             }
-            hd->hd_req.sess_ctx = ctx;
+            r->sess_ctx = ctx;
         }
-        hd->hd_req.free_ctx = free_fn;
+        r->free_ctx = free_fn;
         return;
     }
 
@@ -178,13 +243,12 @@ void httpd_sess_set_transport_ctx(httpd_handle_t handle, int sockfd, void *ctx,
 void httpd_sess_set_descriptors(struct httpd_data *hd,
                                 fd_set *fdset, int *maxfd)
 {
-    int i;
     *maxfd = -1;
-    for (i = 0; i < hd->config.max_open_sockets; i++) {
-        if (hd->hd_sd[i].fd != -1) {
-            FD_SET(hd->hd_sd[i].fd, fdset);
-            if (hd->hd_sd[i].fd > *maxfd) {
-                *maxfd = hd->hd_sd[i].fd;
+    for (struct sock_db *sd = hd->hd_lru_head; sd; sd = sd->lru_next) {
+        if (sd->worker == NULL) {
+            FD_SET(sd->fd, fdset);
+            if (sd->fd > *maxfd) {
+                *maxfd = sd->fd;
             }
         }
     }
@@ -196,18 +260,15 @@ static int fd_is_valid(int fd)
     return fcntl(fd, F_GETFD, 0) != -1 || errno != EBADF;
 }
 
-static inline uint64_t httpd_sess_get_lru_counter()
-{
-    static uint64_t lru_counter = 0;
-    return lru_counter++;
-}
-
 void httpd_sess_delete_invalid(struct httpd_data *hd)
 {
-    for (int i = 0; i < hd->config.max_open_sockets; i++) {
-        if (hd->hd_sd[i].fd != -1 && !fd_is_valid(hd->hd_sd[i].fd)) {
-            ESP_LOGW(TAG, LOG_FMT("Closing invalid socket %d"), hd->hd_sd[i].fd);
-            httpd_sess_delete(hd, hd->hd_sd[i].fd);
+    struct sock_db *next;
+    for (struct sock_db *sd = hd->hd_lru_head; sd; sd = next) {
+        next = sd->lru_next;
+        /* Sessions being processed are left to their worker */
+        if (sd->worker == NULL && !fd_is_valid(sd->fd)) {
+            ESP_LOGW(TAG, LOG_FMT("Closing invalid socket %d"), sd->fd);
+            httpd_sess_delete(hd, sd->fd);
         }
     }
 }
@@ -215,56 +276,59 @@ void httpd_sess_delete_invalid(struct httpd_data *hd)
 int httpd_sess_delete(struct httpd_data *hd, int fd)
 {
     ESP_LOGD(TAG, LOG_FMT("fd = %d"), fd);
-    int i;
-    int pre_sess_fd = -1;
-    for (i = 0; i < hd->config.max_open_sockets; i++) {
-        if (hd->hd_sd[i].fd == fd) {
-            /* global close handler */
-            if (hd->config.close_fn) {
-                hd->config.close_fn(hd, fd);
-            }
+    struct sock_db *sd = httpd_sess_get(hd, fd);
+    if (sd == NULL) {
+        return -1;
+    }
 
-            /* release 'user' context */
-            if (hd->hd_sd[i].ctx) {
-                if (hd->hd_sd[i].free_ctx) {
-                    hd->hd_sd[i].free_ctx(hd->hd_sd[i].ctx);
-                } else {
-                    free(hd->hd_sd[i].ctx);
-                }
-                hd->hd_sd[i].ctx = NULL;
-                hd->hd_sd[i].free_ctx = NULL;
-            }
+    /* global close handler */
+    if (hd->config.close_fn) {
+        hd->config.close_fn(hd, fd);
+    }
 
-            /* release 'transport' context */
-            if (hd->hd_sd[i].transport_ctx) {
-                if (hd->hd_sd[i].free_transport_ctx) {
-                    hd->hd_sd[i].free_transport_ctx(hd->hd_sd[i].transport_ctx);
-                } else {
-                    free(hd->hd_sd[i].transport_ctx);
-                }
-                hd->hd_sd[i].transport_ctx = NULL;
-                hd->hd_sd[i].free_transport_ctx = NULL;
-            }
+    /* release 'user' context */
+    if (sd->ctx) {
+        if (sd->free_ctx) {
+            sd->free_ctx(sd->ctx);
+        } else {
+            free(sd->ctx);
+        }
+        sd->ctx = NULL;
+        sd->free_ctx = NULL;
+    }
 
-            /* mark session slot as available */
-            hd->hd_sd[i].fd = -1;
-            break;
-        } else if (hd->hd_sd[i].fd != -1) {
-            /* Return the fd just preceding the one being
-             * deleted so that iterator can continue from
-             * the correct fd */
-            pre_sess_fd = hd->hd_sd[i].fd;
+    /* release 'transport' context */
+    if (sd->transport_ctx) {
+        if (sd->free_transport_ctx) {
+            sd->free_transport_ctx(sd->transport_ctx);
+        } else {
+            free(sd->transport_ctx);
         }
+        sd->transport_ctx = NULL;
+        sd->free_transport_ctx = NULL;
     }
+
+    /* Return the fd just preceding the one being
+     * deleted so that iterator can continue from
+     * the correct fd */
+    int pre_sess_fd = sd->lru_prev ? sd->lru_prev->fd : -1;
+
+    /* mark session slot as available */
+    httpd_sess_release(hd, sd);
     return pre_sess_fd;
 }
 
 void httpd_sess_init(struct httpd_data *hd)
 {
-    int i;
-    for (i = 0; i < hd->config.max_open_sockets; i++) {
+    memset(hd->hd_sd_map, 0, httpd_sess_map_size(hd->config.max_open_sockets) * sizeof(struct sock_db *));
+    hd->hd_lru_head = NULL;
+    hd->hd_lru_tail = NULL;
+    hd->hd_sd_free = NULL;
+    for (int i = hd->config.max_open_sockets - 1; i >= 0; i--) {
         hd->hd_sd[i].fd = -1;
         hd->hd_sd[i].ctx = NULL;
+        hd->hd_sd[i].lru_next = hd->hd_sd_free;
+        hd->hd_sd_free = &hd->hd_sd[i];
     }
 }
 
@@ -288,23 +352,17 @@ bool httpd_sess_pending(struct httpd_data *hd, int fd)
  * value is returned, everything related to this socket will be
  * cleaned up and the socket will be closed.
  */
-esp_err_t httpd_sess_process(struct httpd_data *hd, int newfd)
+esp_err_t httpd_sess_process(struct httpd_data *hd, struct sock_db *sd)
 {
-    struct sock_db *sd = httpd_sess_get(hd, newfd);
-    if (! sd) {
-        return ESP_FAIL;
-    }
-
     ESP_LOGD(TAG, LOG_FMT("httpd_req_new"));
     if (httpd_req_new(hd, sd) != ESP_OK) {
         return ESP_FAIL;
     }
     ESP_LOGD(TAG, LOG_FMT("httpd_req_delete"));
-    if (httpd_req_delete(hd) != ESP_OK) {
+    if (httpd_req_delete(hd, &sd->worker->req) != ESP_OK) {
         return ESP_FAIL;
     }
     ESP_LOGD(TAG, LOG_FMT("success"));
-    sd->lru_counter = httpd_sess_get_lru_counter();
     return ESP_OK;
 }
 
@@ -316,65 +374,68 @@ esp_err_t httpd_sess_update_lru_counter(httpd_handle_t handle, int sockfd)
 
     /* Search for the socket database entry */
     struct httpd_data *hd = (struct httpd_data *) handle;
-    int i;
-    for (i = 0; i < hd->config.max_open_sockets; i++) {
-        if (hd->hd_sd[i].fd == sockfd) {
-            hd->hd_sd[i].lru_counter = httpd_sess_get_lru_counter();
-            return ESP_OK;
-        }
+    struct sock_db *sd = httpd_sess_get(hd, sockfd);
+    if (sd == NULL) {
+        return ESP_ERR_NOT_FOUND;
     }
-    return ESP_ERR_NOT_FOUND;
+
+    /* This may be called from other tasks, so the session is only
+     * moved in the LRU list by the server when looking for one to close */
+    __atomic_store_n(&sd->lru_touched, true, __ATOMIC_RELAXED);
+    return ESP_OK;
 }
 
 esp_err_t httpd_sess_close_lru(struct httpd_data *hd)
 {
-    uint64_t lru_counter = UINT64_MAX;
-    int lru_fd = -1;
-    int i;
-    for (i = 0; i < hd->config.max_open_sockets; i++) {
-        /* If a descriptor is -1, there is no need to close any session.
-         * So, we can return from here, without finding the Least Recently Used
-         * session
-         */
-        if (hd->hd_sd[i].fd == -1) {
-            return ESP_OK;
+    /* If a descriptor is free, there is no need to close any session */
+    if (httpd_is_sess_available(hd)) {
+        return ESP_OK;
+    }
+
+    struct sock_db *next;
+    for (struct sock_db *sd = hd->hd_lru_head; sd; sd = next) {
+        next = sd->lru_next;
+        if (__atomic_load_n(&sd->lru_touched, __ATOMIC_RELAXED)) {
+            /* Used since it was last moved, it comes after the sessions
+             * still left to look at, which were used less recently */
+            httpd_sess_lru_touch(hd, sd);
+            if (next == NULL) {
+                next = sd;
+            }
+            continue;
         }
-        if (hd->hd_sd[i].lru_counter < lru_counter) {
-            lru_counter = hd->hd_sd[i].lru_counter;
-            lru_fd = hd->hd_sd[i].fd;
+        /* A session can't be closed under the worker processing it */
+        if (sd->worker == NULL) {
+            ESP_LOGD(TAG, LOG_FMT("fd = %d"), sd->fd);
+            return httpd_sess_trigger_close(hd, sd->fd);
         }
     }
-    ESP_LOGD(TAG, LOG_FMT("fd = %d"), lru_fd);
-    return httpd_sess_trigger_close(hd, lru_fd);
+    return ESP_ERR_NOT_FOUND;
 }
 
 int httpd_sess_iterate(struct httpd_data *hd, int start_fd)
 {
-    int start_index = 0;
-    int i;
+    struct sock_db *sd = hd->hd_lru_head;
 
     if (start_fd != -1) {
-        /* Take our index to where this fd is stored */
-        for (i = 0; i < hd->config.max_open_sockets; i++) {
-            if (hd->hd_sd[i].fd == start_fd) {
-                start_index = i + 1;
-                break;
-            }
+        /* Continue from the session with this fd, or start over if it's gone */
+        struct sock_db *start = httpd_sess_get(hd, start_fd);
+        if (start) {
+            sd = start->lru_next;
         }
     }
-
-    for (i = start_index; i < hd->config.max_open_sockets; i++) {
-        if (hd->hd_sd[i].fd != -1) {
-            return hd->hd_sd[i].fd;
-        }
-    }
-    return -1;
+    return sd ? sd->fd : -1;
 }
 
 static void httpd_sess_close(void *arg)
 {
     struct sock_db *sock_db = (struct sock_db *)arg;
     if (sock_db) {
+        if (sock_db->worker) {
+            /* The session is closed once its worker is done with it */
+            sock_db->close_pending = true;
+            return;
+        }
         int fd = sock_db->fd;
         struct httpd_data *hd = (struct httpd_data *) sock_db->handle;
         httpd_sess_delete(hd, fd);
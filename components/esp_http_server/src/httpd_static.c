@@ -0,0 +1,485 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <esp_log.h>
+#include <esp_err.h>
+
+#include <esp_http_server.h>
+#include "esp_httpd_priv.h"
+#include "osal.h"
+
+static const char *TAG = "httpd_static";
+
+#define HTTPD_STATIC_GZIP_EXT   ".gz"
+
+/* Quoted 64 bit hash in hex */
+#define HTTPD_STATIC_ETAG_LEN   (2 + 16)
+
+/* Enough for the usual lists of encodings or entity tags, the rest is ignored */
+#define HTTPD_STATIC_HDR_LEN    128
+
+/**
+ * @brief   ETag of a file served before
+ */
+struct httpd_static_etag {
+    char       *path;           /*!< Path of the file, NULL for an unused entry */
+    time_t      mtime;          /*!< Modification time of the file when it was hashed */
+    off_t       size;           /*!< Size of the file when it was hashed */
+    uint64_t    hash;           /*!< Hash of the content */
+};
+
+/**
+ * @brief   Directory of static files registered with httpd_register_static()
+ */
+struct httpd_static {
+    struct httpd_static *next;  /*!< Next directory of the server */
+    char       *uri;            /*!< URI pattern the handler is registered with */
+    size_t      prefix_len;     /*!< Length of the URIs up to the path of the file */
+    char       *base_path;      /*!< Copy of the configuration */
+    char       *index_file;
+    char       *cache_control;
+    size_t      read_size;
+    osem_t      lock;           /*!< Of the ETag cache, which handlers in worker tasks share */
+    uint16_t    etag_count;     /*!< Size of the ETag cache */
+    uint16_t    etag_next;      /*!< Entry of the cache to be replaced next */
+    struct httpd_static_etag etags[];
+};
+
+static const struct {
+    const char *ext;
+    const char *type;
+} httpd_static_types[] = {
+    { ".html",  HTTPD_TYPE_TEXT             },
+    { ".htm",   HTTPD_TYPE_TEXT             },
+    { ".css",   "text/css"                  },
+    { ".js",    "application/javascript"    },
+    { ".json",  HTTPD_TYPE_JSON             },
+    { ".txt",   "text/plain"                },
+    { ".xml",   "text/xml"                  },
+    { ".svg",   "image/svg+xml"             },
+    { ".png",   "image/png"                 },
+    { ".jpg",   "image/jpeg"                },
+    { ".jpeg",  "image/jpeg"                },
+    { ".gif",   "image/gif"                 },
+    { ".ico",   "image/x-icon"              },
+    { ".woff",  "font/woff"                 },
+    { ".woff2", "font/woff2"                },
+    { ".pdf",   "application/pdf"           },
+};
+
+static const char *httpd_static_type(const char *path)
+{
+    const char *ext = strrchr(path, '.');
+
+    if (ext != NULL && strchr(ext, '/') == NULL) {
+        for (size_t i = 0; i < sizeof(httpd_static_types) / sizeof(httpd_static_types[0]); i++) {
+            if (strcasecmp(ext, httpd_static_types[i].ext) == 0) {
+                return httpd_static_types[i].type;
+            }
+        }
+    }
+    return HTTPD_TYPE_OCTET;
+}
+
+static void httpd_static_free(struct httpd_static *st)
+{
+    for (unsigned i = 0; i < st->etag_count; i++) {
+        free(st->etags[i].path);
+    }
+    if (st->lock) {
+        httpd_os_sem_delete(st->lock);
+    }
+    free(st->uri);
+    free(st->base_path);
+    free(st->index_file);
+    free(st->cache_control);
+    free(st);
+}
+
+static int httpd_static_hex(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c |= 0x20;
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+/* Appends the percent-decoded path of the URI to the one of the file, which
+ * it mustn't lead out of. Returns the length of the file path, or -1 */
+static int httpd_static_decode(char *path, size_t path_len, const char *uri, size_t uri_len)
+{
+    size_t segment = path_len;
+
+    for (size_t i = 0; i <= uri_len; i++) {
+        char c;
+        if (i == uri_len) {
+            c = '\0';
+        } else if (uri[i] == '%') {
+            int hi = (i + 2 < uri_len) ? httpd_static_hex(uri[i + 1]) : -1;
+            int lo = (i + 2 < uri_len) ? httpd_static_hex(uri[i + 2]) : -1;
+            if (hi < 0 || lo < 0 || (hi == 0 && lo == 0)) {
+                return -1;
+            }
+            c = (hi << 4) | lo;
+            i += 2;
+        } else {
+            c = uri[i];
+        }
+
+        if (c == '/' || c == '\0') {
+            /* Segment done, which mustn't go up */
+            if (path_len - segment == 2 && memcmp(path + segment, "..", 2) == 0) {
+                return -1;
+            }
+            segment = path_len + 1;
+        } else if (c == '\\') {
+            return -1;
+        }
+        path[path_len++] = c;
+    }
+    return path_len - 1;
+}
+
+/* Checks whether an Accept-Encoding or If-None-Match list of the
+ * request has an element, which is acceptable unless its q is 0 */
+static bool httpd_static_hdr_has(httpd_req_t *req, const char *field, const char *elem)
+{
+    char val[HTTPD_STATIC_HDR_LEN];
+    size_t elem_len = strlen(elem);
+
+    esp_err_t err = httpd_req_get_hdr_value_str(req, field, val, sizeof(val));
+    if (err != ESP_OK && err != ESP_ERR_HTTPD_RESULT_TRUNC) {
+        return false;
+    }
+
+    for (char *p = val; *p != '\0';) {
+        p += strspn(p, " \t,");
+        if (strncmp(p, "W/", 2) == 0) {
+            /* Weak entity tags match too */
+            p += 2;
+        }
+        size_t len = strcspn(p, ",");
+        size_t name_len = strcspn(p, " \t;,");
+        if (name_len == 1 && p[0] == '*') {
+            return true;
+        }
+        if (name_len == elem_len && strncasecmp(p, elem, elem_len) == 0) {
+            /* Only refused with a quality of 0 */
+            char *q = strstr(p + name_len, "q=");
+            if (q == NULL || q >= p + len || strtod(q + 2, NULL) > 0) {
+                return true;
+            }
+        }
+        p += len;
+    }
+    return false;
+}
+
+/* Hashes the content of the file with 64 bit FNV-1a */
+static esp_err_t httpd_static_hash(int fd, char *buf, size_t buf_size, uint64_t *hash)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    ssize_t len;
+
+    while ((len = read(fd, buf, buf_size)) > 0) {
+        for (ssize_t i = 0; i < len; i++) {
+            h = (h ^ (uint8_t) buf[i]) * 0x100000001b3ULL;
+        }
+    }
+    if (len < 0 || lseek(fd, 0, SEEK_SET) != 0) {
+        return ESP_FAIL;
+    }
+    *hash = h;
+    return ESP_OK;
+}
+
+/* Gets the ETag of the file from the cache, hashing it if it isn't there
+ * yet or has changed. The read buffer is used for the hashing */
+static esp_err_t httpd_static_etag(struct httpd_static *st, const char *path, int fd, const struct stat *sb,
+                                   char *buf, char etag[HTTPD_STATIC_ETAG_LEN + 1])
+{
+    struct httpd_static_etag *entry = NULL;
+    uint64_t hash = 0;
+    bool hit = false;
+
+    httpd_os_sem_take(st->lock);
+    for (unsigned i = 0; i < st->etag_count; i++) {
+        if (st->etags[i].path && strcmp(st->etags[i].path, path) == 0) {
+            entry = &st->etags[i];
+            hit = (entry->mtime == sb->st_mtime && entry->size == sb->st_size);
+            hash = entry->hash;
+            break;
+        }
+    }
+    httpd_os_sem_give(st->lock);
+
+    if (!hit) {
+        ESP_LOGD(TAG, LOG_FMT("hashing %s"), path);
+        if (httpd_static_hash(fd, buf, st->read_size, &hash) != ESP_OK) {
+            return ESP_FAIL;
+        }
+
+        /* Another task may have stored it meanwhile, which does no harm */
+        char *copy = entry ? NULL : strdup(path);
+        httpd_os_sem_take(st->lock);
+        if (entry == NULL && copy != NULL) {
+            entry = &st->etags[st->etag_next];
+            st->etag_next = (st->etag_next + 1) % st->etag_count;
+            free(entry->path);
+            entry->path = copy;
+        }
+        if (entry != NULL && entry->path != NULL && strcmp(entry->path, path) == 0) {
+            entry->mtime = sb->st_mtime;
+            entry->size = sb->st_size;
+            entry->hash = hash;
+        }
+        httpd_os_sem_give(st->lock);
+    }
+
+    static const char hex[] = "0123456789abcdef";
+    etag[0] = '"';
+    for (int i = 0; i < 16; i++) {
+        etag[1 + i] = hex[(hash >> (60 - 4 * i)) & 0xf];
+    }
+    etag[HTTPD_STATIC_ETAG_LEN - 1] = '"';
+    etag[HTTPD_STATIC_ETAG_LEN] = '\0';
+    return ESP_OK;
+}
+
+/* Sends the content of the file, the first read going out together with the head */
+static esp_err_t httpd_static_send(struct httpd_static *st, httpd_req_t *req, int fd, size_t size, char *buf)
+{
+    size_t sent = 0;
+
+    do {
+        ssize_t len = read(fd, buf, MIN(st->read_size, size - sent));
+        if (len < 0 || (len == 0 && size > 0)) {
+            /* Content-Length can't be taken back, so the connection is closed */
+            ESP_LOGE(TAG, LOG_FMT("error reading file"));
+            return ESP_FAIL;
+        }
+        if (sent == 0) {
+            httpd_iov_t iov = { .buf = buf, .len = len };
+            if (httpd_resp_send_head(req, size, &iov, 1) != ESP_OK) {
+                return ESP_FAIL;
+            }
+        } else if (httpd_send_all(req, buf, len) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        sent += len;
+    } while (sent < size);
+    return ESP_OK;
+}
+
+static esp_err_t httpd_static_handler(httpd_req_t *req)
+{
+    struct httpd_static *st = req->user_ctx;
+    struct httpd_req_aux *ra = req->aux;
+    /* The path past the prefix, as captured by the trailing '*' of the
+     * pattern from the path of the URI, which may be in absolute form */
+    const struct path_param *tail = &ra->path_params[ra->path_params_count - 1];
+    const char *uri = tail->value;
+    size_t uri_len = tail->len;
+    size_t base_len = strlen(st->base_path);
+    size_t index_len = st->index_file ? strlen(st->index_file) : 0;
+
+    char *path = malloc(base_len + 1 + uri_len + index_len + sizeof(HTTPD_STATIC_GZIP_EXT));
+    char *buf = malloc(st->read_size);
+    if (path == NULL || buf == NULL) {
+        free(path);
+        free(buf);
+        return httpd_resp_send_500(req);
+    }
+
+    /* Path of the file in the base directory */
+    memcpy(path, st->base_path, base_len);
+    path[base_len] = '/';
+    int path_len = httpd_static_decode(path, base_len + 1, uri, uri_len);
+    if (path_len >= 0 && path[path_len - 1] == '/') {
+        if (st->index_file) {
+            memcpy(path + path_len, st->index_file, index_len + 1);
+            path_len += index_len;
+        } else {
+            path_len = -1;
+        }
+    }
+
+    int fd = -1;
+    bool gzip = false;
+    if (path_len >= 0) {
+        /* Pre-compressed content is preferred */
+        if (httpd_static_hdr_has(req, "Accept-Encoding", "gzip")) {
+            memcpy(path + path_len, HTTPD_STATIC_GZIP_EXT, sizeof(HTTPD_STATIC_GZIP_EXT));
+            fd = open(path, O_RDONLY);
+            gzip = (fd >= 0);
+            path[path_len] = '\0';
+        }
+        if (fd < 0) {
+            fd = open(path, O_RDONLY);
+        }
+    }
+
+    struct stat sb;
+    if (fd < 0 || fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode)) {
+        ESP_LOGD(TAG, LOG_FMT("no file for %s"), req->uri);
+        if (fd >= 0) {
+            close(fd);
+        }
+        free(path);
+        free(buf);
+        return httpd_resp_send_404(req);
+    }
+
+    char etag[HTTPD_STATIC_ETAG_LEN + 1];
+    esp_err_t ret = ESP_OK;
+    if (st->etag_count > 0) {
+        if (gzip) {
+            memcpy(path + path_len, HTTPD_STATIC_GZIP_EXT, sizeof(HTTPD_STATIC_GZIP_EXT));
+        }
+        ret = httpd_static_etag(st, path, fd, &sb, buf, etag);
+        path[path_len] = '\0';
+    }
+
+    if (ret == ESP_OK) {
+        httpd_resp_set_type(req, httpd_static_type(path));
+        /* Responses differ with the encodings accepted, if only by their ETag */
+        httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+        if (gzip) {
+            httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+        }
+        if (st->cache_control) {
+            httpd_resp_set_hdr(req, "Cache-Control", st->cache_control);
+        }
+        if (st->etag_count > 0) {
+            httpd_resp_set_hdr(req, "ETag", etag);
+        }
+
+        if (st->etag_count > 0 && httpd_static_hdr_has(req, "If-None-Match", etag)) {
+            /* Cached copy of the client is still valid */
+            httpd_resp_set_status(req, "304 Not Modified");
+            ret = httpd_resp_send(req, NULL, 0);
+        } else {
+            ret = httpd_static_send(st, req, fd, sb.st_size, buf);
+        }
+    }
+
+    close(fd);
+    free(path);
+    free(buf);
+    return ret;
+}
+
+esp_err_t httpd_register_static(httpd_handle_t handle, const httpd_static_config_t *config)
+{
+    if (handle == NULL || config == NULL || config->uri_prefix == NULL ||
+        config->base_path == NULL || config->read_size < HTTPD_STATIC_READ_ALIGN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct httpd_data *hd = (struct httpd_data *) handle;
+    struct httpd_static *st = calloc(1, sizeof(struct httpd_static) +
+                                     config->etag_cache_size * sizeof(struct httpd_static_etag));
+    if (st == NULL) {
+        return ESP_ERR_HTTPD_ALLOC_MEM;
+    }
+
+    /* Files are matched by the wildcard after the prefix */
+    size_t prefix_len = strlen(config->uri_prefix);
+    while (prefix_len > 0 && config->uri_prefix[prefix_len - 1] == '/') {
+        prefix_len--;
+    }
+    st->uri = malloc(prefix_len + sizeof("/*"));
+    if (st->uri) {
+        memcpy(st->uri, config->uri_prefix, prefix_len);
+        memcpy(st->uri + prefix_len, "/*", sizeof("/*"));
+    }
+    st->prefix_len    = prefix_len + 1;
+    st->base_path     = strdup(config->base_path);
+    st->index_file    = config->index_file ? strdup(config->index_file) : NULL;
+    st->cache_control = config->cache_control ? strdup(config->cache_control) : NULL;
+    st->read_size     = config->read_size - config->read_size % HTTPD_STATIC_READ_ALIGN;
+    st->etag_count    = config->etag_cache_size;
+    if (st->uri == NULL || st->base_path == NULL ||
+        (config->index_file && st->index_file == NULL) ||
+        (config->cache_control && st->cache_control == NULL) ||
+        httpd_os_sem_create(&st->lock) != OS_SUCCESS) {
+        httpd_static_free(st);
+        return ESP_ERR_HTTPD_ALLOC_MEM;
+    }
+    httpd_os_sem_give(st->lock);
+
+    httpd_uri_t uri = {
+        .uri      = st->uri,
+        .method   = HTTP_GET,
+        .handler  = httpd_static_handler,
+        .user_ctx = st,
+    };
+    esp_err_t ret = httpd_register_uri_handler(handle, &uri);
+    if (ret != ESP_OK) {
+        httpd_static_free(st);
+        return ret;
+    }
+
+    ESP_LOGD(TAG, LOG_FMT("serving %s from %s"), st->uri, st->base_path);
+    st->next = hd->hd_static;
+    hd->hd_static = st;
+    return ESP_OK;
+}
+
+esp_err_t httpd_unregister_static(httpd_handle_t handle, const char *uri_prefix)
+{
+    if (handle == NULL || uri_prefix == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct httpd_data *hd = (struct httpd_data *) handle;
+    size_t prefix_len = strlen(uri_prefix);
+    while (prefix_len > 0 && uri_prefix[prefix_len - 1] == '/') {
+        prefix_len--;
+    }
+
+    for (struct httpd_static **prev = &hd->hd_static; *prev; prev = &(*prev)->next) {
+        struct httpd_static *st = *prev;
+        if (st->prefix_len == prefix_len + 1 && strncmp(st->uri, uri_prefix, prefix_len) == 0) {
+            esp_err_t ret = httpd_unregister_uri_handler(handle, st->uri, HTTP_GET);
+            if (ret != ESP_OK && ret != ESP_ERR_NOT_FOUND) {
+                return ret;
+            }
+            *prev = st->next;
+            httpd_static_free(st);
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+void httpd_static_unregister_all(struct httpd_data *hd)
+{
+    while (hd->hd_static) {
+        struct httpd_static *st = hd->hd_static;
+        hd->hd_static = st->next;
+        httpd_static_free(st);
+    }
+}
@@ -22,6 +22,11 @@
 
 static const char *TAG = "httpd_txrx";
 
+/* Largest number of buffers gathered into one sendmsg() call */
+#define HTTPD_IOV_MAX   8
+
+static int httpd_sock_err(const char *ctx, int sockfd);
+
 esp_err_t httpd_sess_set_send_override(httpd_handle_t hd, int sockfd, httpd_send_func_t send_func)
 {
     struct sock_db *sess = httpd_sess_get(hd, sockfd);
@@ -71,7 +76,7 @@ int httpd_send(httpd_req_t *r, const char *buf, size_t buf_len)
     return ret;
 }
 
-static esp_err_t httpd_send_all(httpd_req_t *r, const char *buf, size_t buf_len)
+esp_err_t httpd_send_all(httpd_req_t *r, const char *buf, size_t buf_len)
 {
     struct httpd_req_aux *ra = r->aux;
     int ret;
@@ -231,69 +236,183 @@ esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type)
     return ESP_OK;
 }
 
-esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len)
+/* Appends to the response head being collected in the scratch buffer,
+ * sending out what has been collected so far if it would overflow */
+static esp_err_t httpd_resp_head_append(httpd_req_t *r, size_t *head_len, const char *str)
 {
-    if (r == NULL) {
-        return ESP_ERR_INVALID_ARG;
+    struct httpd_req_aux *ra = r->aux;
+    size_t len = strlen(str);
+
+    if (*head_len + len > HTTPD_SCRATCH_BUF) {
+        if (httpd_send_all(r, ra->scratch, *head_len) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        *head_len = 0;
+        if (len > HTTPD_SCRATCH_BUF) {
+            return httpd_send_all(r, str, len);
+        }
     }
+    memcpy(ra->scratch + *head_len, str, len);
+    *head_len += len;
+    return ESP_OK;
+}
 
-    if (!httpd_valid_req(r)) {
-        return ESP_ERR_HTTPD_INVALID_REQ;
+/* Appends the additional headers set by the handler and the end of
+ * the header section to the essential headers in the scratch buffer */
+static esp_err_t httpd_resp_head_finish(httpd_req_t *r, size_t *head_len)
+{
+    struct httpd_req_aux *ra = r->aux;
+
+    for (unsigned i = 0; i < ra->resp_hdrs_count; i++) {
+        if (httpd_resp_head_append(r, head_len, ra->resp_hdrs[i].field) != ESP_OK ||
+            httpd_resp_head_append(r, head_len, ": ") != ESP_OK ||
+            httpd_resp_head_append(r, head_len, ra->resp_hdrs[i].value) != ESP_OK ||
+            httpd_resp_head_append(r, head_len, "\r\n") != ESP_OK) {
+            return ESP_FAIL;
+        }
     }
+    return httpd_resp_head_append(r, head_len, "\r\n");
+}
 
+/* Sends the buffer followed by the vector. With the default send function
+ * they are gathered into as few sendmsg() calls as possible, while a send
+ * override (e.g. for TLS) gets them one after the other */
+static esp_err_t httpd_send_all_iov(httpd_req_t *r, const char *buf, size_t buf_len,
+                                    const httpd_iov_t *iov, size_t iovcnt)
+{
     struct httpd_req_aux *ra = r->aux;
-    const char *httpd_hdr_str = "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %d\r\n";
-    const char *colon_separator = ": ";
-    const char *cr_lf_seperator = "\r\n";
 
-    if (buf_len == -1) buf_len = strlen(buf);
+    if (ra->sd->send_fn != httpd_default_send) {
+        if (httpd_send_all(r, buf, buf_len) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        for (size_t i = 0; i < iovcnt; i++) {
+            if (httpd_send_all(r, iov[i].buf, iov[i].len) != ESP_OK) {
+                return ESP_FAIL;
+            }
+        }
+        return ESP_OK;
+    }
+
+    while (buf_len > 0 || iovcnt > 0) {
+        struct iovec vec[HTTPD_IOV_MAX];
+        struct msghdr msg = { 0 };
+        size_t cnt = 0;
+
+        if (buf_len > 0) {
+            vec[cnt].iov_base = (void *) buf;
+            vec[cnt++].iov_len = buf_len;
+        }
+        for (size_t i = 0; i < iovcnt && cnt < HTTPD_IOV_MAX; i++) {
+            vec[cnt].iov_base = (void *) iov[i].buf;
+            vec[cnt++].iov_len = iov[i].len;
+        }
+        msg.msg_iov = vec;
+        msg.msg_iovlen = cnt;
+
+        int ret = sendmsg(ra->sd->fd, &msg, 0);
+        if (ret < 0) {
+            httpd_sock_err("sendmsg", ra->sd->fd);
+            return ESP_FAIL;
+        }
+        ESP_LOGD(TAG, LOG_FMT("sent = %d"), ret);
+
+        /* Skip what went out, the rest of a partially sent
+         * element becomes the buffer sent first next time */
+        size_t sent = MIN((size_t) ret, buf_len);
+        buf      += sent;
+        buf_len  -= sent;
+        sent      = ret - sent;
+        while (iovcnt > 0 && sent >= iov->len) {
+            sent -= iov->len;
+            iov++;
+            iovcnt--;
+        }
+        if (sent > 0) {
+            buf     = iov->buf + sent;
+            buf_len = iov->len - sent;
+            iov++;
+            iovcnt--;
+        }
+    }
+    return ESP_OK;
+}
+
+/* Sends the response head collected in the scratch buffer followed by the
+ * vector. Elements which still fit are copied behind the head, so that a
+ * small response goes out in a single write */
+static esp_err_t httpd_resp_flush(httpd_req_t *r, size_t head_len, const httpd_iov_t *iov, size_t iovcnt)
+{
+    struct httpd_req_aux *ra = r->aux;
+
+    while (iovcnt > 0 && head_len + iov->len <= HTTPD_SCRATCH_BUF) {
+        if (iov->len > 0) {
+            memcpy(ra->scratch + head_len, iov->buf, iov->len);
+        }
+        head_len += iov->len;
+        iov++;
+        iovcnt--;
+    }
+    return httpd_send_all_iov(r, ra->scratch, head_len, iov, iovcnt);
+}
+
+esp_err_t httpd_resp_send_head(httpd_req_t *r, size_t content_len, const httpd_iov_t *iov, size_t iovcnt)
+{
+    struct httpd_req_aux *ra = r->aux;
+    const char *httpd_hdr_str = "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %u\r\n";
 
     /* Request headers are no longer available */
     ra->req_hdrs_count = 0;
 
     /* Size of essential headers is limited by scratch buffer size */
-    if (snprintf(ra->scratch, sizeof(ra->scratch), httpd_hdr_str,
-                 ra->status, ra->content_type, buf_len) >= sizeof(ra->scratch)) {
+    int head_len = snprintf(ra->scratch, sizeof(ra->scratch), httpd_hdr_str,
+                            ra->status, ra->content_type, (unsigned int) content_len);
+    if (head_len < 0 || head_len >= sizeof(ra->scratch)) {
         return ESP_ERR_HTTPD_RESP_HDR;
     }
 
-    /* Sending essential headers */
-    if (httpd_send_all(r, ra->scratch, strlen(ra->scratch)) != ESP_OK) {
+    /* Headers and content are coalesced into as few writes as possible */
+    size_t len = head_len;
+    if (httpd_resp_head_finish(r, &len) != ESP_OK ||
+        httpd_resp_flush(r, len, iov, iovcnt) != ESP_OK) {
         return ESP_ERR_HTTPD_RESP_SEND;
     }
+    return ESP_OK;
+}
 
-    /* Sending additional headers based on set_header */
-    for (unsigned i = 0; i < ra->resp_hdrs_count; i++) {
-        /* Send header field */
-        if (httpd_send_all(r, ra->resp_hdrs[i].field, strlen(ra->resp_hdrs[i].field)) != ESP_OK) {
-            return ESP_ERR_HTTPD_RESP_SEND;
-        }
-        /* Send ': ' */
-        if (httpd_send_all(r, colon_separator, strlen(colon_separator)) != ESP_OK) {
-            return ESP_ERR_HTTPD_RESP_SEND;
-        }
-        /* Send header value */
-        if (httpd_send_all(r, ra->resp_hdrs[i].value, strlen(ra->resp_hdrs[i].value)) != ESP_OK) {
-            return ESP_ERR_HTTPD_RESP_SEND;
-        }
-        /* Send CR + LF */
-        if (httpd_send_all(r, cr_lf_seperator, strlen(cr_lf_seperator)) != ESP_OK) {
-            return ESP_ERR_HTTPD_RESP_SEND;
-        }
+esp_err_t httpd_resp_sendv(httpd_req_t *r, const httpd_iov_t *iov, size_t iovcnt)
+{
+    if (r == NULL || (iov == NULL && iovcnt > 0)) {
+        return ESP_ERR_INVALID_ARG;
     }
 
-    /* End header section */
-    if (httpd_send_all(r, cr_lf_seperator, strlen(cr_lf_seperator)) != ESP_OK) {
-        return ESP_ERR_HTTPD_RESP_SEND;
+    if (!httpd_valid_req(r)) {
+        return ESP_ERR_HTTPD_INVALID_REQ;
     }
 
-    /* Sending content */
-    if (buf && buf_len) {
-        if (httpd_send_all(r, buf, buf_len) != ESP_OK) {
-            return ESP_ERR_HTTPD_RESP_SEND;
+    size_t content_len = 0;
+    for (size_t i = 0; i < iovcnt; i++) {
+        if (iov[i].buf == NULL && iov[i].len > 0) {
+            return ESP_ERR_INVALID_ARG;
         }
+        content_len += iov[i].len;
     }
-    return ESP_OK;
+    return httpd_resp_send_head(r, content_len, iov, iovcnt);
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len)
+{
+    if (r == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (buf_len == -1) buf_len = strlen(buf);
+
+    httpd_iov_t iov = {
+        .buf = buf,
+        .len = buf ? buf_len : 0
+    };
+    return httpd_resp_sendv(r, &iov, 1);
 }
 
 esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len)
@@ -310,66 +429,36 @@ esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len
 
     struct httpd_req_aux *ra = r->aux;
     const char *httpd_chunked_hdr_str = "HTTP/1.1 %s\r\nContent-Type: %s\r\nTransfer-Encoding: chunked\r\n";
-    const char *colon_separator = ": ";
-    const char *cr_lf_seperator = "\r\n";
+    size_t head_len = 0;
 
     /* Request headers are no longer available */
     ra->req_hdrs_count = 0;
 
     if (!ra->first_chunk_sent) {
         /* Size of essential headers is limited by scratch buffer size */
-        if (snprintf(ra->scratch, sizeof(ra->scratch), httpd_chunked_hdr_str,
-                     ra->status, ra->content_type) >= sizeof(ra->scratch)) {
+        int ret = snprintf(ra->scratch, sizeof(ra->scratch), httpd_chunked_hdr_str,
+                           ra->status, ra->content_type);
+        if (ret < 0 || ret >= sizeof(ra->scratch)) {
             return ESP_ERR_HTTPD_RESP_HDR;
         }
 
-        /* Sending essential headers */
-        if (httpd_send_all(r, ra->scratch, strlen(ra->scratch)) != ESP_OK) {
-            return ESP_ERR_HTTPD_RESP_SEND;
-        }
-
-        /* Sending additional headers based on set_header */
-        for (unsigned i = 0; i < ra->resp_hdrs_count; i++) {
-            /* Send header field */
-            if (httpd_send_all(r, ra->resp_hdrs[i].field, strlen(ra->resp_hdrs[i].field)) != ESP_OK) {
-                return ESP_ERR_HTTPD_RESP_SEND;
-            }
-            /* Send ': ' */
-            if (httpd_send_all(r, colon_separator, strlen(colon_separator)) != ESP_OK) {
-                return ESP_ERR_HTTPD_RESP_SEND;
-            }
-            /* Send header value */
-            if (httpd_send_all(r, ra->resp_hdrs[i].value, strlen(ra->resp_hdrs[i].value)) != ESP_OK) {
-                return ESP_ERR_HTTPD_RESP_SEND;
-            }
-            /* Send CR + LF */
-            if (httpd_send_all(r, cr_lf_seperator, strlen(cr_lf_seperator)) != ESP_OK) {
-                return ESP_ERR_HTTPD_RESP_SEND;
-            }
-        }
-
-        /* End header section */
-        if (httpd_send_all(r, cr_lf_seperator, strlen(cr_lf_seperator)) != ESP_OK) {
+        head_len = ret;
+        if (httpd_resp_head_finish(r, &head_len) != ESP_OK) {
             return ESP_ERR_HTTPD_RESP_SEND;
         }
         ra->first_chunk_sent = true;
     }
 
-    /* Sending chunked content */
+    /* Chunk size, chunked content and end of chunk go out
+     * together, along with the headers in case of the first one */
     char len_str[10];
-    snprintf(len_str, sizeof(len_str), "%x\r\n", buf_len);
-    if (httpd_send_all(r, len_str, strlen(len_str)) != ESP_OK) {
-        return ESP_ERR_HTTPD_RESP_SEND;
-    }
-
-    if (buf) {
-        if (httpd_send_all(r, buf, (size_t) buf_len) != ESP_OK) {
-            return ESP_ERR_HTTPD_RESP_SEND;
-        }
-    }
-
-    /* Indicate end of chunk */
-    if (httpd_send_all(r, "\r\n", strlen("\r\n")) != ESP_OK) {
+    snprintf(len_str, sizeof(len_str), "%x\r\n", (unsigned int) buf_len);
+    const httpd_iov_t chunk[] = {
+        { .buf = len_str, .len = strlen(len_str) },
+        { .buf = buf,     .len = buf ? buf_len : 0 },
+        { .buf = "\r\n",  .len = 2 }
+    };
+    if (httpd_resp_flush(r, head_len, chunk, sizeof(chunk) / sizeof(chunk[0])) != ESP_OK) {
         return ESP_ERR_HTTPD_RESP_SEND;
     }
     return ESP_OK;
@@ -499,7 +588,7 @@ static int httpd_sock_err(const char *ctx, int sockfd)
 {
     int errval;
     int sock_err;
-    size_t sock_err_len = sizeof(sock_err);
+    socklen_t sock_err_len = sizeof(sock_err);
 
     if (getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &sock_err, &sock_err_len) < 0) {
         ESP_LOGE(TAG, LOG_FMT("error calling getsockopt : %d"), errno);
@@ -23,6 +23,302 @@
 
 static const char *TAG = "httpd_uri";
 
+/**
+ * @brief   Handler registered for a URI pattern
+ */
+struct httpd_uri_route {
+    httpd_uri_t            *uri;        /*!< Registered URI handler */
+    struct httpd_uri_route *next;       /*!< Next handler of the same pattern, for another method */
+};
+
+/**
+ * @brief   Node of the prefix tree which routes request paths to URI handlers
+ *
+ * The static parts of the URI patterns form the edges of a radix tree, their
+ * labels pointing into the registered pattern strings. A {capture} is a child
+ * of its own, while a trailing '*' ends at the node of the prefix before it.
+ */
+struct httpd_uri_node {
+    const char             *label;      /*!< Characters of the path matched by this node */
+    size_t                  label_len;  /*!< Length of the label */
+    struct httpd_uri_node  *child;      /*!< First static child, each one begins with a different character */
+    struct httpd_uri_node  *sibling;    /*!< Next static child of the same parent */
+    struct httpd_uri_node  *param;      /*!< Child matching a capture up to the next '/' */
+    struct httpd_uri_route *routes;     /*!< Handlers of the patterns ending at this node */
+    struct httpd_uri_route *wildcard;   /*!< Handlers of the patterns ending at this node with a '*' */
+};
+
+/**
+ * @brief   Router compiled from the URI handlers
+ *
+ * It is replaced as a whole whenever a handler is registered or unregistered,
+ * while the requests already routed through it may still be running their
+ * handlers. So the server holds a reference to its current router and each
+ * request being processed another one, the router being freed along with the
+ * handlers unregistered by its replacement once all of them are dropped.
+ */
+struct httpd_uri_router {
+    struct httpd_uri_node  *root;       /*!< Root of the prefix tree */
+    unsigned                refs;       /*!< References held, counted under hd_router_lock */
+    struct httpd_uri_route *retired;    /*!< Handlers unregistered when it was replaced */
+};
+
+/* Checks the captures of a URI pattern, which have to span whole
+ * path segments, and the limit on their number */
+static bool httpd_uri_pattern_valid(const char *uri)
+{
+    unsigned captures = 0;
+
+    for (const char *p = uri; *p != '\0'; p++) {
+        if (*p == '*' && p[1] == '\0') {
+            captures++;
+        } else if (*p == '{') {
+            if (p != uri && p[-1] != '/') {
+                return false;
+            }
+            size_t name_len = strcspn(p + 1, "{}/");
+            if (name_len == 0 || p[name_len + 1] != '}') {
+                return false;
+            }
+            p += name_len + 2;
+            if (*p != '/' && *p != '\0') {
+                return false;
+            }
+            p--;
+            captures++;
+        } else if (*p == '}') {
+            return false;
+        }
+    }
+    return captures <= HTTPD_MAX_PATH_PARAMS;
+}
+
+static void httpd_uri_node_free(struct httpd_uri_node *node)
+{
+    while (node) {
+        struct httpd_uri_node *sibling = node->sibling;
+        struct httpd_uri_route *route;
+
+        httpd_uri_node_free(node->child);
+        httpd_uri_node_free(node->param);
+        while ((route = node->routes) != NULL) {
+            node->routes = route->next;
+            free(route);
+        }
+        while ((route = node->wildcard) != NULL) {
+            node->wildcard = route->next;
+            free(route);
+        }
+        free(node);
+        node = sibling;
+    }
+}
+
+static esp_err_t httpd_uri_route_add(struct httpd_uri_route **routes, httpd_uri_t *uri)
+{
+    struct httpd_uri_route *route = malloc(sizeof(struct httpd_uri_route));
+    if (route == NULL) {
+        return ESP_ERR_HTTPD_ALLOC_MEM;
+    }
+    route->uri  = uri;
+    route->next = *routes;
+    *routes = route;
+    return ESP_OK;
+}
+
+/* Splits the label of a node, the node keeping its first len characters
+ * and a new child taking over the rest along with all its descendants */
+static esp_err_t httpd_uri_node_split(struct httpd_uri_node *node, size_t len)
+{
+    struct httpd_uri_node *tail = malloc(sizeof(struct httpd_uri_node));
+    if (tail == NULL) {
+        return ESP_ERR_HTTPD_ALLOC_MEM;
+    }
+    *tail = *node;
+    tail->label     += len;
+    tail->label_len -= len;
+    tail->sibling    = NULL;
+
+    node->label_len = len;
+    node->child     = tail;
+    node->param     = NULL;
+    node->routes    = NULL;
+    node->wildcard  = NULL;
+    return ESP_OK;
+}
+
+static esp_err_t httpd_uri_node_insert(struct httpd_uri_node *node, httpd_uri_t *uri)
+{
+    const char *p = uri->uri;
+
+    while (true) {
+        if (*p == '\0') {
+            return httpd_uri_route_add(&node->routes, uri);
+        }
+        if (p[0] == '*' && p[1] == '\0') {
+            return httpd_uri_route_add(&node->wildcard, uri);
+        }
+        if (*p == '{') {
+            if (node->param == NULL) {
+                node->param = calloc(1, sizeof(struct httpd_uri_node));
+                if (node->param == NULL) {
+                    return ESP_ERR_HTTPD_ALLOC_MEM;
+                }
+            }
+            node = node->param;
+            p = strchr(p, '}') + 1;
+            continue;
+        }
+
+        /* Static part of the pattern, up to the next capture or the trailing '*' */
+        size_t len = strcspn(p, "{");
+        if (p[len] == '\0' && p[len - 1] == '*') {
+            len--;
+        }
+
+        struct httpd_uri_node *child = node->child;
+        while (child && child->label[0] != p[0]) {
+            child = child->sibling;
+        }
+        if (child == NULL) {
+            child = calloc(1, sizeof(struct httpd_uri_node));
+            if (child == NULL) {
+                return ESP_ERR_HTTPD_ALLOC_MEM;
+            }
+            child->label     = p;
+            child->label_len = len;
+            child->sibling   = node->child;
+            node->child = child;
+            node = child;
+            p += len;
+            continue;
+        }
+
+        size_t common = 1;
+        while (common < len && common < child->label_len &&
+               child->label[common] == p[common]) {
+            common++;
+        }
+        if (common < child->label_len &&
+            httpd_uri_node_split(child, common) != ESP_OK) {
+            return ESP_ERR_HTTPD_ALLOC_MEM;
+        }
+        node = child;
+        p += common;
+    }
+}
+
+/* Frees a router, along with the handlers retired by its replacement
+ * if free_handlers is set */
+static void httpd_uri_router_free(struct httpd_uri_router *router, bool free_handlers)
+{
+    struct httpd_uri_route *route;
+
+    while ((route = router->retired) != NULL) {
+        router->retired = route->next;
+        if (free_handlers) {
+            ESP_LOGD(TAG, LOG_FMT("removing %s"), route->uri->uri);
+            free((char*)route->uri->uri);
+            free(route->uri);
+        }
+        free(route);
+    }
+    httpd_uri_node_free(router->root);
+    free(router);
+}
+
+/* Takes a reference to the current router, NULL if there's none */
+static struct httpd_uri_router *httpd_uri_router_get(struct httpd_data *hd)
+{
+    httpd_os_sem_take(hd->hd_router_lock);
+    struct httpd_uri_router *router = hd->hd_router;
+    if (router) {
+        router->refs++;
+    }
+    httpd_os_sem_give(hd->hd_router_lock);
+    return router;
+}
+
+/* Drops a reference to a router, freeing it with the last one */
+static void httpd_uri_router_put(struct httpd_data *hd, struct httpd_uri_router *router)
+{
+    if (router == NULL) {
+        return;
+    }
+    httpd_os_sem_take(hd->hd_router_lock);
+    unsigned refs = --router->refs;
+    httpd_os_sem_give(hd->hd_router_lock);
+    if (refs == 0) {
+        httpd_uri_router_free(router, true);
+    }
+}
+
+static bool httpd_uri_skipped(const httpd_uri_t *uri, const char *skip_uri,
+                              const httpd_method_t *skip_method)
+{
+    return skip_uri && strcmp(uri->uri, skip_uri) == 0 &&
+           (skip_method == NULL || uri->method == *skip_method);
+}
+
+/* Compiles the router from the registered URI handlers, leaving out those
+ * with the given URI (and method, if not NULL), which are removed from the
+ * server and freed with the previous router. The previous router is kept
+ * if it fails */
+static esp_err_t httpd_uri_router_build(struct httpd_data *hd, const char *skip_uri,
+                                        const httpd_method_t *skip_method)
+{
+    struct httpd_uri_router *router = calloc(1, sizeof(struct httpd_uri_router));
+    struct httpd_uri_node *root = calloc(1, sizeof(struct httpd_uri_node));
+    if (router == NULL || root == NULL) {
+        free(root);
+        free(router);
+        return ESP_ERR_HTTPD_ALLOC_MEM;
+    }
+    root->label  = "";
+    router->root = root;
+    router->refs = 1;
+
+    for (int i = 0; i < hd->config.max_uri_handlers; i++) {
+        httpd_uri_t *uri = hd->hd_calls[i];
+        if (uri == NULL) {
+            continue;
+        }
+        /* Handlers left out are kept aside until the router is installed */
+        esp_err_t ret = httpd_uri_skipped(uri, skip_uri, skip_method) ?
+                        httpd_uri_route_add(&router->retired, uri) :
+                        httpd_uri_node_insert(root, uri);
+        if (ret != ESP_OK) {
+            httpd_uri_router_free(router, false);
+            return ESP_ERR_HTTPD_ALLOC_MEM;
+        }
+    }
+    if (skip_uri && router->retired == NULL) {
+        httpd_uri_router_free(router, false);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    for (int i = 0; i < hd->config.max_uri_handlers; i++) {
+        if (hd->hd_calls[i] && httpd_uri_skipped(hd->hd_calls[i], skip_uri, skip_method)) {
+            hd->hd_calls[i] = NULL;
+        }
+    }
+
+    /* Requests routed from now on use the new router, and the handlers
+     * left out are freed once those routed through the previous one,
+     * which may still refer to them, are done */
+    httpd_os_sem_take(hd->hd_router_lock);
+    struct httpd_uri_router *prev = hd->hd_router;
+    if (prev) {
+        prev->retired = router->retired;
+    }
+    router->retired = NULL;
+    hd->hd_router = router;
+    httpd_os_sem_give(hd->hd_router_lock);
+
+    httpd_uri_router_put(hd, prev);
+    return ESP_OK;
+}
+
 static int httpd_find_uri_handler(struct httpd_data *hd,
                                   const char* uri,
                                   httpd_method_t method)
@@ -48,6 +344,11 @@ esp_err_t httpd_register_uri_handler(httpd_handle_t handle,
 
     struct httpd_data *hd = (struct httpd_data *) handle;
 
+    if (!httpd_uri_pattern_valid(uri_handler->uri)) {
+        ESP_LOGW(TAG, LOG_FMT("invalid URI pattern %s"), uri_handler->uri);
+        return ESP_ERR_INVALID_ARG;
+    }
+
     /* Make sure another handler with same URI and method
      * is not already registered
      */
@@ -78,6 +379,18 @@ esp_err_t httpd_register_uri_handler(httpd_handle_t handle,
             hd->hd_calls[i]->method   = uri_handler->method;
             hd->hd_calls[i]->handler  = uri_handler->handler;
             hd->hd_calls[i]->user_ctx = uri_handler->user_ctx;
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+            hd->hd_calls[i]->is_websocket = uri_handler->is_websocket;
+            hd->hd_calls[i]->handle_ws_control_frames = uri_handler->handle_ws_control_frames;
+#endif
+
+            /* Recompile the router with the new handler */
+            if (httpd_uri_router_build(hd, NULL, NULL) != ESP_OK) {
+                free((char*)hd->hd_calls[i]->uri);
+                free(hd->hd_calls[i]);
+                hd->hd_calls[i] = NULL;
+                return ESP_ERR_HTTPD_ALLOC_MEM;
+            }
             ESP_LOGD(TAG, LOG_FMT("[%d] installed %s"), i, uri_handler->uri);
             return ESP_OK;
         }
@@ -95,18 +408,14 @@ esp_err_t httpd_unregister_uri_handler(httpd_handle_t handle,
     }
 
     struct httpd_data *hd = (struct httpd_data *) handle;
-    int i = httpd_find_uri_handler(hd, uri, method);
-
-    if (i != -1) {
-        ESP_LOGD(TAG, LOG_FMT("[%d] removing %s"), i, hd->hd_calls[i]->uri);
 
-        free((char*)hd->hd_calls[i]->uri);
-        free(hd->hd_calls[i]);
-        hd->hd_calls[i] = NULL;
-        return ESP_OK;
+    if (httpd_find_uri_handler(hd, uri, method) == -1) {
+        ESP_LOGW(TAG, LOG_FMT("handler %s with method %d not found"), uri, method);
+        return ESP_ERR_NOT_FOUND;
     }
-    ESP_LOGW(TAG, LOG_FMT("handler %s with method %d not found"), uri, method);
-    return ESP_ERR_NOT_FOUND;
+
+    /* The handler is freed once no request is routed to it any more */
+    return httpd_uri_router_build(hd, uri, &method);
 }
 
 esp_err_t httpd_unregister_uri(httpd_handle_t handle, const char *uri)
@@ -116,27 +425,22 @@ esp_err_t httpd_unregister_uri(httpd_handle_t handle, const char *uri)
     }
 
     struct httpd_data *hd = (struct httpd_data *) handle;
-    bool found = false;
 
-    for (int i = 0; i < hd->config.max_uri_handlers; i++) {
-        if ((hd->hd_calls[i] != NULL) &&
-            (strcmp(hd->hd_calls[i]->uri, uri) == 0)) {
-            ESP_LOGD(TAG, LOG_FMT("[%d] removing %s"), i, uri);
-
-            free((char*)hd->hd_calls[i]->uri);
-            free(hd->hd_calls[i]);
-            hd->hd_calls[i] = NULL;
-            found = true;
-        }
-    }
-    if (!found) {
+    esp_err_t ret = httpd_uri_router_build(hd, uri, NULL);
+    if (ret == ESP_ERR_NOT_FOUND) {
         ESP_LOGW(TAG, LOG_FMT("no handler found for URI %s"), uri);
     }
-    return (found ? ESP_OK : ESP_ERR_NOT_FOUND);
+    return ret;
 }
 
 void httpd_unregister_all_uri_handlers(struct httpd_data *hd)
 {
+    /* Called once the server has stopped, so no request refers to the router */
+    if (hd->hd_router) {
+        httpd_uri_router_free(hd->hd_router, true);
+        hd->hd_router = NULL;
+    }
+
     for (unsigned i = 0; i < hd->config.max_uri_handlers; i++) {
         if (hd->hd_calls[i]) {
             ESP_LOGD(TAG, LOG_FMT("[%d] removing %s"), i, hd->hd_calls[i]->uri);
@@ -147,43 +451,148 @@ void httpd_unregister_all_uri_handlers(struct httpd_data *hd)
     }
 }
 
-/* Alternate implmentation of httpd_find_uri_handler()
- * which takes a uri_len field. This is useful when the URI
- * string contains extra parameters that are not to be included
- * while matching with the registered URI_handler strings
- */
-static httpd_uri_t* httpd_find_uri_handler2(httpd_err_resp_t *err,
-                                            struct httpd_data *hd,
-                                            const char *uri, size_t uri_len,
-                                            httpd_method_t method)
+static httpd_uri_t *httpd_uri_route_find(const struct httpd_uri_route *route,
+                                         httpd_method_t method, httpd_err_resp_t *err)
 {
-    *err = 0;
-    for (int i = 0; i < hd->config.max_uri_handlers; i++) {
-        if (hd->hd_calls[i]) {
-            ESP_LOGD(TAG, LOG_FMT("[%d] = %s"), i, hd->hd_calls[i]->uri);
-            if ((strlen(hd->hd_calls[i]->uri) == uri_len) &&            // First match uri length
-                (strncmp(hd->hd_calls[i]->uri, uri, uri_len) == 0))  {  // Then match uri strings
-                if (hd->hd_calls[i]->method == method)  {               // Finally match methods
-                    return hd->hd_calls[i];
-                }
-                /* URI found but method not allowed.
-                 * If URI IS found later then this
-                 * error is to be neglected */
-                *err = HTTPD_405_METHOD_NOT_ALLOWED;
+    for (; route != NULL; route = route->next) {
+        if (route->uri->method == method) {
+            return route->uri;
+        }
+        /* URI found but method not allowed.
+         * If URI IS found later then this
+         * error is to be neglected */
+        *err = HTTPD_405_METHOD_NOT_ALLOWED;
+    }
+    return NULL;
+}
+
+/* Walks the path down from a node, whose label has been matched already.
+ * Static children are tried before a capture, and a capture before the
+ * wildcard of the node, backtracking if the rest of the path doesn't match */
+static httpd_uri_t *httpd_uri_node_match(const struct httpd_uri_node *node,
+                                         const char *path, size_t len,
+                                         httpd_method_t method, httpd_err_resp_t *err,
+                                         struct httpd_req_aux *ra)
+{
+    httpd_uri_t *uri;
+
+    if (len == 0 && (uri = httpd_uri_route_find(node->routes, method, err)) != NULL) {
+        return uri;
+    }
+
+    if (len > 0) {
+        const struct httpd_uri_node *child = node->child;
+        while (child && child->label[0] != path[0]) {
+            child = child->sibling;
+        }
+        if (child && child->label_len <= len &&
+            memcmp(child->label, path, child->label_len) == 0 &&
+            (uri = httpd_uri_node_match(child, path + child->label_len, len - child->label_len,
+                                        method, err, ra)) != NULL) {
+            return uri;
+        }
+    }
+
+    if (ra->path_params_count < HTTPD_MAX_PATH_PARAMS) {
+        struct path_param *param = &ra->path_params[ra->path_params_count];
+
+        /* Capture up to the next '/', which mustn't be empty */
+        if (node->param && len > 0 && path[0] != '/') {
+            const char *end = memchr(path, '/', len);
+            param->value = path;
+            param->len   = end ? end - path : len;
+            ra->path_params_count++;
+            uri = httpd_uri_node_match(node->param, path + param->len, len - param->len,
+                                       method, err, ra);
+            if (uri) {
+                return uri;
             }
+            ra->path_params_count--;
+        }
+
+        /* Wildcard takes the rest of the path */
+        if (node->wildcard && (uri = httpd_uri_route_find(node->wildcard, method, err)) != NULL) {
+            param->value = path;
+            param->len   = len;
+            ra->path_params_count++;
+            return uri;
         }
     }
-    if (*err == 0) {
+    return NULL;
+}
+
+/* Looks up the handler for the path of a request in the router,
+ * capturing the path parameters into the request */
+static httpd_uri_t* httpd_find_uri_handler2(httpd_err_resp_t *err,
+                                            struct httpd_uri_router *router,
+                                            httpd_req_t *req,
+                                            const char *uri, size_t uri_len)
+{
+    struct httpd_req_aux *ra = req->aux;
+    httpd_uri_t *found = NULL;
+
+    *err = 0;
+    ra->path_params_count = 0;
+    if (router) {
+        found = httpd_uri_node_match(router->root, uri, uri_len, req->method, err, ra);
+    }
+    if (found) {
+        ra->uri_pattern = found->uri;
+    } else if (*err == 0) {
         *err = HTTPD_404_NOT_FOUND;
     }
-    return NULL;
+    return found;
 }
 
-esp_err_t httpd_uri(struct httpd_data *hd)
+esp_err_t httpd_req_get_path_param(httpd_req_t *r, const char *name, char *val, size_t val_size)
+{
+    if (r == NULL || name == NULL || val == NULL || val_size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!httpd_valid_req(r)) {
+        return ESP_ERR_HTTPD_INVALID_REQ;
+    }
+
+    struct httpd_req_aux *ra = r->aux;
+    const char *p = ra->uri_pattern;
+    size_t name_len = strlen(name);
+    unsigned index = 0;
+
+    /* Captures are numbered in the order they appear in the pattern */
+    while (p && index < ra->path_params_count && (p = strpbrk(p, "{*")) != NULL) {
+        bool match;
+        if (*p == '*') {
+            if (p[1] != '\0') {
+                p++;
+                continue;
+            }
+            match = (strcmp(name, "*") == 0);
+            p++;
+        } else {
+            const char *end = strchr(p, '}');
+            match = ((end - p - 1) == name_len) && (strncmp(p + 1, name, name_len) == 0);
+            p = end + 1;
+        }
+
+        if (match) {
+            const struct path_param *param = &ra->path_params[index];
+            size_t len = MIN(param->len, val_size - 1);
+            memcpy(val, param->value, len);
+            val[len] = '\0';
+            ESP_LOGD(TAG, LOG_FMT("%s = %s"), name, val);
+            return (param->len < val_size) ? ESP_OK : ESP_ERR_HTTPD_RESULT_TRUNC;
+        }
+        index++;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+static esp_err_t httpd_uri_route(struct httpd_uri_router *router, httpd_req_t *req)
 {
     httpd_uri_t            *uri = NULL;
-    httpd_req_t            *req = &hd->hd_req;
-    struct http_parser_url *res = &hd->hd_req_aux.url_parse_res;
+    struct httpd_req_aux   *ra  = req->aux;
+    struct http_parser_url *res = &ra->url_parse_res;
 
     /* For conveying URI not found/method not allowed */
     httpd_err_resp_t err = 0;
@@ -191,10 +600,9 @@ esp_err_t httpd_uri(struct httpd_data *hd)
     ESP_LOGD(TAG, LOG_FMT("request for %s with type %d"), req->uri, req->method);
     /* URL parser result contains offset and length of path string */
     if (res->field_set & (1 << UF_PATH)) {
-        uri = httpd_find_uri_handler2(&err, hd,
+        uri = httpd_find_uri_handler2(&err, router, req,
                                       req->uri + res->field_data[UF_PATH].off,
-                                      res->field_data[UF_PATH].len,
-                                      req->method);
+                                      res->field_data[UF_PATH].len);
     }
 
     /* If URI with method not found, respond with error code */
@@ -214,6 +622,25 @@ esp_err_t httpd_uri(struct httpd_data *hd)
     /* Attach user context data (passed during URI registration) into request */
     req->user_ctx = uri->user_ctx;
 
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    if (ra->ws_handshake_detect) {
+        if (!uri->is_websocket) {
+            ESP_LOGW(TAG, LOG_FMT("URI '%s' is not a WebSocket endpoint"), req->uri);
+            return httpd_resp_send_err(req, HTTPD_XXX_UPGRADE_NOT_SUPPORTED);
+        }
+
+        /* Upgrade the session, its further data being WebSocket frames
+         * passed to this handler, which is called with the request too */
+        if (httpd_ws_respond_server_handshake(req) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        ra->sd->ws_handshake_done = true;
+        ra->sd->ws_handler        = uri->handler;
+        ra->sd->ws_control_frames = uri->handle_ws_control_frames;
+        ra->sd->ws_user_ctx       = uri->user_ctx;
+    }
+#endif
+
     /* Invoke handler */
     if (uri->handler(req) != ESP_OK) {
         /* Handler returns error, this socket should be closed */
@@ -222,3 +649,13 @@ esp_err_t httpd_uri(struct httpd_data *hd)
     }
     return ESP_OK;
 }
+
+esp_err_t httpd_uri(struct httpd_data *hd, httpd_req_t *req)
+{
+    /* The router, and so the handler found in it, are kept until the
+     * handler returns, even if unregistered meanwhile by another task */
+    struct httpd_uri_router *router = httpd_uri_router_get(hd);
+    esp_err_t ret = httpd_uri_route(router, req);
+    httpd_uri_router_put(hd, router);
+    return ret;
+}
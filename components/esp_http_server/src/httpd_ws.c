@@ -0,0 +1,443 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <esp_log.h>
+#include <esp_err.h>
+#include <mbedtls/sha1.h>
+#include <mbedtls/base64.h>
+
+#include <esp_http_server.h>
+#include "esp_httpd_priv.h"
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+
+static const char *TAG = "httpd_ws";
+
+/*
+ * Bit masks for WebSocket frames.
+ * Please refer to RFC6455 Section 5.2 for more details.
+ */
+#define HTTPD_WS_FIN_BIT                0x80U
+#define HTTPD_WS_RSV_BITS               0x70U
+#define HTTPD_WS_OPCODE_BITS            0x0fU
+#define HTTPD_WS_MASK_BIT               0x80U
+#define HTTPD_WS_LENGTH_BITS            0x7fU
+
+/* Longest header of a frame sent by the server, which doesn't mask */
+#define HTTPD_WS_MAX_HDR_LEN            10
+
+/* Payloads up to this length are sent in the same write as the header */
+#define HTTPD_WS_COALESCE_LEN           128
+
+/* Control frames can't be fragmented and carry up to 125 bytes */
+#define HTTPD_WS_CONTROL_MAX_LEN        125
+
+/* Status codes of Close frames, see RFC6455 Section 7.4.1 */
+#define HTTPD_WS_CLOSE_NORMAL           1000
+#define HTTPD_WS_CLOSE_PROTOCOL_ERROR   1002
+#define HTTPD_WS_CLOSE_TOO_BIG          1009
+
+/* Appended to the key of the client to compute the accept key, see RFC6455 Section 1.3 */
+static const char ws_magic_uuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+static esp_err_t httpd_ws_send_all(struct sock_db *sd, const uint8_t *buf, size_t buf_len)
+{
+    while (buf_len > 0) {
+        int ret = sd->send_fn(sd->handle, sd->fd, (const char *) buf, buf_len, 0);
+        if (ret < 0) {
+            ESP_LOGD(TAG, LOG_FMT("error in send_fn"));
+            return ESP_FAIL;
+        }
+        buf     += ret;
+        buf_len -= ret;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t httpd_ws_recv_all(httpd_req_t *req, uint8_t *buf, size_t buf_len)
+{
+    while (buf_len > 0) {
+        int ret = httpd_recv_with_opt(req, (char *) buf, buf_len, false);
+        if (ret <= 0) {
+            ESP_LOGD(TAG, LOG_FMT("error in httpd_recv : %d"), ret);
+            return ESP_FAIL;
+        }
+        buf     += ret;
+        buf_len -= ret;
+    }
+    return ESP_OK;
+}
+
+/* Unmasks the next part of the payload of the frame being received */
+static void httpd_ws_unmask(struct httpd_req_aux *ra, uint8_t *buf, size_t buf_len)
+{
+    for (size_t i = 0; i < buf_len; i++) {
+        buf[i] ^= ra->ws_mask_key[(ra->ws_offset + i) & 3];
+    }
+    ra->ws_offset += buf_len;
+}
+
+static esp_err_t httpd_ws_check_frame(httpd_ws_frame_t *frame)
+{
+    if (frame == NULL || (frame->payload == NULL && frame->len > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if ((frame->type >= HTTPD_WS_TYPE_CLOSE) &&
+        (frame->len > HTTPD_WS_CONTROL_MAX_LEN || (frame->fragmented && !frame->final))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+/* Sends a frame, which the server doesn't mask. The header and
+ * a small payload go out together in a single write */
+static esp_err_t httpd_ws_send(struct sock_db *sd, const httpd_ws_frame_t *frame)
+{
+    uint8_t buf[HTTPD_WS_MAX_HDR_LEN + HTTPD_WS_COALESCE_LEN];
+    size_t hdr_len;
+
+    buf[0] = (frame->type & HTTPD_WS_OPCODE_BITS);
+    if (!frame->fragmented || frame->final) {
+        buf[0] |= HTTPD_WS_FIN_BIT;
+    }
+
+    if (frame->len <= HTTPD_WS_CONTROL_MAX_LEN) {
+        buf[1] = frame->len;
+        hdr_len = 2;
+    } else if (frame->len <= UINT16_MAX) {
+        buf[1] = 126;
+        buf[2] = (frame->len >> 8) & 0xff;
+        buf[3] = frame->len & 0xff;
+        hdr_len = 4;
+    } else {
+        uint64_t len = frame->len;
+        buf[1] = 127;
+        for (int i = 0; i < 8; i++) {
+            buf[2 + i] = (len >> (56 - 8 * i)) & 0xff;
+        }
+        hdr_len = 10;
+    }
+
+    if (frame->len <= sizeof(buf) - hdr_len) {
+        if (frame->len > 0) {
+            memcpy(buf + hdr_len, frame->payload, frame->len);
+        }
+        return httpd_ws_send_all(sd, buf, hdr_len + frame->len);
+    }
+    if (httpd_ws_send_all(sd, buf, hdr_len) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return httpd_ws_send_all(sd, frame->payload, frame->len);
+}
+
+static esp_err_t httpd_ws_send_close(struct sock_db *sd, uint16_t status)
+{
+    uint8_t payload[2] = { status >> 8, status & 0xff };
+    httpd_ws_frame_t frame = {
+        .final   = true,
+        .type    = HTTPD_WS_TYPE_CLOSE,
+        .payload = payload,
+        .len     = sizeof(payload)
+    };
+    return httpd_ws_send(sd, &frame);
+}
+
+esp_err_t httpd_ws_respond_server_handshake(httpd_req_t *req)
+{
+    struct httpd_req_aux *ra = req->aux;
+
+    /* The key is 16 random bytes in base64, i.e. 24 characters */
+    char key[32];
+    char version[4];
+    if ((httpd_req_get_hdr_value_str(req, "Sec-WebSocket-Key", key, sizeof(key)) != ESP_OK) ||
+        (httpd_req_get_hdr_value_str(req, "Sec-WebSocket-Version", version, sizeof(version)) != ESP_OK) ||
+        (strcmp(version, "13") != 0)) {
+        ESP_LOGW(TAG, LOG_FMT("invalid WebSocket handshake"));
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST);
+        return ESP_FAIL;
+    }
+
+    /* Accept key is the base64 of the SHA1 of the key followed by the magic UUID */
+    char text[sizeof(key) + sizeof(ws_magic_uuid)];
+    uint8_t digest[20];
+    char accept[32];
+    size_t accept_len = 0;
+    int text_len = snprintf(text, sizeof(text), "%s%s", key, ws_magic_uuid);
+    mbedtls_sha1_ret((const unsigned char *) text, text_len, digest);
+    mbedtls_base64_encode((unsigned char *) accept, sizeof(accept), &accept_len, digest, sizeof(digest));
+    accept[accept_len] = '\0';
+
+    /* Request headers are kept for the handler, which is called after this */
+    char resp[160];
+    int resp_len = snprintf(resp, sizeof(resp),
+                            "HTTP/1.1 101 Switching Protocols\r\n"
+                            "Upgrade: websocket\r\n"
+                            "Connection: Upgrade\r\n"
+                            "Sec-WebSocket-Accept: %s\r\n\r\n", accept);
+    if (resp_len >= sizeof(resp)) {
+        return ESP_FAIL;
+    }
+
+    ESP_LOGD(TAG, LOG_FMT("upgrading fd = %d"), ra->sd->fd);
+    return httpd_ws_send_all(ra->sd, (const uint8_t *) resp, resp_len);
+}
+
+/* Receives the header of a frame into the request and checks it against the
+ * protocol. On failure, the status code for closing the session is set, or
+ * left 0 if the connection itself failed */
+static esp_err_t httpd_ws_recv_header(httpd_req_t *req, uint16_t *close_status)
+{
+    struct httpd_req_aux *ra = req->aux;
+    struct sock_db *sd = ra->sd;
+    uint8_t hdr[8];
+
+    *close_status = 0;
+    if (httpd_ws_recv_all(req, hdr, 2) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    ra->ws_final = (hdr[0] & HTTPD_WS_FIN_BIT) != 0;
+    ra->ws_type  = hdr[0] & HTTPD_WS_OPCODE_BITS;
+    bool rsv     = (hdr[0] & HTTPD_WS_RSV_BITS) != 0;
+    bool masked  = (hdr[1] & HTTPD_WS_MASK_BIT) != 0;
+    uint64_t len = hdr[1] & HTTPD_WS_LENGTH_BITS;
+
+    if (len == 126) {
+        if (httpd_ws_recv_all(req, hdr, 2) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        len = (hdr[0] << 8) | hdr[1];
+    } else if (len == 127) {
+        if (httpd_ws_recv_all(req, hdr, 8) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        len = 0;
+        for (int i = 0; i < 8; i++) {
+            len = (len << 8) | hdr[i];
+        }
+    }
+    if (masked && httpd_ws_recv_all(req, ra->ws_mask_key, sizeof(ra->ws_mask_key)) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    *close_status = HTTPD_WS_CLOSE_PROTOCOL_ERROR;
+    if (rsv) {
+        /* No extension has been negotiated */
+        ESP_LOGW(TAG, LOG_FMT("reserved bits set"));
+        return ESP_FAIL;
+    }
+    switch (ra->ws_type) {
+    case HTTPD_WS_TYPE_CONTINUE:
+        /* Continues the fragmented message being received */
+        if (!sd->ws_fragmented) {
+            ESP_LOGW(TAG, LOG_FMT("continuation without a fragmented message"));
+            return ESP_FAIL;
+        }
+        sd->ws_fragmented = !ra->ws_final;
+        break;
+    case HTTPD_WS_TYPE_TEXT:
+    case HTTPD_WS_TYPE_BINARY:
+        if (sd->ws_fragmented) {
+            ESP_LOGW(TAG, LOG_FMT("new message within a fragmented one"));
+            return ESP_FAIL;
+        }
+        sd->ws_fragmented = !ra->ws_final;
+        break;
+    case HTTPD_WS_TYPE_CLOSE:
+    case HTTPD_WS_TYPE_PING:
+    case HTTPD_WS_TYPE_PONG:
+        /* May come in between the fragments of a message */
+        if (!ra->ws_final || len > HTTPD_WS_CONTROL_MAX_LEN) {
+            ESP_LOGW(TAG, LOG_FMT("invalid control frame"));
+            return ESP_FAIL;
+        }
+        break;
+    default:
+        ESP_LOGW(TAG, LOG_FMT("unknown opcode %d"), ra->ws_type);
+        return ESP_FAIL;
+    }
+    if (!masked) {
+        ESP_LOGW(TAG, LOG_FMT("frames from clients must be masked"));
+        return ESP_FAIL;
+    }
+    if (len > INT32_MAX) {
+        *close_status = HTTPD_WS_CLOSE_TOO_BIG;
+        ESP_LOGW(TAG, LOG_FMT("frame too big"));
+        return ESP_FAIL;
+    }
+
+    *close_status = 0;
+    ra->ws_frame = true;
+    ra->ws_offset = 0;
+    ra->remaining_len = len;
+    return ESP_OK;
+}
+
+esp_err_t httpd_ws_process_frame(httpd_req_t *req)
+{
+    struct httpd_req_aux *ra = req->aux;
+    struct sock_db *sd = ra->sd;
+    uint16_t close_status;
+
+    if (httpd_ws_recv_header(req, &close_status) != ESP_OK) {
+        if (close_status) {
+            httpd_ws_send_close(sd, close_status);
+        }
+        return ESP_FAIL;
+    }
+    ESP_LOGD(TAG, LOG_FMT("fd = %d, type = %d, length = %d"), sd->fd, ra->ws_type, ra->remaining_len);
+
+    bool control = (ra->ws_type >= HTTPD_WS_TYPE_CLOSE);
+    if (!control || sd->ws_control_frames) {
+        req->user_ctx = sd->ws_user_ctx;
+        if (sd->ws_handler(req) != ESP_OK) {
+            /* Handler returns error, this socket should be closed */
+            ESP_LOGW(TAG, LOG_FMT("WebSocket handler execution failed"));
+            return ESP_FAIL;
+        }
+    }
+
+    if (ra->ws_type == HTTPD_WS_TYPE_PING && !sd->ws_control_frames) {
+        /* Answer with a PONG carrying the same data */
+        uint8_t payload[HTTPD_WS_CONTROL_MAX_LEN];
+        httpd_ws_frame_t pong = {
+            .final   = true,
+            .type    = HTTPD_WS_TYPE_PONG,
+            .payload = payload,
+            .len     = ra->remaining_len
+        };
+        if (httpd_ws_recv_all(req, payload, pong.len) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        httpd_ws_unmask(ra, payload, pong.len);
+        ra->remaining_len = 0;
+        return httpd_ws_send(sd, &pong);
+    } else if (ra->ws_type == HTTPD_WS_TYPE_CLOSE) {
+        if (sd->ws_control_frames) {
+            /* Handler has answered the close itself */
+            return ESP_FAIL;
+        }
+        /* Echo the status code */
+        uint16_t status = HTTPD_WS_CLOSE_NORMAL;
+        uint8_t payload[HTTPD_WS_CONTROL_MAX_LEN];
+        size_t len = ra->remaining_len;
+        if (httpd_ws_recv_all(req, payload, len) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        ra->remaining_len = 0;
+        if (len >= 2) {
+            httpd_ws_unmask(ra, payload, 2);
+            status = (payload[0] << 8) | payload[1];
+        }
+        ESP_LOGD(TAG, LOG_FMT("closing fd = %d with status %d"), sd->fd, status);
+        httpd_ws_send_close(sd, status);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t httpd_ws_recv_frame(httpd_req_t *req, httpd_ws_frame_t *frame, size_t max_len)
+{
+    if (req == NULL || frame == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!httpd_valid_req(req)) {
+        return ESP_ERR_HTTPD_INVALID_REQ;
+    }
+
+    struct httpd_req_aux *ra = req->aux;
+    if (!ra->ws_frame) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    frame->type       = ra->ws_type;
+    frame->final      = ra->ws_final;
+    frame->fragmented = !ra->ws_final || (ra->ws_type == HTTPD_WS_TYPE_CONTINUE);
+    if (max_len == 0) {
+        frame->len = ra->remaining_len;
+        return ESP_OK;
+    }
+    if (frame->payload == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t len = MIN(max_len, ra->remaining_len);
+    if (httpd_ws_recv_all(req, frame->payload, len) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    ra->remaining_len -= len;
+    httpd_ws_unmask(ra, frame->payload, len);
+    frame->len = len;
+    return ESP_OK;
+}
+
+esp_err_t httpd_ws_send_frame(httpd_req_t *req, httpd_ws_frame_t *frame)
+{
+    if (req == NULL || httpd_ws_check_frame(frame) != ESP_OK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!httpd_valid_req(req)) {
+        return ESP_ERR_HTTPD_INVALID_REQ;
+    }
+
+    struct httpd_req_aux *ra = req->aux;
+    if (!ra->sd->ws_handshake_done) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return httpd_ws_send(ra->sd, frame);
+}
+
+/* A session being processed can only be sent to from the task running its URI handler,
+ * the frames of other tasks could get mixed up with those of the handler */
+static bool httpd_ws_sess_busy(struct httpd_data *hd, struct sock_db *sd)
+{
+    if (sd->worker == NULL) {
+        return false;
+    }
+    othread_t handle = hd->config.worker_count ? sd->worker->td.handle : hd->hd_td.handle;
+    return httpd_os_thread_handle() != handle;
+}
+
+esp_err_t httpd_ws_send_frame_async(httpd_handle_t hd, int fd, httpd_ws_frame_t *frame)
+{
+    if (hd == NULL || httpd_ws_check_frame(frame) != ESP_OK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct sock_db *sd = (fd < 0) ? NULL : httpd_sess_get(hd, fd);
+    if (sd == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!sd->ws_handshake_done || httpd_ws_sess_busy(hd, sd)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return httpd_ws_send(sd, frame);
+}
+
+httpd_ws_client_info_t httpd_ws_get_fd_info(httpd_handle_t hd, int fd)
+{
+    struct sock_db *sd = (hd && fd >= 0) ? httpd_sess_get(hd, fd) : NULL;
+
+    if (sd == NULL) {
+        return HTTPD_WS_CLIENT_INVALID;
+    }
+    return sd->ws_handshake_done ? HTTPD_WS_CLIENT_WEBSOCKET : HTTPD_WS_CLIENT_HTTP;
+}
+
+#endif /* CONFIG_HTTPD_WS_SUPPORT */
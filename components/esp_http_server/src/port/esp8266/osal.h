@@ -17,6 +17,7 @@
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <freertos/semphr.h>
 #include <unistd.h>
 #include <stdint.h>
 #include <esp_timer.h>
@@ -29,6 +30,7 @@ extern "C" {
 #define OS_FAIL    ESP_FAIL
 
 typedef TaskHandle_t othread_t;
+typedef SemaphoreHandle_t osem_t;
 
 static inline int httpd_os_thread_create(othread_t *thread,
                                  const char *name, uint16_t stacksize, int prio,
@@ -57,6 +59,30 @@ static inline othread_t httpd_os_thread_handle()
     return xTaskGetCurrentTaskHandle();
 }
 
+static inline int httpd_os_sem_create(osem_t *sem)
+{
+    *sem = xSemaphoreCreateBinary();
+    if (*sem) {
+        return OS_SUCCESS;
+    }
+    return OS_FAIL;
+}
+
+static inline void httpd_os_sem_delete(osem_t sem)
+{
+    vSemaphoreDelete(sem);
+}
+
+static inline void httpd_os_sem_give(osem_t sem)
+{
+    xSemaphoreGive(sem);
+}
+
+static inline void httpd_os_sem_take(osem_t sem)
+{
+    xSemaphoreTake(sem, portMAX_DELAY);
+}
+
 #ifdef __cplusplus
 }
 #endif
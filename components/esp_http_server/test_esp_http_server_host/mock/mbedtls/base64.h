@@ -0,0 +1,40 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stddef.h>
+
+#define MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL  -0x002A
+
+static inline int mbedtls_base64_encode(unsigned char *dst, size_t dlen, size_t *olen,
+                                        const unsigned char *src, size_t slen)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t n = 4 * ((slen + 2) / 3);
+
+    *olen = n + 1;
+    if (dlen < n + 1) {
+        return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+    }
+    for (size_t i = 0, j = 0; i < slen; i += 3, j += 4) {
+        unsigned v = src[i] << 16 | (i + 1 < slen ? src[i + 1] << 8 : 0) | (i + 2 < slen ? src[i + 2] : 0);
+        dst[j] = alphabet[(v >> 18) & 0x3f];
+        dst[j + 1] = alphabet[(v >> 12) & 0x3f];
+        dst[j + 2] = i + 1 < slen ? alphabet[(v >> 6) & 0x3f] : '=';
+        dst[j + 3] = i + 2 < slen ? alphabet[v & 0x3f] : '=';
+    }
+    dst[n] = '\0';
+    *olen = n;
+    return 0;
+}
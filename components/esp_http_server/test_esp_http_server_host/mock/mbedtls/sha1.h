@@ -0,0 +1,93 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Plain SHA1 for the WebSocket handshake, RFC 3174 */
+static inline void mock_sha1_block(uint32_t h[5], const unsigned char *block)
+{
+    uint32_t w[80];
+
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 |
+               (uint32_t)block[i * 4 + 2] << 8 | block[i * 4 + 3];
+    }
+    for (int i = 16; i < 80; i++) {
+        uint32_t x = w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16];
+        w[i] = (x << 1) | (x >> 31);
+    }
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        uint32_t t = ((a << 5) | (a >> 27)) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = (b << 30) | (b >> 2);
+        b = a;
+        a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+}
+
+static inline int mbedtls_sha1_ret(const unsigned char *input, size_t ilen, unsigned char output[20])
+{
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    unsigned char block[64];
+    size_t done = 0;
+
+    for (; ilen - done >= 64; done += 64) {
+        mock_sha1_block(h, input + done);
+    }
+
+    /* Padding: 0x80, zeros and the length in bits, in one or two blocks */
+    size_t rest = ilen - done;
+    memset(block, 0, sizeof(block));
+    memcpy(block, input + done, rest);
+    block[rest] = 0x80;
+    if (rest >= 56) {
+        mock_sha1_block(h, block);
+        memset(block, 0, sizeof(block));
+    }
+    uint64_t bits = (uint64_t)ilen * 8;
+    for (int i = 0; i < 8; i++) {
+        block[63 - i] = (unsigned char)(bits >> (8 * i));
+    }
+    mock_sha1_block(h, block);
+
+    for (int i = 0; i < 20; i++) {
+        output[i] = (unsigned char)(h[i / 4] >> (24 - 8 * (i % 4)));
+    }
+    return 0;
+}
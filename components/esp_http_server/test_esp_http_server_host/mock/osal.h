@@ -0,0 +1,117 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _OSAL_H_
+#define _OSAL_H_
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <esp_err.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OS_SUCCESS ESP_OK
+#define OS_FAIL    ESP_FAIL
+
+typedef pthread_t othread_t;
+typedef sem_t *osem_t;
+
+struct httpd_os_thread_args {
+    void (*thread_routine)(void *arg);
+    void *arg;
+};
+
+static inline void *httpd_os_thread_start(void *p)
+{
+    struct httpd_os_thread_args args = *(struct httpd_os_thread_args *)p;
+
+    free(p);
+    args.thread_routine(args.arg);
+    return NULL;
+}
+
+/* Stack size and priority are left to the host */
+static inline int httpd_os_thread_create(othread_t *thread,
+                                 const char *name, uint16_t stacksize, int prio,
+                                 void (*thread_routine)(void *arg), void *arg)
+{
+    struct httpd_os_thread_args *args = (struct httpd_os_thread_args *) malloc(sizeof(*args));
+    if (args == NULL) {
+        return OS_FAIL;
+    }
+    args->thread_routine = thread_routine;
+    args->arg = arg;
+    if (pthread_create(thread, NULL, httpd_os_thread_start, args) != 0) {
+        free(args);
+        return OS_FAIL;
+    }
+    pthread_detach(*thread);
+    return OS_SUCCESS;
+}
+
+/* Only self delete is supported */
+static inline void httpd_os_thread_delete()
+{
+    pthread_exit(NULL);
+}
+
+static inline void httpd_os_thread_sleep(int msecs)
+{
+    usleep(msecs * 1000);
+}
+
+static inline othread_t httpd_os_thread_handle()
+{
+    return pthread_self();
+}
+
+static inline int httpd_os_sem_create(osem_t *sem)
+{
+    *sem = (sem_t *) malloc(sizeof(sem_t));
+    if (*sem && sem_init(*sem, 0, 0) == 0) {
+        return OS_SUCCESS;
+    }
+    free(*sem);
+    *sem = NULL;
+    return OS_FAIL;
+}
+
+static inline void httpd_os_sem_delete(osem_t sem)
+{
+    sem_destroy(sem);
+    free(sem);
+}
+
+/* A worker's semaphore is never given twice before it's taken, so this behaves as the binary one of the target */
+static inline void httpd_os_sem_give(osem_t sem)
+{
+    sem_post(sem);
+}
+
+static inline void httpd_os_sem_take(osem_t sem)
+{
+    while (sem_wait(sem) != 0) {
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ! _OSAL_H_ */
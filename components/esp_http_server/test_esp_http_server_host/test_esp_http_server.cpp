@@ -0,0 +1,1857 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "catch.hpp"
+#include "esp_http_server.h"
+#include "esp_httpd_priv.h"
+#include "ctrl_sock.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <linux/tcp.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+/* Bookkeeping of the handlers, which run in the server or worker threads.
+ * Catch assertions aren't thread safe, so the handlers only count and the test checks the counters */
+struct HandlerStats {
+    std::atomic<int> running{0};
+    std::atomic<int> max_running{0};
+    std::atomic<int> overlapping{0};    // requests started while another one of their session was running
+    std::atomic<int> failed{0};         // calls to the request API which failed
+    std::mutex lock;
+    std::set<int> busy_fds;
+
+    void enter(int fd)
+    {
+        int now = ++running;
+        int max = max_running;
+        while (now > max && !max_running.compare_exchange_weak(max, now)) {
+        }
+        std::lock_guard<std::mutex> guard(lock);
+        if (!busy_fds.insert(fd).second) {
+            overlapping++;
+        }
+    }
+
+    void leave(int fd)
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            busy_fds.erase(fd);
+        }
+        running--;
+    }
+};
+
+struct Route {
+    HandlerStats *stats;
+    int delay_ms;
+};
+
+static esp_err_t send_body(httpd_req_t *req, const std::string &body, HandlerStats *stats)
+{
+    if (httpd_resp_send(req, body.data(), body.size()) != ESP_OK) {
+        stats->failed++;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/* Responds "ok" after the delay of its route */
+static esp_err_t delay_handler(httpd_req_t *req)
+{
+    Route *route = static_cast<Route *>(req->user_ctx);
+    int fd = httpd_req_to_sockfd(req);
+
+    route->stats->enter(fd);
+    std::this_thread::sleep_for(milliseconds(route->delay_ms));
+    route->stats->leave(fd);
+    return send_body(req, "ok", route->stats);
+}
+
+/* Responds the number of requests received by the session, counted in its context */
+static esp_err_t count_handler(httpd_req_t *req)
+{
+    Route *route = static_cast<Route *>(req->user_ctx);
+    int fd = httpd_req_to_sockfd(req);
+
+    route->stats->enter(fd);
+    int *count = static_cast<int *>(httpd_sess_get_ctx(req->handle, fd));
+    if (count == nullptr) {
+        count = static_cast<int *>(calloc(1, sizeof(int)));
+        httpd_sess_set_ctx(req->handle, fd, count, nullptr);
+    }
+    int value = ++(*count);
+    std::this_thread::sleep_for(milliseconds(route->delay_ms));
+    route->stats->leave(fd);
+    return send_body(req, std::to_string(value), route->stats);
+}
+
+/* Responds the body of the request */
+static esp_err_t echo_handler(httpd_req_t *req)
+{
+    Route *route = static_cast<Route *>(req->user_ctx);
+    std::string body(req->content_len, '\0');
+    size_t received = 0;
+
+    while (received < body.size()) {
+        int ret = httpd_req_recv(req, &body[received], body.size() - received);
+        if (ret <= 0) {
+            route->stats->failed++;
+            return ESP_FAIL;
+        }
+        received += ret;
+    }
+    return send_body(req, body, route->stats);
+}
+
+/* Closes its session, which is being processed, then responds */
+static esp_err_t close_handler(httpd_req_t *req)
+{
+    Route *route = static_cast<Route *>(req->user_ctx);
+
+    if (httpd_sess_trigger_close(req->handle, httpd_req_to_sockfd(req)) != ESP_OK) {
+        route->stats->failed++;
+    }
+    std::this_thread::sleep_for(milliseconds(route->delay_ms));
+    return send_body(req, "bye", route->stats);
+}
+
+/* Writes to the sockets of the thread, the sources are linked with send() and sendmsg() wrapped */
+static thread_local int sock_writes;
+
+extern "C" ssize_t __real_send(int sockfd, const void *buf, size_t len, int flags);
+extern "C" ssize_t __real_sendmsg(int sockfd, const struct msghdr *msg, int flags);
+
+extern "C" ssize_t __wrap_send(int sockfd, const void *buf, size_t len, int flags)
+{
+    sock_writes++;
+    return __real_send(sockfd, buf, len, flags);
+}
+
+extern "C" ssize_t __wrap_sendmsg(int sockfd, const struct msghdr *msg, int flags)
+{
+    sock_writes++;
+    return __real_sendmsg(sockfd, msg, flags);
+}
+
+/* Shape of the responses of /shape, and what sending the last one took */
+struct ResponseShape {
+    std::atomic<int> headers{0};
+    std::atomic<size_t> body_len{0};
+    std::atomic<int> writes{-1};
+    std::atomic<int> fd{-1};
+};
+
+static ResponseShape shape;
+
+/* Writes which sent the last response, the handler only stores them once the client got it */
+static int response_writes()
+{
+    int writes;
+
+    while ((writes = shape.writes.exchange(-1)) < 0) {
+        std::this_thread::yield();
+    }
+    return writes;
+}
+
+static esp_err_t shape_handler(httpd_req_t *req)
+{
+    static const char *const fields[] = {"X-Header-0", "X-Header-1", "X-Header-2", "X-Header-3"};
+    Route *route = static_cast<Route *>(req->user_ctx);
+    std::string body(shape.body_len, 'b');
+
+    for (int i = 0; i < shape.headers; i++) {
+        httpd_resp_set_hdr(req, fields[i], "value");
+    }
+    int start = sock_writes;
+    esp_err_t ret = send_body(req, body, route->stats);
+    shape.fd = httpd_req_to_sockfd(req);
+    shape.writes = sock_writes - start;
+    return ret;
+}
+
+/* Sends through the send override, which has to get called with each buffer in turn */
+static int override_send(httpd_handle_t hd, int sockfd, const char *buf, size_t buf_len, int flags)
+{
+    return send(sockfd, buf, buf_len, flags);
+}
+
+static esp_err_t override_handler(httpd_req_t *req)
+{
+    httpd_sess_set_send_override(req->handle, httpd_req_to_sockfd(req), override_send);
+    return shape_handler(req);
+}
+
+/* Responds a header too long for the scratch buffer */
+static esp_err_t long_header_handler(httpd_req_t *req)
+{
+    Route *route = static_cast<Route *>(req->user_ctx);
+    std::string value(2000, 'v');
+
+    httpd_resp_set_hdr(req, "X-Short", "1");
+    httpd_resp_set_hdr(req, "X-Long", value.c_str());
+    return send_body(req, "long", route->stats);
+}
+
+/* Responds the content gathered from pieces of various sizes */
+static esp_err_t sendv_handler(httpd_req_t *req)
+{
+    Route *route = static_cast<Route *>(req->user_ctx);
+    std::string large(2000, 'x');
+    const httpd_iov_t iov[] = {
+        {"hello", 5},
+        {nullptr, 0},
+        {", ", 2},
+        {large.data(), large.size()},
+        {"!", 1},
+    };
+
+    int start = sock_writes;
+    if (httpd_resp_sendv(req, iov, sizeof(iov) / sizeof(iov[0])) != ESP_OK) {
+        route->stats->failed++;
+        return ESP_FAIL;
+    }
+    shape.writes = sock_writes - start;
+    return ESP_OK;
+}
+
+/* Responds three chunks, each one sent with a single write */
+static esp_err_t chunked_handler(httpd_req_t *req)
+{
+    Route *route = static_cast<Route *>(req->user_ctx);
+    int writes = 0;
+
+    httpd_resp_set_hdr(req, "X-Header", "value");
+    for (const char *chunk : {"one", "two", ""}) {
+        int start = sock_writes;
+        if (httpd_resp_send_chunk(req, chunk, -1) != ESP_OK) {
+            route->stats->failed++;
+            return ESP_FAIL;
+        }
+        writes = std::max(writes, sock_writes - start);
+    }
+    shape.writes = writes;
+    return ESP_OK;
+}
+
+/* Responds the name of its route followed by the path parameters it asks for */
+static esp_err_t param_handler(httpd_req_t *req)
+{
+    std::string body = static_cast<const char *>(req->user_ctx);
+    char value[16];
+
+    for (const char *name : {"id", "attr", "*"}) {
+        esp_err_t ret = httpd_req_get_path_param(req, name, value, sizeof(value));
+        if (ret == ESP_OK || ret == ESP_ERR_HTTPD_RESULT_TRUNC) {
+            body += std::string(" ") + name + "=" + value;
+        }
+    }
+    return httpd_resp_send(req, body.data(), body.size());
+}
+
+/* TCP segments with data which were sent out of the socket */
+static uint32_t sent_segments(int fd)
+{
+    struct tcp_info info = {};
+    socklen_t len = sizeof(info);
+
+    getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len);
+    return info.tcpi_data_segs_out;
+}
+
+/* Responses are sent in several writes, which the delayed acknowledgements of the
+ * client would hold back, so they don't count in the latencies */
+static esp_err_t open_handler(httpd_handle_t hd, int sockfd)
+{
+    int enable = 1;
+    setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    return ESP_OK;
+}
+
+class TestServer
+{
+public:
+    TestServer(uint16_t workers, int delay_ms, uint16_t max_sockets = 7)
+        : mSlow{&stats, delay_ms}, mFast{&stats, 0}
+    {
+        static uint16_t port_offset = 0;
+        httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+
+        // the server writes to sockets which the tests may have closed already
+        signal(SIGPIPE, SIG_IGN);
+
+        port = 18000 + port_offset;
+        config.server_port = port;
+        config.ctrl_port = 33000 + port_offset;
+        port_offset++;
+        config.worker_count = workers;
+        config.max_open_sockets = max_sockets;
+        config.open_fn = open_handler;
+        config.max_uri_handlers = 16;
+        REQUIRE(httpd_start(&handle, &config) == ESP_OK);
+
+        const httpd_uri_t uris[] = {
+            {"/slow", HTTP_GET, delay_handler, &mSlow},
+            {"/fast", HTTP_GET, delay_handler, &mFast},
+            {"/count", HTTP_GET, count_handler, &mSlow},
+            {"/echo", HTTP_POST, echo_handler, &mFast},
+            {"/close", HTTP_GET, close_handler, &mSlow},
+            {"/shape", HTTP_GET, shape_handler, &mFast},
+            {"/override", HTTP_GET, override_handler, &mFast},
+            {"/long-header", HTTP_GET, long_header_handler, &mFast},
+            {"/sendv", HTTP_GET, sendv_handler, &mFast},
+            {"/chunked", HTTP_GET, chunked_handler, &mFast},
+        };
+        for (const auto &uri : uris) {
+            REQUIRE(httpd_register_uri_handler(handle, &uri) == ESP_OK);
+        }
+    }
+
+    ~TestServer()
+    {
+        stop();
+    }
+
+    void stop()
+    {
+        if (handle) {
+            httpd_stop(handle);
+            handle = nullptr;
+        }
+    }
+
+    HandlerStats stats;
+    httpd_handle_t handle = nullptr;
+    uint16_t port;
+
+protected:
+    Route mSlow;
+    Route mFast;
+};
+
+/* Blocking client of a keep-alive connection */
+class Client
+{
+public:
+    Client(uint16_t port)
+    {
+        struct sockaddr_in addr = {};
+        struct timeval tv = {5, 0};
+        int enable = 1;
+
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        mFd = socket(AF_INET, SOCK_STREAM, 0);
+        setsockopt(mFd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(mFd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        connected = connect(mFd, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+    }
+
+    ~Client()
+    {
+        close(mFd);
+    }
+
+    bool send(const std::string &data)
+    {
+        return ::send(mFd, data.data(), data.size(), 0) == (ssize_t)data.size();
+    }
+
+    bool get(const std::string &uri)
+    {
+        return send(request(uri));
+    }
+
+    static std::string request(const std::string &uri)
+    {
+        return "GET " + uri + " HTTP/1.1\r\nHost: test\r\n\r\n";
+    }
+
+    /* Returns the body of the next response, or "" if the connection failed */
+    std::string response()
+    {
+        const std::string length_field = "Content-Length: ";
+        size_t end;
+
+        while ((end = mBuf.find("\r\n\r\n")) == std::string::npos) {
+            if (!fill()) {
+                return "";
+            }
+        }
+        size_t pos = mBuf.find(length_field);
+        if (pos == std::string::npos || pos > end) {
+            return "";
+        }
+        size_t len = std::stoul(mBuf.substr(pos + length_field.size()));
+        end += 4;
+        headers = mBuf.substr(0, end);
+        while (mBuf.size() < end + len) {
+            if (!fill()) {
+                return "";
+            }
+        }
+        std::string body = mBuf.substr(end, len);
+        mBuf.erase(0, end + len);
+        return body;
+    }
+
+    /* Returns everything received up to and including the end marker */
+    std::string receive_until(const std::string &marker)
+    {
+        size_t pos, from = 0;
+
+        while ((pos = mBuf.find(marker, from)) == std::string::npos) {
+            // only the new data and the end of the old one can hold the marker
+            from = mBuf.size() >= marker.size() ? mBuf.size() - marker.size() + 1 : 0;
+            if (!fill()) {
+                return "";
+            }
+        }
+        std::string data = mBuf.substr(0, pos + marker.size());
+        mBuf.erase(0, pos + marker.size());
+        return data;
+    }
+
+    /* Waits for the server to close the connection */
+    bool closed()
+    {
+        while (fill()) {
+        }
+        return mEof;
+    }
+
+    bool connected;
+    std::string headers;    // of the last response
+
+protected:
+    bool fill()
+    {
+        char buf[8192];
+        ssize_t ret = recv(mFd, buf, sizeof(buf), 0);
+        if (ret <= 0) {
+            // unread data makes the server reset the connection as it closes it
+            mEof = ret == 0 || errno == ECONNRESET;
+            return false;
+        }
+        mBuf.append(buf, ret);
+        return true;
+    }
+
+    int mFd;
+    bool mEof = false;
+    std::string mBuf;
+};
+
+/* Sends one request on each of its own connections at the same time and returns how long all took */
+static milliseconds parallel_requests(uint16_t port, size_t count, const std::string &uri, std::atomic<int> &ok)
+{
+    std::vector<std::thread> threads;
+    auto start = steady_clock::now();
+
+    for (size_t i = 0; i < count; i++) {
+        threads.emplace_back([&]() {
+            Client client(port);
+            if (client.connected && client.get(uri) && client.response() == "ok") {
+                ok++;
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    return duration_cast<milliseconds>(steady_clock::now() - start);
+}
+
+TEST_CASE("requests are processed in the server task without workers", "[esp_http_server]")
+{
+    TestServer server(0, 5);
+    Client client(server.port);
+    REQUIRE(client.connected);
+
+    CHECK(client.get("/fast"));
+    CHECK(client.response() == "ok");
+
+    CHECK(client.send("POST /echo HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello"));
+    CHECK(client.response() == "hello");
+
+    // pipelined requests, counted in the session context
+    CHECK(client.send(Client::request("/count") + Client::request("/count") + Client::request("/count")));
+    CHECK(client.response() == "1");
+    CHECK(client.response() == "2");
+    CHECK(client.response() == "3");
+
+    std::atomic<int> ok{0};
+    parallel_requests(server.port, 3, "/slow", ok);
+    CHECK(ok == 3);
+    CHECK(server.stats.max_running == 1);
+    CHECK(server.stats.failed == 0);
+}
+
+TEST_CASE("workers run the handlers of different sessions concurrently", "[esp_http_server]")
+{
+    TestServer server(4, 200);
+    std::atomic<int> ok{0};
+
+    auto elapsed = parallel_requests(server.port, 4, "/slow", ok);
+
+    CHECK(ok == 4);
+    CHECK(server.stats.max_running == 4);
+    CHECK(elapsed < milliseconds(600));     // 800 ms if they ran one after the other
+    CHECK(server.stats.failed == 0);
+}
+
+TEST_CASE("sessions wait for a worker when all of them are busy", "[esp_http_server]")
+{
+    TestServer server(2, 100);
+    std::atomic<int> ok{0};
+
+    auto elapsed = parallel_requests(server.port, 5, "/slow", ok);
+
+    CHECK(ok == 5);
+    CHECK(server.stats.max_running == 2);
+    CHECK(elapsed >= milliseconds(300));
+    CHECK(server.stats.failed == 0);
+}
+
+TEST_CASE("requests of a session are processed in order by one worker at a time", "[esp_http_server]")
+{
+    TestServer server(4, 10);
+    const int sessions = 3;
+    const int requests = 10;
+    std::atomic<int> in_order{0};
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < sessions; i++) {
+        threads.emplace_back([&]() {
+            Client client(server.port);
+            std::string pipeline;
+
+            for (int n = 0; n < requests; n++) {
+                pipeline += Client::request("/count");
+            }
+            if (!client.connected || !client.send(pipeline)) {
+                return;
+            }
+            for (int n = 1; n <= requests; n++) {
+                if (client.response() == std::to_string(n)) {
+                    in_order++;
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    CHECK(in_order == sessions * requests);
+    CHECK(server.stats.overlapping == 0);
+    CHECK(server.stats.max_running > 1);
+    CHECK(server.stats.failed == 0);
+}
+
+TEST_CASE("closing a session from its handler takes effect once the worker is done", "[esp_http_server]")
+{
+    TestServer server(2, 50);
+    Client client(server.port);
+    REQUIRE(client.connected);
+
+    CHECK(client.get("/close"));
+    CHECK(client.response() == "bye");
+    CHECK(client.closed());
+    CHECK(server.stats.failed == 0);
+
+    // the session slot is available again
+    Client next(server.port);
+    REQUIRE(next.connected);
+    CHECK(next.get("/fast"));
+    CHECK(next.response() == "ok");
+}
+
+TEST_CASE("stopping the server waits for the handlers running in workers", "[esp_http_server]")
+{
+    TestServer server(2, 200);
+    Client client(server.port);
+    REQUIRE(client.connected);
+
+    CHECK(client.get("/slow"));
+    while (server.stats.running == 0) {
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    server.stop();
+
+    CHECK(server.stats.running == 0);
+    CHECK(client.response() == "ok");
+    CHECK(client.closed());
+}
+
+TEST_CASE("response headers and small content are sent with a single write", "[esp_http_server]")
+{
+    TestServer server(0, 0);
+    Client client(server.port);
+    REQUIRE(client.connected);
+
+    shape.headers = 4;
+    shape.body_len = 100;
+    CHECK(client.get("/shape"));
+    CHECK(client.response() == std::string(100, 'b'));
+    CHECK(client.headers.find("X-Header-3: value\r\n") != std::string::npos);
+    CHECK(response_writes() == 1);
+
+    // gathered into one sendmsg() when the content doesn't fit
+    shape.body_len = 4000;
+    CHECK(client.get("/shape"));
+    CHECK(client.response() == std::string(4000, 'b'));
+    CHECK(response_writes() == 1);
+
+    // headers longer than the scratch buffer still go out
+    CHECK(client.get("/long-header"));
+    CHECK(client.response() == "long");
+    CHECK(client.headers.find("X-Short: 1\r\nX-Long: " + std::string(2000, 'v') + "\r\n") != std::string::npos);
+    CHECK(server.stats.failed == 0);
+}
+
+TEST_CASE("send overrides get the coalesced headers and the content in turn", "[esp_http_server]")
+{
+    TestServer server(0, 0);
+    Client client(server.port);
+    REQUIRE(client.connected);
+
+    shape.headers = 2;
+    shape.body_len = 16;
+    CHECK(client.get("/override"));
+    CHECK(client.response() == std::string(16, 'b'));
+    CHECK(response_writes() == 1);
+
+    shape.body_len = 4000;
+    CHECK(client.get("/override"));
+    CHECK(client.response() == std::string(4000, 'b'));
+    CHECK(response_writes() == 2);
+    CHECK(server.stats.failed == 0);
+}
+
+TEST_CASE("responses are gathered from a vector of buffers", "[esp_http_server]")
+{
+    TestServer server(0, 0);
+    Client client(server.port);
+    REQUIRE(client.connected);
+
+    CHECK(client.get("/sendv"));
+    CHECK(client.response() == "hello, " + std::string(2000, 'x') + "!");
+    CHECK(client.headers.find("Content-Length: 2008\r\n") != std::string::npos);
+    CHECK(response_writes() == 1);
+    CHECK(server.stats.failed == 0);
+}
+
+TEST_CASE("chunks are sent with a single write each", "[esp_http_server]")
+{
+    TestServer server(0, 0);
+    Client client(server.port);
+    REQUIRE(client.connected);
+
+    CHECK(client.get("/chunked"));
+    CHECK(client.receive_until("0\r\n\r\n") ==
+          "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nTransfer-Encoding: chunked\r\n"
+          "X-Header: value\r\n\r\n3\r\none\r\n3\r\ntwo\r\n0\r\n\r\n");
+    CHECK(response_writes() == 1);
+    CHECK(server.stats.failed == 0);
+}
+
+TEST_CASE("URI patterns capture path parameters and wildcards", "[esp_http_server]")
+{
+    TestServer server(0, 0);
+    const httpd_uri_t uris[] = {
+        {"/dev/{id}/state", HTTP_GET, param_handler, (void *)"state"},
+        {"/dev/{id}/{attr}", HTTP_GET, param_handler, (void *)"attr"},
+        {"/dev/all/state", HTTP_GET, param_handler, (void *)"all"},
+        {"/api/*", HTTP_GET, param_handler, (void *)"api"},
+        {"/api/version", HTTP_GET, param_handler, (void *)"version"},
+        {"/api/v{id}", HTTP_GET, param_handler, (void *)"bad"},
+    };
+    for (const auto &uri : uris) {
+        CHECK(httpd_register_uri_handler(server.handle, &uri) == (uri.user_ctx == uris[5].user_ctx ?
+                                                                  ESP_ERR_INVALID_ARG : ESP_OK));
+    }
+    Client client(server.port);
+    REQUIRE(client.connected);
+
+    const std::pair<std::string, std::string> expected[] = {
+        {"/dev/42/state", "state id=42"},
+        {"/dev/42/state?verbose=1", "state id=42"},
+        {"/dev/42/power", "attr id=42 attr=power"},
+        {"/dev/all/state", "all"},
+        {"/dev/all/power", "attr id=all attr=power"},
+        {"/dev/a-very-long-identifier/state", "state id=a-very-long-ide"},
+        {"/api/version", "version"},
+        {"/api/", "api *="},
+        {"/api/v2/users/7", "api *=v2/users/7"},
+        {"/api/versions", "api *=versions"},
+        {"/fast", "ok"},
+        {"/dev//state", "This URI doesn't exist"},
+        {"/dev/42/state/", "This URI doesn't exist"},
+        {"/api", "This URI doesn't exist"},
+        {"/fas", "This URI doesn't exist"},
+    };
+    for (const auto &request : expected) {
+        CHECK(client.get(request.first));
+        CHECK(client.response() == request.second);
+    }
+
+    CHECK(client.send("POST /dev/42/state HTTP/1.1\r\nContent-Length: 0\r\n\r\n"));
+    CHECK(client.response() == "Request method for this URI is not handled by server");
+
+    // routes which share a prefix with the removed one keep working
+    CHECK(httpd_unregister_uri_handler(server.handle, "/dev/{id}/state", HTTP_GET) == ESP_OK);
+    CHECK(httpd_unregister_uri_handler(server.handle, "/dev/{id}/state", HTTP_GET) == ESP_ERR_NOT_FOUND);
+    CHECK(client.get("/dev/42/state"));
+    CHECK(client.response() == "attr id=42 attr=state");
+    CHECK(httpd_unregister_uri(server.handle, "/api/*") == ESP_OK);
+    CHECK(client.get("/api/v2"));
+    CHECK(client.response() == "This URI doesn't exist");
+    CHECK(client.get("/api/version"));
+    CHECK(client.response() == "version");
+}
+
+TEST_CASE("malformed URI patterns are rejected", "[esp_http_server]")
+{
+    TestServer server(0, 0);
+
+    for (const char *pattern : {"/dev/{id", "/dev/{}/state", "/dev/x{id}", "/dev/{id}x", "/dev/id}",
+                                "/{a}/{b}/{c}/{d}/*"}) {
+        httpd_uri_t uri = {pattern, HTTP_GET, param_handler, (void *)"bad"};
+        CHECK(httpd_register_uri_handler(server.handle, &uri) == ESP_ERR_INVALID_ARG);
+    }
+    httpd_uri_t uri = {"/{a}/{b}/{c}/*", HTTP_GET, param_handler, (void *)"max"};
+    CHECK(httpd_register_uri_handler(server.handle, &uri) == ESP_OK);
+}
+
+/* Holds its request until released, then responds the path parameter "id" */
+struct Gate {
+    std::mutex lock;
+    std::condition_variable cond;
+    bool entered = false;
+    bool released = false;
+};
+
+static esp_err_t gate_handler(httpd_req_t *req)
+{
+    Gate *gate = static_cast<Gate *>(req->user_ctx);
+    char id[16] = "";
+    {
+        std::unique_lock<std::mutex> guard(gate->lock);
+        gate->entered = true;
+        gate->cond.notify_all();
+        gate->cond.wait(guard, [&]() { return gate->released; });
+    }
+    httpd_req_get_path_param(req, "id", id, sizeof(id));
+    std::string body = std::string("gate id=") + id;
+    return httpd_resp_send(req, body.data(), body.size());
+}
+
+TEST_CASE("handlers are unregistered while workers run them", "[esp_http_server]")
+{
+    TestServer server(2, 0);
+    Gate gate;
+    httpd_uri_t uri = {"/gate/{id}", HTTP_GET, gate_handler, &gate};
+    REQUIRE(httpd_register_uri_handler(server.handle, &uri) == ESP_OK);
+
+    {
+        Client client(server.port);
+        REQUIRE(client.connected);
+        CHECK(client.get("/gate/42"));
+        {
+            std::unique_lock<std::mutex> guard(gate.lock);
+            REQUIRE(gate.cond.wait_for(guard, seconds(5), [&]() { return gate.entered; }));
+        }
+
+        // the running handler keeps its pattern, while new requests no longer reach it
+        CHECK(httpd_unregister_uri_handler(server.handle, "/gate/{id}", HTTP_GET) == ESP_OK);
+        Client other(server.port);
+        REQUIRE(other.connected);
+        CHECK(other.get("/gate/7"));
+        CHECK(other.response() == "This URI doesn't exist");
+        {
+            std::lock_guard<std::mutex> guard(gate.lock);
+            gate.released = true;
+            gate.cond.notify_all();
+        }
+        CHECK(client.response() == "gate id=42");
+    }
+
+    // requests are routed while the router is being replaced
+    std::atomic<bool> done{false};
+    std::atomic<int> ok{0};
+    std::thread churn([&]() {
+        httpd_uri_t churn_uri = {"/churn/{id}", HTTP_GET, param_handler, (void *)"churn"};
+        while (!done) {
+            httpd_register_uri_handler(server.handle, &churn_uri);
+            httpd_unregister_uri(server.handle, "/churn/{id}");
+        }
+    });
+    for (int i = 0; i < 20; i++) {
+        parallel_requests(server.port, 2, "/fast", ok);
+    }
+    done = true;
+    churn.join();
+    CHECK(ok == 40);
+}
+
+/* WebSocket handlers count the frames they get in the server or worker threads */
+struct WsStats {
+    std::atomic<int> fd{-1};            // of the last handshake
+    std::atomic<int> handshakes{0};
+    std::atomic<int> failed{0};
+    std::mutex lock;
+    std::vector<httpd_ws_type_t> types;  // of the frames the handler got
+} ws;
+
+/* Sends every frame back as it came, fragments included */
+static esp_err_t ws_echo_handler(httpd_req_t *req)
+{
+    if (req->method == HTTP_GET) {
+        ws.fd = httpd_req_to_sockfd(req);
+        ws.handshakes++;
+        return ESP_OK;
+    }
+
+    httpd_ws_frame_t frame = {};
+    if (httpd_ws_recv_frame(req, &frame, 0) != ESP_OK) {
+        ws.failed++;
+        return ESP_FAIL;
+    }
+    {
+        std::lock_guard<std::mutex> guard(ws.lock);
+        ws.types.push_back(frame.type);
+    }
+    std::vector<uint8_t> payload(frame.len);
+    frame.payload = payload.data();
+    if ((frame.len > 0 && httpd_ws_recv_frame(req, &frame, frame.len) != ESP_OK) ||
+        httpd_ws_send_frame(req, &frame) != ESP_OK) {
+        ws.failed++;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/* Client side of a WebSocket over a keep-alive connection */
+class WsClient : public Client
+{
+public:
+    struct Frame {
+        int opcode;
+        bool fin;
+        std::string payload;
+    };
+
+    WsClient(uint16_t port) : Client(port)
+    {
+    }
+
+    /* Returns the response to the upgrade request, up to the end of its headers,
+     * once the handler has been called with the request if it was accepted */
+    std::string handshake(const std::string &uri, const std::string &key = "dGhlIHNhbXBsZSBub25jZQ==")
+    {
+        int handshakes = ws.handshakes;
+        send("GET " + uri + " HTTP/1.1\r\nHost: test\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+             "Sec-WebSocket-Key: " + key + "\r\nSec-WebSocket-Version: 13\r\n\r\n");
+        std::string response = receive_until("\r\n\r\n");
+        // the response is sent before the handler is called
+        for (int i = 0; i < 1000 && response.find(" 101 ") != std::string::npos && ws.handshakes == handshakes; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return response;
+    }
+
+    bool send_frame(int opcode, const std::string &payload, bool fin = true, bool masked = true)
+    {
+        const uint8_t mask[4] = {0x12, 0x34, 0x56, 0x78};
+        std::string frame(1, (char)((fin ? 0x80 : 0) | opcode));
+        uint8_t mask_bit = masked ? 0x80 : 0;
+
+        if (payload.size() < 126) {
+            frame += (char)(mask_bit | payload.size());
+        } else if (payload.size() <= 0xffff) {
+            frame += (char)(mask_bit | 126);
+            frame += (char)(payload.size() >> 8);
+            frame += (char)(payload.size() & 0xff);
+        } else {
+            frame += (char)(mask_bit | 127);
+            for (int i = 7; i >= 0; i--) {
+                frame += (char)(((uint64_t)payload.size() >> (8 * i)) & 0xff);
+            }
+        }
+        if (masked) {
+            frame.append((const char *)mask, sizeof(mask));
+        }
+        for (size_t i = 0; i < payload.size(); i++) {
+            frame += (char)(payload[i] ^ (masked ? mask[i & 3] : 0));
+        }
+        return send(frame);
+    }
+
+    /* Returns the next frame, or one with opcode -1 if the connection failed */
+    Frame recv_frame()
+    {
+        Frame frame = {-1, false, ""};
+
+        if (!need(2)) {
+            return frame;
+        }
+        uint8_t b0 = mBuf[0], b1 = mBuf[1];
+        size_t hdr_len = 2;
+        uint64_t len = b1 & 0x7f;
+        if (len >= 126) {
+            size_t bytes = len == 126 ? 2 : 8;
+            if (!need(2 + bytes)) {
+                return frame;
+            }
+            len = 0;
+            for (size_t i = 0; i < bytes; i++) {
+                len = (len << 8) | (uint8_t)mBuf[2 + i];
+            }
+            hdr_len += bytes;
+        }
+        if ((b1 & 0x80) || !need(hdr_len + len)) {
+            // frames from the server must not be masked
+            return frame;
+        }
+        frame.opcode = b0 & 0x0f;
+        frame.fin = (b0 & 0x80) != 0;
+        frame.payload = mBuf.substr(hdr_len, len);
+        mBuf.erase(0, hdr_len + len);
+        return frame;
+    }
+
+protected:
+    bool need(size_t len)
+    {
+        while (mBuf.size() < len) {
+            if (!fill()) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+static const std::string ws_close_payload(uint16_t status)
+{
+    return std::string{(char)(status >> 8), (char)(status & 0xff)};
+}
+
+/* The WebSocket routes of a test server */
+static void ws_register(TestServer &server, bool control_frames)
+{
+    httpd_uri_t uri = {"/ws", HTTP_GET, ws_echo_handler, nullptr};
+    uri.is_websocket = true;
+    uri.handle_ws_control_frames = control_frames;
+    REQUIRE(httpd_register_uri_handler(server.handle, &uri) == ESP_OK);
+
+    std::lock_guard<std::mutex> guard(ws.lock);
+    ws.types.clear();
+    ws.failed = 0;
+}
+
+TEST_CASE("WebSocket handshake upgrades the session", "[esp_http_server][ws]")
+{
+    for (uint16_t workers : {0, 2}) {
+        TestServer server(workers, 0);
+        ws_register(server, false);
+
+        WsClient client(server.port);
+        REQUIRE(client.connected);
+        std::string response = client.handshake("/ws");
+        CHECK(response.find("HTTP/1.1 101 Switching Protocols\r\n") == 0);
+        CHECK(response.find("Upgrade: websocket\r\n") != std::string::npos);
+        // the example of RFC 6455
+        CHECK(response.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n") != std::string::npos);
+        CHECK(httpd_ws_get_fd_info(server.handle, ws.fd) == HTTPD_WS_CLIENT_WEBSOCKET);
+        CHECK(httpd_ws_get_fd_info(server.handle, -1) == HTTPD_WS_CLIENT_INVALID);
+
+        // frames of all the length encodings come back as they went out
+        for (size_t len : {0, 5, 125, 126, 4000, 70000}) {
+            std::string payload(len, 'a' + len % 26);
+            CHECK(client.send_frame(HTTPD_WS_TYPE_BINARY, payload));
+            WsClient::Frame frame = client.recv_frame();
+            CHECK(frame.opcode == HTTPD_WS_TYPE_BINARY);
+            CHECK(frame.fin);
+            CHECK(frame.payload == payload);
+        }
+        CHECK(ws.failed == 0);
+    }
+}
+
+TEST_CASE("WebSocket handshake is checked", "[esp_http_server][ws]")
+{
+    TestServer server(0, 0);
+    ws_register(server, false);
+
+    // upgrades of plain HTTP routes aren't supported
+    WsClient plain(server.port);
+    REQUIRE(plain.connected);
+    plain.send("GET /fast HTTP/1.1\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+               "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n");
+    CHECK(plain.response() == "Upgrade not supported by server");
+    CHECK(plain.headers.find("HTTP/1.1 200 OK\r\n") == 0);
+
+    WsClient client(server.port);
+    REQUIRE(client.connected);
+    client.send("GET /ws HTTP/1.1\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                "Sec-WebSocket-Version: 13\r\n\r\n");
+    CHECK(client.receive_until("\r\n\r\n").find("HTTP/1.1 400 ") == 0);
+    CHECK(client.closed());
+}
+
+TEST_CASE("WebSocket messages may be fragmented", "[esp_http_server][ws]")
+{
+    TestServer server(0, 0);
+    ws_register(server, false);
+    WsClient client(server.port);
+    REQUIRE(client.connected);
+    REQUIRE(client.handshake("/ws").find(" 101 ") != std::string::npos);
+
+    // control frames may come in between the fragments
+    CHECK(client.send_frame(HTTPD_WS_TYPE_TEXT, "Hel", false));
+    CHECK(client.send_frame(HTTPD_WS_TYPE_PING, "ping"));
+    CHECK(client.send_frame(HTTPD_WS_TYPE_CONTINUE, "lo, ", false));
+    CHECK(client.send_frame(HTTPD_WS_TYPE_CONTINUE, "world"));
+
+    const WsClient::Frame expected[] = {
+        {HTTPD_WS_TYPE_TEXT, false, "Hel"},
+        {HTTPD_WS_TYPE_PONG, true, "ping"},
+        {HTTPD_WS_TYPE_CONTINUE, false, "lo, "},
+        {HTTPD_WS_TYPE_CONTINUE, true, "world"},
+    };
+    for (const auto &e : expected) {
+        WsClient::Frame frame = client.recv_frame();
+        CHECK(frame.opcode == e.opcode);
+        CHECK(frame.fin == e.fin);
+        CHECK(frame.payload == e.payload);
+    }
+    std::lock_guard<std::mutex> guard(ws.lock);
+    CHECK(ws.types == std::vector<httpd_ws_type_t> {HTTPD_WS_TYPE_TEXT, HTTPD_WS_TYPE_CONTINUE,
+                                                    HTTPD_WS_TYPE_CONTINUE});
+}
+
+TEST_CASE("WebSocket sessions are closed on protocol errors", "[esp_http_server][ws]")
+{
+    TestServer server(0, 0);
+    ws_register(server, false);
+
+    const std::pair<std::string, std::function<void(WsClient &)>> cases[] = {
+        {"unmasked", [](WsClient & c) { c.send_frame(HTTPD_WS_TYPE_TEXT, "x", true, false); }},
+        {"continuation", [](WsClient & c) { c.send_frame(HTTPD_WS_TYPE_CONTINUE, "x"); }},
+        {"fragmented control", [](WsClient & c) { c.send_frame(HTTPD_WS_TYPE_PING, "x", false); }},
+        {"long control", [](WsClient & c) { c.send_frame(HTTPD_WS_TYPE_PING, std::string(126, 'x')); }},
+        {"unknown opcode", [](WsClient & c) { c.send_frame(3, "x"); }},
+        {"interleaved message", [](WsClient & c) {
+                c.send_frame(HTTPD_WS_TYPE_TEXT, "x", false);
+                c.send_frame(HTTPD_WS_TYPE_TEXT, "y");
+            }
+        },
+    };
+    for (const auto &c : cases) {
+        INFO(c.first);
+        WsClient client(server.port);
+        REQUIRE(client.connected);
+        REQUIRE(client.handshake("/ws").find(" 101 ") != std::string::npos);
+        c.second(client);
+
+        WsClient::Frame frame = client.recv_frame();
+        if (c.first == "interleaved message") {
+            CHECK(frame.payload == "x");
+            frame = client.recv_frame();
+        }
+        CHECK(frame.opcode == HTTPD_WS_TYPE_CLOSE);
+        CHECK(frame.payload == ws_close_payload(1002));
+        CHECK(client.closed());
+    }
+}
+
+TEST_CASE("WebSocket close is echoed before the session is closed", "[esp_http_server][ws]")
+{
+    for (bool control_frames : {false, true}) {
+        TestServer server(0, 0);
+        ws_register(server, control_frames);
+        WsClient client(server.port);
+        REQUIRE(client.connected);
+        REQUIRE(client.handshake("/ws").find(" 101 ") != std::string::npos);
+
+        CHECK(client.send_frame(HTTPD_WS_TYPE_PING, "abc"));
+        CHECK(client.send_frame(HTTPD_WS_TYPE_CLOSE, ws_close_payload(1001) + "going away"));
+
+        // the echo handler answers the frames itself when it gets them
+        WsClient::Frame frame = client.recv_frame();
+        CHECK(frame.opcode == (control_frames ? HTTPD_WS_TYPE_PING : HTTPD_WS_TYPE_PONG));
+        CHECK(frame.payload == "abc");
+        if (control_frames) {
+            frame = client.recv_frame();
+            CHECK(frame.opcode == HTTPD_WS_TYPE_CLOSE);
+            CHECK(frame.payload == ws_close_payload(1001) + "going away");
+        } else {
+            frame = client.recv_frame();
+            CHECK(frame.opcode == HTTPD_WS_TYPE_CLOSE);
+            CHECK(frame.payload == ws_close_payload(1001));
+        }
+        CHECK(client.closed());
+
+        std::lock_guard<std::mutex> guard(ws.lock);
+        CHECK(ws.types.size() == (control_frames ? 2 : 0));
+    }
+}
+
+struct WsAsyncSend {
+    WsAsyncSend(httpd_handle_t hd, int fd, const std::string &text) : hd(hd), fd(fd), text(text)
+    {
+    }
+
+    httpd_handle_t hd;
+    int fd;
+    std::string text;
+    std::atomic<int> result{-1};
+};
+
+static void ws_async_send(void *arg)
+{
+    WsAsyncSend *send = static_cast<WsAsyncSend *>(arg);
+    httpd_ws_frame_t frame = {};
+
+    frame.type = HTTPD_WS_TYPE_TEXT;
+    frame.payload = (uint8_t *)&send->text[0];
+    frame.len = send->text.size();
+    send->result = httpd_ws_send_frame_async(send->hd, send->fd, &frame);
+}
+
+TEST_CASE("WebSocket frames are sent from other tasks through the work queue", "[esp_http_server][ws]")
+{
+    TestServer server(2, 0);
+    ws_register(server, false);
+    WsClient client(server.port);
+    REQUIRE(client.connected);
+    REQUIRE(client.handshake("/ws").find(" 101 ") != std::string::npos);
+
+    const int count = 10;
+    std::vector<std::unique_ptr<WsAsyncSend>> sends;
+    std::thread sender([&]() {
+        for (int i = 0; i < count; i++) {
+            sends.emplace_back(new WsAsyncSend{server.handle, ws.fd, "event " + std::to_string(i)});
+            httpd_queue_work(server.handle, ws_async_send, sends.back().get());
+        }
+    });
+    sender.join();
+    for (int i = 0; i < count; i++) {
+        WsClient::Frame frame = client.recv_frame();
+        CHECK(frame.opcode == HTTPD_WS_TYPE_TEXT);
+        CHECK(frame.payload == "event " + std::to_string(i));
+    }
+    for (const auto &send : sends) {
+        CHECK(send->result == ESP_OK);
+    }
+
+    // not upgraded, or gone
+    WsAsyncSend gone{server.handle, -1, "x"};
+    ws_async_send(&gone);
+    CHECK(gone.result == ESP_ERR_INVALID_ARG);
+}
+
+/* Keeps the session on its worker until released, after sending the frame back from the handler's task */
+struct WsHold {
+    std::mutex lock;
+    std::condition_variable changed;
+    bool held = false;
+    bool released = false;
+    esp_err_t own_send = ESP_FAIL;
+} ws_hold;
+
+static esp_err_t ws_hold_handler(httpd_req_t *req)
+{
+    if (req->method == HTTP_GET) {
+        ws.fd = httpd_req_to_sockfd(req);
+        ws.handshakes++;
+        return ESP_OK;
+    }
+
+    httpd_ws_frame_t frame = {};
+    std::vector<uint8_t> payload(16);
+    frame.payload = payload.data();
+    if (httpd_ws_recv_frame(req, &frame, payload.size()) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    esp_err_t own_send = httpd_ws_send_frame_async(req->handle, httpd_req_to_sockfd(req), &frame);
+
+    std::unique_lock<std::mutex> guard(ws_hold.lock);
+    ws_hold.own_send = own_send;
+    ws_hold.held = true;
+    ws_hold.changed.notify_all();
+    ws_hold.changed.wait(guard, []() { return ws_hold.released; });
+    return ESP_OK;
+}
+
+TEST_CASE("WebSocket frames are only sent to a session being processed by its handler", "[esp_http_server][ws]")
+{
+    TestServer server(2, 0);
+    httpd_uri_t uri = {"/ws-hold", HTTP_GET, ws_hold_handler, nullptr};
+    uri.is_websocket = true;
+    REQUIRE(httpd_register_uri_handler(server.handle, &uri) == ESP_OK);
+    ws_hold.held = false;
+    ws_hold.released = false;
+
+    WsClient client(server.port);
+    REQUIRE(client.connected);
+    REQUIRE(client.handshake("/ws-hold").find(" 101 ") != std::string::npos);
+    REQUIRE(client.send_frame(HTTPD_WS_TYPE_TEXT, "own"));
+    {
+        std::unique_lock<std::mutex> guard(ws_hold.lock);
+        REQUIRE(ws_hold.changed.wait_for(guard, std::chrono::seconds(5), []() { return ws_hold.held; }));
+    }
+    CHECK(ws_hold.own_send == ESP_OK);
+
+    // the server thread can't send while the worker has the session
+    WsAsyncSend busy{server.handle, ws.fd, "busy"};
+    httpd_queue_work(server.handle, ws_async_send, &busy);
+    for (int i = 0; i < 5000 && busy.result == -1; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(busy.result == ESP_ERR_INVALID_STATE);
+
+    {
+        std::lock_guard<std::mutex> guard(ws_hold.lock);
+        ws_hold.released = true;
+        ws_hold.changed.notify_all();
+    }
+    WsClient::Frame frame = client.recv_frame();
+    CHECK(frame.opcode == HTTPD_WS_TYPE_TEXT);
+    CHECK(frame.payload == "own");
+}
+
+/* Directory of files for the static file handler, removed with its content */
+class StaticDir
+{
+public:
+    StaticDir()
+    {
+        char tmpl[] = "/tmp/httpd_static_XXXXXX";
+        path = mkdtemp(tmpl);
+    }
+
+    ~StaticDir()
+    {
+        std::string cmd = "rm -rf " + path;
+        system(cmd.c_str());
+    }
+
+    void write(const std::string &name, const std::string &content)
+    {
+        std::string file = path + "/" + name;
+        mkdir(file.substr(0, file.rfind('/')).c_str(), 0700);
+        FILE *f = fopen(file.c_str(), "wb");
+        REQUIRE(f);
+        fwrite(content.data(), 1, content.size(), f);
+        fclose(f);
+    }
+
+    std::string path;
+};
+
+static std::string static_get(Client &client, const std::string &uri, const std::string &headers = "")
+{
+    client.send("GET " + uri + " HTTP/1.1\r\nHost: test\r\n" + headers + "\r\n");
+    return client.response();
+}
+
+static bool has_header(Client &client, const std::string &header)
+{
+    return client.headers.find("\r\n" + header + "\r\n") != std::string::npos;
+}
+
+/* Value of a header of the last response */
+static std::string header_value(Client &client, const std::string &field)
+{
+    size_t pos = client.headers.find("\r\n" + field + ": ");
+    if (pos == std::string::npos) {
+        return "";
+    }
+    pos += field.size() + 4;
+    return client.headers.substr(pos, client.headers.find("\r\n", pos) - pos);
+}
+
+TEST_CASE("static files are served from a directory", "[esp_http_server][static]")
+{
+    TestServer server(0, 0);
+    StaticDir dir;
+    dir.write("index.html", "<html>index</html>");
+    dir.write("app.js", "console.log(1)");
+    dir.write("sub/data.json", "{\"a\": 1}");
+    dir.write("sub/index.html", "sub index");
+    dir.write("with space.txt", "space");
+    dir.write("../httpd_static_secret", "secret");
+
+    httpd_static_config_t config = HTTPD_STATIC_DEFAULT_CONFIG();
+    config.uri_prefix = "/www/";
+    config.base_path = dir.path.c_str();
+    config.cache_control = "max-age=60";
+    REQUIRE(httpd_register_static(server.handle, &config) == ESP_OK);
+    CHECK(httpd_register_static(server.handle, &config) == ESP_ERR_HTTPD_HANDLER_EXISTS);
+    Client client(server.port);
+    REQUIRE(client.connected);
+
+    CHECK(static_get(client, "/www/app.js") == "console.log(1)");
+    CHECK(has_header(client, "Content-Type: application/javascript"));
+    CHECK(has_header(client, "Cache-Control: max-age=60"));
+    CHECK(has_header(client, "Vary: Accept-Encoding"));
+    CHECK(!has_header(client, "Content-Encoding: gzip"));
+    CHECK(static_get(client, "/www/sub/data.json?x=1") == "{\"a\": 1}");
+    CHECK(has_header(client, "Content-Type: application/json"));
+    CHECK(static_get(client, "/www/") == "<html>index</html>");
+    CHECK(has_header(client, "Content-Type: text/html"));
+    CHECK(static_get(client, "/www/sub/") == "sub index");
+    CHECK(static_get(client, "/www/with%20space.txt") == "space");
+    // absolute-form request targets, as sent to proxies
+    CHECK(static_get(client, "http://test/www/app.js") == "console.log(1)");
+    CHECK(static_get(client, "http://test:80/www/sub/data.json?x=1") == "{\"a\": 1}");
+    CHECK(static_get(client, "http://test/www/") == "<html>index</html>");
+
+    const char *missing[] = {
+        "/www/missing.js", "/www/sub", "/www/../httpd_static_secret", "/www/%2e%2e/httpd_static_secret",
+        "/www/sub/%2E%2E/../httpd_static_secret", "/www/app.js%00", "/www/app.js%2",
+    };
+    for (const char *uri : missing) {
+        INFO(uri);
+        CHECK(static_get(client, uri) == "This URI doesn't exist");
+        CHECK(client.headers.find("HTTP/1.1 404 ") == 0);
+    }
+    // the prefix itself isn't a file
+    CHECK(static_get(client, "/www") == "This URI doesn't exist");
+
+    CHECK(httpd_unregister_static(server.handle, "/www") == ESP_OK);
+    CHECK(httpd_unregister_static(server.handle, "/www") == ESP_ERR_NOT_FOUND);
+    CHECK(static_get(client, "/www/app.js") == "This URI doesn't exist");
+
+    // without an index, and at the root
+    config.uri_prefix = "/";
+    config.index_file = NULL;
+    REQUIRE(httpd_register_static(server.handle, &config) == ESP_OK);
+    CHECK(static_get(client, "/app.js") == "console.log(1)");
+    CHECK(static_get(client, "/") == "This URI doesn't exist");
+    CHECK(static_get(client, "/fast") == "ok");
+    remove((dir.path + "/../httpd_static_secret").c_str());
+}
+
+TEST_CASE("static files are served pre-compressed to clients accepting gzip", "[esp_http_server][static]")
+{
+    TestServer server(0, 0);
+    StaticDir dir;
+    dir.write("app.js", "plain");
+    dir.write("app.js.gz", "compressed");
+    dir.write("only.css.gz", "compressed only");
+
+    httpd_static_config_t config = HTTPD_STATIC_DEFAULT_CONFIG();
+    config.base_path = dir.path.c_str();
+    REQUIRE(httpd_register_static(server.handle, &config) == ESP_OK);
+    Client client(server.port);
+    REQUIRE(client.connected);
+
+    CHECK(static_get(client, "/app.js", "Accept-Encoding: deflate, gzip, br\r\n") == "compressed");
+    CHECK(has_header(client, "Content-Encoding: gzip"));
+    CHECK(has_header(client, "Content-Type: application/javascript"));
+    CHECK(static_get(client, "/app.js", "Accept-Encoding: *\r\n") == "compressed");
+    CHECK(static_get(client, "/app.js", "Accept-Encoding: gzip;q=0.5\r\n") == "compressed");
+
+    CHECK(static_get(client, "/app.js") == "plain");
+    CHECK(!has_header(client, "Content-Encoding: gzip"));
+    CHECK(static_get(client, "/app.js", "Accept-Encoding: gzip;q=0, deflate\r\n") == "plain");
+    CHECK(static_get(client, "/app.js", "Accept-Encoding: x-gzip-like\r\n") == "plain");
+
+    CHECK(static_get(client, "/only.css", "Accept-Encoding: gzip\r\n") == "compressed only");
+    CHECK(has_header(client, "Content-Type: text/css"));
+    CHECK(static_get(client, "/only.css") == "This URI doesn't exist");
+}
+
+TEST_CASE("static files are validated with content hash ETags", "[esp_http_server][static]")
+{
+    TestServer server(0, 0);
+    StaticDir dir;
+    dir.write("app.js", "version 1");
+    dir.write("app.js.gz", "version 1 compressed");
+    dir.write("copy.js", "version 1");
+
+    httpd_static_config_t config = HTTPD_STATIC_DEFAULT_CONFIG();
+    config.base_path = dir.path.c_str();
+    config.etag_cache_size = 2;
+    REQUIRE(httpd_register_static(server.handle, &config) == ESP_OK);
+    Client client(server.port);
+    REQUIRE(client.connected);
+
+    CHECK(static_get(client, "/app.js") == "version 1");
+    std::string etag = header_value(client, "ETag");
+    CHECK(etag.size() == 18);
+    CHECK(static_get(client, "/copy.js") == "version 1");
+    CHECK(header_value(client, "ETag") == etag);
+    CHECK(static_get(client, "/app.js", "Accept-Encoding: gzip\r\n") == "version 1 compressed");
+    std::string gzip_etag = header_value(client, "ETag");
+    CHECK(gzip_etag != etag);
+
+    // the cached copy of the client is still valid
+    const std::string conditions[] = {etag, "W/" + etag, "\"other\", " + etag, "*"};
+    for (const auto &condition : conditions) {
+        INFO(condition);
+        CHECK(static_get(client, "/app.js", "If-None-Match: " + condition + "\r\n") == "");
+        CHECK(client.headers.find("HTTP/1.1 304 Not Modified\r\n") == 0);
+        CHECK(header_value(client, "ETag") == etag);
+    }
+    CHECK(static_get(client, "/app.js", "If-None-Match: " + gzip_etag + "\r\n") == "version 1");
+    CHECK(static_get(client, "/app.js", "If-None-Match: " + etag + "\r\nAccept-Encoding: gzip\r\n") ==
+          "version 1 compressed");
+
+    // files are hashed again once changed
+    dir.write("app.js", "version 2 is longer");
+    CHECK(static_get(client, "/app.js", "If-None-Match: " + etag + "\r\n") == "version 2 is longer");
+    CHECK(header_value(client, "ETag") != etag);
+    CHECK(static_get(client, "/copy.js", "If-None-Match: " + etag + "\r\n") == "");
+
+    // no ETags at all
+    CHECK(httpd_unregister_static(server.handle, "/") == ESP_OK);
+    config.etag_cache_size = 0;
+    REQUIRE(httpd_register_static(server.handle, &config) == ESP_OK);
+    CHECK(static_get(client, "/copy.js", "If-None-Match: *\r\n") == "version 1");
+    CHECK(header_value(client, "ETag") == "");
+}
+
+TEST_CASE("large static files are streamed by the workers", "[esp_http_server][static]")
+{
+    TestServer server(2, 0);
+    StaticDir dir;
+    std::string content;
+    for (int i = 0; content.size() < 300000; i++) {
+        content += std::to_string(i) + ",";
+    }
+    dir.write("big.txt", content);
+    dir.write("empty.txt", "");
+
+    httpd_static_config_t config = HTTPD_STATIC_DEFAULT_CONFIG();
+    config.base_path = dir.path.c_str();
+    config.read_size = 1000;
+    REQUIRE(httpd_register_static(server.handle, &config) == ESP_OK);
+
+    std::vector<std::thread> threads;
+    std::atomic<int> ok{0};
+    for (int i = 0; i < 4; i++) {
+        threads.emplace_back([&]() {
+            Client client(server.port);
+            for (int j = 0; j < 3; j++) {
+                if (client.connected && static_get(client, "/big.txt") == content &&
+                    static_get(client, "/empty.txt") == "" && client.headers.find("HTTP/1.1 200 OK") == 0) {
+                    ok++;
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    CHECK(ok == 12);
+
+    config.read_size = HTTPD_STATIC_READ_ALIGN - 1;
+    config.uri_prefix = "/small";
+    CHECK(httpd_register_static(server.handle, &config) == ESP_ERR_INVALID_ARG);
+}
+
+/* Layout of the control messages queued by httpd_queue_work() */
+struct CtrlMsg {
+    int msg;
+    httpd_work_fn_t work;
+    void *arg;
+};
+
+/* Session database of a server instance without sockets, checked against
+ * a plain model of the open descriptors in least recently used order */
+struct SessionModel {
+    struct httpd_data hd = {};
+    std::list<int> lru;
+    std::set<int> touched;
+
+    explicit SessionModel(uint16_t max_open_sockets)
+    {
+        hd.config.max_open_sockets = max_open_sockets;
+        hd.config.ctrl_port = 34000;
+        hd.hd_sd = static_cast<struct sock_db *>(calloc(max_open_sockets, sizeof(struct sock_db)));
+        hd.hd_sd_map = static_cast<struct sock_db **>(calloc(httpd_sess_map_size(max_open_sockets),
+                                                             sizeof(struct sock_db *)));
+        hd.msg_fd = cs_create_ctrl_sock(hd.config.ctrl_port);
+        httpd_sess_init(&hd);
+    }
+
+    ~SessionModel()
+    {
+        cs_free_ctrl_sock(hd.msg_fd);
+        free(hd.hd_sd_map);
+        free(hd.hd_sd);
+    }
+
+    void check()
+    {
+        std::vector<int> order;
+        int fd = -1;
+        while ((fd = httpd_sess_iterate(&hd, fd)) != -1) {
+            order.push_back(fd);
+        }
+        REQUIRE(order == std::vector<int>(lru.begin(), lru.end()));
+        REQUIRE(httpd_is_sess_available(&hd) == (lru.size() < hd.config.max_open_sockets));
+    }
+
+    void touch(int fd)
+    {
+        lru.remove(fd);
+        lru.push_back(fd);
+        touched.erase(fd);
+    }
+
+    /* Session that httpd_sess_close_lru() should pick, moving the touched
+     * sessions it walks past to the most recent end */
+    int expected_lru()
+    {
+        std::vector<int> walk(lru.begin(), lru.end());
+        for (size_t i = 0; i < walk.size(); i++) {
+            if (touched.count(walk[i])) {
+                touch(walk[i]);
+                walk.push_back(walk[i]);
+                continue;
+            }
+            if (httpd_sess_get(&hd, walk[i])->worker == NULL) {
+                return walk[i];
+            }
+        }
+        return -1;
+    }
+
+    /* Descriptor of the session whose closure was queued */
+    int queued_close()
+    {
+        struct CtrlMsg msg = {};
+        REQUIRE(recv(hd.msg_fd, &msg, sizeof(msg), 0) == sizeof(msg));
+        return static_cast<struct sock_db *>(msg.arg)->fd;
+    }
+};
+
+TEST_CASE("hundreds of sessions are looked up and evicted in LRU order", "[esp_http_server][sessions]")
+{
+    const int max_sessions = 500;
+    SessionModel model(max_sessions);
+    REQUIRE(model.hd.msg_fd >= 0);
+    struct httpd_data *hd = &model.hd;
+    std::mt19937 rng(19);
+    /* Descriptors spread over more values than the map has slots, so that
+     * they collide and wrap around in it */
+    auto random_fd = [&]() {
+        return 3 + (int)(rng() % (4 * httpd_sess_map_size(max_sessions)));
+    };
+    auto random_open = [&]() {
+        auto it = model.lru.begin();
+        std::advance(it, rng() % model.lru.size());
+        return *it;
+    };
+    struct httpd_worker *busy = reinterpret_cast<struct httpd_worker *>(&model);
+
+    for (int i = 0; i < 200000; i++) {
+        int op = rng() % 100;
+        if (model.lru.empty() || op < 30) {
+            int fd = random_fd();
+            bool open = std::find(model.lru.begin(), model.lru.end(), fd) != model.lru.end();
+            if (open || !httpd_is_sess_available(hd)) {
+                REQUIRE(httpd_sess_new(hd, fd) == ESP_FAIL);
+            } else {
+                REQUIRE(httpd_sess_new(hd, fd) == ESP_OK);
+                model.lru.push_back(fd);
+            }
+        } else if (op < 45) {
+            int fd = random_open();
+            auto it = std::find(model.lru.begin(), model.lru.end(), fd);
+            int prev = it == model.lru.begin() ? -1 : *std::prev(it);
+            REQUIRE(httpd_sess_delete(hd, fd) == prev);
+            model.lru.erase(it);
+            model.touched.erase(fd);
+        } else if (op < 60) {
+            int fd = random_fd();
+            bool open = std::find(model.lru.begin(), model.lru.end(), fd) != model.lru.end();
+            struct sock_db *sd = httpd_sess_get(hd, fd);
+            REQUIRE((sd != NULL) == open);
+            if (sd) {
+                REQUIRE(sd->fd == fd);
+            }
+        } else if (op < 70) {
+            int fd = random_open();
+            httpd_sess_lru_touch(hd, httpd_sess_get(hd, fd));
+            model.touch(fd);
+        } else if (op < 85) {
+            int fd = random_open();
+            REQUIRE(httpd_sess_update_lru_counter(hd, fd) == ESP_OK);
+            model.touched.insert(fd);
+        } else if (op < 90) {
+            struct sock_db *sd = httpd_sess_get(hd, random_open());
+            sd->worker = sd->worker ? NULL : busy;
+        } else {
+            if (httpd_is_sess_available(hd)) {
+                REQUIRE(httpd_sess_close_lru(hd) == ESP_OK);
+                continue;
+            }
+            int fd = model.expected_lru();
+            if (fd < 0) {
+                REQUIRE(httpd_sess_close_lru(hd) == ESP_ERR_NOT_FOUND);
+            } else {
+                REQUIRE(httpd_sess_close_lru(hd) == ESP_OK);
+                REQUIRE(model.queued_close() == fd);
+                /* As the queued work would */
+                httpd_sess_delete(hd, fd);
+                model.lru.remove(fd);
+                model.touched.erase(fd);
+            }
+        }
+        if (i % 1000 == 0 || model.lru.size() == max_sessions) {
+            model.check();
+        }
+    }
+    model.check();
+    CHECK(httpd_sess_update_lru_counter(hd, -1) == ESP_ERR_NOT_FOUND);
+    CHECK(httpd_sess_get(hd, -1) == NULL);
+}
+
+static esp_err_t null_handler(httpd_req_t *req)
+{
+    return ESP_OK;
+}
+
+TEST_CASE("dump esp_http_server URI routing performance", "[esp_http_server][benchmark]")
+{
+    const int routes = 200;
+    const int lookups = 100000;
+    struct httpd_data hd = {};
+    std::vector<std::string> patterns;
+
+    // the router alone, without sockets: server instance data with just the handlers
+    hd.config.max_uri_handlers = routes;
+    hd.hd_calls = static_cast<httpd_uri_t **>(calloc(routes, sizeof(httpd_uri_t *)));
+    REQUIRE(httpd_os_sem_create(&hd.hd_router_lock) == OS_SUCCESS);
+    httpd_os_sem_give(hd.hd_router_lock);
+    for (int i = 0; i < routes; i++) {
+        if (i % 4 == 3) {
+            patterns.push_back("/api/v1/device" + std::to_string(i) + "/{id}/state");
+        } else {
+            patterns.push_back("/api/v1/resource" + std::to_string(i) + "/items");
+        }
+        httpd_uri_t uri = {patterns.back().c_str(), HTTP_GET, null_handler, nullptr};
+        REQUIRE(httpd_register_uri_handler(&hd, &uri) == ESP_OK);
+    }
+
+    for (const char *path : {"/api/v1/resource0/items", "/api/v1/resource198/items",
+                             "/api/v1/device199/1234/state"}) {
+        struct httpd_req_aux aux = {};
+        httpd_req_t req = {};
+        req.aux = &aux;
+        req.method = HTTP_GET;
+        snprintf(const_cast<char *>(req.uri), sizeof(req.uri), "%s", path);
+        REQUIRE(http_parser_parse_url(req.uri, strlen(req.uri), 0, &aux.url_parse_res) == 0);
+
+        auto start = steady_clock::now();
+        for (int i = 0; i < lookups; i++) {
+            REQUIRE(httpd_uri(&hd, &req) == ESP_OK);
+        }
+        auto elapsed = duration_cast<nanoseconds>(steady_clock::now() - start);
+        printf("%d routes, %-30s %5.0f ns per lookup\n", routes, path, (double)elapsed.count() / lookups);
+    }
+
+    httpd_unregister_all_uri_handlers(&hd);
+    httpd_os_sem_delete(hd.hd_router_lock);
+    free(hd.hd_calls);
+}
+
+TEST_CASE("dump esp_http_server concurrency performance", "[esp_http_server][benchmark]")
+{
+    const int slow_clients = 4;
+    const int fast_clients = 4;
+    const auto run_time = seconds(1);
+
+    for (uint16_t workers : {0, 2, 4, 8}) {
+        TestServer server(workers, 20, slow_clients + fast_clients + 2);
+        std::atomic<bool> running{true};
+        std::atomic<int> slow_done{0};
+        std::mutex lock;
+        std::vector<double> latencies;
+        std::vector<std::thread> threads;
+
+        // load generator: the slow clients keep the handlers busy, the fast ones measure the latency
+        for (int i = 0; i < slow_clients + fast_clients; i++) {
+            bool slow = i < slow_clients;
+            threads.emplace_back([&, slow]() {
+                Client client(server.port);
+                std::vector<double> own;
+
+                while (client.connected && running) {
+                    auto start = steady_clock::now();
+                    if (!client.get(slow ? "/slow" : "/fast") || client.response() != "ok") {
+                        break;
+                    }
+                    if (slow) {
+                        slow_done++;
+                    } else {
+                        own.push_back(duration_cast<duration<double, std::micro>>(steady_clock::now() - start).count());
+                    }
+                }
+                std::lock_guard<std::mutex> guard(lock);
+                latencies.insert(latencies.end(), own.begin(), own.end());
+            });
+        }
+        std::this_thread::sleep_for(run_time);
+        running = false;
+        for (auto &thread : threads) {
+            thread.join();
+        }
+
+        CHECK(server.stats.failed == 0);
+        CHECK(server.stats.overlapping == 0);
+        REQUIRE(!latencies.empty());
+        std::sort(latencies.begin(), latencies.end());
+        double mean = 0;
+        for (double latency : latencies) {
+            mean += latency;
+        }
+        mean /= latencies.size();
+        printf("%u workers: %d slow req/s, %zu fast req/s, fast latency mean %.0f us, p99 %.0f us\n",
+               workers, slow_done.load(), latencies.size(), mean, latencies[latencies.size() * 99 / 100]);
+    }
+}
+
+TEST_CASE("dump esp_http_server response writes", "[esp_http_server][benchmark]")
+{
+    const int requests = 100;
+    TestServer server(0, 0);
+    Client client(server.port);
+    REQUIRE(client.connected);
+
+    for (int headers : {0, 4}) {
+        for (size_t body_len : {16, 256, 1024, 4096}) {
+            shape.headers = headers;
+            shape.body_len = body_len;
+            REQUIRE(client.get("/shape"));
+            REQUIRE(client.response().size() == body_len);
+            response_writes();
+
+            int writes = 0;
+            uint32_t segments = sent_segments(shape.fd);
+            for (int i = 0; i < requests; i++) {
+                REQUIRE(client.get("/shape"));
+                REQUIRE(client.response().size() == body_len);
+                writes += response_writes();
+            }
+            segments = sent_segments(shape.fd) - segments;
+            printf("%d custom headers, %4zu bytes body: %.1f writes, %.1f segments per response\n",
+                   headers, body_len, (double)writes / requests, (double)segments / requests);
+        }
+    }
+    CHECK(server.stats.failed == 0);
+}
+
+/* The usual hand-written handler: the file is read with stdio into a small
+ * buffer, each piece of which is sent as a chunk */
+static esp_err_t file_chunk_handler(httpd_req_t *req)
+{
+    const std::string *path = static_cast<const std::string *>(req->user_ctx);
+    char buf[1024];
+    size_t len;
+
+    FILE *f = fopen(path->c_str(), "r");
+    if (f == NULL) {
+        return httpd_resp_send_404(req);
+    }
+    httpd_resp_set_type(req, "text/plain");
+    while ((len = fread(buf, 1, sizeof(buf), f)) > 0) {
+        if (httpd_resp_send_chunk(req, buf, len) != ESP_OK) {
+            fclose(f);
+            return ESP_FAIL;
+        }
+    }
+    fclose(f);
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+TEST_CASE("dump esp_http_server static file throughput", "[esp_http_server][benchmark]")
+{
+    TestServer server(0, 0);
+    StaticDir dir;
+    for (size_t size : {16 * 1024, 1024 * 1024}) {
+        dir.write("file" + std::to_string(size) + ".txt", std::string(size, 'f'));
+    }
+    std::string hand_path = dir.path + "/file";
+
+    httpd_static_config_t config = HTTPD_STATIC_DEFAULT_CONFIG();
+    config.uri_prefix = "/static";
+    config.base_path = dir.path.c_str();
+    REQUIRE(httpd_register_static(server.handle, &config) == ESP_OK);
+    Client client(server.port);
+    REQUIRE(client.connected);
+
+    for (size_t size : {16 * 1024, 1024 * 1024}) {
+        const std::string name = "file" + std::to_string(size) + ".txt";
+        const std::string path = dir.path + "/" + name;
+        httpd_uri_t uri = {"/chunked-file", HTTP_GET, file_chunk_handler, (void *)&path};
+        REQUIRE(httpd_register_uri_handler(server.handle, &uri) == ESP_OK);
+        int requests = size < 100000 ? 2000 : 100;
+
+        auto start = steady_clock::now();
+        for (int i = 0; i < requests; i++) {
+            REQUIRE(client.get("/chunked-file"));
+            REQUIRE(client.receive_until("\r\n0\r\n\r\n").size() > size);
+        }
+        double hand = duration_cast<microseconds>(steady_clock::now() - start).count() / 1e6;
+
+        start = steady_clock::now();
+        for (int i = 0; i < requests; i++) {
+            REQUIRE(static_get(client, "/static/" + name).size() == size);
+        }
+        double engine = duration_cast<microseconds>(steady_clock::now() - start).count() / 1e6;
+
+        start = steady_clock::now();
+        std::string etag;
+        for (int i = 0; i < requests; i++) {
+            REQUIRE(static_get(client, "/static/" + name, etag).size() == (i == 0 ? size : 0));
+            etag = "If-None-Match: " + header_value(client, "ETag") + "\r\n";
+        }
+        double cached = duration_cast<microseconds>(steady_clock::now() - start).count() / 1e6;
+
+        double mb = (double)size * requests / (1024 * 1024);
+        printf("%7zu bytes file: fread + chunks %7.1f MB/s, static handler %7.1f MB/s, "
+               "revalidated %6.0f requests/s\n", size, mb / hand, mb / engine, requests / cached);
+        REQUIRE(httpd_unregister_uri(server.handle, "/chunked-file") == ESP_OK);
+    }
+}
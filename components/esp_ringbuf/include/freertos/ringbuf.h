@@ -125,6 +125,49 @@ BaseType_t xRingbufferSend(RingbufHandle_t xRingbuffer, const void *pvItem, size
  */
 BaseType_t xRingbufferSendFromISR(RingbufHandle_t xRingbuffer, const void *pvItem, size_t xItemSize, BaseType_t *pxHigherPriorityTaskWoken);
 
+/**
+ * @brief       Acquire memory from the ring buffer to be written to by an external source and to be sent later.
+ *
+ * Attempt to allocate buffer for an item to be sent into the ring buffer. This
+ * function will block until enough free space is available or until it
+ * timesout.
+ *
+ * The item, as well as any item acquired or sent after it, cannot be read
+ * from the ring buffer until it is committed by xRingbufferSendComplete().
+ * Several items may be outstanding at the same time, they become readable in
+ * the order they were acquired.
+ *
+ * @param[in]   xRingbuffer     Ring buffer to allocate the memory
+ * @param[out]  ppvItem         Double pointer to memory acquired (set to NULL if no memory were retrieved)
+ * @param[in]   xItemSize       Size of item to acquire.
+ * @param[in]   xTicksToWait    Ticks to wait for room in the ring buffer.
+ *
+ * @note    Only applicable for no-split ring buffers now, the actual size of
+ *          memory that the item will occupy will be rounded up to the nearest
+ *          32-bit aligned size. This is done to ensure all items are always
+ *          stored in 32-bit aligned fashion.
+ *
+ * @return
+ *      - pdTRUE if succeeded
+ *      - pdFALSE on time-out or when the data is larger than the maximum permissible size of the buffer
+ */
+BaseType_t xRingbufferSendAcquire(RingbufHandle_t xRingbuffer, void **ppvItem, size_t xItemSize, TickType_t xTicksToWait);
+
+/**
+ * @brief       Actually send an item into the ring buffer allocated before by xRingbufferSendAcquire().
+ *
+ * @param[in]   xRingbuffer     Ring buffer to insert the item into
+ * @param[in]   pvItem          Pointer to item in allocated memory to insert.
+ *
+ * @note    Only applicable for no-split ring buffers. Only call for items
+ *          allocated by xRingbufferSendAcquire(), and each of them only once.
+ *
+ * @return
+ *      - pdTRUE if succeeded
+ *      - pdFALSE if fail for some reason.
+ */
+BaseType_t xRingbufferSendComplete(RingbufHandle_t xRingbuffer, void *pvItem);
+
 /**
  * @brief   Retrieve an item from the ring buffer
  *
@@ -162,6 +205,28 @@ void *xRingbufferReceive(RingbufHandle_t xRingbuffer, size_t *pxItemSize, TickTy
  */
 void *xRingbufferReceiveFromISR(RingbufHandle_t xRingbuffer, size_t *pxItemSize);
 
+/**
+ * @brief   Retrieve several items from a no-split ring buffer at once
+ *
+ * Attempt to retrieve up to uxMaxItems items from the ring buffer. All items
+ * that are available (up to uxMaxItems) are retrieved under a single critical
+ * section. This function will block until at least one item is available or
+ * until it timesout.
+ *
+ * @param[in]   xRingbuffer     Ring buffer to retrieve the items from
+ * @param[out]  ppvItems        Array which receives pointers to the retrieved items, in order
+ * @param[out]  pxItemSizes     Array which receives the sizes of the retrieved items
+ * @param[in]   uxMaxItems      Number of entries in ppvItems and pxItemSizes
+ * @param[in]   xTicksToWait    Ticks to wait for items in the ring buffer.
+ *
+ * @note    The retrieved items must be returned by vRingbufferReturnItemBatch()
+ *          or one by one by vRingbufferReturnItem().
+ * @note    This function should only be called on no-split buffers
+ *
+ * @return  Number of items retrieved, 0 on timeout.
+ */
+UBaseType_t xRingbufferReceiveBatch(RingbufHandle_t xRingbuffer, void **ppvItems, size_t *pxItemSizes, UBaseType_t uxMaxItems, TickType_t xTicksToWait);
+
 /**
  * @brief   Retrieve a split item from an allow-split ring buffer
  *
@@ -265,6 +330,20 @@ void *xRingbufferReceiveUpToFromISR(RingbufHandle_t xRingbuffer, size_t *pxItemS
  */
 void vRingbufferReturnItem(RingbufHandle_t xRingbuffer, void *pvItem);
 
+/**
+ * @brief   Return several previously-retrieved items to the ring buffer
+ *
+ * Returns all of the items under a single critical section and wakes up
+ * blocked senders only once.
+ *
+ * @param[in]   xRingbuffer Ring buffer the items were retrieved from
+ * @param[in]   ppvItems    Items that were received earlier, e.g. by xRingbufferReceiveBatch()
+ * @param[in]   uxItems     Number of items in ppvItems
+ *
+ * @note    Byte buffers do not allow multiple retrievals, so at most one item can be returned
+ */
+void vRingbufferReturnItemBatch(RingbufHandle_t xRingbuffer, void * const *ppvItems, UBaseType_t uxItems);
+
 /**
  * @brief   Return a previously-retrieved item to the ring buffer from an ISR
  *
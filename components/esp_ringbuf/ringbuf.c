@@ -27,12 +27,13 @@
 //Ring buffer flags
 #define rbALLOW_SPLIT_FLAG          ( ( UBaseType_t ) 1 )   //The ring buffer allows items to be split
 #define rbBYTE_BUFFER_FLAG          ( ( UBaseType_t ) 2 )   //The ring buffer is a byte buffer
-#define rbBUFFER_FULL_FLAG          ( ( UBaseType_t ) 4 )   //The ring buffer is currently full (write pointer == free pointer)
+#define rbBUFFER_FULL_FLAG          ( ( UBaseType_t ) 4 )   //The ring buffer is currently full (acquire pointer == free pointer)
 
 //Item flags
 #define rbITEM_FREE_FLAG            ( ( UBaseType_t ) 1 )   //Item has been retrieved and returned by application, free to overwrite
 #define rbITEM_DUMMY_DATA_FLAG      ( ( UBaseType_t ) 2 )   //Data from here to end of the ring buffer is dummy data. Restart reading at start of head of the buffer
 #define rbITEM_SPLIT_FLAG           ( ( UBaseType_t ) 4 )   //Valid for RINGBUF_TYPE_ALLOWSPLIT, indicating that rest of the data is wrapped around
+#define rbITEM_WRITTEN_FLAG         ( ( UBaseType_t ) 8 )   //Item has been written to by the application, thus it is free to be read
 
 typedef struct {
     //This size of this structure must be 32-bit aligned
@@ -60,13 +61,15 @@ struct Ringbuffer_t {
     ReturnItemFunction_t vReturnItem;           //Function to return item to ring buffer
     GetCurMaxSizeFunction_t xGetCurMaxSize;     //Function to get current free size
 
-    uint8_t *pucWrite;                          //Write Pointer. Points to where the next item should be written
+    uint8_t *pucAcquire;                        //Acquire Pointer. Points to where the next item should be acquired
+    uint8_t *pucWrite;                          //Write Pointer. Points to the first acquired item that has yet to be written
     uint8_t *pucRead;                           //Read Pointer. Points to where the next item should be read from
     uint8_t *pucFree;                           //Free Pointer. Points to the last item that has yet to be returned to the ring buffer
     uint8_t *pucHead;                           //Pointer to the start of the ring buffer storage area
     uint8_t *pucTail;                           //Pointer to the end of the ring buffer storage area
 
     BaseType_t xItemsWaiting;                   //Number of items/bytes(for byte buffers) currently in ring buffer that have not yet been read
+    BaseType_t xItemsAcquired;                  //Number of acquired items that the write pointer has not yet moved past
     SemaphoreHandle_t xFreeSpaceSemaphore;      //Binary semaphore, wakes up writing threads when more free space becomes available or when another thread times out attempting to write
     SemaphoreHandle_t xItemsBufferedSemaphore;  //Binary semaphore, indicates there are new packets in the circular buffer. See remark.
 };
@@ -97,6 +100,12 @@ static BaseType_t prvCheckItemFitsDefault( Ringbuffer_t *pxRingbuffer, size_t xI
 //Checks if an item will currently fit in a byte buffer
 static BaseType_t prvCheckItemFitsByteBuffer( Ringbuffer_t *pxRingbuffer, size_t xItemSize);
 
+//Acquires memory for an item in a no-split ring buffer. Only call this function after calling prvCheckItemFitsDefault()
+static uint8_t *prvAcquireItemNoSplit(Ringbuffer_t *pxRingbuffer, size_t xItemSize);
+
+//Marks an acquired item of a no-split ring buffer as written, so that it can be read
+static void prvSendItemDoneNoSplit(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem);
+
 //Copies an item to a no-split ring buffer. Only call this function after calling prvCheckItemFitsDefault()
 static void prvCopyItemNoSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize);
 
@@ -146,7 +155,7 @@ static size_t prvGetFreeSize(Ringbuffer_t *pxRingbuffer)
     if (pxRingbuffer->uxRingbufferFlags & rbBUFFER_FULL_FLAG) {
         xReturn =  0;
     } else {
-        BaseType_t xFreeSize = pxRingbuffer->pucFree - pxRingbuffer->pucWrite;
+        BaseType_t xFreeSize = pxRingbuffer->pucFree - pxRingbuffer->pucAcquire;
         //Check if xFreeSize has underflowed
         if (xFreeSize <= 0) {
             xFreeSize += pxRingbuffer->xSize;
@@ -160,26 +169,26 @@ static size_t prvGetFreeSize(Ringbuffer_t *pxRingbuffer)
 static BaseType_t prvCheckItemFitsDefault( Ringbuffer_t *pxRingbuffer, size_t xItemSize)
 {
     //Check arguments and buffer state
-    configASSERT(rbCHECK_ALIGNED(pxRingbuffer->pucWrite));              //pucWrite is always aligned in no-split ring buffers
-    configASSERT(pxRingbuffer->pucWrite >= pxRingbuffer->pucHead && pxRingbuffer->pucWrite < pxRingbuffer->pucTail);    //Check write pointer is within bounds
+    configASSERT(rbCHECK_ALIGNED(pxRingbuffer->pucAcquire));              //pucAcquire is always aligned in no-split ring buffers
+    configASSERT(pxRingbuffer->pucAcquire >= pxRingbuffer->pucHead && pxRingbuffer->pucAcquire < pxRingbuffer->pucTail);    //Check acquire pointer is within bounds
 
     size_t xTotalItemSize = rbALIGN_SIZE(xItemSize) + rbHEADER_SIZE;    //Rounded up aligned item size with header
-    if (pxRingbuffer->pucWrite == pxRingbuffer->pucFree) {
+    if (pxRingbuffer->pucAcquire == pxRingbuffer->pucFree) {
         //Buffer is either complete empty or completely full
         return (pxRingbuffer->uxRingbufferFlags & rbBUFFER_FULL_FLAG) ? pdFALSE : pdTRUE;
     }
-    if (pxRingbuffer->pucFree > pxRingbuffer->pucWrite) {
+    if (pxRingbuffer->pucFree > pxRingbuffer->pucAcquire) {
         //Free space does not wrap around
-        return (xTotalItemSize <= pxRingbuffer->pucFree - pxRingbuffer->pucWrite) ? pdTRUE : pdFALSE;
+        return (xTotalItemSize <= pxRingbuffer->pucFree - pxRingbuffer->pucAcquire) ? pdTRUE : pdFALSE;
     }
     //Free space wraps around
-    if (xTotalItemSize <= pxRingbuffer->pucTail - pxRingbuffer->pucWrite) {
+    if (xTotalItemSize <= pxRingbuffer->pucTail - pxRingbuffer->pucAcquire) {
         return pdTRUE;      //Item fits without wrapping around
     }
     //Check if item fits by wrapping
     if (pxRingbuffer->uxRingbufferFlags & rbALLOW_SPLIT_FLAG) {
         //Allow split wrapping incurs an extra header
-        return (xTotalItemSize + rbHEADER_SIZE <= pxRingbuffer->xSize - (pxRingbuffer->pucWrite - pxRingbuffer->pucFree)) ? pdTRUE : pdFALSE;
+        return (xTotalItemSize + rbHEADER_SIZE <= pxRingbuffer->xSize - (pxRingbuffer->pucAcquire - pxRingbuffer->pucFree)) ? pdTRUE : pdFALSE;
     } else {
         return (xTotalItemSize <= pxRingbuffer->pucFree - pxRingbuffer->pucHead) ? pdTRUE : pdFALSE;
     }
@@ -202,41 +211,91 @@ static BaseType_t prvCheckItemFitsByteBuffer( Ringbuffer_t *pxRingbuffer, size_t
     return (xItemSize <= pxRingbuffer->xSize - (pxRingbuffer->pucWrite - pxRingbuffer->pucFree)) ? pdTRUE : pdFALSE;
 }
 
-static void prvCopyItemNoSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize)
+static uint8_t *prvAcquireItemNoSplit(Ringbuffer_t *pxRingbuffer, size_t xItemSize)
 {
     //Check arguments and buffer state
     size_t xAlignedItemSize = rbALIGN_SIZE(xItemSize);                  //Rounded up aligned item size
-    size_t xRemLen = pxRingbuffer->pucTail - pxRingbuffer->pucWrite;    //Length from pucWrite until end of buffer
-    configASSERT(rbCHECK_ALIGNED(pxRingbuffer->pucWrite));              //pucWrite is always aligned in no-split ring buffers
-    configASSERT(pxRingbuffer->pucWrite >= pxRingbuffer->pucHead && pxRingbuffer->pucWrite < pxRingbuffer->pucTail);    //Check write pointer is within bounds
+    size_t xRemLen = pxRingbuffer->pucTail - pxRingbuffer->pucAcquire;  //Length from pucAcquire until end of buffer
+    configASSERT(rbCHECK_ALIGNED(pxRingbuffer->pucAcquire));            //pucAcquire is always aligned in no-split ring buffers
+    configASSERT(pxRingbuffer->pucAcquire >= pxRingbuffer->pucHead && pxRingbuffer->pucAcquire < pxRingbuffer->pucTail);    //Check acquire pointer is within bounds
     configASSERT(xRemLen >= rbHEADER_SIZE);                             //Remaining length must be able to at least fit an item header
 
     //If remaining length can't fit item, set as dummy data and wrap around
     if (xRemLen < xAlignedItemSize + rbHEADER_SIZE) {
-        ItemHeader_t *pxDummy = (ItemHeader_t *)pxRingbuffer->pucWrite;
+        ItemHeader_t *pxDummy = (ItemHeader_t *)pxRingbuffer->pucAcquire;
         pxDummy->uxItemFlags = rbITEM_DUMMY_DATA_FLAG;      //Set remaining length as dummy data
         pxDummy->xItemLen = 0;                              //Dummy data should have no length
-        pxRingbuffer->pucWrite = pxRingbuffer->pucHead;     //Reset write pointer to wrap around
+        pxRingbuffer->pucAcquire = pxRingbuffer->pucHead;   //Reset acquire pointer to wrap around
     }
 
-    //Item should be guaranteed to fit at this point. Set item header and copy data
-    ItemHeader_t *pxHeader = (ItemHeader_t *)pxRingbuffer->pucWrite;
+    //Item should be guaranteed to fit at this point. Set item header, the item is not readable until it is marked as written
+    ItemHeader_t *pxHeader = (ItemHeader_t *)pxRingbuffer->pucAcquire;
     pxHeader->xItemLen = xItemSize;
     pxHeader->uxItemFlags = 0;
-    pxRingbuffer->pucWrite += rbHEADER_SIZE;    //Advance pucWrite past header
-    memcpy(pxRingbuffer->pucWrite, pucItem, xItemSize);
-    pxRingbuffer->xItemsWaiting++;
-    pxRingbuffer->pucWrite += xAlignedItemSize; //Advance pucWrite past item to next aligned address
+    uint8_t *pucItem = pxRingbuffer->pucAcquire + rbHEADER_SIZE;
+    pxRingbuffer->pucAcquire += rbHEADER_SIZE + xAlignedItemSize;   //Advance pucAcquire past header and item to next aligned address
+    pxRingbuffer->xItemsAcquired++;
 
-    //If current remaining length can't fit a header, wrap around write pointer
-    if (pxRingbuffer->pucTail - pxRingbuffer->pucWrite < rbHEADER_SIZE) {
-        pxRingbuffer->pucWrite = pxRingbuffer->pucHead;   //Wrap around pucWrite
+    //If current remaining length can't fit a header, wrap around acquire pointer
+    if (pxRingbuffer->pucTail - pxRingbuffer->pucAcquire < rbHEADER_SIZE) {
+        pxRingbuffer->pucAcquire = pxRingbuffer->pucHead;   //Wrap around pucAcquire
     }
     //Check if buffer is full
-    if (pxRingbuffer->pucWrite == pxRingbuffer->pucFree) {
+    if (pxRingbuffer->pucAcquire == pxRingbuffer->pucFree) {
         //Mark the buffer as full to distinguish with an empty buffer
         pxRingbuffer->uxRingbufferFlags |= rbBUFFER_FULL_FLAG;
     }
+    return pucItem;
+}
+
+static void prvSendItemDoneNoSplit(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem)
+{
+    //Check arguments and buffer state
+    configASSERT(rbCHECK_ALIGNED(pucItem));
+    configASSERT(pucItem >= pxRingbuffer->pucHead);
+    configASSERT(pucItem <= pxRingbuffer->pucTail);     //Inclusive of pucTail in the case of zero length item at the very end
+    configASSERT(pxRingbuffer->xItemsAcquired > 0);
+
+    //Get and check header of the item
+    ItemHeader_t *pxCurHeader = (ItemHeader_t *)(pucItem - rbHEADER_SIZE);
+    configASSERT(pxCurHeader->xItemLen <= pxRingbuffer->xMaxItemSize);
+    configASSERT((pxCurHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG) == 0); //Dummy items should never have been acquired
+    configASSERT((pxCurHeader->uxItemFlags & rbITEM_WRITTEN_FLAG) == 0);    //Indicates item has already been written before
+    pxCurHeader->uxItemFlags |= rbITEM_WRITTEN_FLAG;                        //Mark as written
+
+    /*
+     * Items might not be written in the order they were acquired. Move the write pointer
+     * up to the next item that has not been marked as written, so that items only become
+     * readable in the order they were acquired. Dummy items are skipped over. The walk is
+     * bounded by the acquired count instead of pucAcquire, as pucWrite == pucAcquire both
+     * when no item and when the whole buffer is acquired.
+     */
+    pxCurHeader = (ItemHeader_t *)pxRingbuffer->pucWrite;
+    while (pxRingbuffer->xItemsAcquired > 0 && (pxCurHeader->uxItemFlags & (rbITEM_WRITTEN_FLAG | rbITEM_DUMMY_DATA_FLAG))) {
+        if (pxCurHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG) {
+            pxRingbuffer->pucWrite = pxRingbuffer->pucHead;    //Wrap around due to dummy data
+        } else {
+            //Item has been written, advance write pointer past this item and make it readable
+            size_t xAlignedItemSize = rbALIGN_SIZE(pxCurHeader->xItemLen);
+            pxRingbuffer->pucWrite += xAlignedItemSize + rbHEADER_SIZE;
+            pxRingbuffer->xItemsAcquired--;
+            pxRingbuffer->xItemsWaiting++;
+            //Redundancy check to ensure write pointer has not overshot buffer bounds
+            configASSERT(pxRingbuffer->pucWrite <= pxRingbuffer->pucHead + pxRingbuffer->xSize);
+        }
+        //Check if pucWrite requires wrap around
+        if ((pxRingbuffer->pucTail - pxRingbuffer->pucWrite) < rbHEADER_SIZE) {
+            pxRingbuffer->pucWrite = pxRingbuffer->pucHead;
+        }
+        pxCurHeader = (ItemHeader_t *)pxRingbuffer->pucWrite;      //Update header to point to item
+    }
+}
+
+static void prvCopyItemNoSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize)
+{
+    uint8_t *pucAcquiredItem = prvAcquireItemNoSplit(pxRingbuffer, xItemSize);
+    memcpy(pucAcquiredItem, pucItem, xItemSize);
+    prvSendItemDoneNoSplit(pxRingbuffer, pucAcquiredItem);
 }
 
 static void prvCopyItemAllowSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *pucItem, size_t xItemSize)
@@ -284,6 +343,7 @@ static void prvCopyItemAllowSplit(Ringbuffer_t *pxRingbuffer, const uint8_t *puc
     if (pxRingbuffer->pucTail - pxRingbuffer->pucWrite < rbHEADER_SIZE) {
         pxRingbuffer->pucWrite = pxRingbuffer->pucHead;   //Wrap around pucWrite
     }
+    pxRingbuffer->pucAcquire = pxRingbuffer->pucWrite;     //Items are never left acquired in this buffer type
     //Check if buffer is full
     if (pxRingbuffer->pucWrite == pxRingbuffer->pucFree) {
         //Mark the buffer as full to distinguish with an empty buffer
@@ -315,6 +375,7 @@ static void prvCopyItemByteBuf(Ringbuffer_t *pxRingbuffer, const uint8_t *pucIte
     if (pxRingbuffer->pucWrite == pxRingbuffer->pucTail) {
         pxRingbuffer->pucWrite = pxRingbuffer->pucHead;
     }
+    pxRingbuffer->pucAcquire = pxRingbuffer->pucWrite;     //Items are never left acquired in this buffer type
     //Check if buffer is full
     if (pxRingbuffer->pucWrite == pxRingbuffer->pucFree) {
         pxRingbuffer->uxRingbufferFlags |= rbBUFFER_FULL_FLAG;      //Mark the buffer as full to avoid confusion with an empty buffer
@@ -431,8 +492,13 @@ static void prvReturnItemDefault(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem)
      * freed or items with dummy data should be skipped over
      */
     pxCurHeader = (ItemHeader_t *)pxRingbuffer->pucFree;
+    //pucFree == pucRead in a full buffer means every item has been read, so the walk may start
+    BaseType_t xFullyRead = ((pxRingbuffer->uxRingbufferFlags & rbBUFFER_FULL_FLAG) && pxRingbuffer->pucFree == pxRingbuffer->pucRead) ? pdTRUE : pdFALSE;
+    BaseType_t xFreeMoved = pdFALSE;
     //Skip over Items that have already been freed or are dummy items
-    while (((pxCurHeader->uxItemFlags & rbITEM_FREE_FLAG) || (pxCurHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG)) && pxRingbuffer->pucFree != pxRingbuffer->pucRead) {
+    while (((pxCurHeader->uxItemFlags & rbITEM_FREE_FLAG) || (pxCurHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG)) && (pxRingbuffer->pucFree != pxRingbuffer->pucRead || xFullyRead == pdTRUE)) {
+        xFullyRead = pdFALSE;
+        xFreeMoved = pdTRUE;
         if (pxCurHeader->uxItemFlags & rbITEM_DUMMY_DATA_FLAG) {
             pxCurHeader->uxItemFlags |= rbITEM_FREE_FLAG;   //Mark as freed (not strictly necessary but adds redundancy)
             pxRingbuffer->pucFree = pxRingbuffer->pucHead;    //Wrap around due to dummy data
@@ -450,14 +516,9 @@ static void prvReturnItemDefault(Ringbuffer_t *pxRingbuffer, uint8_t *pucItem)
         pxCurHeader = (ItemHeader_t *)pxRingbuffer->pucFree;      //Update header to point to item
     }
 
-    //Check if the buffer full flag should be reset
-    if (pxRingbuffer->uxRingbufferFlags & rbBUFFER_FULL_FLAG) {
-        if (pxRingbuffer->pucFree != pxRingbuffer->pucWrite) {
-            pxRingbuffer->uxRingbufferFlags &= ~rbBUFFER_FULL_FLAG;
-        } else if (pxRingbuffer->pucFree == pxRingbuffer->pucWrite && pxRingbuffer->pucFree == pxRingbuffer->pucRead) {
-            //Special case where a full buffer is completely freed in one go
-            pxRingbuffer->uxRingbufferFlags &= ~rbBUFFER_FULL_FLAG;
-        }
+    //Buffer is no longer full once the free pointer has moved (possibly a whole lap when a full buffer is completely freed in one go)
+    if (xFreeMoved == pdTRUE) {
+        pxRingbuffer->uxRingbufferFlags &= ~rbBUFFER_FULL_FLAG;
     }
 }
 
@@ -481,13 +542,13 @@ static size_t prvGetCurMaxSizeNoSplit(Ringbuffer_t *pxRingbuffer)
     if (pxRingbuffer->uxRingbufferFlags & rbBUFFER_FULL_FLAG) {
         return 0;
     }
-    if (pxRingbuffer->pucWrite < pxRingbuffer->pucFree) {
-        //Free space is contiguous between pucWrite and pucFree
-        xFreeSize = pxRingbuffer->pucFree - pxRingbuffer->pucWrite;
+    if (pxRingbuffer->pucAcquire < pxRingbuffer->pucFree) {
+        //Free space is contiguous between pucAcquire and pucFree
+        xFreeSize = pxRingbuffer->pucFree - pxRingbuffer->pucAcquire;
     } else {
         //Free space wraps around (or overlapped at pucHead), select largest
         //contiguous free space as no-split items require contiguous space
-        size_t xSize1 = pxRingbuffer->pucTail - pxRingbuffer->pucWrite;
+        size_t xSize1 = pxRingbuffer->pucTail - pxRingbuffer->pucAcquire;
         size_t xSize2 = pxRingbuffer->pucFree - pxRingbuffer->pucHead;
         xFreeSize = (xSize1 > xSize2) ? xSize1 : xSize2;
     }
@@ -673,7 +734,9 @@ RingbufHandle_t xRingbufferCreate(size_t xBufferSize, ringbuf_type_t xBufferType
     pxRingbuffer->pucFree = pxRingbuffer->pucHead;
     pxRingbuffer->pucRead = pxRingbuffer->pucHead;
     pxRingbuffer->pucWrite = pxRingbuffer->pucHead;
+    pxRingbuffer->pucAcquire = pxRingbuffer->pucHead;
     pxRingbuffer->xItemsWaiting = 0;
+    pxRingbuffer->xItemsAcquired = 0;
     pxRingbuffer->xFreeSpaceSemaphore = xSemaphoreCreateBinary();
     pxRingbuffer->xItemsBufferedSemaphore = xSemaphoreCreateBinary();
     pxRingbuffer->uxRingbufferFlags = 0;
@@ -838,6 +901,76 @@ BaseType_t xRingbufferSendFromISR(RingbufHandle_t xRingbuffer, const void *pvIte
     return xReturn;
 }
 
+BaseType_t xRingbufferSendAcquire(RingbufHandle_t xRingbuffer, void **ppvItem, size_t xItemSize, TickType_t xTicksToWait)
+{
+    //Check arguments
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+    configASSERT(pxRingbuffer);
+    configASSERT(ppvItem != NULL);
+    configASSERT((pxRingbuffer->uxRingbufferFlags & (rbBYTE_BUFFER_FLAG | rbALLOW_SPLIT_FLAG)) == 0); //Send acquire currently only supported in NoSplit buffers
+    *ppvItem = NULL;
+    if (xItemSize > pxRingbuffer->xMaxItemSize) {
+        return pdFALSE;     //Data will never ever fit in the queue.
+    }
+
+    //Attempt to acquire space for an item
+    BaseType_t xReturn = pdFALSE;
+    BaseType_t xReturnSemaphore = pdFALSE;
+    TickType_t xTicksEnd = xTaskGetTickCount() + xTicksToWait;
+    TickType_t xTicksRemaining = xTicksToWait;
+    while (xTicksRemaining <= xTicksToWait) {   //xTicksToWait will underflow once xTaskGetTickCount() > ticks_end
+        //Block until more free space becomes available or timeout
+        if (xSemaphoreTake(pxRingbuffer->xFreeSpaceSemaphore, xTicksRemaining) != pdTRUE) {
+            xReturn = pdFALSE;
+            break;
+        }
+        //Semaphore obtained, check if item can fit
+        taskENTER_CRITICAL();
+        if(pxRingbuffer->xCheckItemFits(pxRingbuffer, xItemSize) == pdTRUE) {
+            //Item will fit, reserve space for it
+            *ppvItem = prvAcquireItemNoSplit(pxRingbuffer, xItemSize);
+            xReturn = pdTRUE;
+            //Check if the free semaphore should be returned to allow other tasks to send
+            if (prvGetFreeSize(pxRingbuffer) > 0) {
+                xReturnSemaphore = pdTRUE;
+            }
+            taskEXIT_CRITICAL();
+            break;
+        }
+        //Item doesn't fit, adjust ticks and take the semaphore again
+        if (xTicksToWait != portMAX_DELAY) {
+            xTicksRemaining = xTicksEnd - xTaskGetTickCount();
+        }
+        taskEXIT_CRITICAL();
+        /*
+         * Gap between critical section and re-acquiring of the semaphore. If
+         * semaphore is given now, priority inversion might occur (see docs)
+         */
+    }
+
+    if (xReturnSemaphore == pdTRUE) {
+        xSemaphoreGive(pxRingbuffer->xFreeSpaceSemaphore);  //Give back semaphore so other tasks can send
+    }
+    return xReturn;
+}
+
+BaseType_t xRingbufferSendComplete(RingbufHandle_t xRingbuffer, void *pvItem)
+{
+    //Check arguments
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+    configASSERT(pxRingbuffer);
+    configASSERT(pvItem != NULL);
+    configASSERT((pxRingbuffer->uxRingbufferFlags & (rbBYTE_BUFFER_FLAG | rbALLOW_SPLIT_FLAG)) == 0);
+
+    taskENTER_CRITICAL();
+    prvSendItemDoneNoSplit(pxRingbuffer, pvItem);
+    taskEXIT_CRITICAL();
+
+    //Indicate item was successfully sent
+    xSemaphoreGive(pxRingbuffer->xItemsBufferedSemaphore);
+    return pdTRUE;
+}
+
 void *xRingbufferReceive(RingbufHandle_t xRingbuffer, size_t *pxItemSize, TickType_t xTicksToWait)
 {
     //Check arguments
@@ -876,6 +1009,59 @@ void *xRingbufferReceiveFromISR(RingbufHandle_t xRingbuffer, size_t *pxItemSize)
     }
 }
 
+UBaseType_t xRingbufferReceiveBatch(RingbufHandle_t xRingbuffer, void **ppvItems, size_t *pxItemSizes, UBaseType_t uxMaxItems, TickType_t xTicksToWait)
+{
+    //Check arguments
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+    configASSERT(pxRingbuffer);
+    configASSERT(ppvItems != NULL && pxItemSizes != NULL);
+    configASSERT((pxRingbuffer->uxRingbufferFlags & (rbBYTE_BUFFER_FLAG | rbALLOW_SPLIT_FLAG)) == 0);  //Batch receive currently only supported in NoSplit buffers
+    if (uxMaxItems == 0) {
+        return 0;
+    }
+
+    //Attempt to retrieve up to uxMaxItems items
+    UBaseType_t uxItems = 0;
+    BaseType_t xReturnSemaphore = pdFALSE;
+    TickType_t xTicksEnd = xTaskGetTickCount() + xTicksToWait;
+    TickType_t xTicksRemaining = xTicksToWait;
+    while (xTicksRemaining <= xTicksToWait) {   //xTicksToWait will underflow once xTaskGetTickCount() > ticks_end
+        //Block until items become available or timeout
+        if (xSemaphoreTake(pxRingbuffer->xItemsBufferedSemaphore, xTicksRemaining) != pdTRUE) {
+            break;      //Timed out attempting to get semaphore
+        }
+
+        //Semaphore obtained, retrieve as many items as are available in one critical section
+        taskENTER_CRITICAL();
+        while (uxItems < uxMaxItems && prvCheckItemAvail(pxRingbuffer) == pdTRUE) {
+            BaseType_t xIsSplit;
+            ppvItems[uxItems] = pxRingbuffer->pvGetItem(pxRingbuffer, &xIsSplit, 0, &pxItemSizes[uxItems]);
+            uxItems++;
+        }
+        if (uxItems > 0) {
+            if (pxRingbuffer->xItemsWaiting > 0) {
+                xReturnSemaphore = pdTRUE;
+            }
+            taskEXIT_CRITICAL();
+            break;
+        }
+        //No item available for retrieval, adjust ticks and take the semaphore again
+        if (xTicksToWait != portMAX_DELAY) {
+            xTicksRemaining = xTicksEnd - xTaskGetTickCount();
+        }
+        taskEXIT_CRITICAL();
+        /*
+         * Gap between critical section and re-acquiring of the semaphore. If
+         * semaphore is given now, priority inversion might occur (see docs)
+         */
+    }
+
+    if (xReturnSemaphore == pdTRUE) {
+        xSemaphoreGive(pxRingbuffer->xItemsBufferedSemaphore);  //Give semaphore back so other tasks can retrieve
+    }
+    return uxItems;
+}
+
 BaseType_t xRingbufferReceiveSplit(RingbufHandle_t xRingbuffer, void **ppvHeadItem, void **ppvTailItem, size_t *pxHeadItemSize, size_t *pxTailItemSize, TickType_t xTicksToWait)
 {
     //Check arguments
@@ -1003,6 +1189,24 @@ void vRingbufferReturnItem(RingbufHandle_t xRingbuffer, void *pvItem)
     xSemaphoreGive(pxRingbuffer->xFreeSpaceSemaphore);
 }
 
+void vRingbufferReturnItemBatch(RingbufHandle_t xRingbuffer, void * const *ppvItems, UBaseType_t uxItems)
+{
+    Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
+    configASSERT(pxRingbuffer);
+    configASSERT(ppvItems != NULL || uxItems == 0);
+    if (uxItems == 0) {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    for (UBaseType_t i = 0; i < uxItems; i++) {
+        configASSERT(ppvItems[i] != NULL);
+        pxRingbuffer->vReturnItem(pxRingbuffer, (uint8_t *)ppvItems[i]);
+    }
+    taskEXIT_CRITICAL();
+    xSemaphoreGive(pxRingbuffer->xFreeSpaceSemaphore);
+}
+
 void vRingbufferReturnItemFromISR(RingbufHandle_t xRingbuffer, void *pvItem, BaseType_t *pxHigherPriorityTaskWoken)
 {
     Ringbuffer_t *pxRingbuffer = (Ringbuffer_t *)xRingbuffer;
@@ -0,0 +1,243 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <unity.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/ringbuf.h"
+
+#include "esp_timer.h"
+
+#define ITEM_SIZE       28
+#define ITEM_NUM        8
+
+#define BENCH_ITEM_SIZE 12
+#define BENCH_ITEM_NUM  64
+#define BENCH_ROUNDS    200
+
+static void fill_item(void *item, size_t size, uint8_t tag)
+{
+    memset(item, tag, size);
+}
+
+static void check_item(const void *item, size_t size, uint8_t tag)
+{
+    const uint8_t *p = item;
+
+    for (size_t i = 0; i < size; i++) {
+        TEST_ASSERT_EQUAL_HEX8(tag, p[i]);
+    }
+}
+
+static void receive_and_check(RingbufHandle_t rb, uint8_t tag)
+{
+    size_t size;
+    void *item = xRingbufferReceive(rb, &size, 0);
+
+    TEST_ASSERT_NOT_NULL(item);
+    TEST_ASSERT_EQUAL(ITEM_SIZE, size);
+    check_item(item, size, tag);
+    vRingbufferReturnItem(rb, item);
+}
+
+TEST_CASE("ring buffer send acquire and complete", "[esp_ringbuf]")
+{
+    size_t size;
+    void *item;
+    RingbufHandle_t rb = xRingbufferCreateNoSplit(ITEM_SIZE, ITEM_NUM);
+    TEST_ASSERT_NOT_NULL(rb);
+
+    TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSendAcquire(rb, &item, ITEM_SIZE, 0));
+    TEST_ASSERT_NOT_NULL(item);
+    fill_item(item, ITEM_SIZE, 0x5a);
+
+    //Acquired item must not be visible before it is committed
+    TEST_ASSERT_NULL(xRingbufferReceive(rb, &size, 0));
+
+    TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSendComplete(rb, item));
+    receive_and_check(rb, 0x5a);
+    TEST_ASSERT_NULL(xRingbufferReceive(rb, &size, 0));
+
+    //Oversized items fail without touching the buffer
+    TEST_ASSERT_EQUAL(pdFALSE, xRingbufferSendAcquire(rb, &item, xRingbufferGetMaxItemSize(rb) + 1, 0));
+    TEST_ASSERT_NULL(item);
+
+    vRingbufferDelete(rb);
+}
+
+TEST_CASE("ring buffer outstanding acquisitions are received in order", "[esp_ringbuf]")
+{
+    size_t size;
+    void *items[4];
+    RingbufHandle_t rb = xRingbufferCreateNoSplit(ITEM_SIZE, ITEM_NUM);
+    TEST_ASSERT_NOT_NULL(rb);
+
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSendAcquire(rb, &items[i], ITEM_SIZE, 0));
+        fill_item(items[i], ITEM_SIZE, i);
+    }
+
+    //Items sent by copy queue up behind the outstanding acquisitions
+    uint8_t buf[ITEM_SIZE];
+    fill_item(buf, sizeof(buf), 4);
+    TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSend(rb, buf, sizeof(buf), 0));
+
+    //Completing later items first does not publish them
+    TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSendComplete(rb, items[3]));
+    TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSendComplete(rb, items[1]));
+    TEST_ASSERT_NULL(xRingbufferReceive(rb, &size, 0));
+
+    TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSendComplete(rb, items[0]));
+    receive_and_check(rb, 0);
+    receive_and_check(rb, 1);
+    TEST_ASSERT_NULL(xRingbufferReceive(rb, &size, 0));
+
+    TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSendComplete(rb, items[2]));
+    for (int i = 2; i < 5; i++) {
+        receive_and_check(rb, i);
+    }
+    TEST_ASSERT_NULL(xRingbufferReceive(rb, &size, 0));
+
+    vRingbufferDelete(rb);
+}
+
+TEST_CASE("ring buffer acquire fills and wraps the buffer", "[esp_ringbuf]")
+{
+    size_t size;
+    void *items[ITEM_NUM];
+    void *extra;
+    RingbufHandle_t rb = xRingbufferCreateNoSplit(ITEM_SIZE, ITEM_NUM);
+    TEST_ASSERT_NOT_NULL(rb);
+
+    for (int round = 0; round < 3 * ITEM_NUM; round++) {
+        //Acquire until the buffer is full, wrapping around wastes at most one item
+        int num = 0;
+        while (num < ITEM_NUM && xRingbufferSendAcquire(rb, &items[num], ITEM_SIZE, 0) == pdTRUE) {
+            fill_item(items[num], ITEM_SIZE, round + num);
+            num++;
+        }
+        TEST_ASSERT(num >= ITEM_NUM - 1);
+        TEST_ASSERT_EQUAL(pdFALSE, xRingbufferSendAcquire(rb, &extra, ITEM_SIZE, 0));
+
+        //Commit in reverse order, everything becomes visible with the first item
+        for (int i = num - 1; i > 0; i--) {
+            TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSendComplete(rb, items[i]));
+        }
+        TEST_ASSERT_NULL(xRingbufferReceive(rb, &size, 0));
+        TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSendComplete(rb, items[0]));
+
+        //Read everything before returning anything, then return all items out of order
+        void *rx[ITEM_NUM];
+        for (int i = 0; i < num; i++) {
+            rx[i] = xRingbufferReceive(rb, &size, 0);
+            TEST_ASSERT_NOT_NULL(rx[i]);
+            check_item(rx[i], size, round + i);
+        }
+        TEST_ASSERT_NULL(xRingbufferReceive(rb, &size, 0));
+        for (int i = 0; i < num; i++) {
+            vRingbufferReturnItem(rb, rx[(i + round) % num]);
+        }
+
+        //Shift the write position so that later rounds wrap with dummy data
+        TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSendAcquire(rb, &extra, round % ITEM_SIZE, 0));
+        TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSendComplete(rb, extra));
+        extra = xRingbufferReceive(rb, &size, 0);
+        TEST_ASSERT_NOT_NULL(extra);
+        TEST_ASSERT_EQUAL(round % ITEM_SIZE, size);
+        vRingbufferReturnItem(rb, extra);
+    }
+
+    vRingbufferDelete(rb);
+}
+
+TEST_CASE("ring buffer batch receive and return", "[esp_ringbuf]")
+{
+    void *items[ITEM_NUM];
+    size_t sizes[ITEM_NUM];
+    RingbufHandle_t rb = xRingbufferCreateNoSplit(ITEM_SIZE, ITEM_NUM);
+    TEST_ASSERT_NOT_NULL(rb);
+
+    TEST_ASSERT_EQUAL(0, xRingbufferReceiveBatch(rb, items, sizes, ITEM_NUM, 0));
+
+    for (int round = 0; round < 4 * ITEM_NUM; round++) {
+        uint8_t buf[ITEM_SIZE];
+        int num = round % ITEM_NUM + 1;
+
+        for (int i = 0; i < num; i++) {
+            fill_item(buf, i + 1, round + i);
+            TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSend(rb, buf, i + 1, 0));
+        }
+
+        //Receive in two batches, the first one is limited by the array size
+        UBaseType_t first = xRingbufferReceiveBatch(rb, items, sizes, num / 2 + 1, 0);
+        TEST_ASSERT_EQUAL(num / 2 + 1, first);
+        UBaseType_t second = xRingbufferReceiveBatch(rb, &items[first], &sizes[first], ITEM_NUM - first, 0);
+        TEST_ASSERT_EQUAL(num - first, second);
+
+        for (int i = 0; i < num; i++) {
+            TEST_ASSERT_EQUAL(i + 1, sizes[i]);
+            check_item(items[i], sizes[i], round + i);
+        }
+        vRingbufferReturnItemBatch(rb, items, num);
+        TEST_ASSERT_EQUAL(xRingbufferGetMaxItemSize(rb), xRingbufferGetCurFreeSize(rb));
+    }
+
+    vRingbufferDelete(rb);
+}
+
+TEST_CASE("ring buffer batch receive performance", "[esp_ringbuf]")
+{
+    void *items[BENCH_ITEM_NUM];
+    size_t sizes[BENCH_ITEM_NUM];
+    uint8_t buf[BENCH_ITEM_SIZE] = { 0 };
+    int64_t single_us = 0, batch_us = 0;
+    RingbufHandle_t rb = xRingbufferCreateNoSplit(BENCH_ITEM_SIZE, BENCH_ITEM_NUM);
+    TEST_ASSERT_NOT_NULL(rb);
+
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (int i = 0; i < BENCH_ITEM_NUM - 1; i++) {
+            TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSend(rb, buf, sizeof(buf), 0));
+        }
+        int64_t start = esp_timer_get_time();
+        for (int i = 0; i < BENCH_ITEM_NUM - 1; i++) {
+            size_t size;
+            void *item = xRingbufferReceive(rb, &size, 0);
+            TEST_ASSERT_NOT_NULL(item);
+            vRingbufferReturnItem(rb, item);
+        }
+        single_us += esp_timer_get_time() - start;
+
+        for (int i = 0; i < BENCH_ITEM_NUM - 1; i++) {
+            TEST_ASSERT_EQUAL(pdTRUE, xRingbufferSend(rb, buf, sizeof(buf), 0));
+        }
+        start = esp_timer_get_time();
+        UBaseType_t num = xRingbufferReceiveBatch(rb, items, sizes, BENCH_ITEM_NUM, 0);
+        vRingbufferReturnItemBatch(rb, items, num);
+        batch_us += esp_timer_get_time() - start;
+        TEST_ASSERT_EQUAL(BENCH_ITEM_NUM - 1, num);
+    }
+
+    int total = BENCH_ROUNDS * (BENCH_ITEM_NUM - 1);
+    printf("Drain %d items of %d bytes: per item %u us (%u ns/item), batch %u us (%u ns/item)\n",
+           total, BENCH_ITEM_SIZE, (uint32_t)single_us, (uint32_t)(single_us * 1000 / total),
+           (uint32_t)batch_us, (uint32_t)(batch_us * 1000 / total));
+
+    vRingbufferDelete(rb);
+}
@@ -18,6 +18,7 @@
 #include "esp_libc.h"
 #include "esp_system.h"
 #include "esp_task_wdt.h"
+#include "esp_log.h"
 #include "esp_private/esp_system_internal.h"
 
 #include "esp8266/rom_functions.h"
@@ -161,6 +162,10 @@ void panicHandler(void *frame, int wdt)
     } while (REG_READ(INT_ENA_WDEV) != 0);
 
 #ifdef ESP_PANIC_PRINT
+#ifdef CONFIG_LOG_ASYNC
+    esp_log_async_panic_flush();
+#endif
+
     if (wdt) {
         PANIC("Task watchdog got triggered.\r\n\r\n");
     }
@@ -81,6 +81,30 @@ typedef struct heap_region {
 } heap_region_t;
 
 
+#define HEAP_CAPS_HIST_NUM      17  ///< Number of free block size histogram buckets, covers up to 128 KB
+
+/**
+ * Heap information of all the regions that have the given capabilities.
+ */
+typedef struct heap_caps_info {
+    size_t total_free_bytes;        ///< Total free bytes
+    size_t total_allocated_bytes;   ///< Total allocated bytes, including memory block heads
+    size_t largest_free_block;      ///< Size of the largest allocatable memory block
+    size_t minimum_free_bytes;      ///< Lifetime minimum free bytes
+    size_t allocated_blocks;        ///< Number of allocated memory blocks
+    size_t free_blocks;             ///< Number of free memory blocks
+    size_t total_blocks;            ///< Total number of memory blocks
+    size_t free_block_hist[HEAP_CAPS_HIST_NUM]; ///< Bucket N is the number of free blocks of [2^N, 2^(N+1)) bytes
+} heap_caps_info_t;
+
+/**
+ * Statistics of heap_caps_realloc().
+ */
+typedef struct heap_caps_realloc_stats {
+    uint32_t in_place;      ///< Number of reallocations which resized the memory block without moving it
+    uint32_t moved;         ///< Number of reallocations which allocated a new memory block and copied the data
+} heap_caps_realloc_stats_t;
+
 /**
  * @brief Get the total free size of all the regions that have the given capabilities
  *
@@ -105,6 +129,30 @@ size_t heap_caps_get_free_size(uint32_t caps);
  */
 size_t heap_caps_get_minimum_free_size(uint32_t caps);
 
+/**
+ * @brief Get the largest free block of memory able to be allocated with the given capabilities.
+ *
+ * Returns the largest value of ``s`` for which ``heap_caps_malloc(s, caps)`` will succeed.
+ *
+ * @param caps Bitwise OR of MALLOC_CAP_* flags indicating the type of memory
+ *
+ * @return Size of largest free block in bytes.
+ */
+size_t heap_caps_get_largest_free_block(uint32_t caps);
+
+/**
+ * @brief Get heap information of all the regions that have the given capabilities.
+ *
+ * The information includes the largest free block, the free and allocated block counts and a
+ * power-of-two free block size histogram, which together show how fragmented the heap is.
+ *
+ * @note This function walks all the memory blocks with the region locked, so it is not meant for hot paths.
+ *
+ * @param info Pointer to a structure which will be filled with relevant heap information
+ * @param caps Bitwise OR of MALLOC_CAP_* flags indicating the type of memory
+ */
+void heap_caps_get_info(heap_caps_info_t *info, uint32_t caps);
+
 /**
  * @brief Initialize regions of memory to the collection of heaps at runtime.
  *
@@ -179,6 +227,16 @@ void *_heap_caps_calloc(size_t count, size_t size, uint32_t caps, const char *fi
 
 void *_heap_caps_realloc(void *mem, size_t newsize, uint32_t caps, const char *file, size_t line);
 
+/**
+ * @brief Get the statistics of heap_caps_realloc().
+ *
+ * heap_caps_realloc() grows a buffer into the following free memory block or shrinks it by splitting off
+ * its tail when possible, and only falls back to allocating a new buffer and copying the data otherwise.
+ *
+ * @param stats Pointer to the structure to be filled with the in-place and moved reallocation counts
+ */
+void heap_caps_get_realloc_stats(heap_caps_realloc_stats_t *stats);
+
 /**
  * @brief Allocate a chunk of memory which has the given capabilities. The initialized value in the memory is set to zero.
  *
@@ -0,0 +1,105 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Handle of fixed-size object pool.
+ */
+typedef struct heap_caps_pool *heap_caps_pool_handle_t;
+
+/**
+ * Statistics of fixed-size object pool.
+ */
+typedef struct heap_caps_pool_stats {
+    size_t      obj_size;   ///< Size of every object by byte
+    size_t      count;      ///< Number of objects in the pool
+    size_t      used;       ///< Number of objects currently allocated from the pool
+    size_t      max_used;   ///< Maximum number of objects ever allocated from the pool at the same time
+    uint32_t    fallback;   ///< Number of allocations which fell back to the heap because the pool was empty
+} heap_caps_pool_stats_t;
+
+/**
+ * @brief Create a pool of fixed-size objects
+ *
+ * All objects are allocated together with the pool by one heap_caps_malloc(), so that allocating and freeing
+ * objects takes constant time and does not fragment the heap.
+ *
+ * @param obj_size Size, in bytes, of every object
+ * @param count Number of objects in the pool
+ * @param caps Bitwise OR of MALLOC_CAP_* flags indicating the type of memory of the pool
+ *
+ * @return Pool handle on success, NULL if obj_size or count is 0 or there is no memory
+ */
+heap_caps_pool_handle_t heap_caps_pool_create(size_t obj_size, size_t count, uint32_t caps);
+
+/**
+ * @brief Delete a pool created by heap_caps_pool_create()
+ *
+ * @note All objects of the pool must have been freed.
+ *
+ * @param pool Pool handle
+ */
+void heap_caps_pool_delete(heap_caps_pool_handle_t pool);
+
+/**
+ * @brief Allocate an object from the pool
+ *
+ * If the pool is empty, the object is allocated from the heap with the capabilities of the pool
+ * and the "fallback" statistic is increased.
+ *
+ * @note It is safe to call this function from ISR context.
+ *
+ * @param pool Pool handle
+ *
+ * @return A pointer to the object on success, NULL on failure
+ */
+void *heap_caps_pool_alloc(heap_caps_pool_handle_t pool);
+
+/**
+ * @brief Free an object allocated by heap_caps_pool_alloc()
+ *
+ * Objects which were not allocated from the pool memory, are freed back to the heap.
+ *
+ * @note It is safe to call this function from ISR context.
+ *
+ * @param pool Pool handle
+ * @param ptr Pointer to the object, can be NULL
+ */
+void heap_caps_pool_free(heap_caps_pool_handle_t pool, void *ptr);
+
+/**
+ * @brief Get the statistics of the pool
+ *
+ * @param pool Pool handle
+ * @param stats Pointer to the structure to be filled with the pool statistics
+ *
+ * @return
+ *     - ESP_OK on success
+ *     - ESP_ERR_INVALID_ARG if pool or stats is NULL
+ */
+esp_err_t heap_caps_pool_get_stats(heap_caps_pool_handle_t pool, heap_caps_pool_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
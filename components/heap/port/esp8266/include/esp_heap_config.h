@@ -24,4 +24,18 @@
 #define HEAP_REGIONS_MAX 2
 #endif
 
+#ifdef CONFIG_HEAP_ALLOC_SEGREGATED
+/*
+ * Free blocks keep their free list links at the start of their payload,
+ * so every block must be able to hold two pointers.
+ */
+#define MEM_BLK_MIN (2 * sizeof(void *))
+
+#define HEAP_SEG_SL_SHIFT 2                             ///< log2 of second level list number
+#define HEAP_SEG_SL_NUM (1 << HEAP_SEG_SL_SHIFT)        ///< Second level list number of every first level
+#define HEAP_SEG_FL_MIN 4                               ///< Smallest first level index(16 bytes)
+#define HEAP_SEG_FL_MAX 17                              ///< Largest first level index(128 KB, more than HEAP_MAX_SIZE)
+#define HEAP_SEG_FL_NUM (HEAP_SEG_FL_MAX - HEAP_SEG_FL_MIN + 1)
+#else
 #define MEM_BLK_MIN 1
+#endif
@@ -31,6 +31,27 @@ extern "C" {
 #define MEM_BLK_TRACE           0x00000000  ///< Mark the memory block traced
 #endif
 
+#ifdef CONFIG_HEAP_ALLOC_SEGREGATED
+#define HEAP_SEG_BLK_MIN        (MEM_HEAD_SIZE + MEM_BLK_MIN)   ///< Minimum memory block size, including the head
+
+/**
+ * Free list links, stored at the start of the payload of free memory blocks.
+ */
+typedef struct heap_seg_link {
+    mem_blk_t       *prev;  ///< Point to previous free memory block of the same size class
+    mem_blk_t       *next;  ///< Point to next free memory block of the same size class
+} heap_seg_link_t;
+
+/**
+ * Segregated free lists of one heap region.
+ */
+typedef struct heap_seg {
+    uint32_t        fl_bitmap;                                  ///< Bit N set if first level list N is not empty
+    uint8_t         sl_bitmap[HEAP_SEG_FL_NUM];                 ///< Bit N set if second level list N is not empty
+    mem_blk_t       *blocks[HEAP_SEG_FL_NUM][HEAP_SEG_SL_NUM];  ///< Free list heads
+} heap_seg_t;
+#endif
+
 #define _mem_blk_get_ptr(_mem_blk, _offset, _mask)                          \
     ((mem_blk_t *)((((uint32_t *)(_mem_blk))[_offset]) & (~_mask)))
 
@@ -130,8 +151,13 @@ static inline size_t get_blk_region(void *ptr)
 static inline size_t ptr2memblk_size(size_t size, bool trace)
 {
     size_t head_size = trace ? MEM2_HEAD_SIZE : MEM_HEAD_SIZE;
+#ifdef CONFIG_HEAP_ALLOC_SEGREGATED
+    size_t blk_size = HEAP_ALIGN(size + head_size);
 
+    return blk_size < HEAP_SEG_BLK_MIN ? HEAP_SEG_BLK_MIN : blk_size;
+#else
     return HEAP_ALIGN(size + head_size);
+#endif
 }
 
 static inline bool ptr_is_traced(void *ptr)
@@ -164,6 +190,13 @@ static inline size_t ptr_size(void *ptr)
     return size;
 }
 
+#ifdef CONFIG_HEAP_ALLOC_SEGREGATED
+static inline heap_seg_link_t *mem_blk_seg_link(mem_blk_t *mem_blk)
+{
+    return (heap_seg_link_t *)((uint8_t *)mem_blk + MEM_HEAD_SIZE);
+}
+#endif
+
 #ifdef CONFIG_HEAP_TRACING
 static inline size_t mem2_blk_line(mem2_blk_t *mem2_blk)
 {
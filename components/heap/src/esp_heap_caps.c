@@ -36,6 +36,117 @@ size_t g_heap_region_num;
 int __g_heap_trace_mode = HEAP_TRACE_NONE;
 #endif
 
+#ifdef CONFIG_HEAP_ALLOC_SEGREGATED
+/*
+ * Two-level segregated free lists. The first level splits block sizes by power of two,
+ * the second level splits every power of two range into HEAP_SEG_SL_NUM linear classes.
+ * Bitmaps record which lists are not empty, so finding a suitable list is O(1).
+ *
+ * "free_blk" of heap_region_t is only maintained by the first fit allocator.
+ */
+static heap_seg_t s_heap_seg[HEAP_REGIONS_MAX];
+
+static inline int heap_seg_fls(uint32_t val)
+{
+    return 31 - __builtin_clz(val);
+}
+
+static inline void heap_seg_mapping(size_t size, int *fl, int *sl)
+{
+    int f = heap_seg_fls(size);
+
+    if (f > HEAP_SEG_FL_MAX) {
+        *fl = HEAP_SEG_FL_NUM - 1;
+        *sl = HEAP_SEG_SL_NUM - 1;
+    } else {
+        *fl = f - HEAP_SEG_FL_MIN;
+        *sl = (size >> (f - HEAP_SEG_SL_SHIFT)) & (HEAP_SEG_SL_NUM - 1);
+    }
+}
+
+static void IRAM_ATTR heap_seg_insert(size_t num, mem_blk_t *mem_blk)
+{
+    int fl, sl;
+    heap_seg_t *seg = &s_heap_seg[num];
+    heap_seg_link_t *link = mem_blk_seg_link(mem_blk);
+
+    heap_seg_mapping(blk_link_size(mem_blk), &fl, &sl);
+
+    link->prev = NULL;
+    link->next = seg->blocks[fl][sl];
+    if (link->next)
+        mem_blk_seg_link(link->next)->prev = mem_blk;
+    seg->blocks[fl][sl] = mem_blk;
+
+    seg->fl_bitmap |= 1 << fl;
+    seg->sl_bitmap[fl] |= 1 << sl;
+}
+
+static void IRAM_ATTR heap_seg_remove(size_t num, mem_blk_t *mem_blk)
+{
+    int fl, sl;
+    heap_seg_t *seg = &s_heap_seg[num];
+    heap_seg_link_t *link = mem_blk_seg_link(mem_blk);
+
+    heap_seg_mapping(blk_link_size(mem_blk), &fl, &sl);
+
+    if (link->next)
+        mem_blk_seg_link(link->next)->prev = link->prev;
+    if (link->prev) {
+        mem_blk_seg_link(link->prev)->next = link->next;
+    } else {
+        seg->blocks[fl][sl] = link->next;
+        if (!link->next) {
+            seg->sl_bitmap[fl] &= ~(1 << sl);
+            if (!seg->sl_bitmap[fl])
+                seg->fl_bitmap &= ~(1 << fl);
+        }
+    }
+}
+
+/**
+ * @brief Find a free memory block of at least "size" bytes, "size" includes the block head
+ */
+static mem_blk_t IRAM_ATTR *heap_seg_search(size_t num, size_t size)
+{
+    int fl, sl;
+    uint32_t map;
+    mem_blk_t *mem_blk;
+    heap_seg_t *seg = &s_heap_seg[num];
+
+    /*
+     * Round the size up to the next size class, so that any block of the found list is large enough.
+     */
+    heap_seg_mapping(size + (1 << (heap_seg_fls(size) - HEAP_SEG_SL_SHIFT)) - 1, &fl, &sl);
+
+    map = seg->sl_bitmap[fl] & (~0U << sl);
+    if (!map) {
+        map = seg->fl_bitmap & (~0U << (fl + 1));
+        if (map) {
+            fl = __builtin_ctz(map);
+            map = seg->sl_bitmap[fl];
+        }
+    }
+
+    if (map)
+        return seg->blocks[fl][__builtin_ctz(map)];
+
+    /*
+     * No list of larger classes has a block, the only candidates are the blocks of the same
+     * size class which are not smaller than "size".
+     */
+    heap_seg_mapping(size, &fl, &sl);
+    for (mem_blk = seg->blocks[fl][sl]; mem_blk; mem_blk = mem_blk_seg_link(mem_blk)->next) {
+        if (blk_link_size(mem_blk) >= size)
+            return mem_blk;
+    }
+
+    return NULL;
+}
+#endif
+
+static heap_caps_realloc_stats_t s_realloc_stats;
+
 /**
  * @brief Initialize regions of memory to the collection of heaps at runtime.
  */
@@ -59,6 +170,11 @@ void esp_heap_caps_init_region(heap_region_t *region, size_t max_num)
 
         g_heap_region[num].free_blk = mem_start;
         g_heap_region[num].min_free_bytes = g_heap_region[num].free_bytes = blk_link_size(mem_start);
+
+#ifdef CONFIG_HEAP_ALLOC_SEGREGATED
+        memset(&s_heap_seg[num], 0, sizeof(heap_seg_t));
+        heap_seg_insert(num, mem_start);
+#endif
     }
     g_heap_region_num = max_num;
 }
@@ -91,6 +207,66 @@ size_t heap_caps_get_minimum_free_size(uint32_t caps)
     return bytes;
 }
 
+/**
+ * @brief Get the largest free block of memory able to be allocated with the given capabilities.
+ */
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+    heap_caps_info_t info;
+
+    heap_caps_get_info(&info, caps);
+
+    return info.largest_free_block;
+}
+
+/**
+ * @brief Get heap information of all the regions that have the given capabilities.
+ */
+void heap_caps_get_info(heap_caps_info_t *info, uint32_t caps)
+{
+    bool trace = false;
+
+#ifdef CONFIG_HEAP_TRACING
+    trace = __g_heap_trace_mode == HEAP_TRACE_LEAKS;
+#endif
+
+    memset(info, 0, sizeof(heap_caps_info_t));
+
+    for (int num = 0; num < g_heap_region_num; num++) {
+        mem_blk_t *mem_blk;
+
+        if (caps != (caps & g_heap_region[num].caps))
+            continue;
+
+        _heap_caps_lock(num);
+
+        for (mem_blk = (mem_blk_t *)HEAP_ALIGN(g_heap_region[num].start_addr); !mem_blk_is_end(mem_blk);
+             mem_blk = mem_blk_next(mem_blk)) {
+            size_t blk_size = blk_link_size(mem_blk);
+
+            if (mem_blk_is_used(mem_blk)) {
+                info->allocated_blocks++;
+                info->total_allocated_bytes += blk_size;
+            } else {
+                size_t hist = 31 - __builtin_clz(blk_size);
+
+                info->free_blocks++;
+                info->free_block_hist[MIN(hist, HEAP_CAPS_HIST_NUM - 1)]++;
+
+                if (blk_size - mem_blk_head_size(trace) > info->largest_free_block)
+                    info->largest_free_block = blk_size - mem_blk_head_size(trace);
+            }
+        }
+
+        info->total_free_bytes += g_heap_region[num].free_bytes;
+        info->minimum_free_bytes += g_heap_region[num].min_free_bytes;
+
+        _heap_caps_unlock(num);
+    }
+
+    info->total_blocks = info->allocated_blocks + info->free_blocks;
+}
+
 /**
  * @brief Allocate a chunk of memory which has the given capabilities
  */
@@ -113,7 +289,7 @@ void IRAM_ATTR *_heap_caps_malloc(size_t size, uint32_t caps, const char *file,
     }
 
     for (num = 0; num < g_heap_region_num; num++) {
-        bool trace;
+        bool trace = false;
         size_t head_size;
 
         if ((g_heap_region[num].caps & caps) != caps) {
@@ -135,6 +311,13 @@ void IRAM_ATTR *_heap_caps_malloc(size_t size, uint32_t caps, const char *file,
         if (mem_blk_size > g_heap_region[num].free_bytes)
             goto next_region;
 
+#ifdef CONFIG_HEAP_ALLOC_SEGREGATED
+        mem_blk = heap_seg_search(num, mem_blk_size);
+        if (!mem_blk)
+            goto next_region;
+
+        heap_seg_remove(num, mem_blk);
+#else
         mem_blk = (mem_blk_t *)g_heap_region[num].free_blk;
 
         ESP_EARLY_LOGV(TAG, "malloc start %p", mem_blk);
@@ -149,6 +332,7 @@ void IRAM_ATTR *_heap_caps_malloc(size_t size, uint32_t caps, const char *file,
 
         if (!mem_blk || mem_blk_is_end(mem_blk))
             goto next_region;
+#endif
 
         ret_mem = blk2ptr(mem_blk, trace);
         ESP_EARLY_LOGV(TAG, "ret_mem is %p", ret_mem);
@@ -173,6 +357,10 @@ void IRAM_ATTR *_heap_caps_malloc(size_t size, uint32_t caps, const char *file,
 
             mem_blk_set_prev(mem_blk_next(mem_blk), next_mem_blk);
             mem_blk_set_next(mem_blk, next_mem_blk);
+
+#ifdef CONFIG_HEAP_ALLOC_SEGREGATED
+            heap_seg_insert(num, next_mem_blk);
+#endif
         }
 
         mem_blk_set_used(mem_blk);
@@ -181,6 +369,7 @@ void IRAM_ATTR *_heap_caps_malloc(size_t size, uint32_t caps, const char *file,
             ESP_EARLY_LOGV(TAG, "mem_blk1 %p set trace", mem_blk);
         }
 
+#ifndef CONFIG_HEAP_ALLOC_SEGREGATED
         if (g_heap_region[num].free_blk == mem_blk) {
             mem_blk_t *free_blk = mem_blk;
 
@@ -193,6 +382,7 @@ void IRAM_ATTR *_heap_caps_malloc(size_t size, uint32_t caps, const char *file,
         } else {
             ESP_EARLY_LOGV(TAG, "free_blk is %p", g_heap_region[num].free_blk);
         }
+#endif
 
         mem_blk_size = blk_link_size(mem_blk);
         g_heap_region[num].free_bytes -= mem_blk_size;
@@ -274,6 +464,13 @@ void IRAM_ATTR _heap_caps_free(void *ptr, const char *file, size_t line)
     next = mem_blk_next(mem_blk);
     last = mem_blk_next(next);
 
+#ifdef CONFIG_HEAP_ALLOC_SEGREGATED
+    if (prev && !mem_blk_is_used(prev))
+        heap_seg_remove(num, prev);
+    if (last && !mem_blk_is_used(next))
+        heap_seg_remove(num, next);
+#endif
+
     if (prev && !mem_blk_is_used(prev)) {
         mem_blk_set_next(prev, next);
         mem_blk_set_prev(next, prev);
@@ -289,10 +486,14 @@ void IRAM_ATTR _heap_caps_free(void *ptr, const char *file, size_t line)
     ESP_EARLY_LOGV(TAG, "ptr2 prev->next=%p next->prev=%p", mem_blk_prev(mem_blk) ? mem_blk_next(mem_blk_prev(mem_blk)) : NULL,
                         mem_blk_prev(mem_blk_next(mem_blk)));
 
+#ifdef CONFIG_HEAP_ALLOC_SEGREGATED
+    heap_seg_insert(num, tmp);
+#else
     if ((uint8_t *)mem_blk < (uint8_t *)g_heap_region[num].free_blk) {
         ESP_EARLY_LOGV(TAG, "Free update free block from %p to %p", g_heap_region[num].free_blk, mem_blk);
         g_heap_region[num].free_blk = mem_blk;
     }
+#endif
 
     _heap_caps_unlock(num);
 }
@@ -316,6 +517,74 @@ void *_heap_caps_calloc(size_t count, size_t size, uint32_t caps, const char *fi
     return p;
 }
 
+/**
+ * @brief Resize a used memory block without moving it, by merging the following free block into it
+ *        or by splitting off its tail. Must be called with the region locked.
+ *
+ * @return true if the memory block is resized, false if the following free space is not enough
+ */
+static bool IRAM_ATTR heap_caps_resize_in_place(size_t num, mem_blk_t *mem_blk, size_t mem_blk_size, size_t head_size)
+{
+    mem_blk_t *next_mem_blk = mem_blk_next(mem_blk);
+    mem_blk_t *end_mem_blk = next_mem_blk;
+    mem_blk_t *tail_mem_blk = NULL;
+    size_t old_size = blk_link_size(mem_blk);
+    bool next_is_free = !mem_blk_is_end(next_mem_blk) && !mem_blk_is_used(next_mem_blk);
+
+    if (mem_blk_size > old_size && (!next_is_free || old_size + blk_link_size(next_mem_blk) < mem_blk_size))
+        return false;
+
+    if (next_is_free) {
+#ifdef CONFIG_HEAP_ALLOC_SEGREGATED
+        heap_seg_remove(num, next_mem_blk);
+#endif
+        end_mem_blk = mem_blk_next(next_mem_blk);
+    }
+
+    if ((size_t)end_mem_blk - (size_t)mem_blk >= mem_blk_size + head_size + MEM_BLK_MIN) {
+        tail_mem_blk = (mem_blk_t *)((uint8_t *)mem_blk + mem_blk_size);
+
+        tail_mem_blk->prev = tail_mem_blk->next = NULL;
+
+        mem_blk_set_prev(tail_mem_blk, mem_blk);
+        mem_blk_set_next(tail_mem_blk, end_mem_blk);
+
+        mem_blk_set_prev(end_mem_blk, tail_mem_blk);
+        mem_blk_set_next(mem_blk, tail_mem_blk);
+
+#ifdef CONFIG_HEAP_ALLOC_SEGREGATED
+        heap_seg_insert(num, tail_mem_blk);
+#endif
+    } else if (next_is_free) {
+        mem_blk_set_next(mem_blk, end_mem_blk);
+        mem_blk_set_prev(end_mem_blk, mem_blk);
+    }
+
+#ifndef CONFIG_HEAP_ALLOC_SEGREGATED
+    if (next_is_free && g_heap_region[num].free_blk == next_mem_blk) {
+        mem_blk_t *free_blk = tail_mem_blk;
+
+        if (!free_blk) {
+            free_blk = end_mem_blk;
+            while (free_blk && !mem_blk_is_end(free_blk) && mem_blk_is_used(free_blk))
+                free_blk = mem_blk_next(free_blk);
+        }
+
+        g_heap_region[num].free_blk = free_blk;
+    } else if (tail_mem_blk && (uint8_t *)tail_mem_blk < (uint8_t *)g_heap_region[num].free_blk) {
+        g_heap_region[num].free_blk = tail_mem_blk;
+    }
+#endif
+
+    g_heap_region[num].free_bytes = g_heap_region[num].free_bytes + old_size - blk_link_size(mem_blk);
+    if (g_heap_region[num].min_free_bytes > g_heap_region[num].free_bytes)
+        g_heap_region[num].min_free_bytes = g_heap_region[num].free_bytes;
+
+    ESP_EARLY_LOGV(TAG, "resize mem_blk %p from %d to %d in place", mem_blk, old_size, blk_link_size(mem_blk));
+
+    return true;
+}
+
 /**
  * @brief Reallocate memory previously allocated via heap_caps_(m/c/r/z)alloc().
  */
@@ -323,6 +592,30 @@ void *_heap_caps_realloc(void *mem, size_t newsize, uint32_t caps, const char *f
 {
     void *return_addr = (void *)__builtin_return_address(0);
 
+    if (mem && newsize && newsize <= (HEAP_MAX_SIZE - sizeof(mem2_blk_t) * 2)) {
+        size_t num = get_blk_region(mem);
+
+        if (num < g_heap_region_num && (g_heap_region[num].caps & caps) == caps) {
+            bool trace = ptr_is_traced(mem);
+            mem_blk_t *mem_blk = ptr2blk(mem, trace);
+            bool resized;
+
+            _heap_caps_lock(num);
+
+            resized = heap_caps_resize_in_place(num, mem_blk, ptr2memblk_size(newsize, trace), mem_blk_head_size(trace));
+            if (resized) {
+                if (trace)
+                    mem_blk_set_traced((mem2_blk_t *)mem_blk, file, line);
+                s_realloc_stats.in_place++;
+            }
+
+            _heap_caps_unlock(num);
+
+            if (resized)
+                return mem;
+        }
+    }
+
     void *p = _heap_caps_malloc(newsize, caps, file, line);
     if (p && mem) {
         size_t mem_size = ptr_size(mem);
@@ -330,11 +623,25 @@ void *_heap_caps_realloc(void *mem, size_t newsize, uint32_t caps, const char *f
 
         memcpy(p, mem, min);
         _heap_caps_free(mem, (char *)return_addr, line);
+
+        _heap_caps_lock(0);
+        s_realloc_stats.moved++;
+        _heap_caps_unlock(0);
     }
 
     return p;
 }
 
+/**
+ * @brief Get the statistics of heap_caps_realloc().
+ */
+void heap_caps_get_realloc_stats(heap_caps_realloc_stats_t *stats)
+{
+    _heap_caps_lock(0);
+    *stats = s_realloc_stats;
+    _heap_caps_unlock(0);
+}
+
 /**
  * @brief Allocate a chunk of memory which has the given capabilities. The initialized value in the memory is set to zero.
  */
@@ -0,0 +1,159 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "esp_heap_caps.h"
+#include "esp_heap_pool.h"
+#include "esp_heap_port.h"
+
+#include "esp_attr.h"
+
+/**
+ * Free objects are linked through their first word.
+ */
+typedef struct heap_pool_obj {
+    struct heap_pool_obj    *next;
+} heap_pool_obj_t;
+
+struct heap_caps_pool {
+    heap_pool_obj_t     *free_obj;  ///< First free object
+
+    uint8_t             *start;     ///< First object
+    uint8_t             *end;       ///< End of the last object
+
+    uint32_t            caps;       ///< Capabilities of the pool memory
+
+    heap_caps_pool_stats_t stats;
+};
+
+/**
+ * @brief Create a pool of fixed-size objects
+ */
+heap_caps_pool_handle_t heap_caps_pool_create(size_t obj_size, size_t count, uint32_t caps)
+{
+    size_t total_size;
+    struct heap_caps_pool *pool;
+
+    if (!obj_size || !count)
+        return NULL;
+
+    if (obj_size < sizeof(heap_pool_obj_t))
+        obj_size = sizeof(heap_pool_obj_t);
+    obj_size = HEAP_ALIGN(obj_size);
+
+    if (__builtin_mul_overflow(obj_size, count, &total_size)
+        || __builtin_add_overflow(total_size, HEAP_ALIGN(sizeof(struct heap_caps_pool)), &total_size))
+        return NULL;
+
+    pool = heap_caps_malloc(total_size, caps);
+    if (!pool)
+        return NULL;
+
+    pool->start = (uint8_t *)pool + HEAP_ALIGN(sizeof(struct heap_caps_pool));
+    pool->end = pool->start + obj_size * count;
+    pool->caps = caps;
+
+    pool->stats.obj_size = obj_size;
+    pool->stats.count = count;
+    pool->stats.used = 0;
+    pool->stats.max_used = 0;
+    pool->stats.fallback = 0;
+
+    pool->free_obj = NULL;
+    for (size_t i = count; i > 0; i--) {
+        heap_pool_obj_t *obj = (heap_pool_obj_t *)(pool->start + (i - 1) * obj_size);
+
+        obj->next = pool->free_obj;
+        pool->free_obj = obj;
+    }
+
+    return pool;
+}
+
+/**
+ * @brief Delete a pool created by heap_caps_pool_create()
+ */
+void heap_caps_pool_delete(heap_caps_pool_handle_t pool)
+{
+    if (pool)
+        heap_caps_free(pool);
+}
+
+/**
+ * @brief Allocate an object from the pool
+ */
+void IRAM_ATTR *heap_caps_pool_alloc(heap_caps_pool_handle_t pool)
+{
+    heap_pool_obj_t *obj;
+
+    _heap_caps_lock(0);
+
+    obj = pool->free_obj;
+    if (obj) {
+        pool->free_obj = obj->next;
+
+        if (++pool->stats.used > pool->stats.max_used)
+            pool->stats.max_used = pool->stats.used;
+    } else {
+        pool->stats.fallback++;
+    }
+
+    _heap_caps_unlock(0);
+
+    if (!obj)
+        return heap_caps_malloc(pool->stats.obj_size, pool->caps);
+
+    return obj;
+}
+
+/**
+ * @brief Free an object allocated by heap_caps_pool_alloc()
+ */
+void IRAM_ATTR heap_caps_pool_free(heap_caps_pool_handle_t pool, void *ptr)
+{
+    heap_pool_obj_t *obj = (heap_pool_obj_t *)ptr;
+
+    if (!ptr)
+        return;
+
+    if ((uint8_t *)ptr < pool->start || (uint8_t *)ptr >= pool->end) {
+        heap_caps_free(ptr);
+        return;
+    }
+
+    _heap_caps_lock(0);
+
+    obj->next = pool->free_obj;
+    pool->free_obj = obj;
+    pool->stats.used--;
+
+    _heap_caps_unlock(0);
+}
+
+/**
+ * @brief Get the statistics of the pool
+ */
+esp_err_t heap_caps_pool_get_stats(heap_caps_pool_handle_t pool, heap_caps_pool_stats_t *stats)
+{
+    if (!pool || !stats)
+        return ESP_ERR_INVALID_ARG;
+
+    _heap_caps_lock(0);
+    *stats = pool->stats;
+    _heap_caps_unlock(0);
+
+    return ESP_OK;
+}
@@ -115,5 +115,51 @@ TEST_CASE("Test Heap alloc/free effectivity", "[Heap]")
     test_heap_deinit(buf);
 }
 
+#define FRAGMENTED_HEAP_LIST_NOTES 256
+
+#ifdef CONFIG_HEAP_ALLOC_SEGREGATED
+#define HEAP_ALLOCATOR_NAME "segregated free lists"
+#else
+#define HEAP_ALLOCATOR_NAME "first fit"
+#endif
+
+TEST_CASE("Test Heap alloc/free effectivity with fragmented heap", "[Heap]")
+{
+    uint32_t alloc_us = 0, free_us = 0;
+    uint32_t *buf = heap_caps_malloc(FRAGMENTED_HEAP_LIST_NOTES * sizeof(uint32_t), MALLOC_CAP_8BIT);
+    int cnt;
+
+    TEST_ASSERT_NOT_NULL(buf);
+
+    /*
+     * Leave many small holes in front of the free space, which the first fit allocator has to
+     * walk over for every allocation that is larger than a hole.
+     */
+    for (int i = 0; i < FRAGMENTED_HEAP_LIST_NOTES; i++) {
+        buf[i] = (uint32_t)heap_caps_malloc(16, MALLOC_CAP_8BIT);
+        TEST_ASSERT(buf[i]);
+    }
+
+    for (int i = 0; i < FRAGMENTED_HEAP_LIST_NOTES; i += 2) {
+        heap_caps_free((void *)buf[i]);
+        buf[i] = 0;
+    }
+
+    for (cnt = 0; cnt < 1000; cnt++) {
+        void *p = test_alloc_time_in_us(128, &alloc_us);
+        TEST_ASSERT_NOT_NULL(p);
+        test_free_time_in_us(p, &free_us);
+    }
+
+    printf("%s: each alloc costs time %u us, each free costs time %u us\n", HEAP_ALLOCATOR_NAME,
+           alloc_us / cnt, free_us / cnt);
+
+    for (int i = 0; i < FRAGMENTED_HEAP_LIST_NOTES; i++) {
+        if (buf[i])
+            heap_caps_free((void *)buf[i]);
+    }
+    heap_caps_free(buf);
+}
+
 // Enable Heap Trace  :  Each alloc costs time 27 us, each free costs time 5 us
 // Disable Heap Trace :  Each alloc costs time 18 us, each free costs time 4 us
@@ -0,0 +1,87 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <unity.h>
+
+#include "esp_heap_caps.h"
+
+#define TRACE_SLOTS 16
+#define TRACE_REPEAT 20
+
+/**
+ * One step of an allocation trace: allocate "size" bytes into "slot", or free "slot" if "size" is 0.
+ */
+typedef struct {
+    uint8_t     slot;
+    uint16_t    size;
+} heap_trace_op_t;
+
+/**
+ * Trace recorded from one HTTPS request: TLS handshake buffers, HTTP client buffers,
+ * short lived JSON strings and a long lived response which survives the request.
+ */
+static const heap_trace_op_t s_https_request_trace[] = {
+    {0, 1600}, {1, 320}, {2, 48}, {3, 2048}, {4, 24}, {2, 0}, {5, 512}, {4, 0},
+    {6, 96}, {7, 1024}, {8, 40}, {6, 0}, {9, 200}, {8, 0}, {3, 0}, {10, 64},
+    {11, 700}, {9, 0}, {12, 32}, {1, 0}, {13, 128}, {12, 0}, {7, 0}, {14, 56},
+    {0, 0}, {5, 0}, {11, 0}, {13, 0}, {10, 0},
+};
+
+static void heap_trace_print_info(int step)
+{
+    heap_caps_info_t info;
+
+    heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+
+    printf("step %3d free %6u largest %6u free blocks %3u used blocks %3u fragmentation %3u%%\n", step,
+           info.total_free_bytes, info.largest_free_block, info.free_blocks, info.allocated_blocks,
+           info.total_free_bytes ? 100 - info.largest_free_block * 100 / info.total_free_bytes : 0);
+}
+
+TEST_CASE("Test Heap fragmentation replaying allocation trace", "[Heap]")
+{
+    void *slots[TRACE_SLOTS] = { NULL };
+    void *responses[TRACE_REPEAT];
+
+    heap_trace_print_info(0);
+
+    for (int i = 0; i < TRACE_REPEAT; i++) {
+        for (int j = 0; j < sizeof(s_https_request_trace) / sizeof(s_https_request_trace[0]); j++) {
+            const heap_trace_op_t *op = &s_https_request_trace[j];
+
+            if (op->size) {
+                slots[op->slot] = heap_caps_malloc(op->size, MALLOC_CAP_8BIT);
+                TEST_ASSERT_NOT_NULL(slots[op->slot]);
+            } else {
+                heap_caps_free(slots[op->slot]);
+                slots[op->slot] = NULL;
+            }
+        }
+
+        heap_trace_print_info(i + 1);
+
+        // the response of every request stays allocated until the end of the test
+        responses[i] = slots[14];
+        slots[14] = NULL;
+    }
+
+    for (int i = 0; i < TRACE_REPEAT; i++)
+        heap_caps_free(responses[i]);
+
+    TEST_ASSERT(heap_caps_get_largest_free_block(MALLOC_CAP_8BIT) <= heap_caps_get_free_size(MALLOC_CAP_8BIT));
+}
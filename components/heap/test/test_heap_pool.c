@@ -0,0 +1,56 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdint.h>
+#include <string.h>
+
+#include <unity.h>
+
+#include "esp_heap_caps.h"
+#include "esp_heap_pool.h"
+
+#define TEST_POOL_NUM 4
+
+TEST_CASE("Test Heap pool alloc/free", "[Heap]")
+{
+    void *obj[TEST_POOL_NUM + 1];
+    heap_caps_pool_stats_t stats;
+    heap_caps_pool_handle_t pool = heap_caps_pool_create(10, TEST_POOL_NUM, MALLOC_CAP_8BIT);
+
+    TEST_ASSERT_NOT_NULL(pool);
+
+    for (int i = 0; i < TEST_POOL_NUM + 1; i++) {
+        obj[i] = heap_caps_pool_alloc(pool);
+        TEST_ASSERT_NOT_NULL(obj[i]);
+        memset(obj[i], i, 10);
+    }
+
+    TEST_ASSERT_EQUAL(ESP_OK, heap_caps_pool_get_stats(pool, &stats));
+    TEST_ASSERT_EQUAL(12, stats.obj_size);
+    TEST_ASSERT_EQUAL(TEST_POOL_NUM, stats.used);
+    TEST_ASSERT_EQUAL(TEST_POOL_NUM, stats.max_used);
+    TEST_ASSERT_EQUAL(1, stats.fallback);
+
+    for (int i = 0; i < TEST_POOL_NUM + 1; i++) {
+        for (int j = 0; j < 10; j++)
+            TEST_ASSERT_EQUAL(i, ((uint8_t *)obj[i])[j]);
+        heap_caps_pool_free(pool, obj[i]);
+    }
+
+    TEST_ASSERT_EQUAL(ESP_OK, heap_caps_pool_get_stats(pool, &stats));
+    TEST_ASSERT_EQUAL(0, stats.used);
+    TEST_ASSERT_EQUAL(TEST_POOL_NUM, stats.max_used);
+
+    heap_caps_pool_delete(pool);
+}
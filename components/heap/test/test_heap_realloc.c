@@ -0,0 +1,60 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdint.h>
+#include <string.h>
+
+#include <unity.h>
+
+#include "esp_heap_caps.h"
+
+TEST_CASE("Test Heap realloc grows and shrinks in place", "[Heap]")
+{
+    heap_caps_realloc_stats_t before, after;
+    uint8_t *a, *b, *c;
+
+    heap_caps_get_realloc_stats(&before);
+
+    a = heap_caps_malloc(64, MALLOC_CAP_8BIT);
+    b = heap_caps_malloc(256, MALLOC_CAP_8BIT);
+    c = heap_caps_malloc(64, MALLOC_CAP_8BIT);
+    TEST_ASSERT(a && b && c);
+
+    for (int i = 0; i < 64; i++)
+        a[i] = i;
+
+    // "a" can only grow into the space of "b" if "b" directly follows it
+    if (b > a && b < a + 128) {
+        heap_caps_free(b);
+        b = NULL;
+
+        uint8_t *p = heap_caps_realloc(a, 200, MALLOC_CAP_8BIT);
+        TEST_ASSERT_EQUAL_PTR(a, p);
+        for (int i = 0; i < 64; i++)
+            TEST_ASSERT_EQUAL(i, p[i]);
+    }
+
+    uint8_t *p = heap_caps_realloc(a, 32, MALLOC_CAP_8BIT);
+    TEST_ASSERT_EQUAL_PTR(a, p);
+    for (int i = 0; i < 32; i++)
+        TEST_ASSERT_EQUAL(i, p[i]);
+
+    heap_caps_get_realloc_stats(&after);
+    TEST_ASSERT(after.in_place > before.in_place);
+
+    heap_caps_free(p);
+    if (b)
+        heap_caps_free(b);
+    heap_caps_free(c);
+}
@@ -18,6 +18,7 @@
 #include <stdint.h>
 #include <stdarg.h>
 #include "sdkconfig.h"
+#include "esp_err.h"
 #include "rom/ets_sys.h"
 
 #ifdef __cplusplus
@@ -41,6 +42,46 @@ typedef enum {
 
 typedef int (*putchar_like_t)(int ch);
 
+#ifdef CONFIG_LOG_ASYNC
+/**
+ * @brief Counters of the log ring
+ */
+typedef struct {
+    uint32_t lines;     /*!< Lines appended to the ring */
+    uint32_t dropped;   /*!< Lines dropped because the ring was full */
+    uint32_t max_used;  /*!< Most bytes the ring held at once */
+} esp_log_async_stats_t;
+
+/**
+ * @brief Start writing log lines from the log task
+ *
+ * This function is called at startup. From then on, log lines are formatted into a ring
+ * of CONFIG_LOG_ASYNC_BUFFER_SIZE bytes by the tasks logging them, and written out by a low
+ * priority task. Lines logged when the ring is full are dropped, and their number is logged
+ * when the ring is written out.
+ *
+ * @return
+ *    - ESP_OK on success
+ *    - ESP_ERR_INVALID_STATE if the log task is already running
+ *    - ESP_ERR_NO_MEM if the log task can't be created
+ */
+esp_err_t esp_log_async_init(void);
+
+/**
+ * @brief Write out the log lines waiting in the ring from the calling task
+ *
+ * It can be called before restarting or entering sleep, so that no log line is lost.
+ */
+void esp_log_async_flush(void);
+
+/**
+ * @brief Get the counters of the log ring
+ *
+ * @param stats filled with the counters since startup
+ */
+void esp_log_async_get_stats(esp_log_async_stats_t *stats);
+#endif /* CONFIG_LOG_ASYNC */
+
 #ifdef CONFIG_LOG_SET_LEVEL
 /**
  * @brief Set log level for given tag
@@ -54,6 +95,9 @@ typedef int (*putchar_like_t)(int ch);
  * LOG_LOCAL_LEVEL to one of the ESP_LOG_* values, before including
  * esp_log.h in this file.
  *
+ * Levels of the tags logged are cached by the address of the tag, this function empties
+ * the cache.
+ *
  * @param tag Tag of the log entries to enable. Must be a non-NULL zero terminated string.
  *            Value "*" resets log level for all tags to the given value.
  *
@@ -122,6 +166,112 @@ void esp_log_write(esp_log_level_t level, const char* tag, const char* format, .
  */
 void esp_early_log_write(esp_log_level_t level, const char* tag, const char* format, ...) __attribute__ ((format (printf, 3, 4)));
 
+#if defined(CONFIG_LOG_BINARY) && !defined(BOOTLOADER_BUILD)
+/**
+ * @brief Write a binary log record
+ *
+ * This function is not intended to be used directly. With CONFIG_LOG_BINARY, ESP_LOGE, ESP_LOGW,
+ * ESP_LOGI, ESP_LOGD and ESP_LOGV macros use it instead of esp_log_write().
+ *
+ * The record holds the address of the format string, which is kept in the ".esp_log_fmt" section of
+ * the ELF file and not loaded, the timestamp, the address of the tag and the arguments, which are not
+ * formatted. tools/idf_log_decoder.py turns it into the log line.
+ *
+ * @param level       level of the log
+ * @param tag         tag of the log
+ * @param format      format string, in the ".esp_log_fmt" section
+ * @param conversions copy of the format string in flash when arguments are ESP_LOG_BINARY_ARG_BYTES,
+ *                    their conversions tell whether they are copied as strings, NULL otherwise
+ * @param signature   types of the arguments, ESP_LOG_BINARY_ARG_BITS bits each, the first one in the lowest bits
+ */
+void esp_log_binary_write(esp_log_level_t level, const char *tag, const char *format, const char *conversions,
+                          uint32_t signature, ...);
+
+/** @cond */
+#define ESP_LOG_BINARY_ARG_BITS     3
+#define ESP_LOG_BINARY_ARG_INT      1
+#define ESP_LOG_BINARY_ARG_LONG     2
+#define ESP_LOG_BINARY_ARG_INT64    3
+#define ESP_LOG_BINARY_ARG_DOUBLE   4
+#define ESP_LOG_BINARY_ARG_STR      5
+#define ESP_LOG_BINARY_ARG_PTR      6
+#define ESP_LOG_BINARY_ARG_BYTES    7
+
+/*
+ * Pointers to char are strings, which are copied into the record: log them with %p cast to void *.
+ * Pointers to signed or unsigned char are copied as strings if the format converts them with %s, other
+ * pointers are written as %p.
+ */
+#ifdef __cplusplus
+extern "C++" {
+template <typename T> struct esp_log_binary_arg { static const uint32_t type = ESP_LOG_BINARY_ARG_PTR; };
+template <> struct esp_log_binary_arg<int> { static const uint32_t type = ESP_LOG_BINARY_ARG_INT; };
+template <> struct esp_log_binary_arg<unsigned int> { static const uint32_t type = ESP_LOG_BINARY_ARG_INT; };
+template <> struct esp_log_binary_arg<long> { static const uint32_t type = ESP_LOG_BINARY_ARG_LONG; };
+template <> struct esp_log_binary_arg<unsigned long> { static const uint32_t type = ESP_LOG_BINARY_ARG_LONG; };
+template <> struct esp_log_binary_arg<long long> { static const uint32_t type = ESP_LOG_BINARY_ARG_INT64; };
+template <> struct esp_log_binary_arg<unsigned long long> { static const uint32_t type = ESP_LOG_BINARY_ARG_INT64; };
+template <> struct esp_log_binary_arg<float> { static const uint32_t type = ESP_LOG_BINARY_ARG_DOUBLE; };
+template <> struct esp_log_binary_arg<double> { static const uint32_t type = ESP_LOG_BINARY_ARG_DOUBLE; };
+template <> struct esp_log_binary_arg<char *> { static const uint32_t type = ESP_LOG_BINARY_ARG_STR; };
+template <> struct esp_log_binary_arg<const char *> { static const uint32_t type = ESP_LOG_BINARY_ARG_STR; };
+template <> struct esp_log_binary_arg<signed char *> { static const uint32_t type = ESP_LOG_BINARY_ARG_BYTES; };
+template <> struct esp_log_binary_arg<const signed char *> { static const uint32_t type = ESP_LOG_BINARY_ARG_BYTES; };
+template <> struct esp_log_binary_arg<unsigned char *> { static const uint32_t type = ESP_LOG_BINARY_ARG_BYTES; };
+template <> struct esp_log_binary_arg<const unsigned char *> { static const uint32_t type = ESP_LOG_BINARY_ARG_BYTES; };
+}
+#define ESP_LOG_BINARY_ARG_TYPE(a) esp_log_binary_arg<decltype(+(a))>::type
+#else
+#define ESP_LOG_BINARY_ARG_TYPE(a) _Generic((a) + 0,                                                        \
+        int: ESP_LOG_BINARY_ARG_INT,                unsigned int: ESP_LOG_BINARY_ARG_INT,                   \
+        long: ESP_LOG_BINARY_ARG_LONG,              unsigned long: ESP_LOG_BINARY_ARG_LONG,                 \
+        long long: ESP_LOG_BINARY_ARG_INT64,        unsigned long long: ESP_LOG_BINARY_ARG_INT64,           \
+        float: ESP_LOG_BINARY_ARG_DOUBLE,           double: ESP_LOG_BINARY_ARG_DOUBLE,                      \
+        char *: ESP_LOG_BINARY_ARG_STR,             const char *: ESP_LOG_BINARY_ARG_STR,                   \
+        signed char *: ESP_LOG_BINARY_ARG_BYTES,    const signed char *: ESP_LOG_BINARY_ARG_BYTES,          \
+        unsigned char *: ESP_LOG_BINARY_ARG_BYTES,  const unsigned char *: ESP_LOG_BINARY_ARG_BYTES,        \
+        default: ESP_LOG_BINARY_ARG_PTR)
+#endif
+
+/* Up to 10 arguments after a leading 0, their types are found at build time without evaluating them */
+#define ESP_LOG_BINARY_NARG(...) ESP_LOG_BINARY_NARG_(__VA_ARGS__, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define ESP_LOG_BINARY_NARG_(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, n, ...) n
+#define ESP_LOG_BINARY_CONCAT(a, b) ESP_LOG_BINARY_CONCAT_(a, b)
+#define ESP_LOG_BINARY_CONCAT_(a, b) a ## b
+#define ESP_LOG_BINARY_SIGNATURE(...) ESP_LOG_BINARY_CONCAT(ESP_LOG_BINARY_SIG_, ESP_LOG_BINARY_NARG(__VA_ARGS__))(__VA_ARGS__)
+#define ESP_LOG_BINARY_SIG_0(_0) 0
+#define ESP_LOG_BINARY_SIG_1(_0, a) ESP_LOG_BINARY_ARG_TYPE(a)
+#define ESP_LOG_BINARY_SIG_2(_0, a, ...) (ESP_LOG_BINARY_ARG_TYPE(a) | ESP_LOG_BINARY_SIG_1(_0, __VA_ARGS__) << ESP_LOG_BINARY_ARG_BITS)
+#define ESP_LOG_BINARY_SIG_3(_0, a, ...) (ESP_LOG_BINARY_ARG_TYPE(a) | ESP_LOG_BINARY_SIG_2(_0, __VA_ARGS__) << ESP_LOG_BINARY_ARG_BITS)
+#define ESP_LOG_BINARY_SIG_4(_0, a, ...) (ESP_LOG_BINARY_ARG_TYPE(a) | ESP_LOG_BINARY_SIG_3(_0, __VA_ARGS__) << ESP_LOG_BINARY_ARG_BITS)
+#define ESP_LOG_BINARY_SIG_5(_0, a, ...) (ESP_LOG_BINARY_ARG_TYPE(a) | ESP_LOG_BINARY_SIG_4(_0, __VA_ARGS__) << ESP_LOG_BINARY_ARG_BITS)
+#define ESP_LOG_BINARY_SIG_6(_0, a, ...) (ESP_LOG_BINARY_ARG_TYPE(a) | ESP_LOG_BINARY_SIG_5(_0, __VA_ARGS__) << ESP_LOG_BINARY_ARG_BITS)
+#define ESP_LOG_BINARY_SIG_7(_0, a, ...) (ESP_LOG_BINARY_ARG_TYPE(a) | ESP_LOG_BINARY_SIG_6(_0, __VA_ARGS__) << ESP_LOG_BINARY_ARG_BITS)
+#define ESP_LOG_BINARY_SIG_8(_0, a, ...) (ESP_LOG_BINARY_ARG_TYPE(a) | ESP_LOG_BINARY_SIG_7(_0, __VA_ARGS__) << ESP_LOG_BINARY_ARG_BITS)
+#define ESP_LOG_BINARY_SIG_9(_0, a, ...) (ESP_LOG_BINARY_ARG_TYPE(a) | ESP_LOG_BINARY_SIG_8(_0, __VA_ARGS__) << ESP_LOG_BINARY_ARG_BITS)
+#define ESP_LOG_BINARY_SIG_10(_0, a, ...) (ESP_LOG_BINARY_ARG_TYPE(a) | ESP_LOG_BINARY_SIG_9(_0, __VA_ARGS__) << ESP_LOG_BINARY_ARG_BITS)
+
+/* Whether one of the types of the signature is ESP_LOG_BINARY_ARG_BYTES, all its bits being set */
+#define ESP_LOG_BINARY_HAS_BYTES(signature) (((signature) & (signature) >> 1 & (signature) >> 2 & 01111111111) != 0)
+
+/* Never called, the compiler checks the arguments against the format */
+static inline void __attribute__ ((format (printf, 1, 2))) esp_log_binary_check_format(const char *format, ...) { (void)format; }
+
+/*
+ * The format is expanded before this macro splits it, to take the arguments of macros such as LOG_FMT().
+ * It is only kept in flash for the calls which pass pointers to signed or unsigned char.
+ */
+#define ESP_LOG_BINARY_IMPL(level, tag, format, ...) do {                                                    \
+        static const char __attribute__ ((section(".esp_log_fmt"))) _esp_log_fmt[] = format;                  \
+        if (0)                                                                                              \
+            esp_log_binary_check_format(format, ##__VA_ARGS__);                                             \
+        esp_log_binary_write((esp_log_level_t)(level), tag, _esp_log_fmt,                                   \
+                             ESP_LOG_BINARY_HAS_BYTES(ESP_LOG_BINARY_SIGNATURE(0, ##__VA_ARGS__)) ?         \
+                             format : NULL, ESP_LOG_BINARY_SIGNATURE(0, ##__VA_ARGS__), ##__VA_ARGS__);     \
+    } while(0)
+/** @endcond */
+#endif /* CONFIG_LOG_BINARY && !BOOTLOADER_BUILD */
+
 /** @cond */
 
 #include "esp_log_internal.h"
@@ -308,6 +458,9 @@ void esp_early_log_write(esp_log_level_t level, const char* tag, const char* for
  *
  * @see ``printf``
  */
+#if defined(CONFIG_LOG_BINARY) && !defined(BOOTLOADER_BUILD)
+#define ESP_LOG_LEVEL(level, tag, format, ...) ESP_LOG_BINARY_IMPL(level, tag, format, ##__VA_ARGS__)
+#else
 #define ESP_LOG_LEVEL(level, tag, format, ...) do {                     \
         if (level==ESP_LOG_ERROR )          { esp_log_write(ESP_LOG_ERROR,      tag, format, ##__VA_ARGS__); } \
         else if (level==ESP_LOG_WARN )      { esp_log_write(ESP_LOG_WARN,       tag, format, ##__VA_ARGS__); } \
@@ -315,6 +468,7 @@ void esp_early_log_write(esp_log_level_t level, const char* tag, const char* for
         else if (level==ESP_LOG_VERBOSE )   { esp_log_write(ESP_LOG_VERBOSE,    tag, format, ##__VA_ARGS__); } \
         else                                { esp_log_write(ESP_LOG_INFO,       tag, format, ##__VA_ARGS__); } \
     } while(0)
+#endif
 
 /** runtime macro to output logs at a specified level. Also check the level with ``LOG_LOCAL_LEVEL``.
  *
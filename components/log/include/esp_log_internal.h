@@ -24,5 +24,12 @@
 // void esp_log_buffer_char_internal(const char *tag, const void *buffer, uint16_t buff_len, esp_log_level_t level);
 // void esp_log_buffer_hexdump_internal( const char *tag, const void *buffer, uint16_t buff_len, esp_log_level_t log_level);
 
+#ifdef CONFIG_LOG_ASYNC
+/**
+ * @brief Write out the log lines waiting in the ring to the UART, called by the panic handler
+ */
+void esp_log_async_panic_flush(void);
+#endif
+
 #endif
 
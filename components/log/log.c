@@ -20,6 +20,7 @@
 #include <string.h>
 #include <sys/queue.h>
 #include <sys/lock.h>
+#include <sys/param.h>
 
 #include "esp_libc.h"
 #include "esp_attr.h"
@@ -31,6 +32,10 @@
 
 #ifndef BOOTLOADER_BUILD
 #include "FreeRTOS.h"
+#ifdef CONFIG_LOG_ASYNC
+#include "task.h"
+#include "esp_task.h"
+#endif
 #endif
 
 #ifdef CONFIG_LOG_COLORS
@@ -86,12 +91,62 @@ typedef struct uncached_tag_entry_{
 
 static esp_log_level_t s_global_tag_level = ESP_LOG_VERBOSE;
 static SLIST_HEAD(log_tags_head , uncached_tag_entry_) s_log_uncached_tags = SLIST_HEAD_INITIALIZER(s_log_uncached_tags);
-static uncached_tag_entry_t *s_uncached_tag_entry_prev;
+
+/*
+ * Levels of the tags logged last, found by the address of the tag without comparing strings. Tags
+ * which miss are looked up in s_log_uncached_tags, the cache is emptied when a level is set.
+ */
+#define TAG_CACHE_SIZE  32  // power of 2
+
+static const char *s_tag_cache[TAG_CACHE_SIZE];
+static uint8_t s_tag_cache_level[TAG_CACHE_SIZE];
 #endif /* CONFIG_LOG_SET_LEVEL */
 
 static _lock_t s_lock;
 static putchar_like_t s_putchar_func = &putchar;
 
+#ifdef CONFIG_LOG_ASYNC
+#ifdef CONFIG_LOG_COLORS
+#define LOG_LINE_END_SIZE   (sizeof(LOG_COLOR_END) - 1 + 1)
+#else
+#define LOG_LINE_END_SIZE   1
+#endif
+
+/*
+ * Lines are appended whole to the ring by the tasks logging them, in a short critical section,
+ * and written out by the log task. Only the log task, esp_log_async_flush() and the panic handler
+ * take them out of it.
+ */
+static char s_log_ring[CONFIG_LOG_ASYNC_BUFFER_SIZE];
+static size_t s_log_ring_tail;      // index of the oldest byte
+static size_t s_log_ring_used;
+static esp_log_async_stats_t s_log_stats;
+static uint32_t s_log_dropped_reported;
+static bool s_log_line_start = true;    // the log task isn't in the middle of writing a line or a record
+static TaskHandle_t s_log_task;
+static _lock_t s_log_drain_lock;
+#endif
+
+#ifdef CONFIG_LOG_BINARY
+/*
+ * A binary record is made of:
+ *  - LOG_BINARY_MAGIC, which isn't found in UTF-8 text
+ *  - the length of the payload
+ *  - the payload: the level, with LOG_BINARY_TRUNCATED if arguments were left out, the address of the
+ *    format string, the timestamp, the address of the tag, the signature and the arguments
+ *  - the sum of the bytes of the payload
+ * Integers are LEB128 varints, except the addresses of the tag and of %p arguments which are 32 bits
+ * little endian, as are doubles. Strings are copied with their terminating null.
+ */
+#define LOG_BINARY_MAGIC        0xfe
+#define LOG_BINARY_TRUNCATED    0x80
+#ifdef CONFIG_LOG_ASYNC
+#define LOG_BINARY_RECORD_SIZE  MIN(CONFIG_LOG_ASYNC_LINE_SIZE, 255 + 3)
+#else
+#define LOG_BINARY_RECORD_SIZE  128
+#endif
+#endif
+
 #ifdef CONFIG_LOG_SET_LEVEL
 /**
  * @brief get entry by inputting tag
@@ -114,14 +169,27 @@ static bool esp_log_get_tag_entry(const char *tag, uncached_tag_entry_t **entry)
 
 static void clear_log_level_list(void)
 {
-    uncached_tag_entry_t *it = NULL;
+    uncached_tag_entry_t *it;
 
-    SLIST_FOREACH(it, &s_log_uncached_tags, entries) {
-        SLIST_REMOVE(&s_log_uncached_tags, it, uncached_tag_entry_, entries);
+    while ((it = SLIST_FIRST(&s_log_uncached_tags)) != NULL) {
+        SLIST_REMOVE_HEAD(&s_log_uncached_tags, entries);
         free(it);
     }
 }
 
+static inline uint32_t tag_cache_index(const char *tag)
+{
+    /* Tags next to each other in .rodata are spread over the cache */
+    return ((uint32_t)(uintptr_t)tag * 2654435761U) >> 27 & (TAG_CACHE_SIZE - 1);
+}
+
+static void clear_tag_cache(void)
+{
+    vPortEnterCritical();
+    memset(s_tag_cache, 0, sizeof(s_tag_cache));
+    vPortExitCritical();
+}
+
 /**
  * @brief get level by inputting tag
  */
@@ -129,22 +197,29 @@ static esp_log_level_t esp_log_get_level(const char *tag)
 {
     esp_log_level_t out_level;
     uncached_tag_entry_t *entry;
+    const uint32_t index = tag_cache_index(tag);
+    bool hit;
 
-    _lock_acquire_recursive(&s_lock);
+    vPortEnterCritical();
+    hit = s_tag_cache[index] == tag;
+    out_level = (esp_log_level_t)s_tag_cache_level[index];
+    vPortExitCritical();
+    if (hit)
+        return out_level;
 
-    if (s_uncached_tag_entry_prev && !strcmp(s_uncached_tag_entry_prev->tag, tag)) {
-        out_level = (esp_log_level_t)s_uncached_tag_entry_prev->level;
-        goto exit;
-    }
+    /* esp_log_level_set() can't empty the cache before the level found here is put in it */
+    _lock_acquire_recursive(&s_lock);
 
-    if (esp_log_get_tag_entry(tag, &entry) == true) {
+    if (esp_log_get_tag_entry(tag, &entry) == true)
         out_level = (esp_log_level_t)entry->level;
-        s_uncached_tag_entry_prev = entry;
-        goto exit;
-    } else
+    else
         out_level = s_global_tag_level;
 
-exit:
+    vPortEnterCritical();
+    s_tag_cache[index] = tag;
+    s_tag_cache_level[index] = out_level;
+    vPortExitCritical();
+
     _lock_release_recursive(&s_lock);
     return out_level;
 }
@@ -167,6 +242,8 @@ void esp_log_level_set(const char *tag, esp_log_level_t level)
 
     _lock_acquire_recursive(&s_lock);
 
+    clear_tag_cache();
+
     if (!strcmp(tag, GLOBAL_TAG)) {
         s_global_tag_level = level;
         clear_log_level_list();
@@ -205,6 +282,112 @@ static int esp_log_write_str(const char *s)
     return ret;
 }
 
+#ifdef CONFIG_LOG_ASYNC
+/**
+ * @brief append a whole line or record to the ring, or count it as dropped if it is full
+ */
+static void esp_log_async_append(const void *data, size_t len)
+{
+    vPortEnterCritical();
+    if (len > CONFIG_LOG_ASYNC_BUFFER_SIZE - s_log_ring_used) {
+        s_log_stats.dropped++;
+    } else {
+        size_t head = (s_log_ring_tail + s_log_ring_used) % CONFIG_LOG_ASYNC_BUFFER_SIZE;
+        size_t first = MIN(len, CONFIG_LOG_ASYNC_BUFFER_SIZE - head);
+
+        memcpy(s_log_ring + head, data, first);
+        memcpy(s_log_ring, (const char *)data + first, len - first);
+        s_log_ring_used += len;
+        s_log_stats.lines++;
+        if (s_log_ring_used > s_log_stats.max_used)
+            s_log_stats.max_used = s_log_ring_used;
+    }
+    vPortExitCritical();
+
+    xTaskNotifyGive(s_log_task);
+}
+
+/**
+ * @brief format a line on the stack and append it to the ring
+ */
+static void esp_log_async_write(esp_log_level_t level, const char *tag, const char *fmt, va_list va)
+{
+    char line[CONFIG_LOG_ASYNC_LINE_SIZE];
+    const size_t size = sizeof(line) - LOG_LINE_END_SIZE;
+    char prefix = level >= ESP_LOG_MAX ? 'N' : s_log_prefix[level];
+    size_t len = 0;
+    int ret;
+
+#ifdef CONFIG_LOG_COLORS
+    uint32_t color = level >= ESP_LOG_MAX ? 0 : s_log_color[level];
+
+    if (color)
+        len = sprintf(line, LOG_COLOR_HEAD, color);
+#endif
+
+    /* Lines longer than the buffer are truncated, the end of the line is always written */
+    ret = snprintf(line + len, size - len, "%c (%d) %s: ", prefix, esp_log_early_timestamp(), tag);
+    if (ret > 0)
+        len = MIN(len + ret, size - 1);
+    ret = vsnprintf(line + len, size - len, fmt, va);
+    if (ret > 0)
+        len = MIN(len + ret, size - 1);
+
+#ifdef CONFIG_LOG_COLORS
+    if (color) {
+        memcpy(line + len, LOG_COLOR_END, sizeof(LOG_COLOR_END) - 1);
+        len += sizeof(LOG_COLOR_END) - 1;
+    }
+#endif
+    line[len++] = '\n';
+
+    esp_log_async_append(line, len);
+}
+
+/**
+ * @brief write out what the ring holds, and how many lines were dropped since the last report
+ */
+static void esp_log_async_drain(void)
+{
+    size_t tail, len, used;
+    uint32_t dropped;
+
+    _lock_acquire_recursive(&s_log_drain_lock);
+
+    while (1) {
+        vPortEnterCritical();
+        tail = s_log_ring_tail;
+        used = s_log_ring_used;
+        len = MIN(used, CONFIG_LOG_ASYNC_BUFFER_SIZE - tail);
+        dropped = s_log_stats.dropped;
+        vPortExitCritical();
+
+        /* Lines and records wrapping around the end of the ring are written in two parts, not reported in between */
+        if (dropped != s_log_dropped_reported && s_log_line_start) {
+            char buf[48];
+
+            sprintf(buf, "W (%d) log: %u lines dropped\n", esp_log_early_timestamp(), dropped - s_log_dropped_reported);
+            esp_log_write_str(buf);
+            s_log_dropped_reported = dropped;
+        }
+
+        if (!len)
+            break;
+
+        for (size_t i = 0; i < len; i++)
+            s_putchar_func(s_log_ring[tail + i]);
+        s_log_line_start = len == used || tail + len < CONFIG_LOG_ASYNC_BUFFER_SIZE;
+
+        vPortEnterCritical();
+        s_log_ring_tail = (tail + len) % CONFIG_LOG_ASYNC_BUFFER_SIZE;
+        s_log_ring_used -= len;
+        vPortExitCritical();
+    }
+
+    _lock_release_recursive(&s_log_drain_lock);
+}
+#endif /* CONFIG_LOG_ASYNC */
+
 #endif
 
 /**
@@ -248,6 +431,19 @@ void esp_log_write(esp_log_level_t level, const char *tag,  const char *fmt, ...
     char *pbuf;
     char prefix;
 
+#ifdef CONFIG_LOG_ASYNC
+    if (s_log_task) {
+#ifdef CONFIG_LOG_SET_LEVEL
+        if (!should_output(level, esp_log_get_level(tag)))
+            return;
+#endif
+        va_start(va, fmt);
+        esp_log_async_write(level, tag, fmt, va);
+        va_end(va);
+        return;
+    }
+#endif
+
     _lock_acquire_recursive(&s_lock);
 
 #ifdef CONFIG_LOG_SET_LEVEL
@@ -300,6 +496,172 @@ exit:
     _lock_release_recursive(&s_lock);
 }
 
+#ifdef CONFIG_LOG_BINARY
+static size_t esp_log_binary_put_varint(uint8_t *p, uint32_t val)
+{
+    size_t len = 0;
+
+    while (val >= 0x80) {
+        p[len++] = (uint8_t)val | 0x80;
+        val >>= 7;
+    }
+    p[len++] = val;
+
+    return len;
+}
+
+static size_t esp_log_binary_put_varint64(uint8_t *p, uint64_t val)
+{
+    size_t len = 0;
+
+    while (val >= 0x80) {
+        p[len++] = (uint8_t)val | 0x80;
+        val >>= 7;
+    }
+    p[len++] = val;
+
+    return len;
+}
+
+static size_t esp_log_binary_put_u32(uint8_t *p, uint32_t val)
+{
+    p[0] = val;
+    p[1] = val >> 8;
+    p[2] = val >> 16;
+    p[3] = val >> 24;
+
+    return 4;
+}
+
+/*
+ * Gives the pointers to signed or unsigned char of the signature the type of their conversion in the
+ * format: strings for %s, pointers otherwise.
+ */
+static uint32_t esp_log_binary_resolve_bytes(const char *conversions, uint32_t signature)
+{
+    const uint32_t mask = (1 << ESP_LOG_BINARY_ARG_BITS) - 1;
+    /* Up to 10 arguments */
+    const uint32_t bits = 10 * ESP_LOG_BINARY_ARG_BITS;
+    const char *f = conversions;
+    uint32_t shift = 0;
+
+    while (shift < bits && (f = strchr(f, '%')) != NULL) {
+        if (*++f == '%') {
+            f++;
+            continue;
+        }
+        /* Flags, width, precision and length, a '*' takes an argument */
+        for (; *f && !strchr("diouxXeEfFgGaAcspn", *f); f++) {
+            if (*f == '*')
+                shift += ESP_LOG_BINARY_ARG_BITS;
+        }
+        if (!*f || shift >= bits)
+            break;
+        if ((signature >> shift & mask) == ESP_LOG_BINARY_ARG_BYTES) {
+            uint32_t type = *f == 's' ? ESP_LOG_BINARY_ARG_STR : ESP_LOG_BINARY_ARG_PTR;
+
+            signature ^= (ESP_LOG_BINARY_ARG_BYTES ^ type) << shift;
+        }
+        shift += ESP_LOG_BINARY_ARG_BITS;
+        f++;
+    }
+
+    /* Arguments without a conversion */
+    for (shift = 0; shift < bits; shift += ESP_LOG_BINARY_ARG_BITS) {
+        if ((signature >> shift & mask) == ESP_LOG_BINARY_ARG_BYTES)
+            signature ^= (uint32_t)(ESP_LOG_BINARY_ARG_BYTES ^ ESP_LOG_BINARY_ARG_PTR) << shift;
+    }
+
+    return signature;
+}
+
+/**
+ * @brief Write a binary log record
+ */
+void esp_log_binary_write(esp_log_level_t level, const char *tag, const char *format, const char *conversions,
+                          uint32_t signature, ...)
+{
+    uint8_t rec[LOG_BINARY_RECORD_SIZE];
+    uint8_t *p = rec + 2;
+    /* The last byte is kept for the checksum */
+    uint8_t *const end = rec + sizeof(rec) - 1;
+    uint8_t sum = 0;
+    va_list va;
+
+#ifdef CONFIG_LOG_SET_LEVEL
+    if (!should_output(level, esp_log_get_level(tag)))
+        return;
+#endif
+
+    if (conversions)
+        signature = esp_log_binary_resolve_bytes(conversions, signature);
+
+    *p++ = level;
+    p += esp_log_binary_put_varint(p, (uintptr_t)format);
+    p += esp_log_binary_put_varint(p, esp_log_early_timestamp());
+    p += esp_log_binary_put_u32(p, (uintptr_t)tag);
+    p += esp_log_binary_put_varint(p, signature);
+
+    va_start(va, signature);
+    for (; signature; signature >>= ESP_LOG_BINARY_ARG_BITS) {
+        uint32_t type = signature & ((1 << ESP_LOG_BINARY_ARG_BITS) - 1);
+
+        /* Arguments which don't fit are left out, the string which doesn't fit is cut */
+        if (end - p < (type == ESP_LOG_BINARY_ARG_STR ? 1 : 10)) {
+            rec[2] |= LOG_BINARY_TRUNCATED;
+            break;
+        }
+
+        if (type == ESP_LOG_BINARY_ARG_INT) {
+            p += esp_log_binary_put_varint(p, va_arg(va, int));
+        } else if (type == ESP_LOG_BINARY_ARG_LONG) {
+            p += esp_log_binary_put_varint(p, va_arg(va, long));
+        } else if (type == ESP_LOG_BINARY_ARG_INT64) {
+            p += esp_log_binary_put_varint64(p, va_arg(va, long long));
+        } else if (type == ESP_LOG_BINARY_ARG_DOUBLE) {
+            double val = va_arg(va, double);
+
+            memcpy(p, &val, sizeof(val));
+            p += sizeof(val);
+        } else if (type == ESP_LOG_BINARY_ARG_STR) {
+            const char *str = va_arg(va, const char *);
+            size_t len = strnlen(str ? str : "(null)", end - p - 1);
+
+            memcpy(p, str ? str : "(null)", len);
+            p += len;
+            *p++ = '\0';
+            if (str && str[len]) {
+                rec[2] |= LOG_BINARY_TRUNCATED;
+                break;
+            }
+        } else {
+            p += esp_log_binary_put_u32(p, (uintptr_t)va_arg(va, void *));
+        }
+    }
+    va_end(va);
+
+    rec[0] = LOG_BINARY_MAGIC;
+    rec[1] = p - rec - 2;
+    for (uint8_t *b = rec + 2; b < p; b++)
+        sum += *b;
+    *p++ = sum;
+
+#ifdef CONFIG_LOG_ASYNC
+    if (s_log_task) {
+        esp_log_async_append(rec, p - rec);
+        return;
+    }
+#endif
+
+    _lock_acquire_recursive(&s_lock);
+    for (uint8_t *b = rec; b < p; b++) {
+        if (s_putchar_func(*b) == EOF)
+            break;
+    }
+    _lock_release_recursive(&s_lock);
+}
+#endif /* CONFIG_LOG_BINARY */
+
 /**
  * @brief Set function used to output log entries
  */
@@ -314,4 +676,56 @@ putchar_like_t esp_log_set_putchar(putchar_like_t func)
 
     return tmp;
 }
+
+#ifdef CONFIG_LOG_ASYNC
+static void esp_log_async_task(void *arg)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        esp_log_async_drain();
+    }
+}
+
+/**
+ * @brief Start writing log lines from the log task
+ */
+esp_err_t esp_log_async_init(void)
+{
+    if (s_log_task)
+        return ESP_ERR_INVALID_STATE;
+
+    if (xTaskCreate(esp_log_async_task, "log", ESP_TASK_LOG_STACK, NULL, ESP_TASK_LOG_PRIO, &s_log_task) != pdPASS)
+        return ESP_ERR_NO_MEM;
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Write out the log lines waiting in the ring from the calling task
+ */
+void esp_log_async_flush(void)
+{
+    esp_log_async_drain();
+}
+
+/**
+ * @brief Get the counters of the log ring
+ */
+void esp_log_async_get_stats(esp_log_async_stats_t *stats)
+{
+    vPortEnterCritical();
+    *stats = s_log_stats;
+    vPortExitCritical();
+}
+
+/**
+ * @brief Write out the log lines waiting in the ring to the UART, at panic
+ */
+void esp_log_async_panic_flush(void)
+{
+    /* Nothing can run anymore, the ring is written as it is, without taking the lines out of it */
+    for (size_t i = 0; i < s_log_ring_used; i++)
+        ets_putc(s_log_ring[(s_log_ring_tail + i) % CONFIG_LOG_ASYNC_BUFFER_SIZE]);
+}
+#endif /* CONFIG_LOG_ASYNC */
 #endif
@@ -0,0 +1,55 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/* The log calls of the binary tests, built as C */
+#define CONFIG_LOG_BINARY 1
+#include "esp_log.h"
+
+static const char *TAG = "binary";
+
+const char *binary_log_tag(void)
+{
+    return TAG;
+}
+
+void binary_log_args(void)
+{
+    ESP_LOGI(TAG, "int %d unsigned %u long %ld long long %lld double %.3f char %c string %s bytes %s pointer %p",
+             -5, 7u, -123456L, -1234567890123LL, 2.5, 'x', "hello", (const uint8_t *)"ssid", (void *)0x1234);
+}
+
+void binary_log_bytes(const uint8_t *buf)
+{
+    ESP_LOGI(TAG, "%p %.*s %-12p %s", buf, 2, buf, buf, buf);
+}
+
+void binary_log_no_args(void)
+{
+    ESP_LOGW(TAG, "no arguments");
+}
+
+void binary_log_level(esp_log_level_t level, int i)
+{
+    ESP_LOG_LEVEL(level, TAG, "level %d", i);
+}
+
+void binary_log_long(const char *str, int i)
+{
+    ESP_LOGE(TAG, "%s %d", str, i);
+}
+
+void binary_log_bench(int i, int count)
+{
+    ESP_LOGI("bench", "value %d of %d", i, count);
+}
@@ -0,0 +1,44 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define pdTRUE          1
+#define pdFALSE         0
+#define pdPASS          pdTRUE
+#define portMAX_DELAY   0xffffffffUL
+
+typedef uint32_t TickType_t;
+typedef unsigned long UBaseType_t;
+typedef long BaseType_t;
+
+/* Implemented by the tests */
+extern uint32_t g_esp_ticks_per_us;
+uint32_t soc_get_ccount(void);
+
+/* The critical sections of all tasks share one mutex */
+extern pthread_mutex_t g_mock_critical;
+
+static inline void vPortEnterCritical(void)
+{
+    pthread_mutex_lock(&g_mock_critical);
+}
+
+static inline void vPortExitCritical(void)
+{
+    pthread_mutex_unlock(&g_mock_critical);
+}
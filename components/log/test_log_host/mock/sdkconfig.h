@@ -0,0 +1,23 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#define CONFIG_LOG_DEFAULT_LEVEL 5
+#define CONFIG_LOG_COLORS 1
+#define CONFIG_LOG_SET_LEVEL 1
+#define CONFIG_LOG_ASYNC 1
+#define CONFIG_LOG_ASYNC_BUFFER_SIZE 2048
+#define CONFIG_LOG_ASYNC_LINE_SIZE 128
+#define CONFIG_LOG_ASYNC_TASK_STACK_SIZE 1536
@@ -0,0 +1,44 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <pthread.h>
+
+/* Recursive locks of newlib on pthread mutexes, which are ready when zeroed */
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_t owner;
+    int count;
+} _lock_t;
+
+static inline void _lock_acquire_recursive(_lock_t *lock)
+{
+    /* Only the owner finds itself there, it is cleared before the mutex is released */
+    if (pthread_equal(__atomic_load_n(&lock->owner, __ATOMIC_RELAXED), pthread_self())) {
+        lock->count++;
+        return;
+    }
+    pthread_mutex_lock(&lock->mutex);
+    __atomic_store_n(&lock->owner, pthread_self(), __ATOMIC_RELAXED);
+    lock->count = 1;
+}
+
+static inline void _lock_release_recursive(_lock_t *lock)
+{
+    if (--lock->count == 0) {
+        __atomic_store_n(&lock->owner, (pthread_t)0, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&lock->mutex);
+    }
+}
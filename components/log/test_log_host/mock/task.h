@@ -0,0 +1,85 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdlib.h>
+#include <pthread.h>
+#include "FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+
+/* Tasks are threads, which are never deleted */
+typedef struct {
+    TaskFunction_t func;
+    void *arg;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    uint32_t notified;
+} mock_task_t;
+
+typedef mock_task_t *TaskHandle_t;
+
+static __thread TaskHandle_t s_mock_current_task;
+
+static inline void *mock_task_start(void *arg)
+{
+    s_mock_current_task = (TaskHandle_t)arg;
+    s_mock_current_task->func(s_mock_current_task->arg);
+    return NULL;
+}
+
+static inline BaseType_t xTaskCreate(TaskFunction_t func, const char *name, uint32_t stack, void *arg,
+                                     UBaseType_t prio, TaskHandle_t *handle)
+{
+    TaskHandle_t task = (TaskHandle_t)calloc(1, sizeof(mock_task_t));
+
+    if (!task)
+        return pdFALSE;
+    task->func = func;
+    task->arg = arg;
+    pthread_mutex_init(&task->mutex, NULL);
+    pthread_cond_init(&task->cond, NULL);
+    *handle = task;
+    if (pthread_create(&task->thread, NULL, mock_task_start, task)) {
+        *handle = NULL;
+        free(task);
+        return pdFALSE;
+    }
+    return pdPASS;
+}
+
+static inline BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->mutex);
+    task->notified++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->mutex);
+    return pdPASS;
+}
+
+static inline uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+    TaskHandle_t task = s_mock_current_task;
+    uint32_t notified;
+
+    pthread_mutex_lock(&task->mutex);
+    while (!task->notified)
+        pthread_cond_wait(&task->cond, &task->mutex);
+    notified = task->notified;
+    task->notified = clear ? 0 : notified - 1;
+    pthread_mutex_unlock(&task->mutex);
+    return notified;
+}
@@ -0,0 +1,676 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch.hpp"
+#include "esp_log.h"
+#include "esp_log_internal.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+/* binary_log_c.c and binary_log_cpp.cpp log the same lines as binary records */
+extern "C" {
+const char *binary_log_tag(void);
+void binary_log_args(void);
+void binary_log_bytes(const uint8_t *buf);
+void binary_log_no_args(void);
+void binary_log_level(esp_log_level_t level, int i);
+void binary_log_long(const char *str, int i);
+void binary_log_bench(int i, int count);
+}
+
+namespace cpp {
+const char *binary_log_tag(void);
+void binary_log_args(void);
+void binary_log_bytes(const uint8_t *buf);
+void binary_log_no_args(void);
+void binary_log_level(esp_log_level_t level, int i);
+void binary_log_long(const char *str, int i);
+}
+
+static const steady_clock::time_point s_boot = steady_clock::now();
+static std::string s_uart;
+
+extern "C" {
+uint64_t g_esp_os_us;
+uint32_t g_esp_boot_ccount;
+uint32_t g_esp_ticks_per_us = 80;
+pthread_mutex_t g_mock_critical = PTHREAD_MUTEX_INITIALIZER;
+
+uint32_t soc_get_ccount(void)
+{
+    return duration_cast<microseconds>(steady_clock::now() - s_boot).count() * g_esp_ticks_per_us;
+}
+
+int ets_putc(int c)
+{
+    s_uart += (char)c;
+    return c;
+}
+
+int ets_vprintf(const char *fmt, va_list ap)
+{
+    return vprintf(fmt, ap);
+}
+
+int ets_printf(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int ret = vprintf(fmt, ap);
+    va_end(ap);
+    return ret;
+}
+}
+
+/* The output of the log, which can be blocked, discarded or slowed down to the speed of a UART */
+struct Sink {
+    std::mutex mutex;
+    std::condition_variable unblocked;
+    std::string output;
+    bool blocked = false;
+    bool discard = false;
+    nanoseconds per_char{0};
+    size_t bytes = 0;
+
+    static int putchar(int c)
+    {
+        Sink &sink = instance();
+        nanoseconds per_char;
+        {
+            std::unique_lock<std::mutex> lock(sink.mutex);
+            sink.unblocked.wait(lock, [&]() { return !sink.blocked; });
+            if (!sink.discard) {
+                sink.output += (char)c;
+            }
+            sink.bytes++;
+            per_char = sink.per_char;
+        }
+        /* The UART is polled, the time is spent by the task writing */
+        auto until = steady_clock::now() + per_char;
+        while (per_char.count() && steady_clock::now() < until) {
+        }
+        return c;
+    }
+
+    static Sink &instance()
+    {
+        static Sink sink;
+        return sink;
+    }
+
+    void block(bool block)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        blocked = block;
+        unblocked.notify_all();
+    }
+
+    void set(bool discard, nanoseconds per_char)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->discard = discard;
+        this->per_char = per_char;
+    }
+
+    size_t written()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return bytes;
+    }
+
+    std::string take()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::string ret;
+        ret.swap(output);
+        return ret;
+    }
+};
+
+static void log_async_start()
+{
+    static bool started;
+    if (!started) {
+        esp_log_set_putchar(Sink::putchar);
+        REQUIRE(esp_log_async_init() == ESP_OK);
+        started = true;
+    }
+}
+
+static esp_log_async_stats_t log_async_stats()
+{
+    esp_log_async_stats_t stats;
+    esp_log_async_get_stats(&stats);
+    return stats;
+}
+
+static std::vector<std::string> split_lines(const std::string &output)
+{
+    std::vector<std::string> lines;
+    size_t start = 0, end;
+    while ((end = output.find('\n', start)) != std::string::npos) {
+        lines.push_back(output.substr(start, end - start));
+        start = end + 1;
+    }
+    REQUIRE(start == output.size());
+    return lines;
+}
+
+/* Adds up the counts of the "lines dropped" reports, and removes them */
+static unsigned take_dropped_reports(std::vector<std::string> &lines)
+{
+    static const std::regex report("W \\([0-9]+\\) log: ([0-9]+) lines dropped");
+    unsigned dropped = 0;
+    for (auto it = lines.begin(); it != lines.end();) {
+        std::smatch match;
+        if (std::regex_match(*it, match, report)) {
+            dropped += std::stoul(match[1]);
+            it = lines.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return dropped;
+}
+
+static void text_log(int i, int count)
+{
+    ESP_LOGI("bench", "value %d of %d", i, count);
+}
+
+/* Runs first, the log is synchronous until it is started */
+TEST_CASE("dump log latency", "[log][benchmark]")
+{
+    Sink &sink = Sink::instance();
+    static bool sync_measured;
+
+    auto measure = [&](const char *name, int count, void (*log)(int, int)) {
+        esp_log_async_stats_t before = log_async_stats();
+        size_t bytes = sink.written();
+        nanoseconds total{0}, max{0};
+        for (int i = 0; i < count; i++) {
+            auto start = steady_clock::now();
+            log(i, count);
+            nanoseconds elapsed = steady_clock::now() - start;
+            total += elapsed;
+            max = std::max(max, elapsed);
+        }
+        esp_log_async_flush();
+        esp_log_async_stats_t after = log_async_stats();
+        unsigned dropped = after.dropped - before.dropped;
+        printf("%-36s mean %9.2f us, max %9.2f us, %5u of %5d lines dropped, %5.1f bytes per line\n", name,
+               duration_cast<duration<double, std::micro>>(total).count() / count,
+               duration_cast<duration<double, std::micro>>(max).count(),
+               dropped, count, (double)(sink.written() - bytes) / (count - dropped));
+    };
+
+    const nanoseconds uart_char(86806);
+    sink.set(true, nanoseconds(0));
+    esp_log_set_putchar(Sink::putchar);
+    if (!sync_measured) {
+        measure("sync, memory", 100000, text_log);
+        measure("sync, binary, memory", 100000, binary_log_bench);
+        sink.set(true, uart_char);
+        measure("sync, UART at 115200 baud", 100, text_log);
+        measure("sync, binary, UART at 115200 baud", 100, binary_log_bench);
+        sink.set(true, nanoseconds(0));
+        sync_measured = true;
+    }
+
+    log_async_start();
+    measure("async, memory", 100000, text_log);
+    measure("async, binary, memory", 100000, binary_log_bench);
+    sink.set(true, uart_char);
+    measure("async, UART at 115200 baud", 1000, text_log);
+    measure("async, binary, UART at 115200 baud", 1000, binary_log_bench);
+    sink.set(false, nanoseconds(0));
+    sink.take();
+}
+
+TEST_CASE("log lines of several tasks are written whole and in order", "[log]")
+{
+    const int tasks = 4;
+    const int count = 2000;
+    Sink &sink = Sink::instance();
+
+    log_async_start();
+    esp_log_async_flush();
+    sink.take();
+    esp_log_async_stats_t before = log_async_stats();
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < tasks; t++) {
+        threads.emplace_back([t]() {
+            for (int i = 0; i < count; i++) {
+                ESP_LOGI("order", "task %d line %d", t, i);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    esp_log_async_flush();
+    esp_log_async_stats_t after = log_async_stats();
+
+    std::vector<std::string> lines = split_lines(sink.take());
+    unsigned dropped = take_dropped_reports(lines);
+    CHECK(dropped == after.dropped - before.dropped);
+    CHECK(lines.size() == after.lines - before.lines);
+    CHECK(lines.size() + dropped == tasks * count);
+    CHECK(after.max_used <= CONFIG_LOG_ASYNC_BUFFER_SIZE);
+
+    static const std::regex line("\033\\[0;32mI \\([0-9]+\\) order: task ([0-9]+) line ([0-9]+)\033\\[0m");
+    std::vector<int> last(tasks, -1);
+    for (const auto &l : lines) {
+        std::smatch match;
+        REQUIRE(std::regex_match(l, match, line));
+        int t = std::stoi(match[1]);
+        int i = std::stoi(match[2]);
+        REQUIRE(t < tasks);
+        CHECK(i > last[t]);
+        last[t] = i;
+    }
+}
+
+TEST_CASE("log lines are dropped and counted while the output is blocked", "[log]")
+{
+    const int count = 200;
+    Sink &sink = Sink::instance();
+
+    log_async_start();
+    esp_log_async_flush();
+    sink.take();
+    esp_log_async_stats_t before = log_async_stats();
+
+    sink.block(true);
+    for (int i = 0; i < count; i++) {
+        ESP_LOGW("blocked", "line %d", i);
+    }
+    esp_log_async_stats_t blocked = log_async_stats();
+    CHECK(blocked.dropped - before.dropped > 0);
+    CHECK(blocked.max_used > CONFIG_LOG_ASYNC_BUFFER_SIZE - CONFIG_LOG_ASYNC_LINE_SIZE);
+    sink.block(false);
+    esp_log_async_flush();
+
+    std::vector<std::string> lines = split_lines(sink.take());
+    unsigned dropped = take_dropped_reports(lines);
+    CHECK(dropped == blocked.dropped - before.dropped);
+    CHECK(lines.size() == blocked.lines - before.lines);
+    CHECK(lines.size() + dropped == count);
+    /* The lines which fit are the first ones */
+    for (size_t i = 0; i < lines.size(); i++) {
+        CHECK(lines[i].find("blocked: line " + std::to_string(i) + "\033") != std::string::npos);
+    }
+}
+
+TEST_CASE("long log lines are truncated", "[log]")
+{
+    Sink &sink = Sink::instance();
+    std::string message(500, 'x');
+
+    log_async_start();
+    esp_log_async_flush();
+    sink.take();
+
+    ESP_LOGE("long", "%s", message.c_str());
+    ESP_LOGD("long", "%s", message.c_str());
+    esp_log_async_flush();
+
+    std::vector<std::string> lines = split_lines(sink.take());
+    REQUIRE(lines.size() == 2);
+    CHECK(lines[0].size() < CONFIG_LOG_ASYNC_LINE_SIZE);
+    CHECK(lines[0].find("\033[0;31mE (") == 0);
+    CHECK(lines[0].find(": xxxxxxxx") != std::string::npos);
+    CHECK(lines[0].substr(lines[0].size() - 5) == "x\033[0m");
+    CHECK(lines[1].size() < CONFIG_LOG_ASYNC_LINE_SIZE);
+    CHECK(lines[1].find("D (") == 0);
+    CHECK(lines[1].back() == 'x');
+}
+
+TEST_CASE("log lines below the level of their tag are not kept", "[log]")
+{
+    Sink &sink = Sink::instance();
+
+    log_async_start();
+    esp_log_async_flush();
+    sink.take();
+    esp_log_async_stats_t before = log_async_stats();
+
+    esp_log_level_set("quiet", ESP_LOG_WARN);
+    ESP_LOGI("quiet", "not kept");
+    ESP_LOGW("quiet", "kept");
+    esp_log_level_set("quiet", ESP_LOG_VERBOSE);
+    esp_log_async_flush();
+
+    CHECK(log_async_stats().lines - before.lines == 1);
+    std::vector<std::string> lines = split_lines(sink.take());
+    REQUIRE(lines.size() == 1);
+    CHECK(lines[0].find("quiet: kept") != std::string::npos);
+}
+
+TEST_CASE("tag levels are found for copies of the tag and changed by esp_log_level_set", "[log]")
+{
+    Sink &sink = Sink::instance();
+    char copy[] = "cached";
+
+    log_async_start();
+    esp_log_async_flush();
+    sink.take();
+
+    esp_log_level_set("cached", ESP_LOG_WARN);
+    ESP_LOGI("cached", "not kept");
+    ESP_LOGI(copy, "not kept");
+    esp_log_level_set("cached", ESP_LOG_INFO);
+    ESP_LOGI("cached", "kept");
+    ESP_LOGI(copy, "kept");
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    ESP_LOGW("cached", "not kept");
+    esp_log_level_set("*", ESP_LOG_VERBOSE);
+    ESP_LOGW("cached", "kept");
+    esp_log_async_flush();
+
+    std::vector<std::string> lines = split_lines(sink.take());
+    REQUIRE(lines.size() == 3);
+    for (const std::string &line : lines) {
+        CHECK(line.find("cached: kept") != std::string::npos);
+    }
+}
+
+TEST_CASE("tag level lookup latency", "[log][benchmark]")
+{
+    const int tags = 50;
+    std::vector<std::string> names;
+    std::vector<std::vector<char>> copies;
+
+    log_async_start();
+    for (int i = 0; i < tags; i++) {
+        names.push_back("tag" + std::to_string(i));
+        esp_log_level_set(names.back().c_str(), ESP_LOG_INFO);
+    }
+    /* Copies of the tags at as many addresses as log calls miss the cache, their level is found by
+       comparing strings like before the cache */
+    for (int i = 0; i < 1000; i++) {
+        const std::string &name = names[i % tags];
+        copies.emplace_back(name.c_str(), name.c_str() + name.size() + 1);
+    }
+
+    auto measure = [&](const char *name, int count, std::function<const char *(int)> tag) {
+        esp_log_async_stats_t before = log_async_stats();
+        auto start = steady_clock::now();
+        for (int i = 0; i < count; i++) {
+            ESP_LOG_LEVEL(ESP_LOG_DEBUG, tag(i), "filtered out %d", i);
+        }
+        nanoseconds elapsed = steady_clock::now() - start;
+        CHECK(log_async_stats().lines == before.lines);
+        printf("%-36s mean %9.3f us\n", name, duration_cast<duration<double, std::micro>>(elapsed).count() / count);
+    };
+
+    /* The first tags set are at the end of the list */
+    measure("filtered, 50 tags, cached", 1000000, [&](int i) { return names[i % 4].c_str(); });
+    measure("filtered, 50 tags, string compare", 1000000, [&](int i) { return copies[i % copies.size()].data(); });
+
+    esp_log_level_set("*", ESP_LOG_VERBOSE);
+}
+
+TEST_CASE("log lines waiting in the ring are written out at panic", "[log]")
+{
+    Sink &sink = Sink::instance();
+
+    log_async_start();
+    esp_log_async_flush();
+    sink.take();
+
+    sink.block(true);
+    ESP_LOGI("panic", "first");
+    ESP_LOGI("panic", "second");
+    s_uart.clear();
+    esp_log_async_panic_flush();
+
+    std::vector<std::string> lines = split_lines(s_uart);
+    REQUIRE(lines.size() == 2);
+    CHECK(lines[0].find("panic: first") != std::string::npos);
+    CHECK(lines[1].find("panic: second") != std::string::npos);
+
+    /* The ring is left as it is */
+    sink.block(false);
+    esp_log_async_flush();
+    CHECK(sink.take() == s_uart);
+}
+
+/* Types of the arguments in the signature of a binary record, as in esp_log.h */
+enum {
+    ARG_INT = 1,
+    ARG_LONG,
+    ARG_INT64,
+    ARG_DOUBLE,
+    ARG_STR,
+    ARG_PTR,
+};
+
+/* A binary log record, its arguments as the decoder would print them with "%d", "%lld", "%f", "%s" or "%p" */
+struct Record {
+    int level;
+    bool truncated;
+    const char *format;
+    uint32_t timestamp;
+    uint32_t tag;
+    std::vector<std::string> args;
+};
+
+static std::vector<Record> parse_records(const std::string &output)
+{
+    std::vector<Record> records;
+    const uint8_t *p = (const uint8_t *)output.data();
+    const uint8_t *const output_end = p + output.size();
+
+    while (p < output_end) {
+        REQUIRE(output_end - p >= 3);
+        REQUIRE(p[0] == 0xfe);
+        const uint8_t *end = p + 2 + p[1];
+        REQUIRE(end < output_end);
+        uint8_t sum = 0;
+        for (const uint8_t *b = p + 2; b < end; b++) {
+            sum += *b;
+        }
+        CHECK(sum == *end);
+        p += 2;
+
+        auto varint = [&]() {
+            uint64_t val = 0;
+            int shift = 0;
+            do {
+                REQUIRE(p < end);
+                val |= (uint64_t)(*p & 0x7f) << shift;
+                shift += 7;
+            } while (*p++ & 0x80);
+            return val;
+        };
+        auto u32 = [&]() {
+            REQUIRE(end - p >= 4);
+            uint32_t val = p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+            p += 4;
+            return val;
+        };
+
+        Record record;
+        record.level = *p & 0x7f;
+        record.truncated = *p++ & 0x80;
+        /* The test program isn't position independent, the format is found at its address */
+        record.format = (const char *)(uintptr_t)varint();
+        record.timestamp = varint();
+        record.tag = u32();
+        for (uint32_t signature = varint(); signature && p < end; signature >>= 3) {
+            char buf[32];
+            switch (signature & 7) {
+            case ARG_INT:
+            case ARG_LONG:
+                record.args.push_back(std::to_string((int32_t)varint()));
+                break;
+            case ARG_INT64:
+                record.args.push_back(std::to_string((int64_t)varint()));
+                break;
+            case ARG_DOUBLE: {
+                double val;
+                REQUIRE(end - p >= 8);
+                memcpy(&val, p, sizeof(val));
+                p += sizeof(val);
+                record.args.push_back(std::to_string(val));
+                break;
+            }
+            case ARG_STR: {
+                const uint8_t *nul = (const uint8_t *)memchr(p, 0, end - p);
+                REQUIRE(nul != nullptr);
+                record.args.push_back(std::string((const char *)p, nul - p));
+                p = nul + 1;
+                break;
+            }
+            case ARG_PTR:
+                snprintf(buf, sizeof(buf), "0x%x", u32());
+                record.args.push_back(buf);
+                break;
+            default:
+                FAIL("bad signature");
+            }
+        }
+        CHECK(p == end);
+        p = end + 1;
+        records.push_back(record);
+    }
+    return records;
+}
+
+static std::vector<Record> take_records()
+{
+    esp_log_async_flush();
+    return parse_records(Sink::instance().take());
+}
+
+struct BinaryLog {
+    const char *name;
+    const char *(*tag)(void);
+    void (*args)(void);
+    void (*bytes)(const uint8_t *buf);
+    void (*no_args)(void);
+    void (*level)(esp_log_level_t level, int i);
+    void (*long_str)(const char *str, int i);
+};
+
+static const BinaryLog s_binary_logs[] = {
+    {"C", binary_log_tag, binary_log_args, binary_log_bytes, binary_log_no_args, binary_log_level, binary_log_long},
+    {"C++", cpp::binary_log_tag, cpp::binary_log_args, cpp::binary_log_bytes, cpp::binary_log_no_args, cpp::binary_log_level, cpp::binary_log_long},
+};
+
+TEST_CASE("binary log records hold the format, the tag and the arguments", "[log][binary]")
+{
+    log_async_start();
+    take_records();
+
+    for (const BinaryLog &log : s_binary_logs) {
+        SECTION(log.name) {
+            uint32_t now = esp_log_early_timestamp();
+            log.args();
+            log.no_args();
+            log.level(ESP_LOG_DEBUG, 42);
+
+            std::vector<Record> records = take_records();
+            REQUIRE(records.size() == 3);
+            for (const auto &record : records) {
+                CHECK_FALSE(record.truncated);
+                CHECK(record.tag == (uint32_t)(uintptr_t)log.tag());
+                CHECK(record.timestamp - now < 1000);
+            }
+            CHECK(records[0].level == ESP_LOG_INFO);
+            CHECK(std::string(records[0].format) ==
+                  "int %d unsigned %u long %ld long long %lld double %.3f char %c string %s bytes %s pointer %p");
+            CHECK(records[0].args == std::vector<std::string>({"-5", "7", "-123456", "-1234567890123", "2.500000",
+                                                               "120", "hello", "ssid", "0x1234"}));
+            CHECK(records[1].level == ESP_LOG_WARN);
+            CHECK(std::string(records[1].format) == "no arguments");
+            CHECK(records[1].args.empty());
+            CHECK(records[2].level == ESP_LOG_DEBUG);
+            CHECK(std::string(records[2].format) == "level %d");
+            CHECK(records[2].args == std::vector<std::string>({"42"}));
+        }
+    }
+}
+
+TEST_CASE("binary log records copy pointers to bytes converted with %s only", "[log][binary]")
+{
+    static const uint8_t buf[] = "secret";
+    char addr[32];
+
+    snprintf(addr, sizeof(addr), "0x%x", (unsigned)(uintptr_t)buf);
+    log_async_start();
+    take_records();
+
+    for (const BinaryLog &log : s_binary_logs) {
+        SECTION(log.name) {
+            log.bytes(buf);
+
+            std::vector<Record> records = take_records();
+            REQUIRE(records.size() == 1);
+            CHECK(std::string(records[0].format) == "%p %.*s %-12p %s");
+            CHECK(records[0].args == std::vector<std::string>({addr, "2", "secret", addr, "secret"}));
+        }
+    }
+}
+
+TEST_CASE("binary log records which don't fit are truncated", "[log][binary]")
+{
+    const int record_size = std::min(CONFIG_LOG_ASYNC_LINE_SIZE, 258);
+    std::string str(300, 's');
+
+    log_async_start();
+    take_records();
+
+    binary_log_long(str.c_str(), 1);
+    binary_log_long("short", 2);
+    esp_log_async_flush();
+    std::string output = Sink::instance().take();
+    std::vector<Record> records = parse_records(output);
+
+    REQUIRE(records.size() == 2);
+    CHECK(2 + (uint8_t)output[1] + 1 == record_size);
+    CHECK(records[0].truncated);
+    REQUIRE(records[0].args.size() == 1);
+    CHECK(str.compare(0, records[0].args[0].size(), records[0].args[0]) == 0);
+    CHECK_FALSE(records[1].truncated);
+    CHECK(records[1].args == std::vector<std::string>({"short", "2"}));
+}
+
+TEST_CASE("binary log records below the level of their tag are not written", "[log][binary]")
+{
+    log_async_start();
+    take_records();
+
+    esp_log_level_set("binary", ESP_LOG_WARN);
+    binary_log_level(ESP_LOG_INFO, 1);
+    binary_log_level(ESP_LOG_WARN, 2);
+    esp_log_level_set("binary", ESP_LOG_VERBOSE);
+
+    std::vector<Record> records = take_records();
+    REQUIRE(records.size() == 1);
+    CHECK(records[0].args == std::vector<std::string>({"2"}));
+}
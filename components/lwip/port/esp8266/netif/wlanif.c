@@ -50,6 +50,7 @@
 #include "stdlib.h"
 
 #include "esp8266/eagle_soc.h"
+#include "esp_heap_pool.h"
 
 int ieee80211_output_pbuf(esp_aio_t *aio);
 int8_t wifi_get_netif(uint8_t fd);
@@ -66,8 +67,11 @@ typedef struct pbuf_send_list {
     int err_cnt;
 } pbuf_send_list_t;
 
+#define PBUF_SEND_LIST_POOL_NUM 16
+
 static pbuf_send_list_t* pbuf_list_head = NULL;
 static int pbuf_send_list_num = 0;
+static heap_caps_pool_handle_t pbuf_send_list_pool;
 #endif
 static int low_level_send_cb(esp_aio_t* aio);
 
@@ -205,8 +209,16 @@ static void insert_to_list(int fd, struct pbuf* p)
 
     LWIP_DEBUGF(PBUF_CACHE_DEBUG, ("Insert %p,%d\n", p, pbuf_send_list_num));
 
+    if (!pbuf_send_list_pool) {
+        pbuf_send_list_pool = heap_caps_pool_create(sizeof(pbuf_send_list_t), PBUF_SEND_LIST_POOL_NUM, MALLOC_CAP_8BIT);
+        if (!pbuf_send_list_pool) {
+            LWIP_DEBUGF(PBUF_CACHE_DEBUG, ("no memory create pbuf list pool error\n"));
+            return;
+        }
+    }
+
     if (pbuf_list_head == NULL) {
-        tmp_pbuf_list1 = (pbuf_send_list_t*)malloc(sizeof(pbuf_send_list_t));
+        tmp_pbuf_list1 = (pbuf_send_list_t*)heap_caps_pool_alloc(pbuf_send_list_pool);
 
         if (!tmp_pbuf_list1) {
             LWIP_DEBUGF(PBUF_CACHE_DEBUG, ("no memory malloc pbuf list error\n"));
@@ -236,7 +248,7 @@ static void insert_to_list(int fd, struct pbuf* p)
         tmp_pbuf_list1 = tmp_pbuf_list2->next;
     }
 
-    tmp_pbuf_list1 = (pbuf_send_list_t*)malloc(sizeof(pbuf_send_list_t));
+    tmp_pbuf_list1 = (pbuf_send_list_t*)heap_caps_pool_alloc(pbuf_send_list_pool);
 
     if (!tmp_pbuf_list1) {
         LWIP_DEBUGF(PBUF_CACHE_DEBUG, ("no memory malloc pbuf list error\n"));
@@ -261,7 +273,7 @@ void send_from_list()
             tmp_pbuf_list1 = pbuf_list_head->next;
             LWIP_DEBUGF(PBUF_CACHE_DEBUG, ("Delete %p,%d\n", pbuf_list_head->p, pbuf_send_list_num));
             pbuf_free(pbuf_list_head->p);
-            free(pbuf_list_head);
+            heap_caps_pool_free(pbuf_send_list_pool, pbuf_list_head);
             pbuf_send_list_num--;
             pbuf_list_head = tmp_pbuf_list1;
         } else {
@@ -287,7 +299,7 @@ void send_from_list()
                 if (pbuf_list_head->err_cnt >= 3) {
                     LWIP_DEBUGF(PBUF_CACHE_DEBUG, ("Delete %p,%d\n", pbuf_list_head->p, pbuf_send_list_num));
                     pbuf_free(pbuf_list_head->p);
-                    free(pbuf_list_head);
+                    heap_caps_pool_free(pbuf_send_list_pool, pbuf_list_head);
                     pbuf_send_list_num--;
                     pbuf_list_head = tmp_pbuf_list1;
                 }
@@ -295,13 +307,13 @@ void send_from_list()
                 return;
             } else if (err == ERR_OK) {
                 LWIP_DEBUGF(PBUF_CACHE_DEBUG, ("Delete %p,%d\n", pbuf_list_head->p, pbuf_send_list_num));
-                free(pbuf_list_head);
+                heap_caps_pool_free(pbuf_send_list_pool, pbuf_list_head);
                 pbuf_send_list_num--;
                 pbuf_list_head = tmp_pbuf_list1;
             } else {
                 LWIP_DEBUGF(PBUF_CACHE_DEBUG, ("Delete %p,%d\n", pbuf_list_head->p, pbuf_send_list_num));
                 pbuf_free(pbuf_list_head->p);
-                free(pbuf_list_head);
+                heap_caps_pool_free(pbuf_send_list_pool, pbuf_list_head);
                 pbuf_send_list_num--;
                 pbuf_list_head = tmp_pbuf_list1;
             }
@@ -127,7 +127,7 @@ esp_err_t _mdns_send_rx_action(mdns_rx_packet_t * packet)
 {
     mdns_action_t * action = NULL;
 
-    action = (mdns_action_t *)malloc(sizeof(mdns_action_t));
+    action = (mdns_action_t *)heap_caps_pool_alloc(_mdns_server->action_pool);
     if (!action) {
         HOOK_MALLOC_FAILED;
         return ESP_ERR_NO_MEM;
@@ -136,7 +136,7 @@ esp_err_t _mdns_send_rx_action(mdns_rx_packet_t * packet)
     action->type = ACTION_RX_HANDLE;
     action->data.rx_handle.packet = packet;
     if (xQueueSend(_mdns_server->action_queue, &action, (portTickType)0) != pdPASS) {
-        free(action);
+        heap_caps_pool_free(_mdns_server->action_pool, action);
         return ESP_ERR_NO_MEM;
     }
     return ESP_OK;
@@ -3710,7 +3710,7 @@ static void _mdns_free_action(mdns_action_t * action)
     default:
         break;
     }
-    free(action);
+    heap_caps_pool_free(_mdns_server->action_pool, action);
 }
 
 /**
@@ -3901,7 +3901,7 @@ static void _mdns_execute_action(mdns_action_t * action)
     default:
         break;
     }
-    free(action);
+    heap_caps_pool_free(_mdns_server->action_pool, action);
 }
 
 /**
@@ -4175,6 +4175,12 @@ esp_err_t mdns_init()
         goto free_lock;
     }
 
+    _mdns_server->action_pool = heap_caps_pool_create(sizeof(mdns_action_t), MDNS_ACTION_QUEUE_LEN, MALLOC_CAP_8BIT);
+    if (!_mdns_server->action_pool) {
+        err = ESP_ERR_NO_MEM;
+        goto free_queue;
+    }
+
     if ((err = esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL)) != ESP_OK) {
         goto free_event_handlers;
     }
@@ -4211,6 +4217,8 @@ free_all_and_disable_pcbs:
 free_event_handlers:
     esp_event_handler_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, &event_handler);
     esp_event_handler_unregister(IP_EVENT, ESP_EVENT_ANY_ID, &event_handler);
+    heap_caps_pool_delete(_mdns_server->action_pool);
+free_queue:
     vQueueDelete(_mdns_server->action_queue);
 free_lock:
     vSemaphoreDelete(_mdns_server->lock);
@@ -4246,6 +4254,7 @@ void mdns_free()
         }
         vQueueDelete(_mdns_server->action_queue);
     }
+    heap_caps_pool_delete(_mdns_server->action_pool);
     _mdns_clear_tx_queue_head();
     while (_mdns_server->search_once) {
         mdns_search_once_t * h = _mdns_server->search_once;
@@ -18,6 +18,7 @@
 #include <stdbool.h>
 #include "tcpip_adapter.h"
 #include "esp_timer.h"
+#include "esp_heap_pool.h"
 #include "mdns.h"
 
 //#define MDNS_ENABLE_DEBUG
@@ -343,6 +344,7 @@ typedef struct mdns_server_s {
     mdns_srv_item_t * services;
     SemaphoreHandle_t lock;
     QueueHandle_t action_queue;
+    heap_caps_pool_handle_t action_pool;
     mdns_tx_packet_t * tx_queue_head;
     mdns_search_once_t * search_once;
     esp_timer_handle_t timer_handle;
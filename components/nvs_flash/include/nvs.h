@@ -507,6 +507,58 @@ esp_err_t nvs_erase_all(nvs_handle_t handle);
  */
 esp_err_t nvs_commit(nvs_handle_t handle);
 
+/**
+ * @brief      Start a transaction on the handle
+ *
+ * Until nvs_txn_commit() or nvs_txn_abort() is called, the nvs_set_* and nvs_erase_key
+ * functions only stage the change in RAM and don't report errors of the underlying storage.
+ * nvs_get_* functions keep returning the values which are stored in flash, and
+ * nvs_erase_all() is rejected.
+ *
+ * @param[in]  handle  Storage handle obtained with nvs_open.
+ *                     Handles that were opened read only cannot be used.
+ *
+ * @return
+ *             - ESP_OK if the transaction has been started
+ *             - ESP_ERR_NVS_INVALID_HANDLE if handle has been closed or is NULL
+ *             - ESP_ERR_NVS_READ_ONLY if handle was opened as read only
+ *             - ESP_ERR_NVS_INVALID_STATE if a transaction is already in progress on the handle
+ */
+esp_err_t nvs_txn_begin(nvs_handle_t handle);
+
+/**
+ * @brief      Write all changes staged since nvs_txn_begin() as one atomic batch
+ *
+ * The changes are first written to a journal. If power is lost before the journal
+ * is complete, none of the changes is visible after restart. If it is lost later,
+ * the remaining changes are applied by nvs_flash_init(). The transaction ends
+ * regardless of the result.
+ *
+ * @param[in]  handle  Storage handle obtained with nvs_open.
+ *
+ * @return
+ *             - ESP_OK if all changes have been written
+ *             - ESP_ERR_NVS_INVALID_HANDLE if handle has been closed or is NULL
+ *             - ESP_ERR_NVS_INVALID_STATE if no transaction is in progress on the handle
+ *             - ESP_ERR_NVS_NOT_ENOUGH_SPACE if there is not enough space to journal and
+ *               apply the changes; nothing has been written in this case
+ *             - ESP_ERR_NVS_VALUE_TOO_LONG if one of the blobs is too long
+ *             - other error codes from the underlying storage driver
+ */
+esp_err_t nvs_txn_commit(nvs_handle_t handle);
+
+/**
+ * @brief      Discard all changes staged since nvs_txn_begin() and end the transaction
+ *
+ * @param[in]  handle  Storage handle obtained with nvs_open.
+ *
+ * @return
+ *             - ESP_OK if the transaction has been discarded
+ *             - ESP_ERR_NVS_INVALID_HANDLE if handle has been closed or is NULL
+ *             - ESP_ERR_NVS_INVALID_STATE if no transaction is in progress on the handle
+ */
+esp_err_t nvs_txn_abort(nvs_handle_t handle);
+
 /**
  * @brief      Close the storage handle and free any allocated resources
  *
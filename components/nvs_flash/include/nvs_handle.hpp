@@ -183,6 +183,44 @@ public:
      */
     virtual esp_err_t commit() = 0;
 
+    /**
+     * @brief      Start staging writes and erases done through this handle
+     *
+     * Until \ref commit_transaction or \ref abort_transaction is called, set_item, set_string, set_blob and
+     * erase_item only record the change in RAM. Reads keep returning the values which are stored in flash.
+     *
+     * @return
+     *             - ESP_OK if the transaction has been started
+     *             - ESP_ERR_NVS_READ_ONLY if the handle was opened as read only
+     *             - ESP_ERR_NVS_INVALID_STATE if a transaction is already in progress on this handle
+     */
+    virtual esp_err_t begin_transaction() = 0;
+
+    /**
+     * @brief      Write all staged changes as one atomic batch
+     *
+     * The changes are first written as a journal. If power is lost afterwards, the remaining changes are
+     * applied when the partition is initialized again, otherwise none of them is visible.
+     * The transaction ends regardless of the result.
+     *
+     * @return
+     *             - ESP_OK if all changes have been written
+     *             - ESP_ERR_NVS_INVALID_STATE if no transaction is in progress on this handle
+     *             - ESP_ERR_NVS_NOT_ENOUGH_SPACE if there is not enough space to journal and apply the changes,
+     *               nothing has been written in this case
+     *             - other error codes from the underlying storage driver
+     */
+    virtual esp_err_t commit_transaction() = 0;
+
+    /**
+     * @brief      Discard all staged changes and end the transaction
+     *
+     * @return
+     *             - ESP_OK if the transaction has been discarded
+     *             - ESP_ERR_NVS_INVALID_STATE if no transaction is in progress on this handle
+     */
+    virtual esp_err_t abort_transaction() = 0;
+
     /**
      * @brief      Calculate all entries in the scope of the handle.
      *
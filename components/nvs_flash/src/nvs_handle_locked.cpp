@@ -64,6 +64,21 @@ esp_err_t NVSHandleLocked::commit() {
     return handle->commit();
 }
 
+esp_err_t NVSHandleLocked::begin_transaction() {
+    Lock lock;
+    return handle->begin_transaction();
+}
+
+esp_err_t NVSHandleLocked::commit_transaction() {
+    Lock lock;
+    return handle->commit_transaction();
+}
+
+esp_err_t NVSHandleLocked::abort_transaction() {
+    Lock lock;
+    return handle->abort_transaction();
+}
+
 esp_err_t NVSHandleLocked::get_used_entry_count(size_t& usedEntries) {
     Lock lock;
     return handle->get_used_entry_count(usedEntries);
@@ -50,6 +50,12 @@ public:
 
     esp_err_t commit() override;
 
+    esp_err_t begin_transaction() override;
+
+    esp_err_t commit_transaction() override;
+
+    esp_err_t abort_transaction() override;
+
     esp_err_t get_used_entry_count(size_t& usedEntries) override;
 
 protected:
@@ -25,6 +25,7 @@ esp_err_t NVSHandleSimple::set_typed_item(ItemType datatype, const char *key, co
 {
     if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
     if (mReadOnly) return ESP_ERR_NVS_READ_ONLY;
+    if (mInTransaction) return mTransaction.addWrite(mNsIndex, datatype, key, data, dataSize);
 
     return mStoragePtr->writeItem(mNsIndex, datatype, key, data, dataSize);
 }
@@ -40,6 +41,7 @@ esp_err_t NVSHandleSimple::set_string(const char *key, const char* str)
 {
     if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
     if (mReadOnly) return ESP_ERR_NVS_READ_ONLY;
+    if (mInTransaction) return mTransaction.addWrite(mNsIndex, nvs::ItemType::SZ, key, str, strlen(str) + 1);
 
     return mStoragePtr->writeItem(mNsIndex, nvs::ItemType::SZ, key, str, strlen(str) + 1);
 }
@@ -48,6 +50,7 @@ esp_err_t NVSHandleSimple::set_blob(const char *key, const void* blob, size_t le
 {
     if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
     if (mReadOnly) return ESP_ERR_NVS_READ_ONLY;
+    if (mInTransaction) return mTransaction.addWrite(mNsIndex, nvs::ItemType::BLOB, key, blob, len);
 
     return mStoragePtr->writeItem(mNsIndex, nvs::ItemType::BLOB, key, blob, len);
 }
@@ -77,6 +80,7 @@ esp_err_t NVSHandleSimple::erase_item(const char* key)
 {
     if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
     if (mReadOnly) return ESP_ERR_NVS_READ_ONLY;
+    if (mInTransaction) return mTransaction.addErase(mNsIndex, key);
 
     return mStoragePtr->eraseItem(mNsIndex, key);
 }
@@ -85,6 +89,7 @@ esp_err_t NVSHandleSimple::erase_all()
 {
     if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
     if (mReadOnly) return ESP_ERR_NVS_READ_ONLY;
+    if (mInTransaction) return ESP_ERR_NVS_INVALID_STATE;
 
     return mStoragePtr->eraseNamespace(mNsIndex);
 }
@@ -96,6 +101,37 @@ esp_err_t NVSHandleSimple::commit()
     return ESP_OK;
 }
 
+esp_err_t NVSHandleSimple::begin_transaction()
+{
+    if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (mReadOnly) return ESP_ERR_NVS_READ_ONLY;
+    if (mInTransaction) return ESP_ERR_NVS_INVALID_STATE;
+
+    mInTransaction = 1;
+    return ESP_OK;
+}
+
+esp_err_t NVSHandleSimple::commit_transaction()
+{
+    if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!mInTransaction) return ESP_ERR_NVS_INVALID_STATE;
+
+    esp_err_t err = mStoragePtr->writeTransaction(mTransaction);
+    mTransaction.clear();
+    mInTransaction = 0;
+    return err;
+}
+
+esp_err_t NVSHandleSimple::abort_transaction()
+{
+    if (!valid) return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!mInTransaction) return ESP_ERR_NVS_INVALID_STATE;
+
+    mTransaction.clear();
+    mInTransaction = 0;
+    return ESP_OK;
+}
+
 esp_err_t NVSHandleSimple::get_used_entry_count(size_t& used_entries)
 {
     used_entries = 0;
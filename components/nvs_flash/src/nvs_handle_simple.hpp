@@ -37,7 +37,8 @@ public:
         mStoragePtr(StoragePtr),
         mNsIndex(nsIndex),
         mReadOnly(readOnly),
-        valid(1)
+        valid(1),
+        mInTransaction(0)
     { }
 
     ~NVSHandleSimple();
@@ -62,6 +63,12 @@ public:
 
     esp_err_t commit() override;
 
+    esp_err_t begin_transaction() override;
+
+    esp_err_t commit_transaction() override;
+
+    esp_err_t abort_transaction() override;
+
     esp_err_t get_used_entry_count(size_t &usedEntries) override;
 
     esp_err_t getItemDataSize(ItemType datatype, const char *key, size_t &dataSize);
@@ -100,6 +107,16 @@ private:
      * Upon opening, a handle is valid. It becomes invalid if the underlying storage is de-initialized.
      */
     uint8_t valid;
+
+    /**
+     * Whether writes and erases are staged in mTransaction instead of being written to storage.
+     */
+    uint8_t mInTransaction;
+
+    /**
+     * Changes staged since begin_transaction().
+     */
+    Transaction mTransaction;
 };
 
 } // nvs
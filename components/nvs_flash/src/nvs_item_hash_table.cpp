@@ -0,0 +1,126 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nvs_item_hash_table.hpp"
+
+namespace nvs
+{
+
+HashTable::HashTable()
+{
+    static_assert(SLOT_COUNT >= 2 * ENTRY_COUNT && (SLOT_COUNT & (SLOT_COUNT - 1)) == 0,
+                  "hash table must be a power of two and at most half full");
+}
+
+HashTable::~HashTable()
+{
+    clear();
+}
+
+void HashTable::clear()
+{
+    delete mData;
+    mData = nullptr;
+    mUsedSlots = 0;
+    mErasedSlots = 0;
+}
+
+esp_err_t HashTable::insert(const Item& item, size_t index)
+{
+    assert(index < ENTRY_COUNT);
+
+    if (!mData) {
+        mData = new (std::nothrow) HashTableData;
+        if (!mData) return ESP_ERR_NO_MEM;
+
+        std::fill_n(mData->mSlots, SLOT_COUNT, SLOT_EMPTY);
+        std::fill_n(mData->mHashes, ENTRY_COUNT, 0);
+    }
+
+    // entry indices are not reused before the page is erased, but don't let erased slots fill up the table
+    if (mUsedSlots + mErasedSlots >= SLOT_COUNT / 2) {
+        rebuild();
+    }
+
+    const uint32_t hash_24 = item.calculateCrc32WithoutValue() & 0xffffff;
+    size_t slot = homeSlot(hash_24);
+    while (mData->mSlots[slot] != SLOT_EMPTY && mData->mSlots[slot] != SLOT_ERASED) {
+        slot = (slot + 1) & (SLOT_COUNT - 1);
+    }
+    if (mData->mSlots[slot] == SLOT_ERASED) {
+        --mErasedSlots;
+    }
+    mData->mSlots[slot] = index;
+    mData->mHashes[index] = hash_24 | HASH_VALID;
+    ++mUsedSlots;
+
+    return ESP_OK;
+}
+
+bool HashTable::erase(size_t index)
+{
+    if (!mData || index >= ENTRY_COUNT || !(mData->mHashes[index] & HASH_VALID)) {
+        // item hasn't been present in cache
+        return false;
+    }
+
+    size_t slot = homeSlot(mData->mHashes[index]);
+    while (mData->mSlots[slot] != index) {
+        assert(mData->mSlots[slot] != SLOT_EMPTY);
+        slot = (slot + 1) & (SLOT_COUNT - 1);
+    }
+    mData->mSlots[slot] = SLOT_ERASED;
+    mData->mHashes[index] = 0;
+    --mUsedSlots;
+    ++mErasedSlots;
+
+    return true;
+}
+
+size_t HashTable::find(size_t start, const Item& item)
+{
+    if (!mData) {
+        return SIZE_MAX;
+    }
+
+    // all items with this hash are in the same probe sequence, return the lowest index
+    const uint32_t hash = (item.calculateCrc32WithoutValue() & 0xffffff) | HASH_VALID;
+    size_t result = SIZE_MAX;
+    for (size_t slot = homeSlot(hash); mData->mSlots[slot] != SLOT_EMPTY; slot = (slot + 1) & (SLOT_COUNT - 1)) {
+        const size_t index = mData->mSlots[slot];
+        if (index != SLOT_ERASED && index >= start && index < result && mData->mHashes[index] == hash) {
+            result = index;
+        }
+    }
+    return result;
+}
+
+void HashTable::rebuild()
+{
+    std::fill_n(mData->mSlots, SLOT_COUNT, SLOT_EMPTY);
+    mUsedSlots = 0;
+    for (size_t index = 0; index < ENTRY_COUNT; ++index) {
+        if (mData->mHashes[index] & HASH_VALID) {
+            size_t slot = homeSlot(mData->mHashes[index]);
+            while (mData->mSlots[slot] != SLOT_EMPTY) {
+                slot = (slot + 1) & (SLOT_COUNT - 1);
+            }
+            mData->mSlots[slot] = index;
+            ++mUsedSlots;
+        }
+    }
+    mErasedSlots = 0;
+}
+
+} // namespace nvs
@@ -0,0 +1,77 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef nvs_item_hash_table_h
+#define nvs_item_hash_table_h
+
+#include "nvs.h"
+#include "nvs_types.hpp"
+
+namespace nvs
+{
+
+/**
+ * Open addressing alternative to HashList, with the same interface.
+ *
+ * The table is sized for the entries of one page and allocated on the first
+ * insert, so lookups and erases take constant time instead of walking a list
+ * of blocks. It is released again by clear(), i.e. when the page is erased.
+ */
+class HashTable
+{
+public:
+    static const size_t ENTRY_COUNT = 126;
+    static const size_t SLOT_COUNT = 256;
+
+    HashTable();
+    ~HashTable();
+
+    esp_err_t insert(const Item& item, size_t index);
+    bool erase(const size_t index);
+    size_t find(size_t start, const Item& item);
+    void clear();
+
+private:
+    HashTable(const HashTable& other);
+    const HashTable& operator= (const HashTable& rhs);
+
+protected:
+
+    static const uint8_t SLOT_EMPTY = 0xff;
+    static const uint8_t SLOT_ERASED = 0xfe;
+    static const uint32_t HASH_VALID = 0x80000000;
+
+    struct HashTableData {
+        // entry index stored in each slot, probed linearly from hash % SLOT_COUNT
+        uint8_t mSlots[SLOT_COUNT];
+        // 24-bit item hash of each entry index, HASH_VALID is set while the entry is in the table
+        uint32_t mHashes[ENTRY_COUNT];
+    };
+
+    static size_t homeSlot(uint32_t hash)
+    {
+        return hash & (SLOT_COUNT - 1);
+    }
+
+    void rebuild();
+
+    HashTableData* mData = nullptr;
+    size_t mUsedSlots = 0;
+    size_t mErasedSlots = 0;
+}; // class HashTable
+
+} // namespace nvs
+
+
+#endif /* nvs_item_hash_table_h */
@@ -0,0 +1,134 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nvs_key_index.hpp"
+
+namespace nvs
+{
+
+KeyIndex::KeyIndex()
+{
+}
+
+esp_err_t KeyIndex::init(size_t entryCount)
+{
+    // round the number of sets down to a power of two, so that the set can be selected by masking the hash
+    size_t setCount = 1;
+    while (setCount * 2 * WAYS <= entryCount) {
+        setCount *= 2;
+    }
+
+    if (setCount != mSetCount) {
+        mEntries.reset(new (std::nothrow) KeyIndexEntry[setCount * WAYS]);
+        if (!mEntries) {
+            mSetCount = 0;
+            return ESP_ERR_NO_MEM;
+        }
+        mSetCount = setCount;
+    }
+
+    clear();
+    return ESP_OK;
+}
+
+void KeyIndex::clear()
+{
+    for (size_t i = 0; i < getCapacity(); ++i) {
+        mEntries[i].mPage = nullptr;
+    }
+}
+
+bool KeyIndex::find(const Item& item, Page* &page, size_t &index) const
+{
+    if (!mSetCount) {
+        return false;
+    }
+
+    const uint32_t hash = item.calculateCrc32WithoutValue();
+    const KeyIndexEntry* set = getSet(hash);
+    for (size_t i = 0; i < WAYS; ++i) {
+        if (set[i].matches(hash, item) && set[i].mDatatype == item.datatype) {
+            page = set[i].mPage;
+            index = set[i].mIndex;
+            return true;
+        }
+    }
+    return false;
+}
+
+void KeyIndex::insert(const Item& item, Page* page, size_t index)
+{
+    if (!mSetCount) {
+        return;
+    }
+
+    const uint32_t hash = item.calculateCrc32WithoutValue();
+    KeyIndexEntry* set = getSet(hash);
+    KeyIndexEntry* entry = nullptr;
+    for (size_t i = 0; i < WAYS; ++i) {
+        if (set[i].matches(hash, item) && set[i].mDatatype == item.datatype) {
+            entry = &set[i];
+            break;
+        }
+        if (!entry && set[i].mPage == nullptr) {
+            entry = &set[i];
+        }
+    }
+    if (!entry) {
+        entry = &set[mVictim++ % WAYS];
+    }
+
+    entry->mPage = page;
+    entry->mHash = hash;
+    entry->mNsIndex = item.nsIndex;
+    entry->mDatatype = item.datatype;
+    entry->mChunkIndex = item.chunkIndex;
+    entry->mIndex = static_cast<uint8_t>(index);
+}
+
+void KeyIndex::erase(const Item& item)
+{
+    if (!mSetCount) {
+        return;
+    }
+
+    // drop entries of any data type, the same key may have been stored with a different type
+    const uint32_t hash = item.calculateCrc32WithoutValue();
+    KeyIndexEntry* set = getSet(hash);
+    for (size_t i = 0; i < WAYS; ++i) {
+        if (set[i].matches(hash, item)) {
+            set[i].mPage = nullptr;
+        }
+    }
+}
+
+void KeyIndex::erasePage(const Page* page)
+{
+    for (size_t i = 0; i < getCapacity(); ++i) {
+        if (mEntries[i].mPage == page) {
+            mEntries[i].mPage = nullptr;
+        }
+    }
+}
+
+void KeyIndex::eraseNamespace(uint8_t nsIndex)
+{
+    for (size_t i = 0; i < getCapacity(); ++i) {
+        if (mEntries[i].mNsIndex == nsIndex) {
+            mEntries[i].mPage = nullptr;
+        }
+    }
+}
+
+} // namespace nvs
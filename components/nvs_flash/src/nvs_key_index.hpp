@@ -0,0 +1,94 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef nvs_key_index_hpp
+#define nvs_key_index_hpp
+
+#include <memory>
+#include "nvs.h"
+#include "nvs_types.hpp"
+
+namespace nvs
+{
+
+class Page;
+
+/**
+ * Bounded in-RAM index mapping <namespace, key, chunk index> to the page and
+ * entry index the item was last seen at.
+ *
+ * The index is a set-associative cache: a lookup may miss even if the item
+ * exists, and a hit is only a hint which the caller has to validate against
+ * the page contents. Storage keeps it up to date on writes, erases and page
+ * reclaims so that validation normally succeeds.
+ */
+class KeyIndex
+{
+public:
+    static const size_t WAYS = 4;
+
+    KeyIndex();
+
+    esp_err_t init(size_t entryCount);
+
+    void clear();
+
+    bool find(const Item& item, Page* &page, size_t &index) const;
+
+    void insert(const Item& item, Page* page, size_t index);
+
+    void erase(const Item& item);
+
+    void erasePage(const Page* page);
+
+    void eraseNamespace(uint8_t nsIndex);
+
+    size_t getCapacity() const
+    {
+        return mSetCount * WAYS;
+    }
+
+private:
+    KeyIndex(const KeyIndex& other);
+    const KeyIndex& operator= (const KeyIndex& rhs);
+
+protected:
+
+    struct KeyIndexEntry {
+        Page* mPage;
+        uint32_t mHash;
+        uint8_t mNsIndex;
+        ItemType mDatatype;
+        uint8_t mChunkIndex;
+        uint8_t mIndex;
+
+        bool matches(uint32_t hash, const Item& item) const
+        {
+            return mPage != nullptr && mHash == hash && mNsIndex == item.nsIndex
+                   && mChunkIndex == item.chunkIndex;
+        }
+    };
+
+    KeyIndexEntry* getSet(uint32_t hash) const
+    {
+        return &mEntries[(hash & (mSetCount - 1)) * WAYS];
+    }
+
+    std::unique_ptr<KeyIndexEntry[]> mEntries;
+    size_t mSetCount = 0;
+    size_t mVictim = 0;
+}; // class KeyIndex
+
+} // namespace nvs
+
+#endif /* nvs_key_index_hpp */
@@ -23,7 +23,9 @@
 #include "esp_spi_flash.h"
 #include "compressed_enum_table.hpp"
 #include "intrusive_list.h"
+#include "sdkconfig.h"
 #include "nvs_item_hash_list.hpp"
+#include "nvs_item_hash_table.hpp"
 #include "partition.hpp"
 
 namespace nvs
@@ -105,6 +107,12 @@ public:
 
     esp_err_t findItem(uint8_t nsIndex, ItemType datatype, const char* key, size_t &itemIndex, Item& item, uint8_t chunkIdx = CHUNK_ANY, VerOffset chunkStart = VerOffset::VER_ANY);
 
+    // Returns the entry index recorded in the hash list without reading flash, or SIZE_MAX
+    size_t findItemIndex(uint8_t nsIndex, ItemType datatype, const char* key, uint8_t chunkIdx = CHUNK_ANY)
+    {
+        return mHashList.find(0, Item(nsIndex, datatype, 0, key, chunkIdx));
+    }
+
     template<typename T>
     esp_err_t writeItem(uint8_t nsIndex, const char* key, const T& value)
     {
@@ -227,7 +235,11 @@ protected:
     /**
      * This hash list stores hashes of namespace index, key, and ChunkIndex for quick lookup when searching items.
      */
+#ifdef CONFIG_NVS_ITEM_HASH_TABLE
+    HashTable mHashList;
+#else
     HashList mHashList;
+#endif
 
     Partition *mPartition;
 
@@ -236,6 +248,7 @@ protected:
     static const uint32_t ENTRY_DATA_OFFSET = ENTRY_TABLE_OFFSET + 32;
 
     static_assert(sizeof(Header) == 32, "header size must be 32 bytes");
+    static_assert(HashTable::ENTRY_COUNT == ENTRY_COUNT, "hash table size must match the number of entries");
     static_assert(ENTRY_TABLE_OFFSET % 32 == 0, "entry table offset should be aligned");
     static_assert(ENTRY_DATA_OFFSET % 32 == 0, "entry data offset should be aligned");
 
@@ -137,7 +137,7 @@ esp_err_t PageManager::load(Partition *partition, uint32_t baseSector, uint32_t
     return ESP_OK;
 }
 
-esp_err_t PageManager::requestNewPage()
+esp_err_t PageManager::requestNewPage(Page** reclaimedPage)
 {
     if (mFreePageList.empty()) {
         return ESP_ERR_NVS_INVALID_STATE;
@@ -172,6 +172,9 @@ esp_err_t PageManager::requestNewPage()
     Page* newPage = &mPageList.back();
 
     Page* erasedPage = maxUnusedItemsPageIt;
+    if (reclaimedPage) {
+        *reclaimedPage = erasedPage;
+    }
 
 #ifndef NDEBUG
     size_t usedEntries = erasedPage->getUsedEntryCount();
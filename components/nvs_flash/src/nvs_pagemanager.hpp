@@ -52,7 +52,7 @@ public:
         return mPageCount;
     }
 
-    esp_err_t requestNewPage();
+    esp_err_t requestNewPage(Page** reclaimedPage = nullptr);
 
     esp_err_t fillStats(nvs_stats_t& nvsStats);
 
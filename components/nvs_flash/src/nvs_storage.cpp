@@ -27,6 +27,10 @@
 namespace nvs
 {
 
+// The journal of a transaction being committed is a blob in a namespace of its own
+static const char* TXN_NAMESPACE = "nvs.txn";
+static const char* TXN_KEY = "journal";
+
 Storage::~Storage()
 {
     clearNamespaces();
@@ -102,6 +106,14 @@ esp_err_t Storage::init(uint32_t baseSector, uint32_t sectorCount)
         return err;
     }
 
+#ifdef CONFIG_NVS_KEY_INDEX
+    err = mKeyIndex.init(CONFIG_NVS_KEY_INDEX_SIZE);
+    if (err != ESP_OK) {
+        mState = StorageState::INVALID;
+        return err;
+    }
+#endif
+
     // load namespaces list
     clearNamespaces();
     std::fill_n(mNamespaceUsage.data(), mNamespaceUsage.byteSize() / 4, 0);
@@ -142,6 +154,13 @@ esp_err_t Storage::init(uint32_t baseSector, uint32_t sectorCount)
     // Purge the blob index list
     blobIdxList.clearAndFreeNodes();
 
+    // Finish a transaction which was interrupted after its journal had been written
+    err = recoverTransaction();
+    if (err != ESP_OK) {
+        mState = StorageState::INVALID;
+        return err;
+    }
+
 #ifdef DEBUG_STORAGE
     debugCheck();
 #endif
@@ -155,17 +174,70 @@ bool Storage::isValid() const
 
 esp_err_t Storage::findItem(uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, Item& item, uint8_t chunkIdx, VerOffset chunkStart)
 {
+#ifdef CONFIG_NVS_KEY_INDEX
+    const bool indexed = nsIndex != Page::NS_ANY && datatype != ItemType::ANY && key != nullptr &&
+                         (datatype != ItemType::BLOB_DATA || chunkIdx != Page::CHUNK_ANY);
+    const Item indexKey(nsIndex, datatype, 0, indexed ? key : nullptr, chunkIdx);
+    Page* indexPage;
+    size_t indexEntry;
+    if (indexed && mKeyIndex.find(indexKey, indexPage, indexEntry)) {
+        // the index is only a hint, the item must still be at the recorded entry
+        size_t itemIndex = indexEntry;
+        auto err = indexPage->findItem(nsIndex, datatype, key, itemIndex, item, chunkIdx, chunkStart);
+        if (err == ESP_OK && itemIndex == indexEntry) {
+            page = indexPage;
+            return ESP_OK;
+        }
+        mKeyIndex.erase(indexKey);
+    }
+#endif
+
     for (auto it = std::begin(mPageManager); it != std::end(mPageManager); ++it) {
         size_t itemIndex = 0;
         auto err = it->findItem(nsIndex, datatype, key, itemIndex, item, chunkIdx, chunkStart);
         if (err == ESP_OK) {
             page = it;
+#ifdef CONFIG_NVS_KEY_INDEX
+            if (indexed) {
+                mKeyIndex.insert(indexKey, page, itemIndex);
+            }
+#endif
             return ESP_OK;
         }
     }
     return ESP_ERR_NVS_NOT_FOUND;
 }
 
+esp_err_t Storage::requestNewPage()
+{
+    Page* reclaimedPage = nullptr;
+    auto err = mPageManager.requestNewPage(&reclaimedPage);
+#ifdef CONFIG_NVS_KEY_INDEX
+    // items of the reclaimed page have been moved, even if erasing it failed afterwards
+    if (reclaimedPage) {
+        mKeyIndex.erasePage(reclaimedPage);
+    }
+#endif
+    return err;
+}
+
+void Storage::indexItem(uint8_t nsIndex, ItemType datatype, const char* key, Page& page, uint8_t chunkIdx)
+{
+#ifdef CONFIG_NVS_KEY_INDEX
+    size_t itemIndex = page.findItemIndex(nsIndex, datatype, key, chunkIdx);
+    if (itemIndex < Page::ENTRY_COUNT) {
+        mKeyIndex.insert(Item(nsIndex, datatype, 0, key, chunkIdx), &page, itemIndex);
+    }
+#endif
+}
+
+void Storage::unindexItem(uint8_t nsIndex, const char* key, uint8_t chunkIdx)
+{
+#ifdef CONFIG_NVS_KEY_INDEX
+    mKeyIndex.erase(Item(nsIndex, ItemType::ANY, 0, key, chunkIdx));
+#endif
+}
+
 esp_err_t Storage::writeMultiPageBlob(uint8_t nsIndex, const char* key, const void* data, size_t dataSize, VerOffset chunkStart)
 {
     uint8_t chunkCount = 0;
@@ -197,7 +269,7 @@ esp_err_t Storage::writeMultiPageBlob(uint8_t nsIndex, const char* key, const vo
                     return err;
                 }
             }
-            err = mPageManager.requestNewPage();
+            err = requestNewPage();
             if (err != ESP_OK) {
                 return err;
             } else if(getCurrentPage().getVarDataTailroom() == tailroom) {
@@ -230,6 +302,7 @@ esp_err_t Storage::writeMultiPageBlob(uint8_t nsIndex, const char* key, const vo
             }
             node->mPage = &page;
             usedPages.push_back(node);
+            indexItem(nsIndex, ItemType::BLOB_DATA, key, page, static_cast<uint8_t> (chunkStart) + chunkCount - 1);
             if (remainingSize || (tailroom - chunkSize) < Page::ENTRY_SIZE) {
                 if (page.state() != Page::PageState::FULL) {
                     err = page.markFull();
@@ -237,7 +310,7 @@ esp_err_t Storage::writeMultiPageBlob(uint8_t nsIndex, const char* key, const vo
                         break;
                     }
                 }
-                err = mPageManager.requestNewPage();
+                err = requestNewPage();
                 if (err != ESP_OK) {
                     break;
                 }
@@ -262,6 +335,7 @@ esp_err_t Storage::writeMultiPageBlob(uint8_t nsIndex, const char* key, const vo
         /* Anything failed, then we should erase all the written chunks*/
         int ii=0;
         for (auto it = std::begin(usedPages); it != std::end(usedPages); it++) {
+            unindexItem(nsIndex, key, static_cast<uint8_t> (chunkStart) + ii);
             it->mPage->eraseItem(nsIndex, ItemType::BLOB_DATA, key, ii++);
         }
     }
@@ -359,7 +433,7 @@ esp_err_t Storage::writeItem(uint8_t nsIndex, ItemType datatype, const char* key
                     return err;
                 }
             }
-            err = mPageManager.requestNewPage();
+            err = requestNewPage();
             if (err != ESP_OK) {
                 return err;
             }
@@ -389,6 +463,8 @@ esp_err_t Storage::writeItem(uint8_t nsIndex, ItemType datatype, const char* key
             return err;
         }
     }
+
+    indexItem(nsIndex, (datatype == ItemType::BLOB) ? ItemType::BLOB_IDX : datatype, key, getCurrentPage());
 #ifdef DEBUG_STORAGE
     debugCheck();
 #endif
@@ -563,6 +639,7 @@ esp_err_t Storage::eraseMultiPageBlob(uint8_t nsIndex, const char* key, VerOffse
         return err;
     }
     /* Erase the index first and make children blobs orphan*/
+    unindexItem(nsIndex, key);
     err = findPage->eraseItem(nsIndex, ItemType::BLOB_IDX, key, Page::CHUNK_ANY, chunkStart);
     if (err != ESP_OK) {
         return err;
@@ -585,6 +662,7 @@ esp_err_t Storage::eraseMultiPageBlob(uint8_t nsIndex, const char* key, VerOffse
         } else if (err == ESP_ERR_NVS_NOT_FOUND) {
             continue; // Keep erasing other chunks
         }
+        unindexItem(nsIndex, key, static_cast<uint8_t> (chunkStart) + chunkNum);
         err = findPage->eraseItem(nsIndex, ItemType::BLOB_DATA, key, static_cast<uint8_t> (chunkStart) + chunkNum);
         if (err != ESP_OK) {
             return err;
@@ -616,6 +694,7 @@ esp_err_t Storage::eraseItem(uint8_t nsIndex, ItemType datatype, const char* key
         return eraseMultiPageBlob(nsIndex, key);
     }
 
+    unindexItem(nsIndex, key);
     return findPage->eraseItem(nsIndex, datatype, key);
 }
 
@@ -625,6 +704,9 @@ esp_err_t Storage::eraseNamespace(uint8_t nsIndex)
         return ESP_ERR_NVS_NOT_INITIALIZED;
     }
 
+#ifdef CONFIG_NVS_KEY_INDEX
+    mKeyIndex.eraseNamespace(nsIndex);
+#endif
     for (auto it = std::begin(mPageManager); it != std::end(mPageManager); ++it) {
         while (true) {
             auto err = it->eraseItem(nsIndex, ItemType::ANY, nullptr);
@@ -640,6 +722,113 @@ esp_err_t Storage::eraseNamespace(uint8_t nsIndex)
 
 }
 
+esp_err_t Storage::writeTransaction(const Transaction& txn)
+{
+    if (mState != StorageState::ACTIVE) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+
+    if (txn.empty()) {
+        return ESP_OK;
+    }
+
+    // Reject what would fail to apply before writing the journal, it would fail again on every replay
+    size_t maxBlobSize = std::min<size_t>(mPageManager.getPageCount() - 1, (Page::CHUNK_ANY - 1) / 2) * Page::CHUNK_MAX_SIZE;
+    auto err = txn.forEach([=](const Transaction::Record& record, const uint8_t*) -> esp_err_t {
+        if (record.datatype == ItemType::BLOB && record.dataSize > maxBlobSize) {
+            return ESP_ERR_NVS_VALUE_TOO_LONG;
+        }
+        return ESP_OK;
+    });
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    nvs_stats_t stats;
+    err = fillStats(stats);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (stats.free_entries < txn.getEntryCount() + Page::ENTRY_COUNT) {
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+
+    uint8_t txnNsIndex;
+    err = createOrOpenNamespace(TXN_NAMESPACE, true, txnNsIndex);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Don't overwrite the journal of an earlier transaction which failed to apply
+    err = recoverTransaction();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Once the blob index of the journal is written, the transaction will be applied even after a power loss
+    err = writeItem(txnNsIndex, ItemType::BLOB, TXN_KEY, txn.data(), txn.size());
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    err = applyTransaction(txn);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    return eraseItem(txnNsIndex, ItemType::BLOB, TXN_KEY);
+}
+
+esp_err_t Storage::applyTransaction(const Transaction& txn)
+{
+    // Writes and erases are idempotent, so a partially applied transaction can be applied again
+    return txn.forEach([this](const Transaction::Record& record, const uint8_t* data) -> esp_err_t {
+        if (record.datatype == ItemType::ANY) {
+            auto err = eraseItem(record.nsIndex, record.key);
+            return (err == ESP_ERR_NVS_NOT_FOUND) ? ESP_OK : err;
+        }
+        return writeItem(record.nsIndex, record.datatype, record.key, data, record.dataSize);
+    });
+}
+
+esp_err_t Storage::recoverTransaction()
+{
+    uint8_t txnNsIndex;
+    if (createOrOpenNamespace(TXN_NAMESPACE, false, txnNsIndex) != ESP_OK) {
+        return ESP_OK;
+    }
+
+    size_t size;
+    auto err = getItemDataSize(txnNsIndex, ItemType::BLOB, TXN_KEY, size);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        return ESP_OK;
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    Transaction txn;
+    err = txn.resize(size);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = readItem(txnNsIndex, ItemType::BLOB, TXN_KEY, txn.data(), size);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        // the journal was incomplete and has been erased
+        return ESP_OK;
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    err = applyTransaction(txn);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    return eraseItem(txnNsIndex, ItemType::BLOB, TXN_KEY);
+}
+
 esp_err_t Storage::getItemDataSize(uint8_t nsIndex, ItemType datatype, const char* key, size_t& dataSize)
 {
     if (mState != StorageState::ACTIVE) {
@@ -16,10 +16,13 @@
 
 #include <memory>
 #include <unordered_map>
+#include "sdkconfig.h"
 #include "nvs.hpp"
 #include "nvs_types.hpp"
 #include "nvs_page.hpp"
 #include "nvs_pagemanager.hpp"
+#include "nvs_key_index.hpp"
+#include "nvs_transaction.hpp"
 #include "partition.hpp"
 
 //extern void dumpBytes(const uint8_t* data, size_t count);
@@ -100,6 +103,8 @@ public:
 
     esp_err_t eraseNamespace(uint8_t nsIndex);
 
+    esp_err_t writeTransaction(const Transaction& txn);
+
     const Partition *getPart() const
     {
         return mPartition;
@@ -152,6 +157,16 @@ protected:
 
     esp_err_t findItem(uint8_t nsIndex, ItemType datatype, const char* key, Page* &page, Item& item, uint8_t chunkIdx = Page::CHUNK_ANY, VerOffset chunkStart = VerOffset::VER_ANY);
 
+    esp_err_t requestNewPage();
+
+    void indexItem(uint8_t nsIndex, ItemType datatype, const char* key, Page& page, uint8_t chunkIdx = Page::CHUNK_ANY);
+
+    void unindexItem(uint8_t nsIndex, const char* key, uint8_t chunkIdx = Page::CHUNK_ANY);
+
+    esp_err_t applyTransaction(const Transaction& txn);
+
+    esp_err_t recoverTransaction();
+
 protected:
     Partition *mPartition;
     size_t mPageCount;
@@ -159,6 +174,9 @@ protected:
     TNamespaces mNamespaces;
     CompressedEnumTable<bool, 1, 256> mNamespaceUsage;
     StorageState mState = StorageState::INVALID;
+#ifdef CONFIG_NVS_KEY_INDEX
+    KeyIndex mKeyIndex;
+#endif
 };
 
 } // namespace nvs
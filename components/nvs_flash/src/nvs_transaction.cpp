@@ -0,0 +1,127 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nvs_transaction.hpp"
+#include "nvs_page.hpp"
+
+namespace nvs
+{
+
+static size_t varLengthEntryCount(size_t dataSize)
+{
+    return 1 + (dataSize + Page::ENTRY_SIZE - 1) / Page::ENTRY_SIZE;
+}
+
+static size_t blobEntryCount(size_t dataSize)
+{
+    // a chunk header per page the blob may be split across, plus the index
+    return varLengthEntryCount(dataSize) + dataSize / Page::CHUNK_MAX_SIZE + 2;
+}
+
+Transaction::Transaction()
+{
+    static_assert(sizeof(Record) % 4 == 0, "records must keep the data aligned");
+}
+
+esp_err_t Transaction::addWrite(uint8_t nsIndex, ItemType datatype, const char* key, const void* data, size_t dataSize)
+{
+    if (datatype == ItemType::SZ && dataSize > Page::CHUNK_MAX_SIZE) {
+        return ESP_ERR_NVS_VALUE_TOO_LONG;
+    }
+    return append(nsIndex, datatype, key, data, dataSize);
+}
+
+esp_err_t Transaction::addErase(uint8_t nsIndex, const char* key)
+{
+    return append(nsIndex, ItemType::ANY, key, nullptr, 0);
+}
+
+esp_err_t Transaction::append(uint8_t nsIndex, ItemType datatype, const char* key, const void* data, size_t dataSize)
+{
+    if (key == nullptr || strlen(key) > Item::MAX_KEY_LENGTH) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+
+    const size_t recordSize = sizeof(Record) + paddedSize(dataSize);
+    auto err = reserve(mSize + recordSize);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    Record* record = reinterpret_cast<Record*>(mData.get() + mSize);
+    std::fill_n(reinterpret_cast<uint8_t*>(record), recordSize, 0);
+    record->nsIndex = nsIndex;
+    record->datatype = datatype;
+    record->dataSize = dataSize;
+    strncpy(record->key, key, sizeof(record->key) - 1);
+    if (dataSize) {
+        memcpy(mData.get() + mSize + sizeof(Record), data, dataSize);
+    }
+    mSize += recordSize;
+    return ESP_OK;
+}
+
+esp_err_t Transaction::reserve(size_t capacity)
+{
+    if (capacity <= mCapacity) {
+        return ESP_OK;
+    }
+
+    size_t newCapacity = std::max(mCapacity * 2, std::max(capacity, static_cast<size_t>(Page::ENTRY_SIZE * 4)));
+    std::unique_ptr<uint8_t[]> newData(new (std::nothrow) uint8_t[newCapacity]);
+    if (!newData) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (mSize) {
+        memcpy(newData.get(), mData.get(), mSize);
+    }
+    mData = std::move(newData);
+    mCapacity = newCapacity;
+    return ESP_OK;
+}
+
+esp_err_t Transaction::resize(size_t size)
+{
+    auto err = reserve(size);
+    if (err != ESP_OK) {
+        return err;
+    }
+    mSize = size;
+    return ESP_OK;
+}
+
+void Transaction::clear()
+{
+    mData.reset();
+    mSize = 0;
+    mCapacity = 0;
+}
+
+size_t Transaction::getEntryCount() const
+{
+    size_t entryCount = blobEntryCount(mSize);
+    forEach([&](const Record& record, const uint8_t*) -> esp_err_t {
+        if (record.datatype == ItemType::BLOB) {
+            entryCount += blobEntryCount(record.dataSize);
+        } else if (isVariableLengthType(record.datatype)) {
+            entryCount += varLengthEntryCount(record.dataSize);
+        } else if (record.datatype != ItemType::ANY) {
+            entryCount += 1;
+        }
+        return ESP_OK;
+    });
+    return entryCount;
+}
+
+} // namespace nvs
@@ -0,0 +1,121 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef nvs_transaction_hpp
+#define nvs_transaction_hpp
+
+#include <memory>
+#include "nvs.h"
+#include "nvs_types.hpp"
+
+namespace nvs
+{
+
+/**
+ * Writes and erases staged in RAM, serialized the same way as they are
+ * stored in the transaction journal.
+ *
+ * The buffer is a sequence of records, each followed by its data padded to
+ * a multiple of four bytes. Records are applied in order, so a key which was
+ * set several times ends up with the last value.
+ */
+class Transaction
+{
+public:
+    struct Record {
+        uint8_t nsIndex;
+        ItemType datatype;  // ItemType::ANY erases the key
+        uint8_t reserved[2];
+        uint32_t dataSize;
+        char key[Item::MAX_KEY_LENGTH + 1];
+    };
+
+    Transaction();
+
+    esp_err_t addWrite(uint8_t nsIndex, ItemType datatype, const char* key, const void* data, size_t dataSize);
+
+    esp_err_t addErase(uint8_t nsIndex, const char* key);
+
+    // Resizes the buffer without initializing it, used to read back a journal
+    esp_err_t resize(size_t size);
+
+    void clear();
+
+    uint8_t* data()
+    {
+        return mData.get();
+    }
+
+    const uint8_t* data() const
+    {
+        return mData.get();
+    }
+
+    size_t size() const
+    {
+        return mSize;
+    }
+
+    bool empty() const
+    {
+        return mSize == 0;
+    }
+
+    // Upper bound of the number of entries needed to journal and apply the records
+    size_t getEntryCount() const;
+
+    // Calls f(record, data) for each record, returns ESP_ERR_NVS_INVALID_LENGTH if the buffer is malformed
+    template<typename TFunc>
+    esp_err_t forEach(TFunc f) const
+    {
+        size_t offset = 0;
+        while (offset < mSize) {
+            if (mSize - offset < sizeof(Record)) {
+                return ESP_ERR_NVS_INVALID_LENGTH;
+            }
+            const Record* record = reinterpret_cast<const Record*>(mData.get() + offset);
+            offset += sizeof(Record);
+            if (mSize - offset < record->dataSize || record->key[Item::MAX_KEY_LENGTH] != 0) {
+                return ESP_ERR_NVS_INVALID_LENGTH;
+            }
+            auto err = f(*record, mData.get() + offset);
+            if (err != ESP_OK) {
+                return err;
+            }
+            offset += paddedSize(record->dataSize);
+        }
+        return ESP_OK;
+    }
+
+private:
+    Transaction(const Transaction& other);
+    const Transaction& operator= (const Transaction& rhs);
+
+protected:
+    static size_t paddedSize(size_t size)
+    {
+        return (size + 3) & ~3;
+    }
+
+    esp_err_t append(uint8_t nsIndex, ItemType datatype, const char* key, const void* data, size_t dataSize);
+
+    esp_err_t reserve(size_t capacity);
+
+    std::unique_ptr<uint8_t[]> mData;
+    size_t mSize = 0;
+    size_t mCapacity = 0;
+}; // class Transaction
+
+} // namespace nvs
+
+#endif /* nvs_transaction_hpp */
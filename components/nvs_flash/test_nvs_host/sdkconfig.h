@@ -1,3 +1,6 @@
 #define CONFIG_NVS_ENCRYPTION 1
 //currently use the legacy implementation, since the stubs for new HAL are not done yet
 #define CONFIG_SPI_FLASH_USE_LEGACY_IMPL 1
+#define CONFIG_NVS_KEY_INDEX 1
+#define CONFIG_NVS_KEY_INDEX_SIZE 128
+#define CONFIG_NVS_ITEM_HASH_TABLE 1
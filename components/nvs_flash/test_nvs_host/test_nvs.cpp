@@ -21,6 +21,7 @@
 #include "mbedtls/aes.h"
 #include <sstream>
 #include <iostream>
+#include <chrono>
 #include <fstream>
 #include <dirent.h>
 #include <unistd.h>
@@ -297,6 +298,20 @@ class HashListTestHelper : public HashList
         {
             return mBlockList.size();
         }
+
+        size_t getByteSize()
+        {
+            return mBlockList.size() * HashListBlock::BYTE_SIZE;
+        }
+};
+
+class HashTableTestHelper : public HashTable
+{
+    public:
+        size_t getByteSize()
+        {
+            return mData ? sizeof(HashTableData) : 0;
+        }
 };
 
 TEST_CASE("HashList is cleaned up as soon as items are erased", "[nvs]")
@@ -332,6 +347,79 @@ TEST_CASE("HashList is cleaned up as soon as items are erased", "[nvs]")
     CHECK(hashlist.getBlockCount() == 0);
 }
 
+TEST_CASE("HashTable finds the same items as HashList", "[nvs]")
+{
+    HashListTestHelper hashlist;
+    HashTableTestHelper hashtable;
+    std::mt19937 gen(42);
+    const size_t keyCount = 16;
+    bool inserted[Page::ENTRY_COUNT] = { };
+
+    // entry indices are inserted in increasing order, as they are written to a page
+    for (size_t i = 0; i < Page::ENTRY_COUNT; ++i) {
+        char key[16];
+        snprintf(key, sizeof(key), "i%d", static_cast<int>(gen() % keyCount));
+        Item item(1, ItemType::U32, 1, key);
+        REQUIRE(hashlist.insert(item, i) == ESP_OK);
+        REQUIRE(hashtable.insert(item, i) == ESP_OK);
+        inserted[i] = true;
+
+        size_t erased = gen() % (i + 1);
+        CHECK(hashlist.erase(erased) == inserted[erased]);
+        CHECK(hashtable.erase(erased) == inserted[erased]);
+        inserted[erased] = false;
+
+        for (size_t k = 0; k < keyCount; ++k) {
+            snprintf(key, sizeof(key), "i%d", static_cast<int>(k));
+            size_t start = gen() % Page::ENTRY_COUNT;
+            CHECK(hashtable.find(start, Item(1, ItemType::U32, 1, key)) == hashlist.find(start, Item(1, ItemType::U32, 1, key)));
+        }
+    }
+    CHECK(hashtable.getByteSize() > 0);
+    hashtable.clear();
+    CHECK(hashtable.getByteSize() == 0);
+    CHECK(hashtable.find(0, Item(1, ItemType::U32, 1, "i0")) == SIZE_MAX);
+}
+
+TEST_CASE("measure RAM and lookup time of HashList and HashTable", "[nvs]")
+{
+    HashListTestHelper hashlist;
+    HashTableTestHelper hashtable;
+    const size_t lookupCount = 100;
+    std::vector<Item> items;
+
+    for (size_t i = 0; i < Page::ENTRY_COUNT; ++i) {
+        char key[16];
+        snprintf(key, sizeof(key), "key%d", static_cast<int>(i));
+        items.push_back(Item(1, ItemType::U32, 1, key));
+        REQUIRE(hashlist.insert(items.back(), i) == ESP_OK);
+        REQUIRE(hashtable.insert(items.back(), i) == ESP_OK);
+    }
+
+    size_t found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t n = 0; n < lookupCount; ++n) {
+        for (size_t i = 0; i < items.size(); ++i) {
+            found += hashlist.find(0, items[i]) == i;
+        }
+    }
+    auto listTime = std::chrono::steady_clock::now() - start;
+    start = std::chrono::steady_clock::now();
+    for (size_t n = 0; n < lookupCount; ++n) {
+        for (size_t i = 0; i < items.size(); ++i) {
+            found += hashtable.find(0, items[i]) == i;
+        }
+    }
+    auto tableTime = std::chrono::steady_clock::now() - start;
+    CHECK(found == 2 * lookupCount * items.size());
+
+    const size_t lookups = lookupCount * items.size();
+    s_perf << "Lookup in a full page: HashList " << hashlist.getByteSize() << " bytes, "
+           << std::chrono::duration_cast<std::chrono::nanoseconds>(listTime).count() / lookups << " ns per lookup; "
+           << "HashTable " << hashtable.getByteSize() << " bytes, "
+           << std::chrono::duration_cast<std::chrono::nanoseconds>(tableTime).count() / lookups << " ns per lookup" << std::endl;
+}
+
 TEST_CASE("can init PageManager in empty flash", "[nvs]")
 {
     PartitionEmulationFixture f(0, 4);
@@ -3519,6 +3607,324 @@ TEST_CASE("check and read data from partition generated via manufacturing utilit
 }
 #endif
 
+#ifdef CONFIG_NVS_KEY_INDEX
+class KeyIndexStorageHelper : public Storage
+{
+    public:
+        KeyIndexStorageHelper(Partition *partition) : Storage(partition) { }
+
+        bool isIndexed(uint8_t nsIndex, ItemType datatype, const char* key)
+        {
+            Page* page;
+            size_t index;
+            return mKeyIndex.find(Item(nsIndex, datatype, 0, key), page, index);
+        }
+
+        // Check that the index points at the entry the item is actually stored at
+        bool isIndexedCorrectly(uint8_t nsIndex, ItemType datatype, const char* key)
+        {
+            Page* page;
+            size_t index;
+            if (!mKeyIndex.find(Item(nsIndex, datatype, 0, key), page, index)) {
+                return false;
+            }
+            size_t itemIndex = index;
+            Item item;
+            return page->findItem(nsIndex, datatype, key, itemIndex, item) == ESP_OK && itemIndex == index;
+        }
+
+        // Erase an item from flash without updating the index
+        void eraseFromPages(uint8_t nsIndex, ItemType datatype, const char* key)
+        {
+            for (auto it = std::begin(mPageManager); it != std::end(mPageManager); ++it) {
+                it->eraseItem(nsIndex, datatype, key);
+            }
+        }
+};
+
+TEST_CASE("key index follows items across writes, erases and page reclaim", "[nvs]")
+{
+    const size_t pageCount = 6;
+    const size_t keyCount = 20;
+    PartitionEmulationFixture f(0, pageCount);
+    KeyIndexStorageHelper storage(&f.part);
+    CHECK(storage.init(0, pageCount) == ESP_OK);
+
+    char key[16];
+    for (size_t i = 0; i < Page::ENTRY_COUNT * pageCount * 4; ++i) {
+        snprintf(key, sizeof(key), "k%d", static_cast<int>(i % keyCount));
+        REQUIRE(storage.writeItem(1, key, static_cast<uint32_t>(i)) == ESP_OK);
+        REQUIRE(storage.isIndexedCorrectly(1, ItemType::U32, key));
+    }
+    for (size_t i = 0; i < keyCount; ++i) {
+        snprintf(key, sizeof(key), "k%d", static_cast<int>(i));
+        uint32_t value;
+        REQUIRE(storage.readItem(1, key, value) == ESP_OK);
+        CHECK(value % keyCount == i);
+        CHECK(storage.isIndexedCorrectly(1, ItemType::U32, key));
+    }
+
+    // blobs are indexed by their blob index entry
+    uint8_t blob[Page::CHUNK_MAX_SIZE * 3 / 2];
+    uint8_t buf[sizeof(blob)];
+    for (int i = 0; i < 4; ++i) {
+        std::fill_n(blob, sizeof(blob), i);
+        REQUIRE(storage.writeItem(2, ItemType::BLOB, "blob", blob, sizeof(blob)) == ESP_OK);
+        CHECK(storage.isIndexedCorrectly(2, ItemType::BLOB_IDX, "blob"));
+        REQUIRE(storage.readItem(2, ItemType::BLOB, "blob", buf, sizeof(buf)) == ESP_OK);
+        CHECK(memcmp(blob, buf, sizeof(blob)) == 0);
+    }
+
+    TEST_ESP_OK(storage.eraseItem(1, "k0"));
+    CHECK_FALSE(storage.isIndexed(1, ItemType::U32, "k0"));
+    uint32_t value;
+    TEST_ESP_ERR(storage.readItem(1, "k0", value), ESP_ERR_NVS_NOT_FOUND);
+
+    TEST_ESP_OK(storage.eraseItem(2, ItemType::BLOB, "blob"));
+    CHECK_FALSE(storage.isIndexed(2, ItemType::BLOB_IDX, "blob"));
+    TEST_ESP_ERR(storage.readItem(2, ItemType::BLOB, "blob", buf, sizeof(buf)), ESP_ERR_NVS_NOT_FOUND);
+
+    TEST_ESP_OK(storage.eraseNamespace(1));
+    for (size_t i = 1; i < keyCount; ++i) {
+        snprintf(key, sizeof(key), "k%d", static_cast<int>(i));
+        CHECK_FALSE(storage.isIndexed(1, ItemType::U32, key));
+        TEST_ESP_ERR(storage.readItem(1, key, value), ESP_ERR_NVS_NOT_FOUND);
+    }
+}
+
+TEST_CASE("key index recovers from entries which went stale", "[nvs]")
+{
+    const size_t pageCount = 4;
+    PartitionEmulationFixture f(0, pageCount);
+    KeyIndexStorageHelper storage(&f.part);
+    CHECK(storage.init(0, pageCount) == ESP_OK);
+
+    TEST_ESP_OK(storage.writeItem(1, "foo", 1U));
+    TEST_ESP_OK(storage.writeItem(1, "bar", 2U));
+
+    CHECK(storage.isIndexed(1, ItemType::U32, "foo"));
+    storage.eraseFromPages(1, ItemType::U32, "foo");
+    uint32_t value;
+    TEST_ESP_ERR(storage.readItem(1, "foo", value), ESP_ERR_NVS_NOT_FOUND);
+    CHECK_FALSE(storage.isIndexed(1, ItemType::U32, "foo"));
+    TEST_ESP_OK(storage.readItem(1, "bar", value));
+    CHECK(value == 2);
+}
+#endif // CONFIG_NVS_KEY_INDEX
+
+TEST_CASE("measure lookup latency of items spread over many pages", "[nvs]")
+{
+    const size_t pageCount = 48;
+    const size_t keyCount = 2000;
+    const size_t hotKeyCount = 64;
+    const size_t lookupCount = 20000;
+    PartitionEmulationFixture f(0, pageCount);
+    Storage storage(&f.part);
+    CHECK(storage.init(0, pageCount) == ESP_OK);
+
+    char key[16];
+    for (size_t i = 0; i < keyCount; ++i) {
+        snprintf(key, sizeof(key), "key%d", static_cast<int>(i));
+        REQUIRE(storage.writeItem(1 + i % 4, key, static_cast<uint32_t>(i)) == ESP_OK);
+    }
+
+    // hot keys are spread over all pages, as they would be after some time of updates
+    const size_t keySets[] = { hotKeyCount, keyCount };
+    for (size_t keySet : keySets) {
+        f.emu.clearStats();
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < lookupCount; ++i) {
+            size_t n = (i % keySet) * (keyCount / keySet);
+            snprintf(key, sizeof(key), "key%d", static_cast<int>(n));
+            uint32_t value;
+            REQUIRE(storage.readItem(1 + n % 4, key, value) == ESP_OK);
+            REQUIRE(value == n);
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        s_perf << "Lookup of " << keySet << " of " << keyCount << " keys in " << pageCount << " pages: "
+               << elapsed.count() / lookupCount << " ns per lookup (" << f.emu.getReadOps() << " reads for "
+               << lookupCount << " lookups)" << std::endl;
+    }
+}
+
+TEST_CASE("transaction stages changes until it is committed", "[nvs]")
+{
+    PartitionEmulationFixture f(0, 4);
+    TEST_ESP_OK(NVSPartitionManager::get_instance()->init_custom(&f.part, 0, 4));
+
+    nvs_handle_t handle;
+    TEST_ESP_OK(nvs_open("test", NVS_READWRITE, &handle));
+    TEST_ESP_OK(nvs_set_u32(handle, "a", 1));
+    TEST_ESP_OK(nvs_set_u32(handle, "erased", 1));
+
+    TEST_ESP_ERR(nvs_txn_commit(handle), ESP_ERR_NVS_INVALID_STATE);
+    TEST_ESP_ERR(nvs_txn_abort(handle), ESP_ERR_NVS_INVALID_STATE);
+
+    TEST_ESP_OK(nvs_txn_begin(handle));
+    TEST_ESP_ERR(nvs_txn_begin(handle), ESP_ERR_NVS_INVALID_STATE);
+    TEST_ESP_OK(nvs_set_u32(handle, "a", 2));
+    TEST_ESP_OK(nvs_set_str(handle, "str", "value"));
+    const uint8_t blob[Page::CHUNK_MAX_SIZE + 100] = {1, 2, 3};
+    TEST_ESP_OK(nvs_set_blob(handle, "blob", blob, sizeof(blob)));
+    TEST_ESP_OK(nvs_erase_key(handle, "erased"));
+    TEST_ESP_ERR(nvs_set_u8(handle, "key which is too long", 1), ESP_ERR_NVS_KEY_TOO_LONG);
+    TEST_ESP_ERR(nvs_erase_all(handle), ESP_ERR_NVS_INVALID_STATE);
+
+    // reads return the committed values
+    uint32_t value;
+    TEST_ESP_OK(nvs_get_u32(handle, "a", &value));
+    CHECK(value == 1);
+    TEST_ESP_OK(nvs_get_u32(handle, "erased", &value));
+    size_t size;
+    TEST_ESP_ERR(nvs_get_str(handle, "str", nullptr, &size), ESP_ERR_NVS_NOT_FOUND);
+
+    TEST_ESP_OK(nvs_txn_commit(handle));
+
+    TEST_ESP_OK(nvs_get_u32(handle, "a", &value));
+    CHECK(value == 2);
+    char str[8];
+    size = sizeof(str);
+    TEST_ESP_OK(nvs_get_str(handle, "str", str, &size));
+    CHECK(strcmp(str, "value") == 0);
+    uint8_t readBlob[sizeof(blob)];
+    size = sizeof(readBlob);
+    TEST_ESP_OK(nvs_get_blob(handle, "blob", readBlob, &size));
+    CHECK(memcmp(blob, readBlob, sizeof(blob)) == 0);
+    TEST_ESP_ERR(nvs_get_u32(handle, "erased", &value), ESP_ERR_NVS_NOT_FOUND);
+
+    // aborted changes are discarded
+    TEST_ESP_OK(nvs_txn_begin(handle));
+    TEST_ESP_OK(nvs_set_u32(handle, "a", 3));
+    TEST_ESP_OK(nvs_erase_key(handle, "str"));
+    TEST_ESP_OK(nvs_txn_abort(handle));
+    TEST_ESP_OK(nvs_get_u32(handle, "a", &value));
+    CHECK(value == 2);
+    size = sizeof(str);
+    TEST_ESP_OK(nvs_get_str(handle, "str", str, &size));
+
+    // the journal doesn't survive a successful commit
+    CHECK(nvs_entry_find(NVS_DEFAULT_PART_NAME, "nvs.txn", NVS_TYPE_ANY) == nullptr);
+
+    nvs_handle_t readOnlyHandle;
+    TEST_ESP_OK(nvs_open("test", NVS_READONLY, &readOnlyHandle));
+    TEST_ESP_ERR(nvs_txn_begin(readOnlyHandle), ESP_ERR_NVS_READ_ONLY);
+    nvs_close(readOnlyHandle);
+
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+}
+
+TEST_CASE("transaction which doesn't fit is rejected before anything is written", "[nvs]")
+{
+    PartitionEmulationFixture f(0, 3);
+    TEST_ESP_OK(NVSPartitionManager::get_instance()->init_custom(&f.part, 0, 3));
+
+    nvs_handle_t handle;
+    TEST_ESP_OK(nvs_open("test", NVS_READWRITE, &handle));
+    TEST_ESP_OK(nvs_set_u32(handle, "a", 1));
+
+    static const uint8_t blob[Page::CHUNK_MAX_SIZE] = {0};
+    TEST_ESP_OK(nvs_txn_begin(handle));
+    TEST_ESP_OK(nvs_set_u32(handle, "a", 2));
+    TEST_ESP_OK(nvs_set_blob(handle, "blob", blob, sizeof(blob)));
+    f.emu.clearStats();
+    TEST_ESP_ERR(nvs_txn_commit(handle), ESP_ERR_NVS_NOT_ENOUGH_SPACE);
+    CHECK(f.emu.getWriteOps() == 0);
+
+    uint32_t value;
+    TEST_ESP_OK(nvs_get_u32(handle, "a", &value));
+    CHECK(value == 1);
+
+    nvs_close(handle);
+    TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+}
+
+TEST_CASE("transaction is applied completely or not at all after power loss", "[nvs]")
+{
+    const size_t pageCount = 4;
+    const char* newStr = "new value";
+    uint8_t oldBlob[Page::CHUNK_MAX_SIZE / 2];
+    uint8_t newBlob[Page::CHUNK_MAX_SIZE / 2];
+    std::fill_n(oldBlob, sizeof(oldBlob), 0x11);
+    std::fill_n(newBlob, sizeof(newBlob), 0x22);
+
+    size_t failCount = 0;
+    size_t replayCount = 0;
+    for (uint32_t errDelay = 0; ; ++errDelay) {
+        INFO(errDelay);
+        PartitionEmulationFixture f(0, pageCount);
+        TEST_ESP_OK(NVSPartitionManager::get_instance()->init_custom(&f.part, 0, pageCount));
+
+        nvs_handle_t handle;
+        TEST_ESP_OK(nvs_open("test", NVS_READWRITE, &handle));
+        TEST_ESP_OK(nvs_set_u32(handle, "a", 1));
+        TEST_ESP_OK(nvs_set_u32(handle, "b", 1));
+        TEST_ESP_OK(nvs_set_str(handle, "str", "old value"));
+        TEST_ESP_OK(nvs_set_blob(handle, "blob", oldBlob, sizeof(oldBlob)));
+        TEST_ESP_OK(nvs_set_u8(handle, "erased", 1));
+
+        TEST_ESP_OK(nvs_txn_begin(handle));
+        TEST_ESP_OK(nvs_set_u32(handle, "a", 2));
+        TEST_ESP_OK(nvs_set_u32(handle, "b", 2));
+        TEST_ESP_OK(nvs_set_str(handle, "str", newStr));
+        TEST_ESP_OK(nvs_set_blob(handle, "blob", newBlob, sizeof(newBlob)));
+        TEST_ESP_OK(nvs_erase_key(handle, "erased"));
+        TEST_ESP_OK(nvs_set_u32(handle, "added", 2));
+
+        f.emu.failAfter(errDelay);
+        esp_err_t err = nvs_txn_commit(handle);
+        nvs_close(handle);
+        TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+        f.emu.failAfter(UINT32_MAX);
+
+        // "power on" again, recovery has to finish or drop the transaction
+        TEST_ESP_OK(NVSPartitionManager::get_instance()->init_custom(&f.part, 0, pageCount));
+        TEST_ESP_OK(nvs_open("test", NVS_READWRITE, &handle));
+
+        uint32_t a, b;
+        TEST_ESP_OK(nvs_get_u32(handle, "a", &a));
+        TEST_ESP_OK(nvs_get_u32(handle, "b", &b));
+        CHECK(a == b);
+
+        char str[16];
+        size_t size = sizeof(str);
+        TEST_ESP_OK(nvs_get_str(handle, "str", str, &size));
+        CHECK(strcmp(str, (a == 2) ? newStr : "old value") == 0);
+
+        uint8_t blob[sizeof(newBlob)];
+        size = sizeof(blob);
+        TEST_ESP_OK(nvs_get_blob(handle, "blob", blob, &size));
+        CHECK(memcmp(blob, (a == 2) ? newBlob : oldBlob, sizeof(blob)) == 0);
+
+        uint8_t erased;
+        uint32_t added;
+        if (a == 2) {
+            TEST_ESP_ERR(nvs_get_u8(handle, "erased", &erased), ESP_ERR_NVS_NOT_FOUND);
+            TEST_ESP_OK(nvs_get_u32(handle, "added", &added));
+        } else {
+            TEST_ESP_OK(nvs_get_u8(handle, "erased", &erased));
+            TEST_ESP_ERR(nvs_get_u32(handle, "added", &added), ESP_ERR_NVS_NOT_FOUND);
+        }
+        CHECK(nvs_entry_find(NVS_DEFAULT_PART_NAME, "nvs.txn", NVS_TYPE_ANY) == nullptr);
+
+        nvs_close(handle);
+        TEST_ESP_OK(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME));
+
+        if (err == ESP_OK) {
+            CHECK(a == 2);
+            break;
+        }
+        ++failCount;
+        if (a == 2) {
+            ++replayCount;
+        }
+    }
+    // the commit must have been interrupted while writing the journal as well as while applying it
+    CHECK(failCount > Page::CHUNK_MAX_SIZE / 4);
+    CHECK(replayCount > 0);
+    CHECK(replayCount < failCount);
+}
+
 /* Add new tests above */
 /* This test has to be the final one */
 
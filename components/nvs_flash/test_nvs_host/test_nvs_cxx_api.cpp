@@ -191,3 +191,52 @@ TEST_CASE("NVSHandleSimple CXX api read/write blob", "[nvs cxx]")
 
     nvs::NVSPartitionManager::get_instance()->deinit_partition("nvs");
 }
+
+TEST_CASE("NVSHandleSimple CXX api transaction", "[nvs cxx]")
+{
+    const uint32_t NVS_FLASH_SECTOR = 6;
+    const uint32_t NVS_FLASH_SECTOR_COUNT_MIN = 3;
+    PartitionEmulationFixture f(0, 10);
+    char read_buffer [256];
+    uint32_t value;
+    esp_err_t result;
+    shared_ptr<nvs::NVSHandle> handle;
+
+    REQUIRE(nvs::NVSPartitionManager::get_instance()->init_custom(&f.part, NVS_FLASH_SECTOR, NVS_FLASH_SECTOR_COUNT_MIN)
+            == ESP_OK);
+
+    handle = nvs::open_nvs_handle("test_ns", NVS_READWRITE, &result);
+    CHECK(result == ESP_OK);
+    REQUIRE(handle);
+
+    CHECK(handle->set_item("value", 1U) == ESP_OK);
+
+    CHECK(handle->begin_transaction() == ESP_OK);
+    CHECK(handle->begin_transaction() == ESP_ERR_NVS_INVALID_STATE);
+    CHECK(handle->set_item("value", 2U) == ESP_OK);
+    CHECK(handle->set_string("test", "test string") == ESP_OK);
+    CHECK(handle->erase_all() == ESP_ERR_NVS_INVALID_STATE);
+
+    // nothing is visible before the commit
+    CHECK(handle->get_item("value", value) == ESP_OK);
+    CHECK(value == 1);
+    CHECK(handle->get_string("test", read_buffer, sizeof(read_buffer)) == ESP_ERR_NVS_NOT_FOUND);
+
+    CHECK(handle->commit_transaction() == ESP_OK);
+    CHECK(handle->commit_transaction() == ESP_ERR_NVS_INVALID_STATE);
+    CHECK(handle->get_item("value", value) == ESP_OK);
+    CHECK(value == 2);
+    CHECK(handle->get_string("test", read_buffer, sizeof(read_buffer)) == ESP_OK);
+    CHECK(string(read_buffer) == "test string");
+
+    CHECK(handle->begin_transaction() == ESP_OK);
+    CHECK(handle->set_item("value", 3U) == ESP_OK);
+    CHECK(handle->erase_item("test") == ESP_OK);
+    CHECK(handle->abort_transaction() == ESP_OK);
+    CHECK(handle->abort_transaction() == ESP_ERR_NVS_INVALID_STATE);
+    CHECK(handle->get_item("value", value) == ESP_OK);
+    CHECK(value == 2);
+    CHECK(handle->get_string("test", read_buffer, sizeof(read_buffer)) == ESP_OK);
+
+    nvs::NVSPartitionManager::get_instance()->deinit_partition("nvs");
+}
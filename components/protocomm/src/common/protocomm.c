@@ -154,7 +154,7 @@ esp_err_t protocomm_req_handle(protocomm_t *pc, const char *ep_name, uint32_t se
                                uint8_t **outbuf, ssize_t *outlen)
 {
     if (!pc || !ep_name || !outbuf || !outlen) {
-        ESP_LOGE(TAG, "Invalid params %p %p", pc, ep_name);
+        ESP_LOGE(TAG, "Invalid params %p %p", pc, (const void *)ep_name);
         return ESP_ERR_INVALID_ARG;
     }
 
@@ -7,6 +7,8 @@
 #ifndef _ESP_TRANSPORT_WS_H_
 #define _ESP_TRANSPORT_WS_H_
 
+#include <stdbool.h>
+#include <stdint.h>
 #include "esp_transport.h"
 
 #ifdef __cplusplus
@@ -22,6 +24,23 @@ typedef enum ws_transport_opcodes {
     WS_TRANSPORT_OPCODES_PONG = 0x0a,
 } ws_transport_opcodes_t;
 
+/**
+ * @brief      Callback called by esp_transport_ws_read_message() with each part of a message
+ *
+ * @param[in]  opcode    Opcode of the message, the one of its first frame for a fragmented message
+ * @param[in]  chunk     Unmasked part of the payload, in the buffer given to esp_transport_ws_read_message()
+ * @param[in]  len       Length of the part, 0 only for the part ending an empty frame
+ * @param[in]  offset    Position of the part in the payload of the whole message
+ * @param[in]  fin       Whether this part is the last one of the message
+ * @param[in]  user_ctx  Context given to esp_transport_ws_read_message()
+ *
+ * @return
+ *  - ESP_OK to go on reading
+ *  - Any other value to stop, esp_transport_ws_read_message() then returns -1
+ */
+typedef esp_err_t (*ws_transport_message_cb_t)(ws_transport_opcodes_t opcode, const char *chunk, int len,
+                                               uint64_t offset, bool fin, void *user_ctx);
+
 /**
  * @brief      Create web socket transport
  *
@@ -96,6 +115,57 @@ esp_err_t esp_transport_ws_set_headers(esp_transport_handle_t t, const char *hea
  */
 int esp_transport_ws_send_raw(esp_transport_handle_t t, ws_transport_opcodes_t opcode, const char *b, int len, int timeout_ms);
 
+/**
+ * @brief               Sends a frame of a websocket message whose total length isn't known up front
+ *
+ * The first frame of the message is sent with the given opcode, the following ones as continuation
+ * frames, until the frame with fin set. Control frames may be sent with esp_transport_ws_send_raw()
+ * between the frames of the message, but no other data message.
+ *
+ * @note A frame which fails to be sent may have been sent in part, so the connection has to be closed
+ *       then; the message is abandoned and the next frame sent would start a new one.
+ *
+ * @param[in]  t           Websocket transport handle
+ * @param[in]  opcode      WS_TRANSPORT_OPCODES_TEXT or WS_TRANSPORT_OPCODES_BINARY, the opcode of the message
+ * @param[in]  b           The part of the message, may be NULL if len is 0
+ * @param[in]  len         The length of the part, may be 0
+ * @param[in]  fin         Whether this part is the last one of the message
+ * @param[in]  timeout_ms  The timeout milliseconds (-1 indicates block forever)
+ *
+ * @return
+ *  - Number of bytes was written
+ *  - (-1) if there are any errors, should check errno
+ */
+int esp_transport_ws_send_fragment(esp_transport_handle_t t, ws_transport_opcodes_t opcode, const char *b, int len, bool fin, int timeout_ms);
+
+/**
+ * @brief               Reads a websocket message, passing its payload to a callback part by part
+ *
+ * The frames of a fragmented message are delivered as one message, the offset of each part counting
+ * from the start of the message, whatever its length. No memory is allocated for the message, parts
+ * are at most len bytes long. Control frames received between the frames of a message are delivered
+ * as messages of their own, the read then returning before the end of the interrupted message, which
+ * the next call goes on with. If the timeout expires within a frame, the next call goes on with the
+ * rest of the frame as well.
+ *
+ * This API and esp_transport_read() must not be mixed to read one message.
+ *
+ * @param[in]  t           Websocket transport handle
+ * @param[in]  buffer      The buffer in which the parts are read
+ * @param[in]  len         The length of the buffer
+ * @param[in]  callback    The callback called with each part
+ * @param[in]  user_ctx    The context passed to the callback
+ * @param[in]  timeout_ms  The timeout milliseconds (-1 indicates block forever)
+ *
+ * @return
+ *  - 1 when a message was read to its end
+ *  - 0 if the timeout expired before
+ *  - (-1) on errors of the connection or of the protocol, or if the callback stopped reading,
+ *    the connection should then be closed
+ */
+int esp_transport_ws_read_message(esp_transport_handle_t t, char *buffer, int len,
+                                  ws_transport_message_cb_t callback, void *user_ctx, int timeout_ms);
+
 /**
  * @brief               Returns websocket op-code for last received data
  *
@@ -112,7 +182,7 @@ ws_transport_opcodes_t esp_transport_ws_get_read_opcode(esp_transport_handle_t t
  * @param t             websocket transport handle
  *
  * @return
- *      - Number of bytes in the payload
+ *      - Number of bytes in the payload, INT_MAX for longer payloads
  */
 int esp_transport_ws_get_read_payload_len(esp_transport_handle_t t);
 
@@ -0,0 +1,28 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+
+/* The transports log with the formats of the target, the arguments are evaluated but the format isn't checked */
+static inline void esp_log_mock(const char *tag, const char *format, ...)
+{
+}
+
+#define ESP_LOGE(tag, format, ...)  esp_log_mock(tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...)  esp_log_mock(tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...)  esp_log_mock(tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...)  esp_log_mock(tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...)  esp_log_mock(tag, format, ##__VA_ARGS__)
@@ -0,0 +1,26 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "esp_err.h"
+
+/* Only the error tracker which every transport list has */
+typedef struct esp_tls_last_error* esp_tls_error_handle_t;
+
+typedef struct esp_tls_last_error {
+    esp_err_t last_error;
+    int       esp_tls_error_code;
+    int       esp_tls_flags;
+} esp_tls_last_error_t;
@@ -0,0 +1,767 @@
+// Copyright 2019-2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "catch.hpp"
+#include "esp_transport.h"
+#include "esp_transport_tcp.h"
+#include "esp_transport_ws.h"
+#include "mbedtls/base64.h"
+#include "mbedtls/sha1.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <climits>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+namespace {
+
+/* Transport under the WebSocket one, keeping what is written to it */
+struct Parent {
+    esp_transport_handle_t handle;
+    std::string written;
+    std::vector<int> writes;        // length of each write
+    int max_write = 0;              // accept at most this many bytes per write, 0 for any
+    int fail_after = -1;            // bytes accepted before the writes fail, -1 for any
+    bool keep = true;               // false to only count the bytes written
+    std::string to_read;            // what the transport reads, up to max_read bytes at a time
+    int max_read = 0;
+    uint64_t generated = 0;         // bytes read after to_read, each block of 64 KB filled with its number
+    uint64_t generated_pos = 0;
+
+    Parent()
+    {
+        handle = esp_transport_init();
+        esp_transport_set_context_data(handle, this);
+        esp_transport_set_func(handle, nullptr, read, write, nullptr, poll_read, poll_write, nullptr);
+    }
+
+    static int read(esp_transport_handle_t t, char *buffer, int len, int timeout_ms)
+    {
+        Parent *parent = static_cast<Parent *>(esp_transport_get_context_data(t));
+        if (parent->max_read && len > parent->max_read) {
+            len = parent->max_read;
+        }
+        if (parent->to_read.empty() && parent->generated) {
+            uint64_t block = parent->generated_pos >> 16;
+            len = std::min<uint64_t>({(uint64_t)len, parent->generated, ((block + 1) << 16) - parent->generated_pos});
+            memset(buffer, (char)block, len);
+            parent->generated -= len;
+            parent->generated_pos += len;
+            return len;
+        }
+        // Nothing to read is a timeout
+        len = parent->to_read.copy(buffer, len);
+        parent->to_read.erase(0, len);
+        return len;
+    }
+
+    static int write(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms)
+    {
+        Parent *parent = static_cast<Parent *>(esp_transport_get_context_data(t));
+        if (parent->max_write && len > parent->max_write) {
+            len = parent->max_write;
+        }
+        if (parent->fail_after >= 0) {
+            if (parent->fail_after == 0) {
+                return -1;
+            }
+            len = std::min(len, parent->fail_after);
+            parent->fail_after -= len;
+        }
+        if (parent->keep) {
+            parent->written.append(buffer, len);
+            parent->writes.push_back(len);
+        }
+        return len;
+    }
+
+    static int poll_read(esp_transport_handle_t t, int timeout_ms)
+    {
+        Parent *parent = static_cast<Parent *>(esp_transport_get_context_data(t));
+        return !parent->to_read.empty() || parent->generated;
+    }
+
+    static int poll_write(esp_transport_handle_t t, int timeout_ms)
+    {
+        return 1;
+    }
+};
+
+/* WebSocket transport, as after the handshake */
+struct Ws {
+    Parent parent;
+    esp_transport_handle_t handle;
+
+    Ws()
+    {
+        handle = esp_transport_ws_init(parent.handle);
+    }
+
+    ~Ws()
+    {
+        esp_transport_destroy(handle);
+        esp_transport_destroy(parent.handle);
+    }
+};
+
+struct Frame {
+    bool fin;
+    int opcode;
+    bool masked;
+    std::string payload;            // unmasked
+};
+
+/* Splits what was written into frames */
+std::vector<Frame> parse_frames(const std::string &data)
+{
+    std::vector<Frame> frames;
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(data.data());
+    size_t pos = 0;
+    while (pos < data.size()) {
+        REQUIRE(data.size() - pos >= 2);
+        Frame frame;
+        frame.fin = p[pos] & 0x80;
+        frame.opcode = p[pos] & 0x0f;
+        frame.masked = p[pos + 1] & 0x80;
+        uint64_t len = p[pos + 1] & 0x7f;
+        pos += 2;
+        int extra = len == 126 ? 2 : len == 127 ? 8 : 0;
+        if (extra) {
+            REQUIRE(data.size() - pos >= (size_t)extra);
+            len = 0;
+            for (int i = 0; i < extra; i++) {
+                len = len << 8 | p[pos++];
+            }
+        }
+        uint8_t mask[4] = {0, 0, 0, 0};
+        if (frame.masked) {
+            REQUIRE(data.size() - pos >= 4);
+            memcpy(mask, p + pos, 4);
+            pos += 4;
+        }
+        REQUIRE(data.size() - pos >= len);
+        frame.payload.resize(len);
+        for (uint64_t i = 0; i < len; i++) {
+            frame.payload[i] = p[pos + i] ^ mask[i % 4];
+        }
+        pos += len;
+        frames.push_back(frame);
+    }
+    return frames;
+}
+
+std::string pattern(size_t len)
+{
+    std::string s(len, '\0');
+    for (size_t i = 0; i < len; i++) {
+        s[i] = (char)(i * 7 + 3);
+    }
+    return s;
+}
+
+/* Parts given to the callback of esp_transport_ws_read_message() */
+struct Part {
+    ws_transport_opcodes_t opcode;
+    std::string chunk;
+    uint64_t offset;
+    bool fin;
+};
+
+struct Parts {
+    std::vector<Part> parts;
+    int stop_at = -1;               // the callback fails for this part
+
+    static esp_err_t callback(ws_transport_opcodes_t opcode, const char *chunk, int len, uint64_t offset, bool fin, void *ctx)
+    {
+        Parts *parts = static_cast<Parts *>(ctx);
+        if ((int)parts->parts.size() == parts->stop_at) {
+            return ESP_FAIL;
+        }
+        parts->parts.push_back({opcode, std::string(chunk, len), offset, fin});
+        return ESP_OK;
+    }
+
+    /* Payload of the message made of the parts with this opcode, checking their offsets */
+    std::string message(ws_transport_opcodes_t opcode)
+    {
+        std::string payload;
+        for (const Part &part : parts) {
+            if (part.opcode == opcode) {
+                CHECK(part.offset == payload.size());
+                payload += part.chunk;
+            }
+        }
+        return payload;
+    }
+};
+
+/* Unmasked frame, as sent by servers */
+std::string server_frame(uint8_t first_byte, const std::string &payload)
+{
+    std::string frame(1, (char)first_byte);
+    if (payload.size() < 126) {
+        frame += (char)payload.size();
+    } else if (payload.size() < 65536) {
+        frame += (char)126;
+        frame += (char)(payload.size() >> 8);
+        frame += (char)payload.size();
+    } else {
+        frame += (char)127;
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            frame += (char)((uint64_t)payload.size() >> shift);
+        }
+    }
+    return frame + payload;
+}
+
+/* WebSocket server on the loopback interface, echoing the messages it receives */
+class EchoServer {
+public:
+    int fragment = 0;               // echoed messages are sent in frames of this many bytes, 0 for one frame
+    bool ping_between = false;      // a ping is sent between the frames of echoed messages
+    std::mutex lock;
+    std::vector<std::pair<int, bool>> received;    // opcode and fin of the frames received
+
+    EchoServer()
+    {
+        listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t addr_len = sizeof(addr);
+        REQUIRE(bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+        REQUIRE(listen(listen_fd, 4) == 0);
+        REQUIRE(getsockname(listen_fd, (struct sockaddr *)&addr, &addr_len) == 0);
+        port = ntohs(addr.sin_port);
+        thread = std::thread(&EchoServer::run, this);
+    }
+
+    ~EchoServer()
+    {
+        stop = true;
+        thread.join();
+        close(listen_fd);
+    }
+
+    int port;
+
+private:
+    int listen_fd;
+    std::atomic<bool> stop{false};
+    std::thread thread;
+
+    void run()
+    {
+        while (!stop) {
+            struct pollfd pfd = {listen_fd, POLLIN, 0};
+            if (poll(&pfd, 1, 10) != 1) {
+                continue;
+            }
+            int fd = accept(listen_fd, nullptr, nullptr);
+            if (fd >= 0) {
+                if (handshake(fd)) {
+                    serve(fd);
+                }
+                close(fd);
+            }
+        }
+    }
+
+    bool recv_all(int fd, char *buf, size_t len)
+    {
+        while (len) {
+            struct pollfd pfd = {fd, POLLIN, 0};
+            if (stop) {
+                return false;
+            }
+            if (poll(&pfd, 1, 10) != 1) {
+                continue;
+            }
+            ssize_t ret = recv(fd, buf, len, 0);
+            if (ret <= 0) {
+                return false;
+            }
+            buf += ret;
+            len -= ret;
+        }
+        return true;
+    }
+
+    void send_all(int fd, const std::string &data)
+    {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t ret = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (ret <= 0) {
+                return;
+            }
+            sent += ret;
+        }
+    }
+
+    bool handshake(int fd)
+    {
+        std::string request;
+        char c;
+        while (request.find("\r\n\r\n") == std::string::npos) {
+            if (!recv_all(fd, &c, 1)) {
+                return false;
+            }
+            request += c;
+        }
+        const std::string key_header = "Sec-WebSocket-Key: ";
+        size_t key_pos = request.find(key_header);
+        if (key_pos == std::string::npos) {
+            return false;
+        }
+        key_pos += key_header.size();
+        std::string key = request.substr(key_pos, request.find("\r\n", key_pos) - key_pos);
+        key += "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+        unsigned char sha1[20];
+        unsigned char accept[32];
+        size_t accept_len;
+        mbedtls_sha1_ret((const unsigned char *)key.data(), key.size(), sha1);
+        mbedtls_base64_encode(accept, sizeof(accept), &accept_len, sha1, sizeof(sha1));
+        send_all(fd, "HTTP/1.1 101 Switching Protocols\r\n"
+                 "Upgrade: websocket\r\n"
+                 "Connection: Upgrade\r\n"
+                 "Sec-WebSocket-Accept: " + std::string((char *)accept, accept_len) + "\r\n\r\n");
+        return true;
+    }
+
+    void serve(int fd)
+    {
+        std::string message;
+        int message_opcode = 0;
+        while (true) {
+            uint8_t header[14];
+            if (!recv_all(fd, (char *)header, 2)) {
+                return;
+            }
+            bool fin = header[0] & 0x80;
+            int opcode = header[0] & 0x0f;
+            uint64_t len = header[1] & 0x7f;
+            int len_size = len == 126 ? 2 : len == 127 ? 8 : 0;
+            if (!recv_all(fd, (char *)header, len_size + 4)) {
+                return;
+            }
+            if (len_size) {
+                len = 0;
+                for (int i = 0; i < len_size; i++) {
+                    len = len << 8 | header[i];
+                }
+            }
+            const uint8_t *mask = header + len_size;
+            std::string payload(len, '\0');
+            if (!recv_all(fd, &payload[0], len)) {
+                return;
+            }
+            for (size_t i = 0; i < len; i++) {
+                payload[i] ^= mask[i % 4];
+            }
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                received.push_back({opcode, fin});
+            }
+
+            if (opcode == WS_TRANSPORT_OPCODES_CLOSE) {
+                send_all(fd, server_frame(0x80 | opcode, payload));
+                return;
+            } else if (opcode == WS_TRANSPORT_OPCODES_PING) {
+                send_all(fd, server_frame(0x80 | WS_TRANSPORT_OPCODES_PONG, payload));
+                continue;
+            } else if (opcode != WS_TRANSPORT_OPCODES_CONT) {
+                message_opcode = opcode;
+            }
+            message += payload;
+            if (fin) {
+                echo(fd, message_opcode, message);
+                message.clear();
+            }
+        }
+    }
+
+    void echo(int fd, int opcode, const std::string &message)
+    {
+        size_t frame_len = fragment ? fragment : message.size();
+        size_t pos = 0;
+        do {
+            std::string part = message.substr(pos, frame_len);
+            pos += part.size();
+            bool fin = pos == message.size();
+            if (ping_between && pos > part.size()) {
+                send_all(fd, server_frame(0x80 | WS_TRANSPORT_OPCODES_PING, "ping"));
+            }
+            send_all(fd, server_frame((fin ? 0x80 : 0) | (pos > part.size() ? WS_TRANSPORT_OPCODES_CONT : opcode), part));
+        } while (pos < message.size());
+    }
+};
+
+/* WebSocket transport connected to a server */
+struct WsClient {
+    esp_transport_handle_t tcp;
+    esp_transport_handle_t handle;
+
+    WsClient(int port)
+    {
+        tcp = esp_transport_tcp_init();
+        handle = esp_transport_ws_init(tcp);
+        REQUIRE(esp_transport_connect(handle, "127.0.0.1", port, 1000) == 0);
+    }
+
+    ~WsClient()
+    {
+        esp_transport_close(handle);
+        esp_transport_destroy(handle);
+        esp_transport_destroy(tcp);
+    }
+};
+
+}
+
+TEST_CASE("frames are masked without modifying the data", "[transport_ws]")
+{
+    const int lengths[] = {1, 3, 4, 5, 125, 126, 127, 1007, 1008, 1009, 2016, 4099, 65535, 65536, 100003};
+    for (int len : lengths) {
+        // Every alignment of the data, as the word masking differs for unaligned data
+        for (int offset = 0; offset < 4; offset++) {
+            std::string source = pattern(len + offset);
+            const std::string copy = source;
+            Ws ws;
+            REQUIRE(esp_transport_ws_send_raw(ws.handle, WS_TRANSPORT_OPCODES_TEXT, &source[offset], len, 1000) == len);
+            REQUIRE(source == copy);
+
+            std::vector<Frame> frames = parse_frames(ws.parent.written);
+            REQUIRE(frames.size() == 1);
+            CHECK(frames[0].fin);
+            CHECK(frames[0].opcode == WS_TRANSPORT_OPCODES_TEXT);
+            CHECK(frames[0].masked);
+            CHECK(frames[0].payload == copy.substr(offset));
+        }
+    }
+}
+
+TEST_CASE("a ping is a frame with no payload", "[transport_ws]")
+{
+    Ws ws;
+    REQUIRE(esp_transport_write(ws.handle, nullptr, 0, 1000) == 0);
+    REQUIRE(ws.parent.writes.size() == 1);
+    std::vector<Frame> frames = parse_frames(ws.parent.written);
+    REQUIRE(frames.size() == 1);
+    CHECK(frames[0].fin);
+    CHECK(frames[0].opcode == WS_TRANSPORT_OPCODES_PING);
+    CHECK(frames[0].payload.empty());
+}
+
+TEST_CASE("the header is sent with the payload in one write", "[transport_ws]")
+{
+    Ws ws;
+    // Header of 6 bytes, 2 of length and 4 of mask
+    std::string data = pattern(100);
+    REQUIRE(esp_transport_write(ws.handle, data.data(), data.size(), 1000) == 100);
+    REQUIRE(ws.parent.writes == std::vector<int>{106});
+
+    // Longer payloads are masked and sent by chunks of the buffer of the transport, the header with the first one
+    ws.parent.writes.clear();
+    ws.parent.written.clear();
+    data = pattern(3000);
+    REQUIRE(esp_transport_write(ws.handle, data.data(), data.size(), 1000) == 3000);
+    REQUIRE(ws.parent.writes == std::vector<int>{8 + 1008, 1008, 984});
+    std::vector<Frame> frames = parse_frames(ws.parent.written);
+    REQUIRE(frames.size() == 1);
+    CHECK(frames[0].opcode == WS_TRANSPORT_OPCODES_BINARY);
+    CHECK(frames[0].payload == data);
+}
+
+TEST_CASE("frames are complete when the parent transport writes less than asked", "[transport_ws]")
+{
+    Ws ws;
+    ws.parent.max_write = 7;
+    std::string data = pattern(2500);
+    REQUIRE(esp_transport_write(ws.handle, data.data(), data.size(), 1000) == 2500);
+    REQUIRE(esp_transport_ws_send_raw(ws.handle, WS_TRANSPORT_OPCODES_PONG, "pong", 4, 1000) == 4);
+    std::vector<Frame> frames = parse_frames(ws.parent.written);
+    REQUIRE(frames.size() == 2);
+    CHECK(frames[0].payload == data);
+    CHECK(frames[1].opcode == WS_TRANSPORT_OPCODES_PONG);
+    CHECK(frames[1].payload == "pong");
+}
+
+TEST_CASE("a masked payload is unmasked when read in parts", "[transport_ws]")
+{
+    const uint8_t mask[4] = {0xa1, 0xb2, 0xc3, 0xd4};
+    std::string data = pattern(300);
+    std::string frame = {(char)0x82, (char)(0x80 | 126), 0x01, 0x2c};
+    frame.append(reinterpret_cast<const char *>(mask), 4);
+    for (size_t i = 0; i < data.size(); i++) {
+        frame += (char)(data[i] ^ mask[i % 4]);
+    }
+
+    Ws ws;
+    ws.parent.to_read = frame;
+    ws.parent.max_read = 7;
+    std::string payload;
+    char buffer[13];
+    while (payload.size() < data.size()) {
+        int len = esp_transport_read(ws.handle, buffer, sizeof(buffer), 1000);
+        REQUIRE(len > 0);
+        payload.append(buffer, len);
+    }
+    CHECK(esp_transport_ws_get_read_opcode(ws.handle) == WS_TRANSPORT_OPCODES_BINARY);
+    CHECK(esp_transport_ws_get_read_payload_len(ws.handle) == 300);
+    CHECK(payload == data);
+}
+
+TEST_CASE("a fragmented message is read through its parts", "[transport_ws]")
+{
+    EchoServer server;
+    server.fragment = 1000;
+    server.ping_between = true;
+    WsClient client(server.port);
+    std::string data = pattern(10000);
+    REQUIRE(esp_transport_ws_send_raw(client.handle, WS_TRANSPORT_OPCODES_TEXT, data.data(), data.size(), 1000) == 10000);
+
+    // The pings between the 10 frames of the message come as messages of their own
+    Parts parts;
+    char buffer[256];
+    int messages = 0;
+    while (parts.parts.empty() || parts.parts.back().opcode != WS_TRANSPORT_OPCODES_TEXT || !parts.parts.back().fin) {
+        REQUIRE(esp_transport_ws_read_message(client.handle, buffer, sizeof(buffer), Parts::callback, &parts, 1000) == 1);
+        messages++;
+    }
+    CHECK(messages == 10);
+    CHECK(parts.message(WS_TRANSPORT_OPCODES_TEXT) == data);
+    int pings = 0;
+    for (const Part &part : parts.parts) {
+        CHECK(part.chunk.size() <= sizeof(buffer));
+        if (part.opcode == WS_TRANSPORT_OPCODES_PING) {
+            CHECK(part.chunk == "ping");
+            CHECK(part.offset == 0);
+            CHECK(part.fin);
+            pings++;
+        } else {
+            CHECK(part.fin == (part.offset + part.chunk.size() == data.size()));
+        }
+    }
+    CHECK(pings == 9);
+}
+
+TEST_CASE("a message of unknown length is sent in fragments", "[transport_ws]")
+{
+    EchoServer server;
+    WsClient client(server.port);
+    std::string data = pattern(5000);
+    REQUIRE(esp_transport_ws_send_fragment(client.handle, WS_TRANSPORT_OPCODES_BINARY, "abc", 3, false, 1000) == 3);
+    REQUIRE(esp_transport_ws_send_fragment(client.handle, WS_TRANSPORT_OPCODES_BINARY, nullptr, 0, false, 1000) == 0);
+    REQUIRE(esp_transport_ws_send_raw(client.handle, WS_TRANSPORT_OPCODES_PING, "p", 1, 1000) == 1);
+    REQUIRE(esp_transport_ws_send_fragment(client.handle, WS_TRANSPORT_OPCODES_BINARY, data.data(), data.size(), false, 1000) == 5000);
+    REQUIRE(esp_transport_ws_send_fragment(client.handle, WS_TRANSPORT_OPCODES_BINARY, "end", 3, true, 1000) == 3);
+    // Control frames can't be fragmented
+    CHECK(esp_transport_ws_send_fragment(client.handle, WS_TRANSPORT_OPCODES_PING, "x", 1, true, 1000) == -1);
+
+    // The pong answering the ping comes before the echo
+    Parts parts;
+    char buffer[1024];
+    REQUIRE(esp_transport_ws_read_message(client.handle, buffer, sizeof(buffer), Parts::callback, &parts, 1000) == 1);
+    REQUIRE(parts.parts.size() == 1);
+    CHECK(parts.parts[0].opcode == WS_TRANSPORT_OPCODES_PONG);
+    CHECK(parts.parts[0].chunk == "p");
+    REQUIRE(esp_transport_ws_read_message(client.handle, buffer, sizeof(buffer), Parts::callback, &parts, 1000) == 1);
+    CHECK(parts.message(WS_TRANSPORT_OPCODES_BINARY) == "abc" + data + "end");
+
+    std::lock_guard<std::mutex> guard(server.lock);
+    CHECK(server.received == (std::vector<std::pair<int, bool>> {
+        {WS_TRANSPORT_OPCODES_BINARY, false}, {WS_TRANSPORT_OPCODES_CONT, false}, {WS_TRANSPORT_OPCODES_PING, true},
+        {WS_TRANSPORT_OPCODES_CONT, false}, {WS_TRANSPORT_OPCODES_CONT, true}
+    }));
+}
+
+TEST_CASE("the next message is sent whole after a fragmented one", "[transport_ws]")
+{
+    EchoServer server;
+    WsClient client(server.port);
+    REQUIRE(esp_transport_ws_send_fragment(client.handle, WS_TRANSPORT_OPCODES_TEXT, "one", 3, true, 1000) == 3);
+    REQUIRE(esp_transport_ws_send_fragment(client.handle, WS_TRANSPORT_OPCODES_BINARY, "two", 3, true, 1000) == 3);
+
+    Parts parts;
+    char buffer[16];
+    REQUIRE(esp_transport_ws_read_message(client.handle, buffer, sizeof(buffer), Parts::callback, &parts, 1000) == 1);
+    REQUIRE(esp_transport_ws_read_message(client.handle, buffer, sizeof(buffer), Parts::callback, &parts, 1000) == 1);
+    CHECK(parts.message(WS_TRANSPORT_OPCODES_TEXT) == "one");
+    CHECK(parts.message(WS_TRANSPORT_OPCODES_BINARY) == "two");
+    // Nothing more to read
+    CHECK(esp_transport_ws_read_message(client.handle, buffer, sizeof(buffer), Parts::callback, &parts, 10) == 0);
+}
+
+TEST_CASE("a fragment which fails to be sent abandons the message", "[transport_ws]")
+{
+    Ws ws;
+    REQUIRE(esp_transport_ws_send_fragment(ws.handle, WS_TRANSPORT_OPCODES_BINARY, "abc", 3, false, 1000) == 3);
+    // Only part of the header goes out
+    ws.parent.fail_after = 4;
+    CHECK(esp_transport_ws_send_fragment(ws.handle, WS_TRANSPORT_OPCODES_BINARY, "def", 3, false, 1000) == -1);
+
+    ws.parent.fail_after = -1;
+    ws.parent.written.clear();
+    REQUIRE(esp_transport_ws_send_fragment(ws.handle, WS_TRANSPORT_OPCODES_TEXT, "new", 3, true, 1000) == 3);
+    std::vector<Frame> frames = parse_frames(ws.parent.written);
+    REQUIRE(frames.size() == 1);
+    CHECK(frames[0].opcode == WS_TRANSPORT_OPCODES_TEXT);
+    CHECK(frames[0].fin);
+    CHECK(frames[0].payload == "new");
+}
+
+TEST_CASE("payload lengths over 32 bits are read", "[transport_ws]")
+{
+    const uint64_t len = (1ULL << 32) + 5;
+    Ws ws;
+    ws.parent.to_read = {(char)0x82, 127, 0, 0, 0, 1, 0, 0, 0, 5};
+    ws.parent.generated = len;
+
+    struct Check {
+        uint64_t next = 0;
+        int fins = 0;
+    } check;
+    auto callback = [](ws_transport_opcodes_t opcode, const char *chunk, int chunk_len, uint64_t offset, bool fin, void *ctx) {
+        Check *check = static_cast<Check *>(ctx);
+        // Blocks of 64 KB are filled with their number
+        if (opcode != WS_TRANSPORT_OPCODES_BINARY || offset != check->next
+                || chunk[0] != (char)(offset >> 16) || chunk[chunk_len - 1] != (char)((offset + chunk_len - 1) >> 16)) {
+            return ESP_FAIL;
+        }
+        check->next += chunk_len;
+        check->fins += fin;
+        return ESP_OK;
+    };
+    std::vector<char> buffer(65536);
+    REQUIRE(esp_transport_ws_read_message(ws.handle, buffer.data(), buffer.size(), callback, &check, 1000) == 1);
+    CHECK(check.next == len);
+    CHECK(check.fins == 1);
+    CHECK(esp_transport_ws_get_read_payload_len(ws.handle) == INT_MAX);
+}
+
+TEST_CASE("a message interrupted by the timeout is read on by the next call", "[transport_ws]")
+{
+    Ws ws;
+    ws.parent.to_read = server_frame(WS_TRANSPORT_OPCODES_TEXT, "hello ") + server_frame(0x80, "world").substr(0, 5);
+    Parts parts;
+    char buffer[64];
+    REQUIRE(esp_transport_ws_read_message(ws.handle, buffer, sizeof(buffer), Parts::callback, &parts, 10) == 0);
+    CHECK(parts.message(WS_TRANSPORT_OPCODES_TEXT) == "hello wor");
+    CHECK_FALSE(parts.parts.back().fin);
+
+    ws.parent.to_read = "ld";
+    REQUIRE(esp_transport_ws_read_message(ws.handle, buffer, sizeof(buffer), Parts::callback, &parts, 10) == 1);
+    CHECK(parts.message(WS_TRANSPORT_OPCODES_TEXT) == "hello world");
+    CHECK(parts.parts.back().offset == 9);
+    CHECK(parts.parts.back().fin);
+}
+
+TEST_CASE("empty frames are read, masked or not", "[transport_ws]")
+{
+    Ws ws;
+    // A masked ping with no payload still has its mask, then an empty message of two frames
+    ws.parent.to_read = std::string{(char)0x89, (char)0x80, 1, 2, 3, 4} + server_frame(WS_TRANSPORT_OPCODES_BINARY, "")
+                        + server_frame(0x80, "");
+    Parts parts;
+    char buffer[8];
+    REQUIRE(esp_transport_ws_read_message(ws.handle, buffer, sizeof(buffer), Parts::callback, &parts, 10) == 1);
+    REQUIRE(esp_transport_ws_read_message(ws.handle, buffer, sizeof(buffer), Parts::callback, &parts, 10) == 1);
+    REQUIRE(parts.parts.size() == 2);
+    CHECK(parts.parts[0].opcode == WS_TRANSPORT_OPCODES_PING);
+    CHECK(parts.parts[0].chunk.empty());
+    CHECK(parts.parts[1].opcode == WS_TRANSPORT_OPCODES_BINARY);
+    CHECK(parts.parts[1].chunk.empty());
+    CHECK(parts.parts[1].fin);
+}
+
+TEST_CASE("invalid sequences of frames fail the read", "[transport_ws]")
+{
+    char buffer[64];
+    Parts parts;
+    SECTION("continuation frame without a message") {
+        Ws ws;
+        ws.parent.to_read = server_frame(0x80, "cont");
+        CHECK(esp_transport_ws_read_message(ws.handle, buffer, sizeof(buffer), Parts::callback, &parts, 10) == -1);
+    }
+    SECTION("new message before the end of the previous one") {
+        Ws ws;
+        ws.parent.to_read = server_frame(WS_TRANSPORT_OPCODES_TEXT, "a") + server_frame(0x80 | WS_TRANSPORT_OPCODES_TEXT, "b");
+        CHECK(esp_transport_ws_read_message(ws.handle, buffer, sizeof(buffer), Parts::callback, &parts, 10) == -1);
+    }
+    SECTION("fragmented control frame") {
+        Ws ws;
+        ws.parent.to_read = server_frame(WS_TRANSPORT_OPCODES_PING, "a");
+        CHECK(esp_transport_ws_read_message(ws.handle, buffer, sizeof(buffer), Parts::callback, &parts, 10) == -1);
+    }
+    SECTION("reading stopped by the callback") {
+        Ws ws;
+        ws.parent.to_read = server_frame(WS_TRANSPORT_OPCODES_TEXT, "stop") + server_frame(0x80, "ped");
+        parts.stop_at = 1;
+        CHECK(esp_transport_ws_read_message(ws.handle, buffer, sizeof(buffer), Parts::callback, &parts, 10) == -1);
+        CHECK(parts.parts.size() == 1);
+    }
+}
+
+/* How frames were masked before, a byte at a time and in place, then unmasked */
+static void mask_bytes_in_place(char *buffer, int len, const char *mask)
+{
+    for (int i = 0; i < len; ++i) {
+        buffer[i] = (buffer[i] ^ mask[i % 4]);
+    }
+}
+
+TEST_CASE("dump esp_transport_ws masking performance", "[transport_ws][benchmark]")
+{
+    const size_t total = 256 * 1024 * 1024;
+    const int lengths[] = {128, 512, 1024, 4096, 16384, 65536};
+    const char mask[4] = {0x12, 0x34, 0x56, 0x78};
+    volatile char sink = 0;
+
+    printf("%-10s %16s %16s\n", "frame", "byte masking", "send_raw");
+    for (int len : lengths) {
+        std::string data = pattern(len);
+        int count = total / len;
+
+        auto start = steady_clock::now();
+        for (int i = 0; i < count; i++) {
+            mask_bytes_in_place(&data[0], len, mask);
+            sink = sink + data[i % len];
+            mask_bytes_in_place(&data[0], len, mask);
+        }
+        double bytes_elapsed = duration_cast<duration<double>>(steady_clock::now() - start).count();
+
+        Ws ws;
+        ws.parent.keep = false;
+        start = steady_clock::now();
+        for (int i = 0; i < count; i++) {
+            REQUIRE(esp_transport_ws_send_raw(ws.handle, WS_TRANSPORT_OPCODES_BINARY, data.data(), len, 1000) == len);
+        }
+        double send_elapsed = duration_cast<duration<double>>(steady_clock::now() - start).count();
+
+        printf("%8d B %11.0f MB/s %11.0f MB/s\n", len, total / bytes_elapsed / 1e6, total / send_elapsed / 1e6);
+    }
+}
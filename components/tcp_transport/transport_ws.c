@@ -1,6 +1,9 @@
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include <ctype.h>
+#include <limits.h>
 #include <sys/random.h>
 #include "esp_log.h"
 #include "esp_transport.h"
@@ -26,16 +29,25 @@ static const char *TAG = "TRANSPORT_WS";
 #define WS_SIZE16         126
 #define WS_SIZE64         127
 #define MAX_WEBSOCKET_HEADER_SIZE 16
+// Room for the masked payload in ws->buffer, after the header of the frame
+#define WS_BUFFER_PAYLOAD_SIZE    (DEFAULT_WS_BUFFER - MAX_WEBSOCKET_HEADER_SIZE)
 #define WS_RESPONSE_OK    101
 
 
 typedef struct {
     uint8_t opcode;
+    bool fin;                           /*!< Whether the frame is the last one of its message */
+    bool masked;                        /*!< Whether the payload is masked */
     char mask_key[4];                   /*!< Mask key for this payload */
-    int payload_len;                    /*!< Total length of the payload */
-    int bytes_remaining;                /*!< Bytes left to read of the payload  */
+    uint64_t payload_len;               /*!< Total length of the payload */
+    uint64_t bytes_remaining;           /*!< Bytes left to read of the payload  */
 } ws_transport_frame_state_t;
 
+typedef struct {
+    uint8_t opcode;                     /*!< Opcode of the data message being read, 0 if none */
+    uint64_t offset;                    /*!< Bytes of the message delivered so far */
+} ws_transport_message_state_t;
+
 typedef struct {
     char *path;
     char *buffer;
@@ -43,6 +55,8 @@ typedef struct {
     char *user_agent;
     char *headers;
     ws_transport_frame_state_t frame_state;
+    ws_transport_message_state_t message_state;
+    bool sending_fragments;             /*!< Whether frames of a fragmented message are being sent */
     esp_transport_handle_t parent;
 } transport_ws_t;
 
@@ -101,6 +115,9 @@ static char *get_http_header(const char *buffer, const char *key)
 static int ws_connect(esp_transport_handle_t t, const char *host, int port, int timeout_ms)
 {
     transport_ws_t *ws = esp_transport_get_context_data(t);
+    memset(&ws->frame_state, 0, sizeof(ws->frame_state));
+    memset(&ws->message_state, 0, sizeof(ws->message_state));
+    ws->sending_fragments = false;
     if (esp_transport_connect(ws->parent, host, port, timeout_ms) < 0) {
         ESP_LOGE(TAG, "Error connecting to host %s:%d", host, port);
         return -1;
@@ -202,13 +219,49 @@ static int ws_connect(esp_transport_handle_t t, const char *host, int port, int
     return 0;
 }
 
+/* XOR the data with the mask, mask[0] applying to its first byte, a 32-bit word at a time.
+   dst may be src, the data being masked in place then */
+static void ws_mask(char *dst, const char *src, int len, const char mask[4])
+{
+    uint32_t word_mask, word;
+    int i = 0;
+
+    memcpy(&word_mask, mask, sizeof(word_mask));
+    if ((((uintptr_t)dst | (uintptr_t)src) & 3) == 0) {
+        for (; i + 4 <= len; i += 4) {
+            *(uint32_t *)(dst + i) = *(const uint32_t *)(src + i) ^ word_mask;
+        }
+    } else {
+        for (; i + 4 <= len; i += 4) {
+            memcpy(&word, src + i, sizeof(word));
+            word ^= word_mask;
+            memcpy(dst + i, &word, sizeof(word));
+        }
+    }
+    for (; i < len; i++) {
+        dst[i] = src[i] ^ mask[i % 4];
+    }
+}
+
+static int ws_write_all(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms)
+{
+    int written = 0;
+    while (written < len) {
+        int ret = esp_transport_write(t, buffer + written, len - written, timeout_ms);
+        if (ret <= 0) {
+            return -1;
+        }
+        written += ret;
+    }
+    return written;
+}
+
 static int _ws_write(esp_transport_handle_t t, int opcode, int mask_flag, const char *b, int len, int timeout_ms)
 {
     transport_ws_t *ws = esp_transport_get_context_data(t);
-    char *buffer = (char *)b;
     char ws_header[MAX_WEBSOCKET_HEADER_SIZE];
-    char *mask;
-    int header_len = 0, i;
+    char *mask = NULL;
+    int header_len = 0;
 
     int poll_write;
     if ((poll_write = esp_transport_poll_write(ws->parent, timeout_ms)) <= 0) {
@@ -225,45 +278,52 @@ static int _ws_write(esp_transport_handle_t t, int opcode, int mask_flag, const
         ws_header[header_len++] = (uint8_t)(len & 0xFF);
     } else {
         ws_header[header_len++] = WS_SIZE64 | mask_flag;
-        /* Support maximum 4 bytes length */
-        ws_header[header_len++] = 0; //(uint8_t)((len >> 56) & 0xFF);
-        ws_header[header_len++] = 0; //(uint8_t)((len >> 48) & 0xFF);
-        ws_header[header_len++] = 0; //(uint8_t)((len >> 40) & 0xFF);
-        ws_header[header_len++] = 0; //(uint8_t)((len >> 32) & 0xFF);
-        ws_header[header_len++] = (uint8_t)((len >> 24) & 0xFF);
-        ws_header[header_len++] = (uint8_t)((len >> 16) & 0xFF);
-        ws_header[header_len++] = (uint8_t)((len >> 8) & 0xFF);
-        ws_header[header_len++] = (uint8_t)((len >> 0) & 0xFF);
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            ws_header[header_len++] = (uint8_t)(((uint64_t)len >> shift) & 0xFF);
+        }
     }
 
     if (mask_flag) {
         mask = &ws_header[header_len];
         getrandom(ws_header + header_len, 4, 0);
         header_len += 4;
-
-        for (i = 0; i < len; ++i) {
-            buffer[i] = (buffer[i] ^ mask[i % 4]);
-        }
     }
 
-    if (esp_transport_write(ws->parent, ws_header, header_len, timeout_ms) != header_len) {
-        ESP_LOGE(TAG, "Error write header");
-        return -1;
-    }
-    if (len == 0) {
-        return 0;
+    if (!mask_flag && len > WS_BUFFER_PAYLOAD_SIZE) {
+        // Nothing to mask, a long payload is sent from the caller's buffer rather than copied
+        if (ws_write_all(ws->parent, ws_header, header_len, timeout_ms) != header_len
+                || ws_write_all(ws->parent, b, len, timeout_ms) != len) {
+            ESP_LOGE(TAG, "Error write frame");
+            return -1;
+        }
+        return len;
     }
 
-    int ret = esp_transport_write(ws->parent, buffer, len, timeout_ms);
-    // in case of masked transport we have to revert back to the original data, as ws layer
-    // does not create its own copy of data to be sent
-    if (mask_flag) {
-        mask = &ws_header[header_len-4];
-        for (i = 0; i < len; ++i) {
-            buffer[i] = (buffer[i] ^ mask[i % 4]);
+    // The payload is masked into ws->buffer, chunk by chunk, as the caller's data must not be modified.
+    // The header is placed right before the first chunk so that both are sent by one write
+    char *payload = ws->buffer + MAX_WEBSOCKET_HEADER_SIZE;
+    char *frame = payload - header_len;
+    int frame_len = header_len;
+    int sent = 0;
+    memcpy(frame, ws_header, header_len);
+    do {
+        // Chunks are a multiple of 4 bytes long, each one starts with mask[0]
+        int chunk_len = (len - sent < WS_BUFFER_PAYLOAD_SIZE) ? (len - sent) : WS_BUFFER_PAYLOAD_SIZE;
+        if (chunk_len && mask) {
+            ws_mask(payload, b + sent, chunk_len, mask);
+        } else if (chunk_len) {
+            memcpy(payload, b + sent, chunk_len);
         }
-    }
-    return ret;
+        frame_len += chunk_len;
+        if (ws_write_all(ws->parent, frame, frame_len, timeout_ms) != frame_len) {
+            ESP_LOGE(TAG, "Error write frame");
+            return -1;
+        }
+        sent += chunk_len;
+        frame = payload;
+        frame_len = 0;
+    } while (sent < len);
+    return len;
 }
 
 int esp_transport_ws_send_raw(esp_transport_handle_t t, ws_transport_opcodes_t opcode, const char *b, int len, int timeout_ms)
@@ -277,6 +337,22 @@ int esp_transport_ws_send_raw(esp_transport_handle_t t, ws_transport_opcodes_t o
     return _ws_write(t, op_code | WS_FIN, WS_MASK, b, len, timeout_ms);
 }
 
+int esp_transport_ws_send_fragment(esp_transport_handle_t t, ws_transport_opcodes_t opcode, const char *b, int len, bool fin, int timeout_ms)
+{
+    if (t == NULL || len < 0 || (len && b == NULL)
+            || (opcode != WS_TRANSPORT_OPCODES_TEXT && opcode != WS_TRANSPORT_OPCODES_BINARY)) {
+        ESP_LOGE(TAG, "Invalid arguments");
+        return -1;
+    }
+    transport_ws_t *ws = esp_transport_get_context_data(t);
+    // Only the first frame of the message gives its opcode, the following ones are continuation frames
+    uint8_t op_code = ws->sending_fragments ? WS_OPCODE_CONT : ws_get_bin_opcode(opcode);
+    ESP_LOGD(TAG, "Sending ws fragment with opcode %d, fin %d", op_code, fin);
+    int ret = _ws_write(t, op_code | (fin ? WS_FIN : 0), WS_MASK, b, len, timeout_ms);
+    ws->sending_fragments = (ret == len) && !fin;
+    return ret;
+}
+
 static int ws_write(esp_transport_handle_t t, const char *b, int len, int timeout_ms)
 {
     if (len == 0) {
@@ -290,6 +366,19 @@ static int ws_write(esp_transport_handle_t t, const char *b, int len, int timeou
 }
 
 
+static int ws_read_all(esp_transport_handle_t t, char *buffer, int len, int timeout_ms)
+{
+    int read = 0;
+    while (read < len) {
+        int ret = esp_transport_read(t, buffer + read, len - read, timeout_ms);
+        if (ret <= 0) {
+            return -1;
+        }
+        read += ret;
+    }
+    return read;
+}
+
 static int ws_read_payload(esp_transport_handle_t t, char *buffer, int len, int timeout_ms)
 {
     transport_ws_t *ws = esp_transport_get_context_data(t);
@@ -298,7 +387,7 @@ static int ws_read_payload(esp_transport_handle_t t, char *buffer, int len, int
     int rlen = 0;
 
     if (ws->frame_state.bytes_remaining > len) {
-        ESP_LOGD(TAG, "Actual data to receive (%d) are longer than ws buffer (%d)", ws->frame_state.bytes_remaining, len);
+        ESP_LOGD(TAG, "Actual data to receive (%llu) are longer than ws buffer (%d)", (unsigned long long)ws->frame_state.bytes_remaining, len);
         bytes_to_read = len;
 
     } else {
@@ -310,82 +399,70 @@ static int ws_read_payload(esp_transport_handle_t t, char *buffer, int len, int
         ESP_LOGE(TAG, "Error read data");
         return rlen;
     }
-    ws->frame_state.bytes_remaining -= rlen;
-
-    if (ws->frame_state.mask_key) {
-        for (int i = 0; i < bytes_to_read; i++) {
-            buffer[i] = (buffer[i] ^ ws->frame_state.mask_key[i % 4]);
+    if (ws->frame_state.masked) {
+        // The payload may be read in several parts, the mask is rotated to where this one starts
+        uint64_t offset = ws->frame_state.payload_len - ws->frame_state.bytes_remaining;
+        char mask[4];
+        for (int i = 0; i < 4; i++) {
+            mask[i] = ws->frame_state.mask_key[(offset + i) % 4];
         }
+        ws_mask(buffer, buffer, rlen, mask);
     }
+    ws->frame_state.bytes_remaining -= rlen;
     return rlen;
 }
 
 
-/* Read and parse the WS header, determine length of payload */
-static int ws_read_header(esp_transport_handle_t t, char *buffer, int len, int timeout_ms)
+/* Read and parse the WS header, determine length of payload.
+   Returns 1 once the header is read, 0 if no frame started before the timeout, -1 on errors */
+static int ws_read_header(esp_transport_handle_t t, int timeout_ms)
 {
     transport_ws_t *ws = esp_transport_get_context_data(t);
-    int payload_len;
-
-    char ws_header[MAX_WEBSOCKET_HEADER_SIZE];
-    char *data_ptr = ws_header, mask;
-    int rlen;
+    uint8_t ws_header[MAX_WEBSOCKET_HEADER_SIZE];
+    uint64_t payload_len;
     int poll_read;
     if ((poll_read = esp_transport_poll_read(ws->parent, timeout_ms)) <= 0) {
         return poll_read;
     }
 
     // Receive and process header first (based on header size)
-    int header = 2;
-    int mask_len = 4;
-    if ((rlen = esp_transport_read(ws->parent, data_ptr, header, timeout_ms)) <= 0) {
+    if (ws_read_all(ws->parent, (char *)ws_header, 2, timeout_ms) < 0) {
         ESP_LOGE(TAG, "Error read data");
-        return rlen;
+        return -1;
     }
-    ws->frame_state.opcode = (*data_ptr & 0x0F);
-    data_ptr ++;
-    mask = ((*data_ptr >> 7) & 0x01);
-    payload_len = (*data_ptr & 0x7F);
-    data_ptr++;
-    ESP_LOGD(TAG, "Opcode: %d, mask: %d, len: %d\r\n", ws->frame_state.opcode, mask, payload_len);
-    if (payload_len == 126) {
-        // headerLen += 2;
-        if ((rlen = esp_transport_read(ws->parent, data_ptr, header, timeout_ms)) <= 0) {
-            ESP_LOGE(TAG, "Error read data");
-            return rlen;
-        }
-        payload_len = data_ptr[0] << 8 | data_ptr[1];
-    } else if (payload_len == 127) {
-        // headerLen += 8;
-        header = 8;
-        if ((rlen = esp_transport_read(ws->parent, data_ptr, header, timeout_ms)) <= 0) {
+    ws->frame_state.fin = (ws_header[0] & WS_FIN) != 0;
+    ws->frame_state.opcode = (ws_header[0] & 0x0F);
+    ws->frame_state.masked = (ws_header[1] & WS_MASK) != 0;
+    payload_len = (ws_header[1] & 0x7F);
+
+    // Extended payload length of 2 or 8 bytes, in network order
+    int len_size = (payload_len == WS_SIZE16) ? 2 : (payload_len == WS_SIZE64) ? 8 : 0;
+    if (len_size) {
+        if (ws_read_all(ws->parent, (char *)ws_header, len_size, timeout_ms) < 0) {
             ESP_LOGE(TAG, "Error read data");
-            return rlen;
+            return -1;
         }
-
-        if (data_ptr[0] != 0 || data_ptr[1] != 0 || data_ptr[2] != 0 || data_ptr[3] != 0) {
-            // really too big!
-            payload_len = 0xFFFFFFFF;
-        } else {
-            payload_len = data_ptr[4] << 24 | data_ptr[5] << 16 | data_ptr[6] << 8 | data_ptr[7];
+        payload_len = 0;
+        for (int i = 0; i < len_size; i++) {
+            payload_len = (payload_len << 8) | ws_header[i];
         }
     }
 
-    if (mask) {
-        // Read and store mask
-        if (payload_len != 0 && (rlen = esp_transport_read(ws->parent, buffer, mask_len, timeout_ms)) <= 0) {
+    if (ws->frame_state.masked) {
+        // Read and store mask, which comes even with an empty payload
+        if (ws_read_all(ws->parent, ws->frame_state.mask_key, sizeof(ws->frame_state.mask_key), timeout_ms) < 0) {
             ESP_LOGE(TAG, "Error read data");
-            return rlen;
+            return -1;
         }
-        memcpy(ws->frame_state.mask_key, buffer, mask_len);
     } else {
-        memset(ws->frame_state.mask_key, 0, mask_len);
+        memset(ws->frame_state.mask_key, 0, sizeof(ws->frame_state.mask_key));
     }
+    ESP_LOGD(TAG, "Opcode: %d, fin: %d, mask: %d, len: %llu", ws->frame_state.opcode, ws->frame_state.fin, ws->frame_state.masked, (unsigned long long)payload_len);
 
     ws->frame_state.payload_len = payload_len;
     ws->frame_state.bytes_remaining = payload_len;
 
-    return payload_len;
+    return 1;
 }
 
 static int ws_read(esp_transport_handle_t t, char *buffer, int len, int timeout_ms)
@@ -394,12 +471,13 @@ static int ws_read(esp_transport_handle_t t, char *buffer, int len, int timeout_
     transport_ws_t *ws = esp_transport_get_context_data(t);
 
     // If message exceeds buffer len then subsequent reads will skip reading header and read whatever is left of the payload
-    if (ws->frame_state.bytes_remaining <= 0) {
-        if ( (rlen = ws_read_header(t, buffer, len, timeout_ms)) <= 0) {
+    if (ws->frame_state.bytes_remaining == 0) {
+        if ( (rlen = ws_read_header(t, timeout_ms)) <= 0) {
             // If something when wrong then we prepare for reading a new header
             ws->frame_state.bytes_remaining = 0;
             return rlen;
         }
+        rlen = 0;
     }
     if (ws->frame_state.payload_len) {
         if ( (rlen = ws_read_payload(t, buffer, len, timeout_ms)) <= 0) {
@@ -412,6 +490,102 @@ static int ws_read(esp_transport_handle_t t, char *buffer, int len, int timeout_
     return rlen;
 }
 
+/* Check a frame against the message being read and start the message of a first frame */
+static esp_err_t ws_check_frame(transport_ws_t *ws)
+{
+    ws_transport_frame_state_t *frame = &ws->frame_state;
+
+    switch (frame->opcode) {
+    case WS_OPCODE_CLOSE:
+    case WS_OPCODE_PING:
+    case WS_OPCODE_PONG:
+        // Control frames come whole, possibly between the frames of a message
+        if (!frame->fin || frame->payload_len > 125) {
+            ESP_LOGE(TAG, "Invalid control frame, fin: %d, len: %llu", frame->fin, (unsigned long long)frame->payload_len);
+            return ESP_FAIL;
+        }
+        return ESP_OK;
+    case WS_OPCODE_CONT:
+        if (ws->message_state.opcode == 0) {
+            ESP_LOGE(TAG, "Continuation frame without a message");
+            return ESP_FAIL;
+        }
+        return ESP_OK;
+    case WS_OPCODE_TEXT:
+    case WS_OPCODE_BINARY:
+        if (ws->message_state.opcode != 0) {
+            ESP_LOGE(TAG, "New message before the end of the previous one");
+            return ESP_FAIL;
+        }
+        ws->message_state.opcode = frame->opcode;
+        ws->message_state.offset = 0;
+        return ESP_OK;
+    default:
+        ESP_LOGE(TAG, "Unknown opcode %d", frame->opcode);
+        return ESP_FAIL;
+    }
+}
+
+int esp_transport_ws_read_message(esp_transport_handle_t t, char *buffer, int len,
+                                  ws_transport_message_cb_t callback, void *user_ctx, int timeout_ms)
+{
+    if (t == NULL || buffer == NULL || len <= 0 || callback == NULL) {
+        ESP_LOGE(TAG, "Invalid arguments");
+        return -1;
+    }
+    transport_ws_t *ws = esp_transport_get_context_data(t);
+    ws_transport_frame_state_t *frame = &ws->frame_state;
+
+    while (1) {
+        // A frame is left to read if the previous call timed out in its payload
+        if (frame->bytes_remaining == 0) {
+            int ret = ws_read_header(t, timeout_ms);
+            if (ret <= 0) {
+                return ret;
+            }
+            if (ws_check_frame(ws) != ESP_OK) {
+                goto error;
+            }
+        }
+        bool control = (frame->opcode & 0x08) != 0;
+        ws_transport_opcodes_t opcode = control ? frame->opcode : ws->message_state.opcode;
+        do {
+            uint64_t offset = control ? frame->payload_len - frame->bytes_remaining : ws->message_state.offset;
+            int rlen = 0;
+            if (frame->bytes_remaining) {
+                rlen = ws_read_payload(t, buffer, len, timeout_ms);
+                if (rlen == 0) {
+                    // Timed out, the next call goes on with the rest of the frame
+                    return 0;
+                } else if (rlen < 0) {
+                    goto error;
+                }
+            }
+            bool fin = frame->fin && frame->bytes_remaining == 0;
+            // Empty frames are only delivered when they end a message
+            if ((rlen || fin) && callback(opcode, buffer, rlen, offset, fin, user_ctx) != ESP_OK) {
+                ESP_LOGD(TAG, "Reading stopped by the callback");
+                goto error;
+            }
+            if (!control) {
+                ws->message_state.offset += rlen;
+            }
+        } while (frame->bytes_remaining);
+
+        if (frame->fin) {
+            if (!control) {
+                ws->message_state.opcode = 0;
+            }
+            return 1;
+        }
+    }
+
+error:
+    frame->bytes_remaining = 0;
+    ws->message_state.opcode = 0;
+    return -1;
+}
+
 
 static int ws_poll_read(esp_transport_handle_t t, int timeout_ms)
 {
@@ -545,7 +719,7 @@ ws_transport_opcodes_t esp_transport_ws_get_read_opcode(esp_transport_handle_t t
 int esp_transport_ws_get_read_payload_len(esp_transport_handle_t t)
 {
     transport_ws_t *ws = esp_transport_get_context_data(t);
-    return ws->frame_state.payload_len;
+    return (ws->frame_state.payload_len > INT_MAX) ? INT_MAX : (int)ws->frame_state.payload_len;
 }
 
 
@@ -0,0 +1,357 @@
+#!/usr/bin/env python
+#
+# Turns the binary log records written by ESP_LOGx with CONFIG_LOG_BINARY back into log lines,
+# with the format strings and tags read from the ELF file of the application. The text written
+# around the records, by the bootloader, ESP_EARLY_LOGx or printf(), is passed through.
+#
+# Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+from __future__ import print_function, division
+from __future__ import unicode_literals
+import argparse
+import os
+import re
+import struct
+import sys
+
+# The record layout is described in components/log/log.c
+LOG_BINARY_MAGIC = 0xfe
+LOG_BINARY_TRUNCATED = 0x80
+
+# Types of the arguments in the signature of a record, as in components/log/include/esp_log.h
+ARG_BITS = 3
+ARG_INT = 1
+ARG_LONG = 2
+ARG_INT64 = 3
+ARG_DOUBLE = 4
+ARG_STR = 5
+ARG_PTR = 6
+
+FORMAT_SECTION = '.esp_log_fmt'
+
+LEVEL_LETTERS = 'NEWIDV'
+LEVEL_COLORS = [0, 31, 33, 32, 0, 0]
+
+# printf conversion specification: flags, width, precision, length modifier and conversion
+MATCH_CONVERSION = re.compile(r'%([-+ #0]*)(\*|[0-9]+)?(?:\.(\*|[0-9]*))?(hh|h|ll|l|j|z|t|L|q)?([diouxXeEfFgGaAcspn%])')
+
+
+class ElfStrings(object):
+    """
+    Format strings and tags of the log records, read from the ELF file of the application
+    """
+    def __init__(self, elf_file):
+        from elftools.elf.elffile import ELFFile
+        from elftools.elf.constants import SH_FLAGS
+
+        self.formats = None
+        self.sections = []
+        with open(elf_file, 'rb') as f:
+            elf = ELFFile(f)
+            for section in elf.iter_sections():
+                if section.name == FORMAT_SECTION:
+                    self.formats = (section['sh_addr'], section.data())
+                elif section['sh_flags'] & SH_FLAGS.SHF_ALLOC and section['sh_type'] == 'SHT_PROGBITS':
+                    self.sections.append((section['sh_addr'], section.data()))
+
+    def has_formats(self):
+        return self.formats is not None
+
+    @staticmethod
+    def _read_string(section, addr):
+        start, data = section
+        offset = addr - start
+        if offset < 0 or offset >= len(data):
+            return None
+        end = data.find(b'\0', offset)
+        return data[offset:end if end >= 0 else len(data)].decode('utf-8', 'replace')
+
+    def format(self, addr):
+        return self._read_string(self.formats, addr) if self.formats else None
+
+    def tag(self, addr):
+        for section in self.sections:
+            tag = self._read_string(section, addr)
+            if tag is not None:
+                return tag
+        return None
+
+
+class RecordReader(object):
+    def __init__(self, payload):
+        self.payload = payload
+        self.pos = 0
+
+    def done(self):
+        return self.pos >= len(self.payload)
+
+    def byte(self):
+        self.pos += 1
+        return self.payload[self.pos - 1]
+
+    def varint(self):
+        value = 0
+        shift = 0
+        while True:
+            b = self.byte()
+            value |= (b & 0x7f) << shift
+            shift += 7
+            if not b & 0x80:
+                return value
+
+    def unpack(self, fmt):
+        size = struct.calcsize(fmt)
+        if self.pos + size > len(self.payload):
+            raise IndexError('record too short')
+        value = struct.unpack_from(fmt, bytes(self.payload), self.pos)[0]
+        self.pos += size
+        return value
+
+    def string(self):
+        end = self.payload.find(b'\0', self.pos)
+        if end < 0:
+            raise IndexError('string not terminated')
+        value = bytes(self.payload[self.pos:end]).decode('utf-8', 'replace')
+        self.pos = end + 1
+        return value
+
+
+def format_arg(flags, width, precision, length, conversion, arg):
+    """ Formats one argument like printf() on the target, where int and long are 32 bits """
+    kind, value = arg
+    spec = '%' + flags + (width or '') + ('.' + precision if precision is not None else '')
+
+    if kind == ARG_STR:
+        return (spec + 's') % value if conversion == 's' else value
+    if kind == ARG_DOUBLE:
+        if conversion in 'aA':
+            return value.hex()
+        return (spec + conversion) % value if conversion in 'eEfFgG' else str(value)
+
+    bits = 64 if kind == ARG_INT64 else 32
+    if length == 'hh':
+        bits = 8
+    elif length == 'h':
+        bits = 16
+    value &= (1 << bits) - 1
+    if conversion in 'di':
+        if value >= 1 << (bits - 1):
+            value -= 1 << bits
+        return (spec + 'd') % value
+    if conversion == 'u':
+        return (spec + 'd') % value
+    if conversion == 'o' and '#' in flags:
+        # Python writes "0o" where C writes "0"
+        return ('0' if value else '') + (spec.replace('#', '') + 'o') % value
+    if conversion in 'oxX':
+        return (spec + conversion) % value
+    if conversion == 'c':
+        return (spec + 'c') % chr(value & 0xff)
+    if conversion == 'p':
+        return (spec.replace('#', '').replace('0', '') + 's') % ('0x%x' % value)
+    return '0x%x' % value
+
+
+def format_printf(fmt, args):
+    """ printf() of the arguments of a record, conversions without an argument are kept as they are """
+    args = list(args)
+    out = []
+    pos = 0
+    for m in MATCH_CONVERSION.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        pos = m.end()
+        flags, width, precision, length, conversion = m.groups()
+        if conversion == '%':
+            out.append('%')
+            continue
+        if width == '*' or precision == '*':
+            if len(args) < (width == '*') + (precision == '*') + 1:
+                out.append(m.group(0))
+                args = []
+                continue
+            if width == '*':
+                width = str(format_arg('', None, None, None, 'd', args.pop(0)))
+                if width.startswith('-'):
+                    flags += '-'
+                    width = width[1:]
+            if precision == '*':
+                precision = str(max(int(format_arg('', None, None, None, 'd', args.pop(0))), 0))
+        if not args:
+            out.append(m.group(0))
+            continue
+        arg = args.pop(0)
+        if conversion != 'n':
+            out.append(format_arg(flags, width, precision, length, conversion, arg))
+    out.append(fmt[pos:])
+    return ''.join(out)
+
+
+class LogDecoder(object):
+    """
+    Turns the binary log records found in the output of the target into log lines
+
+    strings gives the format string and the tag at their addresses, like ElfStrings
+    """
+    def __init__(self, strings, colors=True):
+        self.strings = strings
+        self.colors = colors
+        self._pending = bytearray()
+
+    def decode_record(self, payload):
+        reader = RecordReader(payload)
+        level = reader.byte()
+        truncated = level & LOG_BINARY_TRUNCATED
+        level &= ~LOG_BINARY_TRUNCATED
+        fmt_addr = reader.varint()
+        timestamp = reader.varint()
+        tag_addr = reader.unpack('<I')
+        signature = reader.varint()
+
+        args = []
+        try:
+            while signature and not reader.done():
+                kind = signature & ((1 << ARG_BITS) - 1)
+                signature >>= ARG_BITS
+                if kind in (ARG_INT, ARG_LONG, ARG_INT64):
+                    args.append((kind, reader.varint()))
+                elif kind == ARG_DOUBLE:
+                    args.append((kind, reader.unpack('<d')))
+                elif kind == ARG_STR:
+                    args.append((kind, reader.string()))
+                elif kind == ARG_PTR:
+                    args.append((kind, reader.unpack('<I')))
+                else:
+                    raise IndexError('bad signature')
+        except IndexError:
+            truncated = True
+
+        fmt = self.strings.format(fmt_addr)
+        if fmt is None:
+            text = '<unknown format 0x%x>%s' % (fmt_addr, ''.join(' ' + str(value) for _, value in args))
+        else:
+            text = format_printf(fmt, args)
+        if truncated:
+            text += ' <truncated>'
+        tag = self.strings.tag(tag_addr)
+        if tag is None:
+            tag = '0x%08x' % tag_addr
+
+        letter = LEVEL_LETTERS[level] if level < len(LEVEL_LETTERS) else 'N'
+        line = '%s (%d) %s: %s' % (letter, timestamp, tag, text)
+        color = LEVEL_COLORS[level] if level < len(LEVEL_COLORS) else 0
+        if self.colors and color:
+            line = '\033[0;%dm%s\033[0m' % (color, line)
+        return line + '\n'
+
+    def decode(self, data):
+        """
+        Returns the data with its records replaced by their lines. A record which isn't complete
+        yet is kept until the next call.
+        """
+        buf = self._pending + bytearray(data)
+        self._pending = bytearray()
+        out = bytearray()
+        pos = 0
+        while True:
+            start = buf.find(bytearray([LOG_BINARY_MAGIC]), pos)
+            if start < 0:
+                out += buf[pos:]
+                break
+            out += buf[pos:start]
+            if len(buf) < start + 2 or len(buf) < start + 3 + buf[start + 1]:
+                self._pending = buf[start:]
+                break
+            end = start + 2 + buf[start + 1]
+            payload = buf[start + 2:end]
+            # Anything else is passed through
+            if not payload or sum(payload) & 0xff != buf[end]:
+                out += buf[start:start + 1]
+                pos = start + 1
+                continue
+            try:
+                out += self.decode_record(payload).encode('utf-8')
+            except IndexError:
+                out += buf[start:end + 1]
+            pos = end + 1
+        return bytes(out)
+
+    def flush(self):
+        """ Returns the bytes kept for a record which will not be completed """
+        pending = bytes(self._pending)
+        self._pending = bytearray()
+        return pending
+
+
+def main():
+    parser = argparse.ArgumentParser("idf_log_decoder - decode the binary log records of ESP_LOGx")
+
+    parser.add_argument(
+        'elf_file', help='ELF file of application')
+
+    parser.add_argument(
+        'input', nargs='?',
+        help='File holding the output of the application, the standard input by default')
+
+    parser.add_argument(
+        '--port', '-p',
+        help='Serial port device to read the output of the application from')
+
+    parser.add_argument(
+        '--baud', '-b',
+        help='Serial port baud rate',
+        type=int,
+        default=os.environ.get('MONITOR_BAUD', 115200))
+
+    parser.add_argument(
+        '--no-color',
+        help='Write the lines without ANSI colors',
+        action='store_true')
+
+    args = parser.parse_args()
+
+    strings = ElfStrings(args.elf_file)
+    if not strings.has_formats():
+        print('%s has no %s section, the application is not built with CONFIG_LOG_BINARY' %
+              (args.elf_file, FORMAT_SECTION), file=sys.stderr)
+        sys.exit(1)
+    decoder = LogDecoder(strings, colors=not args.no_color)
+    output = getattr(sys.stdout, 'buffer', sys.stdout)
+
+    if args.port:
+        import serial
+        serial_instance = serial.serial_for_url(args.port, args.baud, do_not_open=True)
+        serial_instance.dtr = False
+        serial_instance.rts = False
+        serial_instance.open()
+        read = lambda: serial_instance.read(serial_instance.in_waiting or 1)  # noqa: E731
+    else:
+        fd = os.open(args.input, os.O_RDONLY) if args.input else sys.stdin.fileno()
+        read = lambda: os.read(fd, 4096)  # noqa: E731
+
+    try:
+        while True:
+            data = read()
+            if not data and not args.port:
+                break
+            output.write(decoder.decode(data))
+            output.flush()
+    except KeyboardInterrupt:
+        pass
+    output.write(decoder.flush())
+    output.flush()
+
+
+if __name__ == "__main__":
+    main()
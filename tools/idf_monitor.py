@@ -52,6 +52,7 @@ import ctypes
 import types
 from distutils.version import StrictVersion
 from io import open
+from idf_log_decoder import ElfStrings, LogDecoder
 
 key_description = miniterm.key_description
 
@@ -359,6 +360,14 @@ class Monitor(object):
         self._output_enabled = True
         self._serial_check_exit = socket_mode
         self._log_file = None
+        self._log_decoder = None
+        try:
+            strings = ElfStrings(elf_file)
+            if strings.has_formats():
+                # the application writes binary log records (CONFIG_LOG_BINARY)
+                self._log_decoder = LogDecoder(strings)
+        except Exception:
+            pass  # pyelftools isn't installed or the ELF file can't be read, records are printed as they are
 
     def invoke_processing_last_line(self):
         self.event_queue.put((TAG_SERIAL_FLUSH, b''), False)
@@ -419,6 +428,8 @@ class Monitor(object):
                 pass  # this can happen if a non-ascii character was passed, ignoring
 
     def handle_serial_input(self, data, finalize_line=False):
+        if self._log_decoder:
+            data = self._log_decoder.decode(data)
         sp = data.split(b'\n')
         if self._last_line_part != b"":
             # add unprocessed part from previous "data" to the first line
@@ -754,6 +765,8 @@ def main():
         key_description(CTRL_H)))
     if args.print_filter != DEFAULT_PRINT_FILTER:
         yellow_print('--- Print filter: {} ---'.format(args.print_filter))
+    if monitor._log_decoder:
+        yellow_print('--- Decoding binary log records with {} ---'.format(args.elf_file.name))
 
     monitor.main_loop()
 
@@ -0,0 +1,148 @@
+#!/usr/bin/env python
+#
+# Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+import struct
+import unittest
+from idf_log_decoder import LogDecoder
+from idf_log_decoder import format_printf
+from idf_log_decoder import ARG_INT, ARG_LONG, ARG_INT64, ARG_DOUBLE, ARG_STR, ARG_PTR
+
+
+class Strings(object):
+    """ Format strings and tags at their addresses, as ElfStrings reads them from the ELF file """
+    def __init__(self, formats, tags):
+        self.formats = formats
+        self.tags = tags
+
+    def format(self, addr):
+        return self.formats.get(addr)
+
+    def tag(self, addr):
+        return self.tags.get(addr)
+
+
+def varint(value):
+    out = bytearray()
+    while value >= 0x80:
+        out.append(value & 0x7f | 0x80)
+        value >>= 7
+    out.append(value)
+    return out
+
+
+def record(level, fmt, timestamp, tag, args=(), truncated=False):
+    """ Encodes a record like esp_log_binary_write() """
+    signature = 0
+    payload = bytearray()
+    for i, (kind, value) in enumerate(args):
+        signature |= kind << (3 * i)
+        if kind in (ARG_INT, ARG_LONG):
+            payload += varint(value & 0xffffffff)
+        elif kind == ARG_INT64:
+            payload += varint(value & 0xffffffffffffffff)
+        elif kind == ARG_DOUBLE:
+            payload += struct.pack('<d', value)
+        elif kind == ARG_STR:
+            payload += value.encode('utf-8') + b'\0'
+        else:
+            payload += struct.pack('<I', value)
+    payload = (bytearray([level | (0x80 if truncated else 0)]) + varint(fmt) + varint(timestamp) +
+               struct.pack('<I', tag) + varint(signature) + payload)
+    return bytes(bytearray([0xfe, len(payload)]) + payload + bytearray([sum(payload) & 0xff]))
+
+
+FORMATS = {
+    0: 'no arguments',
+    13: 'value %d of %u',
+    28: 'int %d long %ld long long %lld double %.3f char %c string %s pointer %p',
+}
+TAG = 0x3ffe8000
+
+
+class TestLogDecoder(unittest.TestCase):
+    def setUp(self):
+        self.decoder = LogDecoder(Strings(FORMATS, {TAG: 'wifi'}), colors=False)
+
+    def test_arguments(self):
+        data = record(3, 28, 1234, TAG, [(ARG_INT, -5), (ARG_LONG, 123456), (ARG_INT64, -1234567890123),
+                                         (ARG_DOUBLE, 2.5), (ARG_INT, ord('x')), (ARG_STR, 'hello'),
+                                         (ARG_PTR, 0x3ffe1234)])
+        self.assertEqual(self.decoder.decode(data),
+                         b'I (1234) wifi: int -5 long 123456 long long -1234567890123 double 2.500 '
+                         b'char x string hello pointer 0x3ffe1234\n')
+
+    def test_levels_and_colors(self):
+        self.decoder.colors = True
+        self.assertEqual(self.decoder.decode(record(1, 0, 1, TAG)), b'\033[0;31mE (1) wifi: no arguments\033[0m\n')
+        self.assertEqual(self.decoder.decode(record(2, 0, 2, TAG)), b'\033[0;33mW (2) wifi: no arguments\033[0m\n')
+        self.assertEqual(self.decoder.decode(record(4, 0, 3, TAG)), b'D (3) wifi: no arguments\n')
+        self.assertEqual(self.decoder.decode(record(5, 0, 4, TAG)), b'V (4) wifi: no arguments\n')
+
+    def test_text_around_records(self):
+        data = b'boot text\n' + record(3, 13, 10, TAG, [(ARG_INT, -1), (ARG_INT, -1)]) + b'printf\n'
+        self.assertEqual(self.decoder.decode(data), b'boot text\nI (10) wifi: value -1 of 4294967295\nprintf\n')
+
+    def test_records_split_between_reads(self):
+        data = record(3, 13, 10, TAG, [(ARG_INT, 1), (ARG_INT, 2)]) * 2
+        out = b''.join(self.decoder.decode(data[i:i + 1]) for i in range(len(data)))
+        self.assertEqual(out, b'I (10) wifi: value 1 of 2\n' * 2)
+        self.assertEqual(self.decoder.flush(), b'')
+
+    def test_bad_checksum_is_passed_through(self):
+        data = bytearray(record(3, 0, 10, TAG))
+        data[-1] ^= 1
+        # The end of the record may be the start of another one, until the next read
+        self.assertEqual(self.decoder.decode(bytes(data)) + self.decoder.flush(), bytes(data))
+
+    def test_incomplete_record_is_kept(self):
+        data = record(3, 0, 10, TAG)
+        self.assertEqual(self.decoder.decode(b'text' + data[:-2]), b'text')
+        self.assertEqual(self.decoder.flush(), data[:-2])
+
+    def test_truncated_record(self):
+        data = record(4, 13, 10, TAG, [(ARG_INT, 1)], truncated=True)
+        self.assertEqual(self.decoder.decode(data), b'D (10) wifi: value 1 of %u <truncated>\n')
+
+    def test_unknown_format_and_tag(self):
+        data = record(3, 99, 10, 0x40001234, [(ARG_INT, 7), (ARG_STR, 'x')])
+        self.assertEqual(self.decoder.decode(data), b'I (10) 0x40001234: <unknown format 0x63> 7 x\n')
+
+
+class TestFormatPrintf(unittest.TestCase):
+    def test_conversions(self):
+        self.assertEqual(format_printf('%5d|%-5d|%05d|%+d', [(ARG_INT, 42), (ARG_INT, 42), (ARG_INT, 42), (ARG_INT, 42)]),
+                         '   42|42   |00042|+42')
+        self.assertEqual(format_printf('%x %X %#x %o %#o', [(ARG_INT, 255)] * 5), 'ff FF 0xff 377 0377')
+        self.assertEqual(format_printf('%u %lu %llu', [(ARG_INT, -1), (ARG_LONG, -1), (ARG_INT64, -1)]),
+                         '4294967295 4294967295 18446744073709551615')
+        self.assertEqual(format_printf('%hhd %hu', [(ARG_INT, 0x1ff), (ARG_INT, -1)]), '-1 65535')
+        self.assertEqual(format_printf('%.2f %e %g', [(ARG_DOUBLE, 3.14159)] * 3), '3.14 3.141590e+00 3.14159')
+        self.assertEqual(format_printf('%s|%8s|%-4s|%.2s', [(ARG_STR, 'abc')] * 4), 'abc|     abc|abc |ab')
+        self.assertEqual(format_printf('%c%c', [(ARG_INT, ord('o')), (ARG_INT, ord('k'))]), 'ok')
+        self.assertEqual(format_printf('%p', [(ARG_PTR, 0x1234)]), '0x1234')
+        self.assertEqual(format_printf('100%%', []), '100%')
+
+    def test_star_width_and_precision(self):
+        self.assertEqual(format_printf('%*d|%-*d|%.*s', [(ARG_INT, 4), (ARG_INT, 7), (ARG_INT, 3), (ARG_INT, 7),
+                                                         (ARG_INT, 2), (ARG_STR, 'abcdef')]),
+                         '   7|7  |ab')
+
+    def test_missing_arguments(self):
+        self.assertEqual(format_printf('%d and %s', [(ARG_INT, 1)]), '1 and %s')
+
+
+if __name__ == "__main__":
+    unittest.main()